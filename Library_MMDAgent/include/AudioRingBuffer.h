@@ -0,0 +1,95 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <atomic>
+
+/* AudioRingBuffer: lock-free ring buffer of 16bit audio samples for one producer thread and one consumer thread */
+/* the producer only advances the write point and the consumer only advances the read point, so no mutex is required */
+class AudioRingBuffer
+{
+private:
+
+   std::atomic<short *> m_buffer; /* sample buffer, length is power of 2, published after the other members are set */
+   size_t m_size;   /* length of m_buffer in samples */
+   size_t m_mask;   /* m_size - 1 */
+   int m_frequency; /* sampling frequency, used to compute latency */
+
+   std::atomic<size_t> m_writePoint;  /* total number of written samples, modified only by producer */
+   std::atomic<size_t> m_readPoint;   /* total number of read samples, modified only by consumer */
+   std::atomic<bool> m_flushRequest;  /* true when buffered samples should be discarded at next read */
+
+   std::atomic<unsigned int> m_underrunCount; /* number of reads which could not get a full block */
+   std::atomic<size_t> m_droppedSamples;      /* number of samples dropped by overflow */
+   std::atomic<size_t> m_queuedSamples;       /* number of samples queued at the last read */
+   std::atomic<size_t> m_maxQueuedSamples;    /* maximum number of queued samples at read */
+
+   /* initialize: initialize buffer */
+   void initialize();
+
+   /* clear: free buffer */
+   void clear();
+
+   /* processFlushRequest: discard buffered samples if requested, called from consumer */
+   void processFlushRequest();
+
+public:
+
+   /* AudioRingBuffer: constructor */
+   AudioRingBuffer();
+
+   /* ~AudioRingBuffer: destructor */
+   ~AudioRingBuffer();
+
+   /* setup: allocate buffer which can hold at least the given number of samples */
+   bool setup(size_t samples, int frequency);
+
+   /* isReady: return true when buffer is allocated */
+   bool isReady();
+
+   /* getWritable: get number of samples which can be written now, called from producer */
+   size_t getWritable();
+
+   /* write: copy samples into buffer and return number of stored samples, rest will be dropped, called from producer */
+   size_t write(const short *data, size_t num);
+
+   /* getReadable: get number of samples which can be read now, called from consumer */
+   size_t getReadable();
+
+   /* read: copy samples into buf and return number of read samples, called from consumer */
+   /* when partial is false, nothing is read unless num samples are available and the shortage is counted as underrun */
+   size_t read(short *buf, size_t num, bool partial);
+
+   /* discard: discard all buffered samples, called from consumer */
+   void discard();
+
+   /* requestFlush: request consumer to discard buffered samples at next read, can be called from any thread */
+   void requestFlush();
+
+   /* getUnderrunCount: get number of underruns */
+   unsigned int getUnderrunCount();
+
+   /* getDroppedSamples: get number of samples dropped by overflow */
+   size_t getDroppedSamples();
+
+   /* getLatencyMSec: get latency of the last read in msec */
+   double getLatencyMSec();
+
+   /* getMaxLatencyMSec: get maximum latency in msec */
+   double getMaxLatencyMSec();
+
+   /* resetStatistics: reset underrun, overflow and latency counters */
+   void resetStatistics();
+};
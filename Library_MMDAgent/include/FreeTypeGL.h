@@ -102,6 +102,8 @@
 #define FREETYPEGL_DEFAULTFONTSIZEINCOORD 0.85f /* default font scaling factor */
 #define FREETYPEGL_MAXTEXTLEN             16383
 #define FREETYLEGL_MAXOUTLINEUNITNUM      30
+#define FREETYPEGL_TEXTCACHESIZE          256  /* number of slots in the text layout cache */
+#define FREETYPEGL_TEXTCACHEMAXLEN        1024 /* texts longer than this in bytes are not cached */
 
 /* FTGLTextureAtlas: character texture manager */
 class FTGLTextureAtlas
@@ -120,6 +122,8 @@ private:
    size_t m_depth;        /* depth in bytes of the texture */
    GLuint m_id;           /* texture ID in OpenGL */
    unsigned char *m_data; /* texture data */
+   size_t m_dirtyY0;      /* first row modified since the last upload */
+   size_t m_dirtyY1;      /* last row + 1 modified since the last upload, 0 when none */
 
    /* initialize: initialize texture manager */
    void initialize();
@@ -144,7 +148,7 @@ public:
    /* getRegion: alocate a new region and return its location on texture, or return false when the texture is full */
    bool getRegion(size_t width, size_t height, size_t *x, size_t *y);
 
-   /* updateTexture: update the current texture data for OpenGL */
+   /* updateTexture: update the current texture data for OpenGL, only modified rows are uploaded */
    void updateTexture();
 
    /* getWidth: get width of the texture */
@@ -194,6 +198,22 @@ typedef struct _FTGLTextureGlyph {
    struct _FTGLTextureGlyph *next; /* link to next glyph */
 } FTGLTextureGlyph;
 
+/* FTGLTextCache: cached layout of a text placed at the origin */
+typedef struct _FTGLTextCache {
+   char *text;          /* text, NULL when the slot is empty */
+   unsigned int hash;   /* hash value of the key */
+   char langID[2];      /* language ID at layout */
+   int outlineUnit;     /* outline unit at layout, -1 when outline mode is disabled */
+   float linespace;     /* line space at layout */
+   float scalefactor;   /* scale factor at layout */
+   size_t num;          /* number of characters */
+   GLfloat *vertices;   /* vertex array relative to the origin */
+   GLfloat *texcoords;  /* texture coordinates array */
+   float width;         /* total width of the drawing area */
+   float height;        /* total height of the drawing area */
+   float upheight;      /* up height of the drawing area */
+} FTGLTextCache;
+
 class FTGLTextureFont;
 
 /* a set of rendering data for a text */
@@ -243,12 +263,26 @@ private:
 
    char m_langID[3];           /* language ID to display */
 
+   FTGLTextCache m_textCache[FREETYPEGL_TEXTCACHESIZE]; /* text layout cache */
+
    /* initialize: initialize font manager */
    void initialize();
 
    /* clear: free font manager */
    void clear();
 
+   /* getTextCacheHash: get hash value of a text layout key */
+   unsigned int getTextCacheHash(const char *text, float linespace, float scalefactor);
+
+   /* findTextCache: find cached layout of the text with the current language and outline mode */
+   FTGLTextCache *findTextCache(const char *text, float linespace, float scalefactor);
+
+   /* storeTextCache: store the layout of a text placed at (x, y) in elem from index */
+   void storeTextCache(const char *text, float linespace, float scalefactor, FTGLTextDrawElements *elem, size_t index, size_t num, float x, float y);
+
+   /* clearTextCache: free all cached layouts */
+   void clearTextCache();
+
    /* loadGlyph: load glyph */
    bool loadGlyph(unsigned long charcode);
 
@@ -80,6 +80,10 @@ private:
    bool m_narrowStringHasCase;
    FTGLTextDrawElements *m_drawElementNarrow; /* drawing element for rendering narrowing string */
    bool *m_noShowFlag;                   /* no show flag, used for narrowing */
+   int *m_showList;                      /* ring of line indices to be shown, from oldest */
+   int m_showHead;                       /* head position of m_showList */
+   int m_numShow;                        /* number of lines in m_showList */
+   int m_numNewLine;                     /* number of lines under highlighting transition */
 
    bool m_status;                        /* tatus, true when enabled, false when disabled */
    float m_transRate;                    /* transition rate */
@@ -93,8 +97,11 @@ private:
    /* LogText: free logger */
    void clear();
 
-   /* updateNarrow: update narrowing */
-   void updateNarrow();
+   /* updateNarrow: update narrowing, only shown lines are tested when narrower is true, else only hidden lines */
+   void updateNarrow(bool narrower);
+
+   /* rebuildShowList: rebuild list of lines to be shown */
+   void rebuildShowList();
 
    /* matchNarrow: check if string matches narrowing string */
    bool matchNarrow(const char *str);
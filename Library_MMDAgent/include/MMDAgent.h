@@ -218,7 +218,9 @@ class LogToFile;
 #include "FreeTypeGL.h"
 #include "LogText.h"
 #include "LipSync.h"
+#include "AudioRingBuffer.h"
 #include "KeyValue.h"
+#include "VariableStore.h"
 #include "BoneFaceControl.h"
 #include "PMDFaceInterface.h"
 #include "ShapeMap.h"
@@ -305,6 +307,7 @@ private:
 
    PMDObject *m_model;      /* models */
    int *m_renderOrder;      /* model rendering order */
+   int *m_poseSource;       /* index of model to take the pose from at current step, -1 when evaluated by itself */
    int m_numModel;          /* number of models */
    MotionStocker *m_motion; /* motions */
    bool m_hasExtModel;      /* true if displaying any ext model */
@@ -561,6 +564,9 @@ public:
    /* resetAdjustmentTimer: reset adjustment timer */
    void resetAdjustmentTimer();
 
+   /* resetAdjustmentTimer: reset adjustment timer to sync with audio heard from the given time */
+   void resetAdjustmentTimer(double audioStartTime);
+
    /* getModuleId: get module id */
    int getModuleId(const char *ident);
 
@@ -127,6 +127,9 @@ MMDAGENT_STAT MMDAgent_stat(const char *file);
 /* MMDAgent_exist: check if the file exists */
 bool MMDAgent_exist(const char *file);
 
+/* MMDAgent_getmtime: get last modification time of the file in sec, or -1 if not available */
+long long MMDAgent_getmtime(const char *file);
+
 /* MMDAgent_existdir: check if the directory exists */
 bool MMDAgent_existdir(const char *dir);
 
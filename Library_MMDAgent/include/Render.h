@@ -75,6 +75,8 @@
 #endif /* __ANDROID__ */
 #define RENDER_VIEWPOINTFRUSTUMFAR  500.0f
 
+#define RENDER_PICKRAYOFFSET 7 /* offset in pixels of additional rays for picking when the center ray misses */
+
 #ifdef MY_LUMINOUS
 #define LUMINOUS_FBO_UNINITIALIZEDID 0xFFFFFFFF
 #endif
@@ -157,12 +159,39 @@ private:
    bool m_backgroundForTransparent;         /* true when performing transparent window rendering */
    float m_backgroundTransparentColor[4]; /* background color to be used while transparent window rendering */
 
+   unsigned int m_numDrawCall;    /* number of model draw calls in the last frame */
+   unsigned int m_numStateChange; /* number of model state changes in the last frame */
+
+   MMDFilesFrustum m_viewFrustum;        /* view frustum in world coordinates */
+   MMDFilesFrustum m_shadowFrustum;      /* light frustum for shadow mapping in world coordinates */
+   bool *m_culled;                       /* true when model is outside of view frustum */
+   bool *m_shadowCulled;                 /* true when model is outside of light frustum */
+   unsigned int m_numCulledModel;        /* number of models culled by view frustum */
+   unsigned int m_numShadowCulledModel;  /* number of models culled by light frustum */
+   unsigned int m_numCulledMaterial;     /* number of materials culled by view frustum */
+   btVector3 *m_cullCenter;              /* center of bounding sphere of each model */
+   float *m_cullRadius;                  /* radius of bounding sphere of each model, 0 when not available */
+
+   double m_shadowMapMatrix[16];         /* projection * model view matrix of the current depth texture */
+   unsigned int *m_shadowMapSerial;      /* skin serial of each model in the current depth texture, 0 when not rendered */
+   int m_shadowMapNumModel;              /* number of models when the current depth texture was rendered */
+   bool m_shadowMapValid;                /* true when the depth texture holds a rendered result */
+   bool m_shadowMapRequired;             /* true when the depth texture should be rendered at this frame */
+   unsigned int m_numShadowMapReused;    /* number of frames where the depth texture was reused */
+
+   float m_lodEdgeScreenRatio;           /* edge is skipped when model size on screen is below this ratio */
+   float m_lodMeshScreenRatio;           /* simplified mesh is used when model size on screen is below this ratio */
+   unsigned int m_numLowDetailModel;     /* number of models rendered below full detail */
+
    /* applyProjectionMatirx: update projection matrix */
    void applyProjectionMatrix(double nearVal, double farVal);
 
    /* updateModelViewMatrix: update model view matrix */
    void updateModelViewMatrix();
 
+   /* getPickRay: get ray in world coordinates passing the screen position */
+   void getPickRay(float x, float y, btVector3 *from, btVector3 *dir);
+
    /* updateTransRotMatrix:  update trans and rotation matrix */
    bool updateTransRotMatrix(double ellapsedTimeForMove);
 
@@ -178,6 +207,15 @@ private:
    /* initializeShadowMap: initialize OpenGL for shadow mapping */
    void initializeShadowMap(int textureSize);
 
+   /* renderDepthTexture: render depth texture from the light for shadow mapping */
+   void renderDepthTexture(PMDObject *objs, const int *order, int num, int shadowMappingTextureSize);
+
+   /* getShadowMapMatrix: get projection * model view matrix from the light for shadow mapping */
+   void getShadowMapMatrix(double *m);
+
+   /* updateCulling: test models against view and light frustum, and upload skin of models to be rendered */
+   void updateCulling(PMDObject *objs, int num, bool useShadowMapping);
+
    /* renderSceneShadowMap: shadow mapping */
    void renderSceneShadowMap(PMDObject *objs, const int *order, int num, Stage *stage, bool useMMDLikeCartoon, bool useCartoonRendering, float lightIntensity, const float *lightDirection, const float *lightColor, int shadowMappingTextureSize, float shadowMappingSelfDensity);
 
@@ -278,6 +316,9 @@ public:
    /* setShadowMapping: switch shadow mapping */
    void setShadowMapping(bool useShadowMapping, int textureSize);
 
+   /* setLevelOfDetail: set screen ratios of model size to skip edge and to use simplified mesh */
+   void setLevelOfDetail(float edgeRatio, float meshRatio);
+
    /* getRenderOrder: return rendering order */
    void getRenderOrder(int *order, PMDObject *objs, int num);
 
@@ -287,6 +328,9 @@ public:
    /* pickModel: pick up a model at the screen position */
    int pickModel(PMDObject *objs, int num, int x, int y, int *allowDropPicked);
 
+   /* pickModel: pick up a model at the screen position, also get picked material and bone */
+   int pickModel(PMDObject *objs, int num, int x, int y, int *allowDropPicked, int *materialPicked, int *bonePicked);
+
    /* updateLigit: update light */
    void updateLight(bool useMMDLikeCartoon, bool useCartoonRendering, float lightIntensity, const float *lightDirection, const float *lightColor);
 
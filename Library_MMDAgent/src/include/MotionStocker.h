@@ -60,6 +60,10 @@ private:
    VMDList *m_head;   /* head of list */
    VMDList *m_tail;   /* tail of list */
 
+   float m_bakeRate;      /* rate per second to resample bone motions at loading, 0 to disable */
+   float m_bakePosTolerance; /* maximum position error of resampled bone motion */
+   float m_bakeRotTolerance; /* maximum rotation error of resampled bone motion in radian */
+
    /* initialize: initialize MotionStocker */
    void initialize();
 
@@ -82,4 +86,10 @@ public:
 
    /* unload: unload VMD */
    void unload(VMD *vmd);
+
+   /* setBake: set rate per second and tolerances to resample bone motions at loading, rate 0 to disable */
+   void setBake(float rate, float posTolerance, float rotTolerance);
+
+   /* getBakedSize: get total bytes of resampled bone motions in cache */
+   size_t getBakedSize();
 };
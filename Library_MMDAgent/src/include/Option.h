@@ -241,6 +241,40 @@
 
 #define OPTION_SHADOWMAPPINGLIGHTFIRST_STR "shadow_mapping_light_first" /* bogus */
 
+#define OPTION_USEGPUSKINNING_STR "use_gpu_skinning"
+#define OPTION_USEGPUSKINNING_DEF false
+
+#define OPTION_USEANALYTICIK_STR "use_analytic_ik"
+#define OPTION_USEANALYTICIK_DEF false
+
+#define OPTION_LODEDGESCREENRATIO_STR "lod_edge_screen_ratio"
+#define OPTION_LODEDGESCREENRATIO_DEF 0.0f
+#define OPTION_LODEDGESCREENRATIO_MAX 1.0f
+#define OPTION_LODEDGESCREENRATIO_MIN 0.0f
+
+#define OPTION_LODMESHSCREENRATIO_STR "lod_mesh_screen_ratio"
+#define OPTION_LODMESHSCREENRATIO_DEF 0.0f
+#define OPTION_LODMESHSCREENRATIO_MAX 1.0f
+#define OPTION_LODMESHSCREENRATIO_MIN 0.0f
+
+#define OPTION_MOTIONBAKERATE_STR "motion_bake_rate"
+#define OPTION_MOTIONBAKERATE_DEF 0.0f
+#define OPTION_MOTIONBAKERATE_MAX 120.0f
+#define OPTION_MOTIONBAKERATE_MIN 0.0f
+
+#define OPTION_MOTIONBAKEPOSTOLERANCE_STR "motion_bake_pos_tolerance"
+#define OPTION_MOTIONBAKEPOSTOLERANCE_DEF 0.005f
+#define OPTION_MOTIONBAKEPOSTOLERANCE_MAX 1.0f
+#define OPTION_MOTIONBAKEPOSTOLERANCE_MIN 0.0f
+
+#define OPTION_MOTIONBAKEROTTOLERANCE_STR "motion_bake_rot_tolerance"
+#define OPTION_MOTIONBAKEROTTOLERANCE_DEF 0.005f
+#define OPTION_MOTIONBAKEROTTOLERANCE_MAX 0.5f
+#define OPTION_MOTIONBAKEROTTOLERANCE_MIN 0.0f
+
+#define OPTION_MOTIONSHAREPOSE_STR "motion_share_pose"
+#define OPTION_MOTIONSHAREPOSE_DEF false
+
 #define OPTION_DISPLAYCOMMENTTIME_STR "display_comment_time"
 #define OPTION_DISPLAYCOMMENTTIME_DEF 0.0f
 #define OPTION_DISPLAYCOMMENTTIME_MAX 30.0f
@@ -394,6 +428,20 @@ private:
    float m_shadowMapSelfDensity;
    float m_shadowMapFloorDensity;
 
+   /* skinning */
+   bool m_useGPUSkinning;
+   bool m_useAnalyticIK;
+
+   /* level of detail */
+   float m_lodEdgeScreenRatio;
+   float m_lodMeshScreenRatio;
+
+   /* motion resampling */
+   float m_motionBakeRate;
+   float m_motionBakePosTolerance;
+   float m_motionBakeRotTolerance;
+   bool m_motionSharePose;
+
    /* comment */
    float m_displayCommentTime;
 
@@ -658,6 +706,54 @@ public:
    /* setShadowMappingFloorDensity: set floor density of shadow mapping */
    void setShadowMappingFloorDensity(float f);
 
+   /* getUseGPUSkinning: get GPU skinning flag */
+   bool getUseGPUSkinning();
+
+   /* setUseGPUSkinning: set GPU skinning flag */
+   void setUseGPUSkinning(bool b);
+
+   /* getUseAnalyticIK: get analytic IK flag */
+   bool getUseAnalyticIK();
+
+   /* setUseAnalyticIK: set analytic IK flag */
+   void setUseAnalyticIK(bool b);
+
+   /* getLODEdgeScreenRatio: get screen ratio below which edge is skipped */
+   float getLODEdgeScreenRatio();
+
+   /* setLODEdgeScreenRatio: set screen ratio below which edge is skipped */
+   void setLODEdgeScreenRatio(float f);
+
+   /* getLODMeshScreenRatio: get screen ratio below which simplified mesh is used */
+   float getLODMeshScreenRatio();
+
+   /* setLODMeshScreenRatio: set screen ratio below which simplified mesh is used */
+   void setLODMeshScreenRatio(float f);
+
+   /* getMotionBakeRate: get rate per second to resample bone motions */
+   float getMotionBakeRate();
+
+   /* setMotionBakeRate: set rate per second to resample bone motions */
+   void setMotionBakeRate(float f);
+
+   /* getMotionBakePosTolerance: get maximum position error of resampled bone motions */
+   float getMotionBakePosTolerance();
+
+   /* setMotionBakePosTolerance: set maximum position error of resampled bone motions */
+   void setMotionBakePosTolerance(float f);
+
+   /* getMotionBakeRotTolerance: get maximum rotation error of resampled bone motions in radian */
+   float getMotionBakeRotTolerance();
+
+   /* setMotionBakeRotTolerance: set maximum rotation error of resampled bone motions in radian */
+   void setMotionBakeRotTolerance(float f);
+
+   /* getMotionSharePose: get flag to share pose among models playing the same motions */
+   bool getMotionSharePose();
+
+   /* setMotionSharePose: set flag to share pose among models playing the same motions */
+   void setMotionSharePose(bool b);
+
    /* getDisplayCommentTime: get display comment time in sec */
    float getDisplayCommentTime();
 
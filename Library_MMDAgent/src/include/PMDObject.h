@@ -175,12 +175,24 @@ public:
    /* updateMotion: update motions */
    bool updateMotion(double deltaFrame);
 
+   /* canSharePose: return true when this model can take the updated pose of the given model instead of evaluating its own motions */
+   bool canSharePose(PMDObject *obj);
+
+   /* updateMotionWithPose: advance motions and take the pose of the given model already updated in this step */
+   bool updateMotionWithPose(PMDObject *obj, double deltaFrame);
+
    /* updateAfterSimulation: update bone transforms from simulated rigid bodies */
    void updateAfterSimulation(bool physicsEnabled);
 
    /* updateSkin: update skin and toon */
    void updateSkin();
 
+   /* updateSkinCPU: update skin and toon into staging buffer without OpenGL call */
+   void updateSkinCPU();
+
+   /* uploadSkin: upload updated skin to OpenGL buffer */
+   void uploadSkin();
+
    /* updateAlpha: update global model alpha */
    bool updateAlpha(double deltaFrame);
 
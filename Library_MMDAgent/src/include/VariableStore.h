@@ -0,0 +1,96 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <mutex>
+
+/* VariableStoreEntry: variable entry in hash table */
+typedef struct _VariableStoreEntry {
+   char *key;          /* key string, NULL when the slot is not used */
+   size_t keyLen;      /* length of key string */
+   unsigned int hash;  /* hash value of key string */
+   char *value;        /* string value */
+   float number;       /* numeric value */
+   bool removed;       /* true when the entry has been removed and the slot can be reused */
+} VariableStoreEntry;
+
+/* VariableStore: variables in open addressing hash table, keys are stored with their hash values */
+/* callers can keep hash value of a key to look it up without hashing again, all methods are thread safe */
+class VariableStore
+{
+private:
+
+   VariableStoreEntry *m_table; /* hash table, size is power of 2 */
+   unsigned int m_size;         /* size of hash table */
+   unsigned int m_numUsed;      /* number of used slots, including removed ones */
+   unsigned int m_num;          /* number of variables */
+   std::mutex m_mutex;          /* mutex for all access */
+
+   /* initialize: initialize store */
+   void initialize();
+
+   /* clear: free store */
+   void clear();
+
+   /* findEntry: find entry of the key, or empty slot for it */
+   VariableStoreEntry *findEntry(const char *key, size_t keyLen, unsigned int hash);
+
+   /* getEntry: get entry of the key, create if not exist */
+   VariableStoreEntry *getEntry(const char *key, size_t keyLen, unsigned int hash);
+
+   /* resize: rebuild hash table with the size */
+   void resize(unsigned int size);
+
+public:
+
+   /* VariableStore: constructor */
+   VariableStore();
+
+   /* ~VariableStore: destructor */
+   ~VariableStore();
+
+   /* getHash: get hash value of key */
+   static unsigned int getHash(const char *key, size_t keyLen);
+
+   /* release: remove all variables */
+   void release();
+
+   /* set: set string value and numeric value of the string */
+   void set(const char *key, const char *value);
+
+   /* setWithNumber: set string value and numeric value */
+   void setWithNumber(const char *key, const char *value, float number);
+
+   /* remove: remove variable, return false if not exist */
+   bool remove(const char *key);
+
+   /* exist: check if variable exists */
+   bool exist(const char *key);
+
+   /* copyValue: copy string value to buffer and return its length, or -1 if not exist */
+   int copyValue(const char *key, char *buf, size_t bufLen);
+
+   /* copyValueWithHash: copy string value of key with known length and hash to buffer, or return -1 if not exist */
+   int copyValueWithHash(const char *key, size_t keyLen, unsigned int hash, char *buf, size_t bufLen);
+
+   /* getNumber: get numeric value, return false if not exist */
+   bool getNumber(const char *key, float *number);
+
+   /* addNumber: add to numeric value and set the result as string value at once, variable is created with 0 if not exist */
+   float addNumber(const char *key, float diff);
+
+   /* getNum: get number of variables */
+   unsigned int getNum();
+};
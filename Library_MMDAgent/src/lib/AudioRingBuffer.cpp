@@ -0,0 +1,252 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDAgent.h"
+
+/* AudioRingBuffer::initialize: initialize buffer */
+void AudioRingBuffer::initialize()
+{
+   m_buffer.store(NULL, std::memory_order_relaxed);
+   m_size = 0;
+   m_mask = 0;
+   m_frequency = 0;
+
+   m_writePoint = 0;
+   m_readPoint = 0;
+   m_flushRequest = false;
+
+   m_underrunCount = 0;
+   m_droppedSamples = 0;
+   m_queuedSamples = 0;
+   m_maxQueuedSamples = 0;
+}
+
+/* AudioRingBuffer::clear: free buffer */
+void AudioRingBuffer::clear()
+{
+   short *buf = m_buffer.load(std::memory_order_relaxed);
+
+   if (buf)
+      free(buf);
+   initialize();
+}
+
+/* AudioRingBuffer::processFlushRequest: discard buffered samples if requested, called from consumer */
+void AudioRingBuffer::processFlushRequest()
+{
+   if (m_flushRequest.load(std::memory_order_relaxed) == false)
+      return;
+   m_flushRequest.store(false, std::memory_order_relaxed);
+   m_readPoint.store(m_writePoint.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+/* AudioRingBuffer::AudioRingBuffer: constructor */
+AudioRingBuffer::AudioRingBuffer()
+{
+   initialize();
+}
+
+/* AudioRingBuffer::~AudioRingBuffer: destructor */
+AudioRingBuffer::~AudioRingBuffer()
+{
+   clear();
+}
+
+/* AudioRingBuffer::setup: allocate buffer which can hold at least the given number of samples */
+bool AudioRingBuffer::setup(size_t samples, int frequency)
+{
+   size_t size;
+   short *buf;
+
+   clear();
+
+   if (samples == 0 || frequency <= 0)
+      return false;
+
+   /* round up to power of 2 so that positions can be wrapped by mask */
+   for (size = 1; size < samples; size <<= 1);
+
+   buf = (short *)malloc(sizeof(short) * size);
+   if (buf == NULL)
+      return false;
+   m_size = size;
+   m_mask = size - 1;
+   m_frequency = frequency;
+
+   /* publish the buffer last, so that a thread which sees it also sees its size */
+   m_buffer.store(buf, std::memory_order_release);
+
+   return true;
+}
+
+/* AudioRingBuffer::isReady: return true when buffer is allocated */
+bool AudioRingBuffer::isReady()
+{
+   return m_buffer.load(std::memory_order_acquire) != NULL;
+}
+
+/* AudioRingBuffer::getWritable: get number of samples which can be written now, called from producer */
+size_t AudioRingBuffer::getWritable()
+{
+   size_t w, r;
+
+   if (m_buffer.load(std::memory_order_acquire) == NULL)
+      return 0;
+   w = m_writePoint.load(std::memory_order_relaxed);
+   r = m_readPoint.load(std::memory_order_acquire);
+   return m_size - (w - r);
+}
+
+/* AudioRingBuffer::write: copy samples into buffer and return number of stored samples, rest will be dropped, called from producer */
+size_t AudioRingBuffer::write(const short *data, size_t num)
+{
+   size_t w, n, pos, first;
+   short *buf = m_buffer.load(std::memory_order_acquire);
+
+   if (buf == NULL || data == NULL || num == 0)
+      return 0;
+
+   w = m_writePoint.load(std::memory_order_relaxed);
+   n = getWritable();
+   if (n > num)
+      n = num;
+   if (n < num)
+      m_droppedSamples.fetch_add(num - n, std::memory_order_relaxed);
+   if (n == 0)
+      return 0;
+
+   /* copy in at most two parts at the wrap point */
+   pos = w & m_mask;
+   first = m_size - pos;
+   if (first > n)
+      first = n;
+   memcpy(&(buf[pos]), data, sizeof(short) * first);
+   if (n > first)
+      memcpy(buf, &(data[first]), sizeof(short) * (n - first));
+
+   /* publish the written samples to consumer */
+   m_writePoint.store(w + n, std::memory_order_release);
+
+   return n;
+}
+
+/* AudioRingBuffer::getReadable: get number of samples which can be read now, called from consumer */
+size_t AudioRingBuffer::getReadable()
+{
+   if (m_buffer.load(std::memory_order_acquire) == NULL)
+      return 0;
+   processFlushRequest();
+   return m_writePoint.load(std::memory_order_acquire) - m_readPoint.load(std::memory_order_relaxed);
+}
+
+/* AudioRingBuffer::read: copy samples into buf and return number of read samples, called from consumer */
+size_t AudioRingBuffer::read(short *buf, size_t num, bool partial)
+{
+   size_t r, n, pos, first;
+   short *data = m_buffer.load(std::memory_order_acquire);
+
+   if (data == NULL || buf == NULL || num == 0)
+      return 0;
+
+   n = getReadable();
+   r = m_readPoint.load(std::memory_order_relaxed);
+
+   /* update latency counters by the amount of queued samples */
+   m_queuedSamples.store(n, std::memory_order_relaxed);
+   if (m_maxQueuedSamples.load(std::memory_order_relaxed) < n)
+      m_maxQueuedSamples.store(n, std::memory_order_relaxed);
+
+   if (n < num) {
+      if (partial == false) {
+         /* data is coming but not enough to fill a block */
+         if (n > 0)
+            m_underrunCount.fetch_add(1, std::memory_order_relaxed);
+         return 0;
+      }
+   } else {
+      n = num;
+   }
+   if (n == 0)
+      return 0;
+
+   /* copy out at most two parts at the wrap point */
+   pos = r & m_mask;
+   first = m_size - pos;
+   if (first > n)
+      first = n;
+   memcpy(buf, &(data[pos]), sizeof(short) * first);
+   if (n > first)
+      memcpy(&(buf[first]), data, sizeof(short) * (n - first));
+
+   /* release the read area to producer */
+   m_readPoint.store(r + n, std::memory_order_release);
+
+   return n;
+}
+
+/* AudioRingBuffer::discard: discard all buffered samples, called from consumer */
+void AudioRingBuffer::discard()
+{
+   if (m_buffer.load(std::memory_order_acquire) == NULL)
+      return;
+   m_flushRequest.store(false, std::memory_order_relaxed);
+   m_readPoint.store(m_writePoint.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+/* AudioRingBuffer::requestFlush: request consumer to discard buffered samples at next read, can be called from any thread */
+void AudioRingBuffer::requestFlush()
+{
+   m_flushRequest.store(true, std::memory_order_relaxed);
+}
+
+/* AudioRingBuffer::getUnderrunCount: get number of underruns */
+unsigned int AudioRingBuffer::getUnderrunCount()
+{
+   return m_underrunCount.load(std::memory_order_relaxed);
+}
+
+/* AudioRingBuffer::getDroppedSamples: get number of samples dropped by overflow */
+size_t AudioRingBuffer::getDroppedSamples()
+{
+   return m_droppedSamples.load(std::memory_order_relaxed);
+}
+
+/* AudioRingBuffer::getLatencyMSec: get latency of the last read in msec */
+double AudioRingBuffer::getLatencyMSec()
+{
+   if (m_frequency <= 0)
+      return 0.0;
+   return (double)m_queuedSamples.load(std::memory_order_relaxed) * 1000.0 / (double)m_frequency;
+}
+
+/* AudioRingBuffer::getMaxLatencyMSec: get maximum latency in msec */
+double AudioRingBuffer::getMaxLatencyMSec()
+{
+   if (m_frequency <= 0)
+      return 0.0;
+   return (double)m_maxQueuedSamples.load(std::memory_order_relaxed) * 1000.0 / (double)m_frequency;
+}
+
+/* AudioRingBuffer::resetStatistics: reset underrun, overflow and latency counters */
+void AudioRingBuffer::resetStatistics()
+{
+   m_underrunCount.store(0, std::memory_order_relaxed);
+   m_droppedSamples.store(0, std::memory_order_relaxed);
+   m_queuedSamples.store(0, std::memory_order_relaxed);
+   m_maxQueuedSamples.store(0, std::memory_order_relaxed);
+}
@@ -116,6 +116,8 @@ void FTGLTextureAtlas::initialize()
    m_depth = 0;
    m_id = 0;
    m_data = NULL;
+   m_dirtyY0 = 0;
+   m_dirtyY1 = 0;
 }
 
 /* FTGLTextureAtlas::clear: free texture manager */
@@ -183,6 +185,12 @@ bool FTGLTextureAtlas::setRegion(size_t x, size_t y, size_t width, size_t height
    for (i = 0; i < height; i++)
       memcpy(m_data + ((y + i) * m_width + x) * dataSize * m_depth, data + (i * stride) * dataSize, width * dataSize * m_depth);
 
+   /* extend modified rows to be uploaded */
+   if (m_dirtyY1 == 0 || m_dirtyY0 > y)
+      m_dirtyY0 = y;
+   if (m_dirtyY1 < y + height)
+      m_dirtyY1 = y + height;
+
    return true;
 }
 
@@ -274,7 +282,7 @@ bool FTGLTextureAtlas::getRegion(size_t width, size_t height, size_t *x, size_t
    return true;
 }
 
-/* FTGLTextureAtlas::updateTexture: update the current texture data for OpenGL */
+/* FTGLTextureAtlas::updateTexture: update the current texture data for OpenGL, only modified rows are uploaded */
 void FTGLTextureAtlas::updateTexture()
 {
    GLint internalformat;
@@ -282,6 +290,7 @@ void FTGLTextureAtlas::updateTexture()
    GLint type;
 
    if (m_data == NULL) return;
+   if (m_id != 0 && m_dirtyY1 == 0) return;
 
    if (m_depth == 4) {
 #ifdef GL_UNSIGNED_INT_8_8_8_8_REV
@@ -314,9 +323,12 @@ void FTGLTextureAtlas::updateTexture()
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
       glTexImage2D(GL_TEXTURE_2D, 0, internalformat, (GLsizei)m_width, (GLsizei)m_height, 0, format, type, m_data);
    } else {
+      /* rows are uploaded in full width since row length of unpacking is not available on OpenGL ES */
       glBindTexture(GL_TEXTURE_2D, m_id);
-      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, (GLsizei)m_width, (GLsizei)m_height, format, type, m_data);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, (GLint)m_dirtyY0, (GLsizei)m_width, (GLsizei)(m_dirtyY1 - m_dirtyY0), format, type, m_data + m_dirtyY0 * m_width * m_depth);
    }
+   m_dirtyY0 = 0;
+   m_dirtyY1 = 0;
 
    glDisable(GL_TEXTURE_2D);
 }
@@ -376,6 +388,12 @@ void FTGLTextureFont::initialize()
    m_langID[0] = 'e';
    m_langID[1] = 'n';
    m_langID[2] = '\0';
+
+   for (int i = 0; i < FREETYPEGL_TEXTCACHESIZE; i++) {
+      m_textCache[i].text = NULL;
+      m_textCache[i].vertices = NULL;
+      m_textCache[i].texcoords = NULL;
+   }
 }
 
 /* FTGLTextureFont::clear: free font manager */
@@ -404,10 +422,122 @@ void FTGLTextureFont::clear()
    m_index.release();
    for (int i = 0; i < FREETYLEGL_MAXOUTLINEUNITNUM; i++)
       m_indexOutlined[i].release();
+   clearTextCache();
 
    initialize();
 }
 
+/* FTGLTextureFont::getTextCacheHash: get hash value of a text layout key */
+unsigned int FTGLTextureFont::getTextCacheHash(const char *text, float linespace, float scalefactor)
+{
+   unsigned int h = 2166136261U;
+   const unsigned char *p;
+   unsigned char param[2 + sizeof(int) + sizeof(float) * 2];
+   int outlineUnit;
+   size_t i;
+
+   outlineUnit = m_outlineMode ? m_outlineUnit : -1;
+   param[0] = (unsigned char)m_langID[0];
+   param[1] = (unsigned char)m_langID[1];
+   memcpy(&(param[2]), &outlineUnit, sizeof(int));
+   memcpy(&(param[2 + sizeof(int)]), &linespace, sizeof(float));
+   memcpy(&(param[2 + sizeof(int) + sizeof(float)]), &scalefactor, sizeof(float));
+
+   /* FNV-1a */
+   for (p = (const unsigned char *)text; *p != '\0'; p++) {
+      h ^= *p;
+      h *= 16777619U;
+   }
+   for (i = 0; i < sizeof(param); i++) {
+      h ^= param[i];
+      h *= 16777619U;
+   }
+   return h;
+}
+
+/* FTGLTextureFont::findTextCache: find cached layout of the text with the current language and outline mode */
+FTGLTextCache *FTGLTextureFont::findTextCache(const char *text, float linespace, float scalefactor)
+{
+   unsigned int h;
+   FTGLTextCache *c;
+
+   h = getTextCacheHash(text, linespace, scalefactor);
+   c = &(m_textCache[h % FREETYPEGL_TEXTCACHESIZE]);
+   if (c->text == NULL || c->hash != h)
+      return NULL;
+   if (c->langID[0] != m_langID[0] || c->langID[1] != m_langID[1])
+      return NULL;
+   if (c->outlineUnit != (m_outlineMode ? m_outlineUnit : -1))
+      return NULL;
+   if (c->linespace != linespace || c->scalefactor != scalefactor)
+      return NULL;
+   if (MMDAgent_strequal(c->text, text) == false)
+      return NULL;
+   return c;
+}
+
+/* FTGLTextureFont::storeTextCache: store the layout of a text placed at (x, y) in elem from index */
+void FTGLTextureFont::storeTextCache(const char *text, float linespace, float scalefactor, FTGLTextDrawElements *elem, size_t index, size_t num, float x, float y)
+{
+   unsigned int h;
+   size_t i;
+   FTGLTextCache *c;
+
+   if (strlen(text) > FREETYPEGL_TEXTCACHEMAXLEN)
+      return;
+
+   /* overwrite the slot */
+   h = getTextCacheHash(text, linespace, scalefactor);
+   c = &(m_textCache[h % FREETYPEGL_TEXTCACHESIZE]);
+   if (c->text != NULL)
+      free(c->text);
+   if (c->vertices != NULL)
+      free(c->vertices);
+   if (c->texcoords != NULL)
+      free(c->texcoords);
+   c->text = MMDAgent_strdup(text);
+   c->hash = h;
+   c->langID[0] = m_langID[0];
+   c->langID[1] = m_langID[1];
+   c->outlineUnit = m_outlineMode ? m_outlineUnit : -1;
+   c->linespace = linespace;
+   c->scalefactor = scalefactor;
+   c->num = num;
+   c->vertices = NULL;
+   c->texcoords = NULL;
+   if (num > 0) {
+      c->vertices = (GLfloat *)malloc(sizeof(GLfloat) * 12 * num);
+      c->texcoords = (GLfloat *)malloc(sizeof(GLfloat) * 8 * num);
+      for (i = 0; i < num * 4; i++) {
+         c->vertices[i * 3] = elem->vertices[index * 12 + i * 3] - x;
+         c->vertices[i * 3 + 1] = elem->vertices[index * 12 + i * 3 + 1] - y;
+         c->vertices[i * 3 + 2] = elem->vertices[index * 12 + i * 3 + 2];
+      }
+      memcpy(c->texcoords, &(elem->texcoords[index * 8]), sizeof(GLfloat) * 8 * num);
+   }
+   c->width = elem->width;
+   c->height = elem->height;
+   c->upheight = elem->upheight;
+}
+
+/* FTGLTextureFont::clearTextCache: free all cached layouts */
+void FTGLTextureFont::clearTextCache()
+{
+   int i;
+
+   for (i = 0; i < FREETYPEGL_TEXTCACHESIZE; i++) {
+      if (m_textCache[i].text != NULL)
+         free(m_textCache[i].text);
+      if (m_textCache[i].vertices != NULL)
+         free(m_textCache[i].vertices);
+      if (m_textCache[i].texcoords != NULL)
+         free(m_textCache[i].texcoords);
+      m_textCache[i].text = NULL;
+      m_textCache[i].vertices = NULL;
+      m_textCache[i].texcoords = NULL;
+   }
+}
+
 /* FTGLTextureFont::FTGLTextureFont: constructor */
 FTGLTextureFont::FTGLTextureFont()
 {
@@ -706,6 +836,8 @@ void FTGLTextureFont::updateGlyphInfo()
       m_atlas->updateTexture();
       /* generate kerning */
       generateKerning();
+      /* layouts made before kerning may differ */
+      clearTextCache();
    }
 }
 
@@ -864,6 +996,23 @@ bool FTGLTextureFont::getTextDrawElementsFixed(const char *text, FTGLTextDrawEle
    return true;
 }
 
+/* FTGLTextureFont_allocTextDrawElements: make rendering data hold at least the given number of characters */
+static void FTGLTextureFont_allocTextDrawElements(FTGLTextDrawElements *elem, size_t totallen)
+{
+   if (elem->assignedTextLen >= totallen)
+      return;
+   if (elem->assignedTextLen != 0) {
+      elem->vertices = (GLfloat *) realloc(elem->vertices, sizeof(GLfloat) * 12 * totallen); /* 4 corners of (x, y, z) per character */
+      elem->texcoords = (GLfloat *) realloc(elem->texcoords, sizeof(GLfloat) * 8 * totallen); /* 4 corners of (s, t) per character */
+      elem->indices = (GLindices *) realloc(elem->indices, sizeof(GLindices) * 6 * totallen); /* 2 triangle indices per character */
+   } else {
+      elem->vertices = (GLfloat *) malloc(sizeof(GLfloat) * 12 * totallen); /* 4 corners of (x, y, z) per character */
+      elem->texcoords = (GLfloat *) malloc(sizeof(GLfloat) * 8 * totallen); /* 4 corners of (s, t) per character */
+      elem->indices = (GLindices *) malloc(sizeof(GLindices) * 6 * totallen); /* 2 triangle indices per character */
+   }
+   elem->assignedTextLen = totallen;
+}
+
 /* FTGLTextureFont::getTextDrawElementsWithScale: get a set of rendering data for a text with scale */
 bool FTGLTextureFont::getTextDrawElementsWithScale(const char *text, FTGLTextDrawElements *elem, size_t index, float x, float y, float linespace, float scalefactor)
 {
@@ -876,6 +1025,7 @@ bool FTGLTextureFont::getTextDrawElementsWithScale(const char *text, FTGLTextDra
    float width, height, upheight;
    float ymax, ymin;
    bool ret = true;
+   FTGLTextCache *cache;
 
    if (elem == NULL) return false;
 
@@ -894,6 +1044,40 @@ bool FTGLTextureFont::getTextDrawElementsWithScale(const char *text, FTGLTextDra
       return true;
    }
 
+   /* reuse cached layout of the same text, moving it to (x, y) */
+   cache = findTextCache(text, linespace, scalefactor);
+   if (cache != NULL) {
+      totallen = index + cache->num;
+      if (cache->num > 0 && totallen * 4 > 65536) {
+         // nodes exceeded unsigned short!
+         elem->textLen = 0;
+         elem->numIndices = 0;
+         return false;
+      }
+      FTGLTextureFont_allocTextDrawElements(elem, totallen);
+      for (i = 0; i < cache->num * 4; i++) {
+         elem->vertices[index * 12 + i * 3] = cache->vertices[i * 3] + x;
+         elem->vertices[index * 12 + i * 3 + 1] = cache->vertices[i * 3 + 1] + y;
+         elem->vertices[index * 12 + i * 3 + 2] = cache->vertices[i * 3 + 2];
+      }
+      if (cache->num > 0)
+         memcpy(&(elem->texcoords[index * 8]), cache->texcoords, sizeof(GLfloat) * 8 * cache->num);
+      for (j = index; j < totallen; j++) {
+         elem->indices[j * 6] = (GLindices)(j * 4);
+         elem->indices[j * 6 + 1] = (GLindices)(j * 4 + 1);
+         elem->indices[j * 6 + 2] = (GLindices)(j * 4 + 2);
+         elem->indices[j * 6 + 3] = (GLindices)(j * 4);
+         elem->indices[j * 6 + 4] = (GLindices)(j * 4 + 2);
+         elem->indices[j * 6 + 5] = (GLindices)(j * 4 + 3);
+      }
+      elem->width = cache->width;
+      elem->height = cache->height;
+      elem->upheight = cache->upheight;
+      elem->textLen = totallen;
+      elem->numIndices = (unsigned int)(6 * totallen);
+      return true;
+   }
+
    textbuf = MMDAgent_langstr(text, m_langID);
    if (textbuf == NULL) {
       try {
@@ -931,19 +1115,7 @@ bool FTGLTextureFont::getTextDrawElementsWithScale(const char *text, FTGLTextDra
    }
 
    totallen = index + len;
-
-   if (elem->assignedTextLen < totallen) {
-      if (elem->assignedTextLen != 0) {
-         elem->vertices = (GLfloat *) realloc(elem->vertices, sizeof(GLfloat) * 12 * totallen); /* 4 corners of (x, y, z) per character */
-         elem->texcoords = (GLfloat *) realloc(elem->texcoords, sizeof(GLfloat) * 8 * totallen); /* 4 corners of (s, t) per character */
-         elem->indices = (GLindices *) realloc(elem->indices, sizeof(GLindices) * 6 * totallen); /* 2 triangle indices per character */
-      } else {
-         elem->vertices = (GLfloat *) malloc(sizeof(GLfloat) * 12 * totallen); /* 4 corners of (x, y, z) per character */
-         elem->texcoords = (GLfloat *) malloc(sizeof(GLfloat) * 8 * totallen); /* 4 corners of (s, t) per character */
-         elem->indices = (GLindices *) malloc(sizeof(GLindices) * 6 * totallen); /* 2 triangle indices per character */
-      }
-      elem->assignedTextLen = totallen;
-   }
+   FTGLTextureFont_allocTextDrawElements(elem, totallen);
 
    px = x;
    py = y;
@@ -1044,6 +1216,10 @@ bool FTGLTextureFont::getTextDrawElementsWithScale(const char *text, FTGLTextDra
 
    free(buff);
 
+   /* cache the layout when all glyphs were ready and their kerning is up to date */
+   if (ret == true && m_glyphListUpdated == false)
+      storeTextCache(text, linespace, scalefactor, elem, index, num, x, y);
+
    return ret;
 }
 
@@ -103,6 +103,10 @@ void LogText::initialize()
    m_narrowStringHasCase = false;
    m_drawElementNarrow = NULL;
    m_noShowFlag = NULL;
+   m_showList = NULL;
+   m_showHead = 0;
+   m_numShow = 0;
+   m_numNewLine = 0;
 
    m_status = false;
    m_transRate = 0.0;
@@ -143,6 +147,8 @@ void LogText::clear()
    }
    if (m_noShowFlag)
       free(m_noShowFlag);
+   if (m_showList)
+      free(m_showList);
 
    initialize();
 }
@@ -185,6 +191,8 @@ bool LogText::setup(FTGLTextureFont *font, const int *size, const float *positio
    }
    m_flagList = (unsigned int *)malloc(sizeof(unsigned int) * LOGTEXT_MAXNLINES);
    m_transRateList = (float *)malloc(sizeof(float) * LOGTEXT_MAXNLINES);
+   for (i = 0; i < LOGTEXT_MAXNLINES; i++)
+      m_transRateList[i] = 1.0f;
 
    m_drawElements = (FTGLTextDrawElements *) malloc(sizeof(FTGLTextDrawElements) * LOGTEXT_MAXNLINES);
    for(i = 0; i < LOGTEXT_MAXNLINES; i++)
@@ -201,6 +209,9 @@ bool LogText::setup(FTGLTextureFont *font, const int *size, const float *positio
    for (i = 0; i < LOGTEXT_MAXNLINES; i++)
       m_noShowFlag[i] = false;
 
+   m_showList = (int *)malloc(sizeof(int) * LOGTEXT_MAXNLINES);
+   rebuildShowList();
+
    return true;
 }
 
@@ -246,6 +257,13 @@ void LogText::log(unsigned int flag, const char *format, ...)
             c += size;
          }
       }
+      /* the oldest line is overwritten, remove it from the head of shown lines */
+      if (m_numShow > 0 && m_showList[m_showHead] == m_textIndex) {
+         m_showHead = (m_showHead + 1) % LOGTEXT_MAXNLINES;
+         m_numShow--;
+      }
+      if (m_transRateList[m_textIndex] >= 1.0f)
+         m_numNewLine++;
       strcpy(m_textList[m_textIndex], p);
       m_flagList[m_textIndex] = flag;
       m_transRateList[m_textIndex] = 0.0f;
@@ -253,6 +271,11 @@ void LogText::log(unsigned int flag, const char *format, ...)
       m_drawElements[m_textIndex].numIndices = 0;
       m_elementErrorFlag[m_textIndex] = false;
       m_noShowFlag[m_textIndex] = matchNarrow(m_textList[m_textIndex]);
+      if (m_noShowFlag[m_textIndex] == false) {
+         /* append to the tail of shown lines */
+         m_showList[(m_showHead + m_numShow) % LOGTEXT_MAXNLINES] = m_textIndex;
+         m_numShow++;
+      }
       if (m_viewIndex != 0 && m_noShowFlag[m_textIndex] == false)
          scroll(1);
       m_textIndex++;
@@ -312,7 +335,7 @@ void LogText::endTyping()
 void LogText::resetNarrowString()
 {
    m_narrowString[0] = '\0';
-   updateNarrow();
+   updateNarrow(false);
 }
 
 /* LogText::addCharToNarrowString: add char to narrow string */
@@ -324,7 +347,7 @@ void LogText::addCharToNarrowString(char c)
       m_narrowString[len + 1] = '\0';
    }
    m_typingFrame = LOGTEXT_TYPINGDURATIONFRAME;
-   updateNarrow();
+   updateNarrow(true);
 }
 
 /* LogText::backwardCharToNarrowString: backward char to narrow string */
@@ -337,7 +360,7 @@ void LogText::backwardCharToNarrowString()
       endTyping();
    else
       m_typingFrame = LOGTEXT_TYPINGDURATIONFRAME;
-   updateNarrow();
+   updateNarrow(false);
 }
 
 /* LogText::matchNarrow: check if string matches narrowing string */
@@ -354,8 +377,22 @@ bool LogText::matchNarrow(const char *str)
    return ret;
 }
 
-/* LogText::updateNarrow: update Narrow */
-void LogText::updateNarrow()
+/* LogText::rebuildShowList: rebuild list of lines to be shown */
+void LogText::rebuildShowList()
+{
+   int i, j;
+
+   m_showHead = 0;
+   m_numShow = 0;
+   for (i = 0; i < LOGTEXT_MAXNLINES; i++) {
+      j = (m_textIndex + i) % LOGTEXT_MAXNLINES;
+      if (m_noShowFlag[j] == false)
+         m_showList[m_numShow++] = j;
+   }
+}
+
+/* LogText::updateNarrow: update narrowing, only shown lines are tested when narrower is true, else only hidden lines */
+void LogText::updateNarrow(bool narrower)
 {
    int i;
 
@@ -372,19 +409,22 @@ void LogText::updateNarrow()
             break;
          }
       }
+      /* a longer narrowing string never shows hidden lines, and a shorter one never hides shown lines */
       for (i = 0; i < LOGTEXT_MAXNLINES; i++)
-         m_noShowFlag[i] = matchNarrow(m_textList[i]);
+         if (m_noShowFlag[i] != narrower)
+            m_noShowFlag[i] = matchNarrow(m_textList[i]);
       if (m_font->getTextDrawElements(m_narrowString, m_drawElementNarrow, 0, 0.0f, 0.0f, 0.0f) == false) {
          m_drawElementNarrow->textLen = 0; /* reset */
          m_drawElementNarrow->numIndices = 0;
       }
    }
+   rebuildShowList();
 }
 
 /* LogText::renderMain: rendering main function */
 void LogText::renderMain(float w, float h, float fullScale, float textScale, float x, float y, float z)
 {
-   int i, j, k, start, size;
+   int i, j, pos, size;
    float rate;
    GLfloat vertices[12];
 
@@ -494,74 +534,65 @@ void LogText::renderMain(float w, float h, float fullScale, float textScale, flo
       glPopMatrix();
    }
 
+   /* visit only the visible range of shown lines, from the newest */
    size = LOGTEXT_MAXNLINES < m_textHeight ? LOGTEXT_MAXNLINES : m_textHeight;
-   i = 0;
-   start = m_textIndex - 1;
-   if (start < 0)
-      start += LOGTEXT_MAXNLINES;
-   j = start;
-   k = m_viewIndex;
-   while (i < size) {
-      if (m_noShowFlag[j] == false && k-- <= 0) {
-         glTranslatef(0.0f, 0.85f, 0.0f);
-         if (m_drawElements[j].numIndices == 0 && m_elementErrorFlag[j] == false) {
-            if (m_font->getTextDrawElements(m_textList[j], &(m_drawElements[j]), 0, 0.0f, 0.0f, 0.0f) == false) {
-               m_drawElements[j].textLen = 0; /* reset */
-               m_drawElements[j].numIndices = 0;
-               m_elementErrorFlag[j] = true;
-            }
+   for (i = 0; i < size; i++) {
+      pos = m_numShow - 1 - m_viewIndex - i;
+      if (pos < 0)
+         break;
+      j = m_showList[(m_showHead + pos) % LOGTEXT_MAXNLINES];
+      glTranslatef(0.0f, 0.85f, 0.0f);
+      if (m_drawElements[j].numIndices == 0 && m_elementErrorFlag[j] == false && m_textList[j][0] != '\0') {
+         if (m_font->getTextDrawElements(m_textList[j], &(m_drawElements[j]), 0, 0.0f, 0.0f, 0.0f) == false) {
+            m_drawElements[j].textLen = 0; /* reset */
+            m_drawElements[j].numIndices = 0;
+            m_elementErrorFlag[j] = true;
          }
-         if (m_drawElements[j].numIndices > 0) {
-            glPushMatrix();
-            if (m_transRateList[j] < 1.0f) {
-               // hightlighting background for new logs
-               glDisable(GL_TEXTURE_2D);
-               glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-               glColor4f(LOGTEXT_BGCOLOR_UPDATE, 1.0f - m_transRateList[j]);
-               vertices[0] = 0.0f;
-               vertices[1] = -0.2f;
-               vertices[2] = -0.03f;
-               vertices[3] = w;
-               vertices[4] = -0.2f;
-               vertices[5] = -0.03f;
-               vertices[6] = 0.0f;
-               vertices[7] = 0.65f;
-               vertices[8] = -0.03f;
-               vertices[9] = w;
-               vertices[10] = 0.65f;
-               vertices[11] = -0.03f;
-               glVertexPointer(3, GL_FLOAT, 0, vertices);
-               glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-               glEnable(GL_TEXTURE_2D);
-               glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-            }
-            switch (m_flagList[j]) {
-            case MLOG_ERROR:
-               glColor4f(LOGTEXT_COLOR_ERROR); break;
-            case MLOG_WARNING:
-               glColor4f(LOGTEXT_COLOR_WARNING); break;
-            case MLOG_STATUS:
-               glColor4f(LOGTEXT_COLOR_STATUS); break;
-            case MLOG_MESSAGE_SENT:
-               glColor4f(LOGTEXT_COLOR_SENT); break;
-            case MLOG_MESSAGE_CAPTURED:
-               glColor4f(LOGTEXT_COLOR_CAPTURED); break;
-            default:
-               glColor4f(LOGTEXT_COLOR); break;
-            }
-            glScalef(0.9f, 0.9f, 0.9f);
-            glVertexPointer(3, GL_FLOAT, 0, m_drawElements[j].vertices);
-            glTexCoordPointer(2, GL_FLOAT, 0, m_drawElements[j].texcoords);
-            glDrawElements(GL_TRIANGLES, m_drawElements[j].numIndices, GL_INDICES, (const GLvoid *)m_drawElements[j].indices);
-            glPopMatrix();
+      }
+      if (m_drawElements[j].numIndices > 0) {
+         glPushMatrix();
+         if (m_transRateList[j] < 1.0f) {
+            // hightlighting background for new logs
+            glDisable(GL_TEXTURE_2D);
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glColor4f(LOGTEXT_BGCOLOR_UPDATE, 1.0f - m_transRateList[j]);
+            vertices[0] = 0.0f;
+            vertices[1] = -0.2f;
+            vertices[2] = -0.03f;
+            vertices[3] = w;
+            vertices[4] = -0.2f;
+            vertices[5] = -0.03f;
+            vertices[6] = 0.0f;
+            vertices[7] = 0.65f;
+            vertices[8] = -0.03f;
+            vertices[9] = w;
+            vertices[10] = 0.65f;
+            vertices[11] = -0.03f;
+            glVertexPointer(3, GL_FLOAT, 0, vertices);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glEnable(GL_TEXTURE_2D);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
          }
-         i++;
+         switch (m_flagList[j]) {
+         case MLOG_ERROR:
+            glColor4f(LOGTEXT_COLOR_ERROR); break;
+         case MLOG_WARNING:
+            glColor4f(LOGTEXT_COLOR_WARNING); break;
+         case MLOG_STATUS:
+            glColor4f(LOGTEXT_COLOR_STATUS); break;
+         case MLOG_MESSAGE_SENT:
+            glColor4f(LOGTEXT_COLOR_SENT); break;
+         case MLOG_MESSAGE_CAPTURED:
+            glColor4f(LOGTEXT_COLOR_CAPTURED); break;
+         default:
+            glColor4f(LOGTEXT_COLOR); break;
+         }
+         glScalef(0.9f, 0.9f, 0.9f);
+         glVertexPointer(3, GL_FLOAT, 0, m_drawElements[j].vertices);
+         glTexCoordPointer(2, GL_FLOAT, 0, m_drawElements[j].texcoords);
+         glDrawElements(GL_TRIANGLES, m_drawElements[j].numIndices, GL_INDICES, (const GLvoid *)m_drawElements[j].indices);
+         glPopMatrix();
       }
-      j--;
-      if (j < 0)
-         j += LOGTEXT_MAXNLINES;
-      if (j == start)
-         break;
    }
    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
    glDisable(GL_TEXTURE_2D);
@@ -629,11 +660,16 @@ void LogText::updateStatus(double ellapsedFrame)
       }
    }
 
+   /* scan only while some lines are under transition */
+   if (m_numNewLine == 0)
+      return;
    for (i = 0; i < LOGTEXT_MAXNLINES; i++) {
       if (m_transRateList[i] < 1.0f) {
          m_transRateList[i] += (float)ellapsedFrame / LOGTEXT_TEXTTRANSITIONFRAME;
-         if (m_transRateList[i] > 1.0f)
+         if (m_transRateList[i] >= 1.0f) {
             m_transRateList[i] = 1.0f;
+            m_numNewLine--;
+         }
       }
    }
 }
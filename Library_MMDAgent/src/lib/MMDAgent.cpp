@@ -1733,6 +1733,7 @@ void MMDAgent::initialize()
 
    m_model = NULL;
    m_renderOrder = NULL;
+   m_poseSource = NULL;
    m_numModel = 0;
    m_motion = NULL;
    m_hasExtModel = false;
@@ -1857,6 +1858,8 @@ void MMDAgent::clear()
       delete m_motion;
    if (m_renderOrder)
       free(m_renderOrder);
+   if (m_poseSource)
+      free(m_poseSource);
    if (m_model) {
       for (int i = 0; i < m_option->getMaxNumModel(); i++)
          m_model[i].~PMDObject();
@@ -2118,6 +2121,10 @@ bool MMDAgent::setupSystem(const char *systemDirName, const char *pluginDirName,
    m_stage = new(ptr) Stage();
    m_stage->setSize(m_option->getStageSize(), 1.0f, 1.0f);
 
+   /* set skinning method and IK solver for models to be loaded */
+   MMDFiles_setGPUSkinningDefault(m_option->getUseGPUSkinning());
+   MMDFiles_setIKSolverDefault(m_option->getUseAnalyticIK() ? PMDIK_SOLVER_ANALYTIC : PMDIK_SOLVER_CCD);
+
    /* setup render */
    ptr = MMDFiles_alignedmalloc(sizeof(Render), 16);
    m_render = new(ptr) Render();
@@ -2126,6 +2133,7 @@ bool MMDAgent::setupSystem(const char *systemDirName, const char *pluginDirName,
       clear();
       return false;
    }
+   m_render->setLevelOfDetail(m_option->getLODEdgeScreenRatio(), m_option->getLODMeshScreenRatio());
 
    /* setup timer */
    m_timer = new Timer();
@@ -2165,6 +2173,7 @@ bool MMDAgent::setupSystem(const char *systemDirName, const char *pluginDirName,
 
    /* setup motions */
    m_motion = new MotionStocker();
+   m_motion->setBake(m_option->getMotionBakeRate(), m_option->getMotionBakePosTolerance(), m_option->getMotionBakeRotTolerance());
 
    /* set mouse enable timer */
    m_screen->setMouseActiveTime(45.0f);
@@ -2416,12 +2425,20 @@ bool MMDAgent::setupWorld()
    /* re-set stage size */
    m_stage->setSize(m_option->getStageSize(), 1.0f, 1.0f);
 
+   /* re-set skinning method and IK solver for models to be loaded */
+   MMDFiles_setGPUSkinningDefault(m_option->getUseGPUSkinning());
+   MMDFiles_setIKSolverDefault(m_option->getUseAnalyticIK() ? PMDIK_SOLVER_ANALYTIC : PMDIK_SOLVER_CCD);
+
+   /* re-set resampling of motions to be loaded */
+   m_motion->setBake(m_option->getMotionBakeRate(), m_option->getMotionBakePosTolerance(), m_option->getMotionBakeRotTolerance());
+
    /* re-setup render */
    if (m_render->setup(m_screenSize, m_option->getCampusColor(), m_option->getCameraTransition(), m_option->getCameraRotation(), m_option->getCameraDistance(), m_option->getCameraFovy(), m_option->getUseShadow(), m_option->getUseShadowMapping(), m_option->getShadowMappingTextureSize(), m_option->getMaxNumModel()) == false) {
       sendLogString(m_moduleId, MLOG_ERROR, "failed to initialize renderer");
       clear();
       return false;
    }
+   m_render->setLevelOfDetail(m_option->getLODEdgeScreenRatio(), m_option->getLODMeshScreenRatio());
    m_render->setDoppelShadowFlag(m_option->getUseDoppelShadow());
    m_render->setDoppelShadowParam(m_option->getDoppelShadowColor(), m_option->getDoppelShadowOffset());
 
@@ -2471,6 +2488,7 @@ bool MMDAgent::setupWorld()
    for (int i = 0; i < m_option->getMaxNumModel(); i++)
       new (m_model + i) PMDObject();
    m_renderOrder = (int *)malloc(sizeof(int) * m_option->getMaxNumModel());
+   m_poseSource = (int *)malloc(sizeof(int) * m_option->getMaxNumModel());
 
    /* set full screen */
    if (m_option->getFullScreen() == true)
@@ -2839,7 +2857,8 @@ bool MMDAgent::updateAndRender()
 /* MMDAgent::updateScene: update the whole scene */
 bool MMDAgent::updateScene()
 {
-   int i, ite;
+   int i, j, ite;
+   bool updated;
    double intervalFrame;
    double stepFrame;
    double waitFrame;
@@ -2937,6 +2956,17 @@ bool MMDAgent::updateScene()
          continue;
       /* calculate adjustment time for audio */
       adjustFrame = m_timer->getAdditionalFrame(procFrame);
+      /* find models which will give the same pose as a preceding model, they take the pose instead of evaluating motions */
+      for (i = 0; i < m_numModel; i++) {
+         m_poseSource[i] = -1;
+         if (m_option->getMotionSharePose() == false || m_model[i].isEnable() == false) continue;
+         for (j = 0; j < i; j++) {
+            if (m_poseSource[j] == -1 && m_model[i].canSharePose(&m_model[j])) {
+               m_poseSource[i] = j;
+               break;
+            }
+         }
+      }
       /* update motion */
       for (i = 0; i < m_numModel; i++) {
          if (m_model[i].isEnable() == false) continue;
@@ -2961,7 +2991,11 @@ bool MMDAgent::updateScene()
 
          /* update root bone */
          m_model[i].updateRootBone();
-         if (m_model[i].updateMotion(procFrame + adjustFrame)) {
+         if (m_poseSource[i] >= 0 && m_model[m_poseSource[i]].isEnable())
+            updated = m_model[i].updateMotionWithPose(&m_model[m_poseSource[i]], procFrame + adjustFrame);
+         else
+            updated = m_model[i].updateMotion(procFrame + adjustFrame);
+         if (updated) {
             /* search end of motion */
             for (motionPlayer = m_model[i].getMotionManager()->getMotionPlayerList(); motionPlayer; motionPlayer = motionPlayer->next) {
                if (motionPlayer->statusFlag == MOTION_STATUS_DELETED) {
@@ -3050,7 +3084,7 @@ bool MMDAgent::updateScene()
    for (i = 0; i < m_numModel; i++)
       if (m_model[i].isEnable() == true) {
          m_model[i].updateAfterSimulation(m_enablePhysicsSimulation);
-         m_model[i].updateSkin();
+         m_model[i].updateSkinCPU();
          if (m_model[i].getPMDModel()->hasExtParam())
             m_hasExtModel = true;
          /* capture at this timing if capture is enabled */
@@ -3066,10 +3100,6 @@ bool MMDAgent::updateScene()
    /* update stage */
    m_stage->update(processedFrame);
 
-   /* calculate rendering range for shadow mapping */
-   if(m_option->getUseShadowMapping())
-      m_render->updateDepthTextureViewParam(m_model, m_numModel);
-
    /* decrement mouse active time */
    m_screen->updateMouseActiveTime(processedFrame);
 
@@ -3147,6 +3177,8 @@ bool MMDAgent::renderScene()
    char buff[MMDAGENT_MAXBUFLEN];
    Button *b, *blast;
    bool drawLogEdge;
+   unsigned int numEvaluated, numSkipped, numShared, n1, n2, n3;
+   size_t len;
 
    if (m_enable == false)
       return false;
@@ -3385,6 +3417,19 @@ bool MMDAgent::renderScene()
          MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "%d msec delay (current motion: %+d)", (int)(m_option->getMotionAdjustTime() * 1000.0f - 0.5f), (int)(m_timer->getCurrentAdjustmentFrame() * 1000.0 / 30.0 - 0.5f));
       else
          MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "%d msec (current motion: %+d)", (int)(m_option->getMotionAdjustTime() * 1000.0f + 0.5f), (int)(m_timer->getCurrentAdjustmentFrame() * 1000.0 / 30.0 + 0.5f));
+      /* show number of motion controller updates since last display, evaluated or cached, and model updates which took the pose of another model */
+      numEvaluated = numSkipped = numShared = 0;
+      for (i = 0; i < m_numModel; i++) {
+         if (m_model[i].isEnable() == false)
+            continue;
+         m_model[i].getMotionManager()->getStatistics(&n1, &n2, &n3);
+         m_model[i].getMotionManager()->resetStatistics();
+         numEvaluated += n1;
+         numSkipped += n2;
+         numShared += n3;
+      }
+      len = MMDAgent_strlen(buff);
+      MMDAgent_snprintf(buff + len, MMDAGENT_MAXBUFLEN - len, " | motion evaluated %u, cached %u, shared %u, baked %u KB", numEvaluated, numSkipped, numShared, (unsigned int)((m_motion->getBakedSize() + 1023) / 1024));
       if (m_font == NULL || m_font->getTextDrawElements(buff, &m_elem, m_elem.textLen, MMDAGENT_INDICATOR_OFFSET, y_offset + 1.1f * 2.0f, 0.0f) == false) {
          m_elem.textLen = 0; /* reset */
          m_elem.numIndices = 0;
@@ -3783,6 +3828,17 @@ void MMDAgent::resetAdjustmentTimer()
    m_timer->startAdjustment();
 }
 
+/* MMDAgent::resetAdjustmentTimer: reset adjustment timer to sync with audio heard from the given time */
+void MMDAgent::resetAdjustmentTimer(double audioStartTime)
+{
+   if(m_enable == false)
+      return;
+
+   /* motion starting now should be advanced by the time audio has already been heard */
+   m_timer->setTargetAdjustmentFrame(((double) m_option->getMotionAdjustTime() + MMDAgent_getTime() - audioStartTime) * 30.0);
+   m_timer->startAdjustment();
+}
+
 /* MMDAgent::getModuleId: get module id */
 int MMDAgent::getModuleId(const char *ident)
 {
@@ -254,6 +254,12 @@ bool MMDAgent_exist(const char *file)
    return MMDFiles_exist(file);
 }
 
+/* MMDAgent_getmtime: get last modification time of the file in sec, or -1 if not available */
+long long MMDAgent_getmtime(const char *file)
+{
+   return MMDFiles_getmtime(file);
+}
+
 /* MMDAgent_existdir: check if the directory exists */
 bool MMDAgent_existdir(const char *dir)
 {
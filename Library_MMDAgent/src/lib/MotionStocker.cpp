@@ -48,6 +48,9 @@ void MotionStocker::initialize()
 {
    m_head = NULL;
    m_tail = NULL;
+   m_bakeRate = 0.0f;
+   m_bakePosTolerance = 0.0f;
+   m_bakeRotTolerance = 0.0f;
 }
 
 /* MotionStocker::clear: free MotionStocker */
@@ -110,6 +113,8 @@ VMD * MotionStocker::loadFromFile(const char *file)
       delete vl;
       return NULL;
    }
+   if(m_bakeRate > 0.0f)
+      vl->vmd.bake(m_bakeRate, m_bakePosTolerance, m_bakeRotTolerance);
 
    /* save name */
    vl->name = MMDAgent_strdup(file);
@@ -140,6 +145,8 @@ VMD * MotionStocker::loadFromData(const unsigned char *rawData, unsigned int raw
       delete vl;
       return NULL;
    }
+   if(m_bakeRate > 0.0f)
+      vl->vmd.bake(m_bakeRate, m_bakePosTolerance, m_bakeRotTolerance);
 
    /* don't save name */
    vl->name = NULL;
@@ -207,3 +214,23 @@ void MotionStocker::unload(VMD *vmd)
       }
    }
 }
+
+/* MotionStocker::setBake: set rate per second and tolerances to resample bone motions at loading, rate 0 to disable */
+void MotionStocker::setBake(float rate, float posTolerance, float rotTolerance)
+{
+   m_bakeRate = rate;
+   m_bakePosTolerance = posTolerance;
+   m_bakeRotTolerance = rotTolerance;
+}
+
+/* MotionStocker::getBakedSize: get total bytes of resampled bone motions in cache */
+size_t MotionStocker::getBakedSize()
+{
+   VMDList *vl;
+   size_t size = 0;
+
+   for(vl = m_head; vl; vl = vl->next)
+      size += vl->vmd.getBakedSize();
+
+   return size;
+}
@@ -134,6 +134,16 @@ void Option::initialize()
    m_shadowMapSelfDensity = OPTION_SHADOWMAPPINGSELFDENSITY_DEF;
    m_shadowMapFloorDensity = OPTION_SHADOWMAPPINGFLOORDENSITY_DEF;
 
+   m_useGPUSkinning = OPTION_USEGPUSKINNING_DEF;
+   m_useAnalyticIK = OPTION_USEANALYTICIK_DEF;
+
+   m_lodEdgeScreenRatio = OPTION_LODEDGESCREENRATIO_DEF;
+   m_lodMeshScreenRatio = OPTION_LODMESHSCREENRATIO_DEF;
+   m_motionBakeRate = OPTION_MOTIONBAKERATE_DEF;
+   m_motionBakePosTolerance = OPTION_MOTIONBAKEPOSTOLERANCE_DEF;
+   m_motionBakeRotTolerance = OPTION_MOTIONBAKEROTTOLERANCE_DEF;
+   m_motionSharePose = OPTION_MOTIONSHAREPOSE_DEF;
+
    m_displayCommentTime = OPTION_DISPLAYCOMMENTTIME_DEF;
 
    m_maxNumModel = OPTION_MAXNUMMODEL_DEF;
@@ -329,6 +339,22 @@ bool Option::load(const char *file, ZFileKey *key, char **errstr)
          setShadowMappingFloorDensity(MMDAgent_str2float(p1));
       } else if(MMDAgent_strequal(buf, OPTION_SHADOWMAPPINGLIGHTFIRST_STR)) {
          /* bogus, ignored */
+      } else if (MMDAgent_strequal(buf, OPTION_USEGPUSKINNING_STR)) {
+         setUseGPUSkinning(MMDAgent_str2bool(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_USEANALYTICIK_STR)) {
+         setUseAnalyticIK(MMDAgent_str2bool(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_LODEDGESCREENRATIO_STR)) {
+         setLODEdgeScreenRatio(MMDAgent_str2float(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_LODMESHSCREENRATIO_STR)) {
+         setLODMeshScreenRatio(MMDAgent_str2float(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_MOTIONBAKERATE_STR)) {
+         setMotionBakeRate(MMDAgent_str2float(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_MOTIONBAKEPOSTOLERANCE_STR)) {
+         setMotionBakePosTolerance(MMDAgent_str2float(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_MOTIONBAKEROTTOLERANCE_STR)) {
+         setMotionBakeRotTolerance(MMDAgent_str2float(p1));
+      } else if (MMDAgent_strequal(buf, OPTION_MOTIONSHAREPOSE_STR)) {
+         setMotionSharePose(MMDAgent_str2bool(p1));
       } else if(MMDAgent_strequal(buf, OPTION_DISPLAYCOMMENTTIME_STR)) {
          setDisplayCommentTime(MMDAgent_str2float(p1));
       } else if(MMDAgent_strequal(buf, OPTION_MAXNUMMODEL_STR)) {
@@ -1042,6 +1068,127 @@ void Option::setShadowMappingFloorDensity(float f)
       m_shadowMapFloorDensity = f;
 }
 
+/* Option::getUseGPUSkinning: get GPU skinning flag */
+bool Option::getUseGPUSkinning()
+{
+   return m_useGPUSkinning;
+}
+
+/* Option::setUseGPUSkinning: set GPU skinning flag */
+void Option::setUseGPUSkinning(bool b)
+{
+   m_useGPUSkinning = b;
+}
+
+/* Option::getUseAnalyticIK: get analytic IK flag */
+bool Option::getUseAnalyticIK()
+{
+   return m_useAnalyticIK;
+}
+
+/* Option::setUseAnalyticIK: set analytic IK flag */
+void Option::setUseAnalyticIK(bool b)
+{
+   m_useAnalyticIK = b;
+}
+
+/* Option::getLODEdgeScreenRatio: get screen ratio below which edge is skipped */
+float Option::getLODEdgeScreenRatio()
+{
+   return m_lodEdgeScreenRatio;
+}
+
+/* Option::setLODEdgeScreenRatio: set screen ratio below which edge is skipped */
+void Option::setLODEdgeScreenRatio(float f)
+{
+   if(OPTION_LODEDGESCREENRATIO_MAX < f)
+      m_lodEdgeScreenRatio = OPTION_LODEDGESCREENRATIO_MAX;
+   else if(OPTION_LODEDGESCREENRATIO_MIN > f)
+      m_lodEdgeScreenRatio = OPTION_LODEDGESCREENRATIO_MIN;
+   else
+      m_lodEdgeScreenRatio = f;
+}
+
+/* Option::getLODMeshScreenRatio: get screen ratio below which simplified mesh is used */
+float Option::getLODMeshScreenRatio()
+{
+   return m_lodMeshScreenRatio;
+}
+
+/* Option::setLODMeshScreenRatio: set screen ratio below which simplified mesh is used */
+void Option::setLODMeshScreenRatio(float f)
+{
+   if(OPTION_LODMESHSCREENRATIO_MAX < f)
+      m_lodMeshScreenRatio = OPTION_LODMESHSCREENRATIO_MAX;
+   else if(OPTION_LODMESHSCREENRATIO_MIN > f)
+      m_lodMeshScreenRatio = OPTION_LODMESHSCREENRATIO_MIN;
+   else
+      m_lodMeshScreenRatio = f;
+}
+
+/* Option::getMotionBakeRate: get rate per second to resample bone motions */
+float Option::getMotionBakeRate()
+{
+   return m_motionBakeRate;
+}
+
+/* Option::setMotionBakeRate: set rate per second to resample bone motions */
+void Option::setMotionBakeRate(float f)
+{
+   if(OPTION_MOTIONBAKERATE_MAX < f)
+      m_motionBakeRate = OPTION_MOTIONBAKERATE_MAX;
+   else if(OPTION_MOTIONBAKERATE_MIN > f)
+      m_motionBakeRate = OPTION_MOTIONBAKERATE_MIN;
+   else
+      m_motionBakeRate = f;
+}
+
+/* Option::getMotionBakePosTolerance: get maximum position error of resampled bone motions */
+float Option::getMotionBakePosTolerance()
+{
+   return m_motionBakePosTolerance;
+}
+
+/* Option::setMotionBakePosTolerance: set maximum position error of resampled bone motions */
+void Option::setMotionBakePosTolerance(float f)
+{
+   if(OPTION_MOTIONBAKEPOSTOLERANCE_MAX < f)
+      m_motionBakePosTolerance = OPTION_MOTIONBAKEPOSTOLERANCE_MAX;
+   else if(OPTION_MOTIONBAKEPOSTOLERANCE_MIN > f)
+      m_motionBakePosTolerance = OPTION_MOTIONBAKEPOSTOLERANCE_MIN;
+   else
+      m_motionBakePosTolerance = f;
+}
+
+/* Option::getMotionBakeRotTolerance: get maximum rotation error of resampled bone motions in radian */
+float Option::getMotionBakeRotTolerance()
+{
+   return m_motionBakeRotTolerance;
+}
+
+/* Option::setMotionBakeRotTolerance: set maximum rotation error of resampled bone motions in radian */
+void Option::setMotionBakeRotTolerance(float f)
+{
+   if(OPTION_MOTIONBAKEROTTOLERANCE_MAX < f)
+      m_motionBakeRotTolerance = OPTION_MOTIONBAKEROTTOLERANCE_MAX;
+   else if(OPTION_MOTIONBAKEROTTOLERANCE_MIN > f)
+      m_motionBakeRotTolerance = OPTION_MOTIONBAKEROTTOLERANCE_MIN;
+   else
+      m_motionBakeRotTolerance = f;
+}
+
+/* Option::getMotionSharePose: get flag to share pose among models playing the same motions */
+bool Option::getMotionSharePose()
+{
+   return m_motionSharePose;
+}
+
+/* Option::setMotionSharePose: set flag to share pose among models playing the same motions */
+void Option::setMotionSharePose(bool b)
+{
+   m_motionSharePose = b;
+}
+
 /* Option::getDisplayCommentTime: get display comment time in sec */
 float Option::getDisplayCommentTime()
 {
@@ -454,6 +454,53 @@ bool PMDObject::updateMotion(double deltaFrame)
    return ret;
 }
 
+/* PMDObject::canSharePose: return true when this model can take the updated pose of the given model instead of evaluating its own motions */
+bool PMDObject::canSharePose(PMDObject *obj)
+{
+   int i;
+
+   if (obj == this || m_isEnable == false || obj->m_isEnable == false)
+      return false;
+   if (m_motionManager == NULL || obj->m_motionManager == NULL)
+      return false;
+
+   /* bone/face controls of the given model would be copied to this model */
+   for (i = 0; i < PMDOBJECT_MAXNUMBIND; i++)
+      if (obj->m_boneFaceControl[i])
+         return false;
+
+   /* the same motions at the same frame on the same pose give the same result */
+   if (m_motionManager->hasSameState(obj->m_motionManager) == false)
+      return false;
+   return m_pmd->canCopyPose(obj->m_pmd);
+}
+
+/* PMDObject::updateMotionWithPose: advance motions and take the pose of the given model already updated in this step */
+bool PMDObject::updateMotionWithPose(PMDObject *obj, double deltaFrame)
+{
+   bool ret;
+
+   if (m_isEnable == false || m_motionManager == NULL) return false;
+
+   /* advance motion status without evaluation, and copy the resulting bones and faces */
+   ret = m_motionManager->advance(deltaFrame);
+   m_pmd->copyPose(obj->m_pmd);
+   for (int i = 0; i < PMDOBJECT_MAXNUMBIND; i++) {
+      if (m_boneFaceControl[i])
+         m_boneFaceControl[i]->update(deltaFrame); /* update bone/face controller */
+   }
+   /* update comment frame */
+   if (m_displayCommentFrame > 0.0f) {
+      m_displayCommentFrame -= deltaFrame;
+      if (m_displayCommentFrame < 0.0f)
+         m_displayCommentFrame = 0.0f;
+   }
+   /* update texture animation */
+   m_pmd->getTextureLoader()->update(deltaFrame);
+
+   return ret;
+}
+
 /* PMDObject::updateAfterSimulation: update bone transforms from simulated rigid bodies */
 void PMDObject::updateAfterSimulation(bool physicsEnabled)
 {
@@ -476,13 +523,28 @@ void PMDObject::updateAfterSimulation(bool physicsEnabled)
 
 /* PMDObject::updateSkin: update skin and toon */
 void PMDObject::updateSkin()
+{
+   updateSkinCPU();
+   uploadSkin();
+}
+
+/* PMDObject::updateSkinCPU: update skin and toon into staging buffer without OpenGL call */
+void PMDObject::updateSkinCPU()
 {
    if (m_isEnable == false) return;
 
    /* update skin and toon */
    m_pmd->setToonLight(&m_lightDir);
    m_pmd->updateFace();
-   m_pmd->updateSkin();
+   m_pmd->updateSkinCPU();
+}
+
+/* PMDObject::uploadSkin: upload updated skin to OpenGL buffer */
+void PMDObject::uploadSkin()
+{
+   if (m_isEnable == false) return;
+
+   m_pmd->uploadSkin();
 }
 
 /* PMDObject::updateAlpha: update global model alpha */
@@ -72,6 +72,63 @@ static int compareDepth(const void *a, const void *b)
    return ( (x->dist > y->dist) ? 1 : -1 );
 }
 
+/* multMatrix: multiply column-major 4x4 matrices, dst = a * b */
+static void multMatrix(double *dst, const double *a, const double *b)
+{
+   int i, j, k;
+   double s;
+
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < 4; j++) {
+         s = 0.0;
+         for (k = 0; k < 4; k++)
+            s += a[k * 4 + i] * b[j * 4 + k];
+         dst[j * 4 + i] = s;
+      }
+   }
+}
+
+/* setPerspectiveMatrix: set column-major matrix as the same as gluPerspective */
+static void setPerspectiveMatrix(double *m, double fovy, double aspect, double zNear, double zFar)
+{
+   double f = 1.0 / tan(MMDFILES_RAD(fovy) * 0.5);
+   int i;
+
+   for (i = 0; i < 16; i++)
+      m[i] = 0.0;
+   m[0] = f / aspect;
+   m[5] = f;
+   m[10] = (zFar + zNear) / (zNear - zFar);
+   m[11] = -1.0;
+   m[14] = 2.0 * zFar * zNear / (zNear - zFar);
+}
+
+/* setLookAtMatrix: set column-major matrix as the same as gluLookAt */
+static void setLookAtMatrix(double *m, const btVector3 &eye, const btVector3 &center, const btVector3 &up)
+{
+   btVector3 f, s, u;
+   int i;
+
+   f = (center - eye).normalized();
+   s = f.cross(up).normalized();
+   u = s.cross(f);
+   for (i = 0; i < 16; i++)
+      m[i] = 0.0;
+   m[0] = s.x();
+   m[4] = s.y();
+   m[8] = s.z();
+   m[1] = u.x();
+   m[5] = u.y();
+   m[9] = u.z();
+   m[2] = -f.x();
+   m[6] = -f.y();
+   m[10] = -f.z();
+   m[12] = -s.dot(eye);
+   m[13] = -u.dot(eye);
+   m[14] = f.dot(eye);
+   m[15] = 1.0;
+}
+
 /* Render::updateProjectionMatrix: update view information */
 void Render::updateProjectionMatrix()
 {
@@ -119,6 +176,20 @@ void Render::updateModelViewMatrix()
    m_transMatrixInv.getOpenGLMatrix(m_rotMatrixInv);
 }
 
+/* Render::getPickRay: get ray in world coordinates passing the screen position */
+void Render::getPickRay(float x, float y, btVector3 *from, btVector3 *dir)
+{
+   double ty = tan(MMDFILES_RAD(m_currentFovy) * 0.5);
+   double tx = ty * m_width / m_height;
+   btVector3 eyeDir;
+
+   /* direction in eye coordinates, same frustum as applyProjectionMatrix() */
+   eyeDir = btVector3(btScalar((2.0 * x / m_width - 1.0) * tx), btScalar((1.0 - 2.0 * y / m_height) * ty), btScalar(-1.0f));
+   *from = m_transMatrixInv.getOrigin();
+   *dir = m_transMatrixInv.getBasis() * eyeDir;
+   dir->normalize();
+}
+
 /* Render::updateTransRotMatrix:  update trans and rotation matrix */
 bool Render::updateTransRotMatrix(double ellapsedTimeForMove)
 {
@@ -246,6 +317,9 @@ void Render::initializeShadowMap(int textureSize)
       { 0.0, 0.0, 0.0, 1.0 },
    };
 
+   /* depth texture should be rendered at next frame */
+   m_shadowMapValid = false;
+
    /* initialize model view matrix */
    glPushMatrix();
    glLoadIdentity();
@@ -317,25 +391,14 @@ void Render::initializeShadowMap(int textureSize)
 #endif /* !MMDAGENT_DONTUSESHADOWMAP */
 }
 
-/* Render::renderSceneShadowMap: shadow mapping */
-void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, Stage *stage, bool useMMDLikeCartoon, bool useCartoonRendering, float lightIntensity, const float *lightDirection, const float *lightColor, int shadowMappingTextureSize, float shadowMappingSelfDensity)
+/* Render::renderDepthTexture: render depth texture from the light for shadow mapping */
+void Render::renderDepthTexture(PMDObject *objs, const int *order, int num, int shadowMappingTextureSize)
 {
 #ifndef MMDAGENT_DONTUSESHADOWMAP
    short i;
    GLint viewport[4]; /* store viewport */
-   GLdouble modelview[16]; /* store model view transform */
    GLdouble projection[16]; /* store projection transform */
-   bool toonLight = true;
 
-#ifdef RENDER_SHADOWAUTOVIEW
-   float eyeDist;
-   btVector3 v;
-#endif /* RENDER_SHADOWAUTOVIEW */
-
-   static GLfloat lightdim[] = { 0.2f, 0.2f, 0.2f, 1.0f };
-   static const GLfloat lightblk[] = { 0.0f, 0.0f, 0.0f, 1.0f };
-
-   /* render the depth texture */
    /* store the current viewport */
    glGetIntegerv(GL_VIEWPORT, viewport);
 
@@ -360,22 +423,8 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
    glMatrixMode(GL_MODELVIEW);
    glLoadIdentity();
 
-#ifdef RENDER_SHADOWAUTOVIEW
-   /* set the distance to cover all the model range */
-   eyeDist = m_shadowMapAutoViewRadius / sinf(RENDER_SHADOWAUTOVIEWANGLE * 0.5f * 3.1415926f / 180.0f);
-   /* set the perspective */
-   gluPerspective(RENDER_SHADOWAUTOVIEWANGLE, 1.0, 1.0, eyeDist + m_shadowMapAutoViewRadius + 50.0f); /* +50.0f is needed to cover the background */
-   /* the viewpoint should be at eyeDist far toward light direction from the model center */
-   v = m_lightVec * eyeDist + m_shadowMapAutoViewEyePoint;
-   gluLookAt(v.x(), v.y(), v.z(), m_shadowMapAutoViewEyePoint.x(), m_shadowMapAutoViewEyePoint.y(), m_shadowMapAutoViewEyePoint.z(), 0.0, 1.0, 0.0);
-#else
-   /* fixed view */
-   gluPerspective(25.0, 1.0, 1.0, 120.0);
-   gluLookAt(30.0, 77.0, 30.0, 0.0, 17.0, 0.0, 0.0, 1.0, 0.0);
-#endif /* RENDER_SHADOWAUTOVIEW */
-
-   /* keep the current model view for later process */
-   glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+   /* the same matrix has been used for culling */
+   glLoadMatrixd(m_shadowMapMatrix);
 
    /* do not write into frame buffer other than depth information */
    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
@@ -401,7 +450,7 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
    /* render objects for depth */
    /* only objects that wants to drop shadow should be rendered here */
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true) {
+      if (objs[order[i]].isEnable() == true && m_shadowCulled[order[i]] == false) {
          objs[order[i]].getPMDModel()->renderForShadowMap();
       }
    }
@@ -420,6 +469,25 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
    glEnable(GL_LIGHTING);
    glCullFace(GL_BACK);
    glEnable(GL_ALPHA_TEST);
+#endif /* !MMDAGENT_DONTUSESHADOWMAP */
+}
+
+/* Render::renderSceneShadowMap: shadow mapping */
+void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, Stage *stage, bool useMMDLikeCartoon, bool useCartoonRendering, float lightIntensity, const float *lightDirection, const float *lightColor, int shadowMappingTextureSize, float shadowMappingSelfDensity)
+{
+#ifndef MMDAGENT_DONTUSESHADOWMAP
+   short i;
+   bool toonLight = true;
+
+   static GLfloat lightdim[] = { 0.2f, 0.2f, 0.2f, 1.0f };
+   static const GLfloat lightblk[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+   /* render the depth texture only when the light view or casters have been changed */
+   if (m_shadowMapRequired) {
+      renderDepthTexture(objs, order, num, shadowMappingTextureSize);
+      m_shadowMapRequired = false;
+      m_shadowMapValid = true;
+   }
 
    /* clear all the buffers */
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
@@ -475,7 +543,7 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
       glEnable(GL_LIGHTING);
    }
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true) {
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false) {
          if (objs[order[i]].getPMDModel()->getToonFlag() == false && toonLight == true) {
             /* disable toon lighting */
             updateLight(true, false, lightIntensity, lightDirection, lightColor);
@@ -504,7 +572,7 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
    glTranslatef(0.5f, 0.5f, 0.5f);
    glScalef(0.5f, 0.5f, 0.5f);
    /* multiply the model view matrix when the depth texture was rendered */
-   glMultMatrixd(modelview);
+   glMultMatrixd(m_shadowMapMatrix);
    /* multiply the inverse matrix of current model view matrix */
    glMultMatrixf(m_rotMatrixInv);
 
@@ -550,7 +618,7 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
          stage->renderFloor();
    }
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true && objs[order[i]].getPMDModel()->getToonFlag() == false)
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false && objs[order[i]].getPMDModel()->getToonFlag() == false)
          objs[order[i]].getPMDModel()->renderModel(false);
    }
 
@@ -567,7 +635,7 @@ void Render::renderSceneShadowMap(PMDObject *objs, const int *order, int num, St
          stage->renderFloor();
    }
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true && objs[order[i]].getPMDModel()->getToonFlag() == true) {
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false && objs[order[i]].getPMDModel()->getToonFlag() == true) {
          /* set texture coordinates for shadow mapping */
          objs[order[i]].getPMDModel()->updateShadowColorTexCoord(shadowMappingSelfDensity);
          /* tell model to render with the shadow corrdinates */
@@ -714,7 +782,7 @@ void Render::renderScene(PMDObject *objs, const int *order, int num, Stage *stag
 
    /* render model */
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true) {
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false) {
          if (objs[order[i]].getPMDModel()->getToonFlag() == false && toonLight == true) {
             /* disable toon lighting */
             updateLight(true, false, lightIntensity, lightDirection, lightColor);
@@ -887,7 +955,7 @@ void Render::renderBloomTexture(PMDObject *objs, const int *order, int num, Stag
       glPopMatrix();
    }
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true) {
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false) {
          pmd = objs[order[i]].getPMDModel();
          if (pmd->getToonFlag() == false && toonLight == true) {
             /* disable toon lighting */
@@ -929,7 +997,7 @@ void Render::renderBloomTexture(PMDObject *objs, const int *order, int num, Stag
       glPopMatrix();
    }
    for (i = 0; i < num; i++) {
-      if (objs[order[i]].isEnable() == true) {
+      if (objs[order[i]].isEnable() == true && m_culled[order[i]] == false) {
          pmd = objs[order[i]].getPMDModel();
          if (pmd->getToonFlag() == false && toonLight == true) {
             /* disable toon lighting */
@@ -1166,6 +1234,29 @@ void Render::initialize()
    m_defaultFrameBuffer = 0;
 
    m_backgroundForTransparent = false;
+
+   m_numDrawCall = 0;
+   m_numStateChange = 0;
+
+   m_culled = NULL;
+   m_shadowCulled = NULL;
+   m_cullCenter = NULL;
+   m_cullRadius = NULL;
+   m_numCulledModel = 0;
+   m_numShadowCulledModel = 0;
+   m_numCulledMaterial = 0;
+
+   for (int i = 0; i < 16; i++)
+      m_shadowMapMatrix[i] = 0.0;
+   m_shadowMapSerial = NULL;
+   m_shadowMapNumModel = 0;
+   m_shadowMapValid = false;
+   m_shadowMapRequired = true;
+   m_numShadowMapReused = 0;
+
+   m_lodEdgeScreenRatio = 0.0f;
+   m_lodMeshScreenRatio = 0.0f;
+   m_numLowDetailModel = 0;
 }
 
 /* Render::clear: free Render */
@@ -1173,6 +1264,16 @@ void Render::clear()
 {
    if(m_depth)
       free(m_depth);
+   if (m_culled)
+      free(m_culled);
+   if (m_shadowCulled)
+      free(m_shadowCulled);
+   if (m_cullCenter)
+      delete [] m_cullCenter;
+   if (m_cullRadius)
+      free(m_cullRadius);
+   if (m_shadowMapSerial)
+      free(m_shadowMapSerial);
    if (m_baseBoneName)
       free(m_baseBoneName);
    initialize();
@@ -1263,6 +1364,28 @@ bool Render::setup(const int *size, const float *color, const float *trans, cons
    if (m_depth)
       free(m_depth);
    m_depth = (RenderDepthData *) malloc(sizeof(RenderDepthData) * maxNumModel);
+   if (m_culled)
+      free(m_culled);
+   m_culled = (bool *) malloc(sizeof(bool) * maxNumModel);
+   if (m_shadowCulled)
+      free(m_shadowCulled);
+   m_shadowCulled = (bool *) malloc(sizeof(bool) * maxNumModel);
+   if (m_cullCenter)
+      delete [] m_cullCenter;
+   m_cullCenter = new btVector3[maxNumModel];
+   if (m_cullRadius)
+      free(m_cullRadius);
+   m_cullRadius = (float *) malloc(sizeof(float) * maxNumModel);
+   if (m_shadowMapSerial)
+      free(m_shadowMapSerial);
+   m_shadowMapSerial = (unsigned int *) malloc(sizeof(unsigned int) * maxNumModel);
+   for (int i = 0; i < maxNumModel; i++) {
+      m_culled[i] = false;
+      m_shadowCulled[i] = false;
+      m_cullRadius[i] = 0.0f;
+      m_shadowMapSerial[i] = 0;
+   }
+   m_shadowMapValid = false;
 
    return true;
 }
@@ -1440,6 +1563,13 @@ void Render::setShadow(bool useShadow)
    m_useShadow = useShadow;
 }
 
+/* Render::setLevelOfDetail: set screen ratios of model size to skip edge and to use simplified mesh */
+void Render::setLevelOfDetail(float edgeRatio, float meshRatio)
+{
+   m_lodEdgeScreenRatio = edgeRatio;
+   m_lodMeshScreenRatio = meshRatio;
+}
+
 /* Render::setShadowMapping: switch shadow mapping */
 void Render::setShadowMapping(bool useShadowMapping, int textureSize)
 {
@@ -1500,11 +1630,157 @@ void Render::getRenderOrder(int *order, PMDObject *objs, int num)
          objs[i].getPMDModel()->updateMaterialOrder(&m_transMatrix);
 }
 
+/* Render::getShadowMapMatrix: get projection * model view matrix from the light for shadow mapping */
+void Render::getShadowMapMatrix(double *m)
+{
+   double proj[16], view[16];
+#ifdef RENDER_SHADOWAUTOVIEW
+   float eyeDist;
+   btVector3 v;
+
+   /* set the distance to cover all the model range */
+   eyeDist = m_shadowMapAutoViewRadius / sinf(RENDER_SHADOWAUTOVIEWANGLE * 0.5f * 3.1415926f / 180.0f);
+   /* set the perspective */
+   setPerspectiveMatrix(proj, RENDER_SHADOWAUTOVIEWANGLE, 1.0, 1.0, eyeDist + m_shadowMapAutoViewRadius + 50.0f); /* +50.0f is needed to cover the background */
+   /* the viewpoint should be at eyeDist far toward light direction from the model center */
+   v = m_lightVec * eyeDist + m_shadowMapAutoViewEyePoint;
+   setLookAtMatrix(view, v, m_shadowMapAutoViewEyePoint, btVector3(btScalar(0.0f), btScalar(1.0f), btScalar(0.0f)));
+#else
+   /* fixed view */
+   setPerspectiveMatrix(proj, 25.0, 1.0, 1.0, 120.0);
+   setLookAtMatrix(view, btVector3(btScalar(30.0f), btScalar(77.0f), btScalar(30.0f)), btVector3(btScalar(0.0f), btScalar(17.0f), btScalar(0.0f)), btVector3(btScalar(0.0f), btScalar(1.0f), btScalar(0.0f)));
+#endif /* RENDER_SHADOWAUTOVIEW */
+   multMatrix(m, proj, view);
+}
+
+/* Render::updateCulling: test models against view and light frustum, and upload skin of models to be rendered */
+void Render::updateCulling(PMDObject *objs, int num, bool useShadowMapping)
+{
+   int i;
+   double proj[16], view[16], m[16];
+   double x, y, farVal;
+   float depth, ratio;
+   bool shadowMapping = false;
+   bool planarShadow;
+   int ret;
+   unsigned int serial;
+   PMDModel *pmd;
+
+   /* view frustum, the same as applyProjectionMatrix() with the current model view */
+   farVal = RENDER_VIEWPOINTFRUSTUMFAR;
+   y = tan(MMDFILES_RAD(m_currentFovy) * 0.5) * m_viewPointFrustumNear;
+   x = y * m_width / m_height;
+   for (i = 0; i < 16; i++) {
+      proj[i] = 0.0;
+      view[i] = m_rotMatrix[i];
+   }
+   proj[0] = m_viewPointFrustumNear / x;
+   proj[5] = m_viewPointFrustumNear / y;
+   proj[10] = -(farVal + m_viewPointFrustumNear) / (farVal - m_viewPointFrustumNear);
+   proj[11] = -1.0;
+   proj[14] = -2.0 * farVal * m_viewPointFrustumNear / (farVal - m_viewPointFrustumNear);
+   multMatrix(m, proj, view);
+   MMDFiles_setFrustum(&m_viewFrustum, m);
+
+   /* test models against view frustum */
+   m_numCulledModel = 0;
+   m_numShadowCulledModel = 0;
+   m_numCulledMaterial = 0;
+   m_numLowDetailModel = 0;
+   for (i = 0; i < num; i++) {
+      m_culled[i] = false;
+      m_shadowCulled[i] = false;
+      m_cullRadius[i] = 0.0f;
+      if (objs[i].isEnable() == false)
+         continue;
+      pmd = objs[i].getPMDModel();
+      m_cullRadius[i] = pmd->calculateBoundingSphereRange(&(m_cullCenter[i]));
+      if (m_cullRadius[i] <= 0.0f) {
+         /* no bounding sphere, always render */
+         pmd->updateMaterialCulling(NULL);
+         pmd->setDetailLevel(PMDMODEL_DETAIL_FULL);
+         continue;
+      }
+      /* choose detail level from the ratio of bounding sphere to the screen height */
+      depth = -(m_rotMatrix[2] * m_cullCenter[i].x() + m_rotMatrix[6] * m_cullCenter[i].y() + m_rotMatrix[10] * m_cullCenter[i].z() + m_rotMatrix[14]);
+      if (depth <= m_cullRadius[i]) {
+         pmd->setDetailLevel(PMDMODEL_DETAIL_FULL);
+      } else {
+         ratio = m_cullRadius[i] / (depth * (float)tan(MMDFILES_RAD(m_currentFovy) * 0.5));
+         if (ratio < m_lodMeshScreenRatio)
+            pmd->setDetailLevel(PMDMODEL_DETAIL_LOW);
+         else if (ratio < m_lodEdgeScreenRatio)
+            pmd->setDetailLevel(PMDMODEL_DETAIL_NOEDGE);
+         else
+            pmd->setDetailLevel(PMDMODEL_DETAIL_FULL);
+      }
+      if (pmd->getDetailLevel() != PMDMODEL_DETAIL_FULL)
+         m_numLowDetailModel++;
+      ret = MMDFiles_testSphereInFrustum(&m_viewFrustum, &(m_cullCenter[i]), m_cullRadius[i]);
+      if (ret == MMDFILES_FRUSTUM_OUTSIDE) {
+         m_culled[i] = true;
+         m_numCulledModel++;
+      } else if (ret == MMDFILES_FRUSTUM_INSIDE) {
+         pmd->updateMaterialCulling(NULL);
+      } else {
+         m_numCulledMaterial += pmd->updateMaterialCulling(&m_viewFrustum);
+      }
+   }
+
+#ifndef MMDAGENT_DONTUSESHADOWMAP
+   if (m_useShadow && useShadowMapping) {
+#ifdef RENDER_SHADOWAUTOVIEW
+      /* fit light frustum to all models, including ones out of view whose shadows may fall into view */
+      updateDepthTextureViewParam(objs, num);
+#endif /* RENDER_SHADOWAUTOVIEW */
+      getShadowMapMatrix(m);
+      MMDFiles_setFrustum(&m_shadowFrustum, m);
+      shadowMapping = true;
+   }
+#endif /* !MMDAGENT_DONTUSESHADOWMAP */
+
+   /* shadows projected on the floor may be visible even if the model itself is not */
+   planarShadow = m_doppelShadowFlag || (m_useShadow && shadowMapping == false);
+
+   /* test models against light frustum, and upload skin */
+   for (i = 0; i < num; i++) {
+      if (objs[i].isEnable() == false)
+         continue;
+      if (shadowMapping && m_cullRadius[i] > 0.0f && MMDFiles_testSphereInFrustum(&m_shadowFrustum, &(m_cullCenter[i]), m_cullRadius[i]) == MMDFILES_FRUSTUM_OUTSIDE) {
+         m_shadowCulled[i] = true;
+         m_numShadowCulledModel++;
+      }
+      /* skin of culled models is kept in staging buffer and will be uploaded when they come into view */
+      if (m_culled[i] == false || (shadowMapping && m_shadowCulled[i] == false) || planarShadow)
+         objs[i].uploadSkin();
+   }
+
+   /* depth texture can be reused while the light view and shapes of all casters are unchanged */
+   if (shadowMapping) {
+      m_shadowMapRequired = (m_shadowMapValid == false || m_shadowMapNumModel != num || memcmp(m, m_shadowMapMatrix, sizeof(double) * 16) != 0);
+      for (i = 0; i < num; i++) {
+         serial = (objs[i].isEnable() == true && m_shadowCulled[i] == false) ? objs[i].getPMDModel()->getSkinSerial() : 0;
+         if (m_shadowMapSerial[i] != serial) {
+            m_shadowMapSerial[i] = serial;
+            m_shadowMapRequired = true;
+         }
+      }
+      memcpy(m_shadowMapMatrix, m, sizeof(double) * 16);
+      m_shadowMapNumModel = num;
+      if (m_shadowMapRequired == false)
+         m_numShadowMapReused++;
+   }
+}
+
 /* Render::render: render all */
 void Render::render(PMDObject *objs, const int *order, int num, Stage *stage, bool useMMDLikeCartoon, bool useCartoonRendering, float lightIntensity, float *lightDirection, float *lightColor, bool useShadowMapping, int shadowMappingTextureSize, float shadowMappingSelfDensity, float shadowMappingFloorDensity, double ellapsedTimeForMove, float shadowDensity)
 {
    bool updated;
 
+   /* keep draw call and state change counts of the last frame */
+   MMDFiles_getRenderStatistics(&m_numDrawCall, &m_numStateChange);
+   MMDFiles_resetRenderStatistics();
+
    /* update camera view matrices */
    updated = updateDistance(ellapsedTimeForMove);
    updated |= updateTransRotMatrix(ellapsedTimeForMove);
@@ -1516,6 +1792,9 @@ void Render::render(PMDObject *objs, const int *order, int num, Stage *stage, bo
    if (isViewMoving() == false)
       m_viewMoveTime = -1.0;
 
+   /* cull models outside of view and light, and upload skin of the rest */
+   updateCulling(objs, num, useShadowMapping);
+
 #ifdef MY_LUMINOUS
    /* check model status for enable/disable bloom rendering */
    updateLuminous(objs, num, stage);
@@ -1537,80 +1816,55 @@ void Render::render(PMDObject *objs, const int *order, int num, Stage *stage, bo
 /* Render::pickModel: pick up a model at the screen position */
 int Render::pickModel(PMDObject *objs, int num, int x, int y, int *allowDropPicked)
 {
-#ifdef MMDAGENT_DONTPICKMODEL
-   return -1;
-#else
-   int i;
-
-   GLuint selectionBuffer[512];
-   GLint viewport[4];
-
-   GLint hits;
-   GLuint *data;
-   GLuint minDepth = 0, minDepthAllowDrop = 0;
-   int minID, minIDAllowDrop;
-   GLuint depth;
-   int id;
-
-   /* get current viewport */
-   glGetIntegerv(GL_VIEWPORT, viewport);
-   /* set selection buffer */
-   glSelectBuffer(512, selectionBuffer);
-   /* begin selection mode */
-   glRenderMode(GL_SELECT);
-   /* save projection matrix */
-   glMatrixMode(GL_PROJECTION);
-   glPushMatrix();
-   /* set projection matrix for picking */
-   glLoadIdentity();
-   /* apply picking matrix */
-   gluPickMatrix(x, viewport[3] - y, 15.0, 15.0, viewport);
-   /* apply normal projection matrix */
-   applyProjectionMatrix(m_viewPointFrustumNear, RENDER_VIEWPOINTFRUSTUMFAR);
-   /* switch to model view mode */
-   glMatrixMode(GL_MODELVIEW);
-   /* initialize name buffer */
-   glInitNames();
-   glPushName(0);
-   /* draw models with selection names */
-   for (i = 0; i < num; i++) {
-      if (objs[i].isEnable() == true) {
-         glLoadName(i);
-         objs[i].getPMDModel()->renderForPick();
-      }
-   }
+   return pickModel(objs, num, x, y, allowDropPicked, NULL, NULL);
+}
 
-   /* restore projection matrix */
-   glMatrixMode(GL_PROJECTION);
-   glPopMatrix();
-   /* switch to model view mode */
-   glMatrixMode(GL_MODELVIEW);
-   /* end selection mode and get number of hits */
-   hits = glRenderMode(GL_RENDER);
-   if (hits == 0) return -1;
-   data = &(selectionBuffer[0]);
-   minID = -1;
-   minIDAllowDrop = -1;
-   for (i = 0; i < hits; i++) {
-      depth = *(data + 1);
-      id = *(data + 3);
-      if (minID == -1 || minDepth > depth) {
-         minDepth = depth;
-         minID = id;
-      }
-      if (allowDropPicked && objs[id].allowMotionFileDrop()) {
-         if (minIDAllowDrop == -1 || minDepthAllowDrop > depth) {
-            minDepthAllowDrop = depth;
-            minIDAllowDrop = id;
+/* Render::pickModel: pick up a model at the screen position, also get picked material and bone */
+int Render::pickModel(PMDObject *objs, int num, int x, int y, int *allowDropPicked, int *materialPicked, int *bonePicked)
+{
+   /* center ray first, then rays around it to give the same tolerance as the former 15x15 pixel pick window */
+   static const int offset[9][2] = { { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+   int i, k;
+   btVector3 from, dir;
+   float dist, minDist = 0.0f, minDistAllowDrop = 0.0f;
+   int material, bone;
+   int minID = -1, minIDAllowDrop = -1;
+
+   if (materialPicked)
+      *materialPicked = -1;
+   if (bonePicked)
+      *bonePicked = -1;
+
+   for (k = 0; k < 9; k++) {
+      getPickRay((float)(x + offset[k][0] * RENDER_PICKRAYOFFSET) + 0.5f, (float)(y + offset[k][1] * RENDER_PICKRAYOFFSET) + 0.5f, &from, &dir);
+      for (i = 0; i < num; i++) {
+         if (objs[i].isEnable() == false)
+            continue;
+         dist = RENDER_VIEWPOINTFRUSTUMFAR;
+         if (objs[i].getPMDModel()->pickRay(&from, &dir, &dist, &material, &bone) == false)
+            continue;
+         if (minID == -1 || minDist > dist) {
+            minDist = dist;
+            minID = i;
+            if (materialPicked)
+               *materialPicked = material;
+            if (bonePicked)
+               *bonePicked = bone;
+         }
+         if (allowDropPicked && objs[i].allowMotionFileDrop()) {
+            if (minIDAllowDrop == -1 || minDistAllowDrop > dist) {
+               minDistAllowDrop = dist;
+               minIDAllowDrop = i;
+            }
          }
       }
-      data += *data + 3;
+      if (minID != -1)
+         break;
    }
    if (allowDropPicked)
       *allowDropPicked = minIDAllowDrop;
 
    return minID;
-#endif /* MMDAGENT_DONTPICKMODEL */
 }
 
 /* Render::updateLight: update light */
@@ -1662,19 +1916,26 @@ void Render::updateLight(bool useMMDLikeCartoon, bool useCartoonRendering, float
 /* Render::updateDepthTextureViewParam: update center and radius information to get required range for shadow mapping */
 void Render::updateDepthTextureViewParam(PMDObject *objList, int num)
 {
-   int i;
+   int i, n;
    float d, dmax;
    float *r = (float *) malloc(sizeof(float) * num);
    btVector3 *c = new btVector3[num];
    btVector3 cc = btVector3(btScalar(0.0f), btScalar(0.0f), btScalar(0.0f));
 
+   n = 0;
    for (i = 0; i < num; i++) {
       if (objList[i].isEnable() == false)
          continue;
       r[i] = objList[i].getPMDModel()->calculateBoundingSphereRange(&(c[i]));
       cc += c[i];
+      n++;
+   }
+   if (n == 0) {
+      free(r);
+      delete [] c;
+      return;
    }
-   cc /= (float) num;
+   cc /= (float) n;
 
    dmax = 0.0f;
    for (i = 0; i < num; i++) {
@@ -1713,7 +1974,7 @@ void Render::getCurrentViewTransform(btTransform *tr)
 /* Render::getInfoString: store current view parameters to buffer */
 void Render::getInfoString(char *buf, int buflen)
 {
-   MMDAgent_snprintf(buf, buflen, "%.2f, %.2f, %.2f | %.2f, %.2f, %.2f | %.2f | %.2f", m_currentTrans.x(), m_currentTrans.y(), m_currentTrans.z(), m_angle.x(), m_angle.y(), m_angle.z(), m_currentDistance, m_currentFovy);
+   MMDAgent_snprintf(buf, buflen, "%.2f, %.2f, %.2f | %.2f, %.2f, %.2f | %.2f | %.2f | draw %u, state %u | culled %u, shadow %u, material %u | shadowmap reused %u | low detail %u", m_currentTrans.x(), m_currentTrans.y(), m_currentTrans.z(), m_angle.x(), m_angle.y(), m_angle.z(), m_currentDistance, m_currentFovy, m_numDrawCall, m_numStateChange, m_numCulledModel, m_numShadowCulledModel, m_numCulledMaterial, m_numShadowMapReused, m_numLowDetailModel);
 }
 
 /* Render::clearScreen: clear screen */
@@ -0,0 +1,314 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDAgent.h"
+
+/* definitions */
+
+#define VARIABLESTORE_INITIALSIZE 64
+
+/* VariableStore_setValue: set values to entry */
+static void VariableStore_setValue(VariableStoreEntry *e, const char *value, float number)
+{
+   if (e->value != NULL)
+      free(e->value);
+   e->value = MMDAgent_strdup(value != NULL ? value : "");
+   e->number = number;
+}
+
+/* VariableStore::initialize: initialize store */
+void VariableStore::initialize()
+{
+   m_table = NULL;
+   m_size = 0;
+   m_numUsed = 0;
+   m_num = 0;
+}
+
+/* VariableStore::clear: free store */
+void VariableStore::clear()
+{
+   unsigned int i;
+
+   if (m_table != NULL) {
+      for (i = 0; i < m_size; i++) {
+         if (m_table[i].key != NULL)
+            free(m_table[i].key);
+         if (m_table[i].value != NULL)
+            free(m_table[i].value);
+      }
+      free(m_table);
+   }
+   initialize();
+}
+
+/* VariableStore::findEntry: find entry of the key, or empty slot for it */
+VariableStoreEntry *VariableStore::findEntry(const char *key, size_t keyLen, unsigned int hash)
+{
+   unsigned int i, mask;
+   VariableStoreEntry *e, *reuse = NULL;
+
+   if (m_table == NULL)
+      return NULL;
+
+   /* linear probing, removed slots are skipped but remembered for reuse */
+   mask = m_size - 1;
+   for (i = hash & mask; ; i = (i + 1) & mask) {
+      e = &(m_table[i]);
+      if (e->key == NULL)
+         return (reuse != NULL) ? reuse : e;
+      if (e->removed) {
+         if (reuse == NULL)
+            reuse = e;
+      } else if (e->hash == hash && e->keyLen == keyLen && memcmp(e->key, key, keyLen) == 0) {
+         return e;
+      }
+   }
+}
+
+/* VariableStore::getEntry: get entry of the key, create if not exist */
+VariableStoreEntry *VariableStore::getEntry(const char *key, size_t keyLen, unsigned int hash)
+{
+   VariableStoreEntry *e;
+
+   /* keep at least a quarter of slots empty so that probing ends */
+   if (m_table == NULL)
+      resize(VARIABLESTORE_INITIALSIZE);
+   else if ((m_numUsed + 1) * 4 > m_size * 3)
+      resize((m_num + 1) * 2 > m_size ? m_size * 2 : m_size);
+
+   e = findEntry(key, keyLen, hash);
+   if (e->key != NULL && e->removed == false)
+      return e;
+
+   /* new entry */
+   if (e->key == NULL) {
+      m_numUsed++;
+   } else {
+      free(e->key);
+      e->key = NULL;
+   }
+   e->key = (char *)malloc(keyLen + 1);
+   memcpy(e->key, key, keyLen);
+   e->key[keyLen] = '\0';
+   e->keyLen = keyLen;
+   e->hash = hash;
+   e->value = NULL;
+   e->number = 0.0f;
+   e->removed = false;
+   m_num++;
+
+   return e;
+}
+
+/* VariableStore::resize: rebuild hash table with the size */
+void VariableStore::resize(unsigned int size)
+{
+   VariableStoreEntry *old, *e;
+   unsigned int i, oldSize;
+
+   old = m_table;
+   oldSize = m_size;
+
+   m_table = (VariableStoreEntry *)malloc(sizeof(VariableStoreEntry) * size);
+   memset(m_table, 0, sizeof(VariableStoreEntry) * size);
+   m_size = size;
+   m_numUsed = 0;
+   m_num = 0;
+
+   if (old == NULL)
+      return;
+
+   /* move entries, removed ones are dropped */
+   for (i = 0; i < oldSize; i++) {
+      if (old[i].key == NULL)
+         continue;
+      if (old[i].removed) {
+         free(old[i].key);
+         continue;
+      }
+      e = findEntry(old[i].key, old[i].keyLen, old[i].hash);
+      *e = old[i];
+      m_numUsed++;
+      m_num++;
+   }
+   free(old);
+}
+
+/* VariableStore::VariableStore: constructor */
+VariableStore::VariableStore()
+{
+   initialize();
+}
+
+/* VariableStore::~VariableStore: destructor */
+VariableStore::~VariableStore()
+{
+   clear();
+}
+
+/* VariableStore::getHash: get hash value of key */
+unsigned int VariableStore::getHash(const char *key, size_t keyLen)
+{
+   unsigned int hash = 2166136261U;
+   size_t i;
+
+   /* FNV-1a */
+   for (i = 0; i < keyLen; i++) {
+      hash ^= (unsigned char)key[i];
+      hash *= 16777619U;
+   }
+
+   return hash;
+}
+
+/* VariableStore::release: remove all variables */
+void VariableStore::release()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   clear();
+}
+
+/* VariableStore::set: set string value and numeric value of the string */
+void VariableStore::set(const char *key, const char *value)
+{
+   setWithNumber(key, value, MMDAgent_str2float(value));
+}
+
+/* VariableStore::setWithNumber: set string value and numeric value */
+void VariableStore::setWithNumber(const char *key, const char *value, float number)
+{
+   size_t len = MMDAgent_strlen(key);
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (len == 0)
+      return;
+   VariableStore_setValue(getEntry(key, len, getHash(key, len)), value, number);
+}
+
+/* VariableStore::remove: remove variable, return false if not exist */
+bool VariableStore::remove(const char *key)
+{
+   size_t len = MMDAgent_strlen(key);
+   VariableStoreEntry *e;
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (len == 0)
+      return false;
+   e = findEntry(key, len, getHash(key, len));
+   if (e == NULL || e->key == NULL || e->removed)
+      return false;
+
+   /* the key is kept to hold the probing sequence */
+   if (e->value != NULL)
+      free(e->value);
+   e->value = NULL;
+   e->removed = true;
+   m_num--;
+
+   return true;
+}
+
+/* VariableStore::exist: check if variable exists */
+bool VariableStore::exist(const char *key)
+{
+   size_t len = MMDAgent_strlen(key);
+   VariableStoreEntry *e;
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (len == 0)
+      return false;
+   e = findEntry(key, len, getHash(key, len));
+   return e != NULL && e->key != NULL && e->removed == false;
+}
+
+/* VariableStore::copyValue: copy string value to buffer and return its length, or -1 if not exist */
+int VariableStore::copyValue(const char *key, char *buf, size_t bufLen)
+{
+   size_t len = MMDAgent_strlen(key);
+
+   return copyValueWithHash(key, len, getHash(key, len), buf, bufLen);
+}
+
+/* VariableStore::copyValueWithHash: copy string value of key with known length and hash to buffer, or return -1 if not exist */
+int VariableStore::copyValueWithHash(const char *key, size_t keyLen, unsigned int hash, char *buf, size_t bufLen)
+{
+   VariableStoreEntry *e;
+   size_t len;
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (keyLen == 0 || bufLen == 0)
+      return -1;
+   e = findEntry(key, keyLen, hash);
+   if (e == NULL || e->key == NULL || e->removed)
+      return -1;
+
+   len = MMDAgent_strlen(e->value);
+   if (len > bufLen - 1)
+      len = bufLen - 1;
+   memcpy(buf, e->value, len);
+   buf[len] = '\0';
+
+   return (int)len;
+}
+
+/* VariableStore::getNumber: get numeric value, return false if not exist */
+bool VariableStore::getNumber(const char *key, float *number)
+{
+   size_t len = MMDAgent_strlen(key);
+   VariableStoreEntry *e;
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (len == 0)
+      return false;
+   e = findEntry(key, len, getHash(key, len));
+   if (e == NULL || e->key == NULL || e->removed)
+      return false;
+   if (number != NULL)
+      *number = e->number;
+
+   return true;
+}
+
+/* VariableStore::addNumber: add to numeric value and set the result as string value at once, variable is created with 0 if not exist */
+float VariableStore::addNumber(const char *key, float diff)
+{
+   size_t len = MMDAgent_strlen(key);
+   VariableStoreEntry *e;
+   char buf[MMDAGENT_MAXBUFLEN];
+   float number;
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   if (len == 0)
+      return 0.0f;
+   e = getEntry(key, len, getHash(key, len));
+   number = e->number + diff;
+   MMDAgent_snprintf(buf, MMDAGENT_MAXBUFLEN, "%g", number);
+   VariableStore_setValue(e, buf, number);
+
+   return number;
+}
+
+/* VariableStore::getNum: get number of variables */
+unsigned int VariableStore::getNum()
+{
+   std::lock_guard<std::mutex> lock(m_mutex);
+
+   return m_num;
+}
@@ -71,12 +71,51 @@
 #define MMDFILESUTILS_SYSTEMDIRSEPARATOR '/'
 #endif /* _WIN32 */
 
+#define MMDFILES_FRUSTUM_OUTSIDE   0
+#define MMDFILES_FRUSTUM_INTERSECT 1
+#define MMDFILES_FRUSTUM_INSIDE    2
+
+/* MMDFilesFrustum: frustum as 6 planes, a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all planes */
+typedef struct {
+   float plane[6][4];
+} MMDFilesFrustum;
+
 /* MMDFiles_setVBOMethodDefault: set default VBO method */
 void MMDFiles_setVBOMethodDefault(short flag);
 
 /* MMDFiles_getVBOMethodDefault: get default VBO method */
 short MMDFiles_getVBOMethodDefault();
 
+/* MMDFiles_setGPUSkinningDefault: set default flag of skinning on GPU */
+void MMDFiles_setGPUSkinningDefault(bool flag);
+
+/* MMDFiles_getGPUSkinningDefault: get default flag of skinning on GPU */
+bool MMDFiles_getGPUSkinningDefault();
+
+/* MMDFiles_setIKSolverDefault: set default IK solver */
+void MMDFiles_setIKSolverDefault(unsigned char solver);
+
+/* MMDFiles_getIKSolverDefault: get default IK solver */
+unsigned char MMDFiles_getIKSolverDefault();
+
+/* MMDFiles_resetRenderStatistics: reset number of draw calls and state changes */
+void MMDFiles_resetRenderStatistics();
+
+/* MMDFiles_addRenderStatistics: add number of draw calls and state changes */
+void MMDFiles_addRenderStatistics(unsigned int numDrawCall, unsigned int numStateChange);
+
+/* MMDFiles_getRenderStatistics: get number of draw calls and state changes since the last reset */
+void MMDFiles_getRenderStatistics(unsigned int *numDrawCall, unsigned int *numStateChange);
+
+/* MMDFiles_getNewSerial: get new serial number, unique in the process */
+unsigned int MMDFiles_getNewSerial();
+
+/* MMDFiles_setFrustum: set frustum planes from column-major projection * model view matrix */
+void MMDFiles_setFrustum(MMDFilesFrustum *frustum, const double *m);
+
+/* MMDFiles_testSphereInFrustum: test sphere against frustum, return MMDFILES_FRUSTUM_OUTSIDE, INTERSECT or INSIDE */
+int MMDFiles_testSphereInFrustum(const MMDFilesFrustum *frustum, const btVector3 *center, float radius);
+
 /* MMDFiles_getcharsize: get character size */
 unsigned char MMDFiles_getcharsize(const char *str);
 
@@ -148,6 +187,9 @@ MMDFILES_STAT MMDFiles_stat(const char *file);
 /* MMDFiles_exist: check if the file exists */
 bool MMDFiles_exist(const char *file);
 
+/* MMDFiles_getmtime: get last modification time of the file in sec, or -1 if not available */
+long long MMDFiles_getmtime(const char *file);
+
 /* MMDFiles_existdir: check if the directory exists */
 bool MMDFiles_existdir(const char *dir);
 
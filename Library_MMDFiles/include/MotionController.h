@@ -87,6 +87,8 @@ typedef struct _MotionControllerBoneElement {
    bool looped;           /* true if the stored end-of-motion position/rotation should be applied as keyframs at first frame */
    unsigned char opFlag;  /* operation flag, one of MOTIONCONTROLLDER_OPERATION_* */
    float opRate;          /* operation rate for MOTIONCONTROLLER_OPERATION */
+   bool cached;           /* true if pos/rot hold the result at cachedFrame */
+   float cachedFrame;     /* frame of the cached pos/rot, clamped to the last key frame */
 } MotionControllerBoneElement;
 
 /* MotionControllerFaceElement: Motion control element for face */
@@ -104,6 +106,8 @@ typedef struct _MotionControllerFaceElement {
    bool looped;           /* true if the stored end-of-motion weight should be applied as keyframs at first frame */
    unsigned char opFlag;  /* operation flag, one of MOTIONCONTROLLDER_OPERATION_* */
    float opRate;          /* operation rate for MOTIONCONTROLLER_OPERATION */
+   bool cached;           /* true if weight holds the result at cachedFrame */
+   float cachedFrame;     /* frame of the cached weight, clamped to the last key frame */
 } MotionControllerFaceElement;
 
 /* MotionControllerSwitchElement: Motion control element for switches */
@@ -144,9 +148,15 @@ private:
    /* internal work area for initial pose snapshot */
    bool m_overrideFirst; /* when true, the initial bone pos/rot and face weights in the motion at the first frame will be replaced by the runtime pose snapshot */
 
+   /* internal work area for static motion */
+   bool m_evaluated; /* true when any key frame was evaluated at the last call to control() */
+
    /* calcBoneAt: calculate bone pos/rot at the given frame */
    void calcBoneAt(MotionControllerBoneElement *mc, float absFrame);
 
+   /* smearBone: blend bone pos/rot with the snapshot at the beginning of motion */
+   void smearBone(MotionControllerBoneElement *mc);
+
    /* calcFaceAt: calculate face weight at the given frame */
    void calcFaceAt(MotionControllerFaceElement *mc, float absFrame);
 
@@ -159,12 +169,18 @@ private:
    /* control: set bone position/rotation and face weights according to the motion to the specified frame */
    void control(float frameNow);
 
+   /* proceed: proceed the current frame, return true when reached end */
+   bool proceed(double deltaFrame);
+
    /* takeSnap: take a snap shot of bones/faces for motion smoothing at beginning of a motion */
    void takeSnap(btVector3 *centerPos);
 
    /* setLoopedFlags: set flag if the stored end-of-motion position/rotation/weight should be applied at first frame */
    void setLoopedFlags(bool flag);
 
+   /* clearCache: discard cached results of all bones and faces */
+   void clearCache();
+
    /* initialize: initialize controller */
    void initialize();
 
@@ -188,6 +204,12 @@ public:
    /* advance: advance motion controller by the given frame, return true when reached end */
    bool advance(double deltaFrame);
 
+   /* advanceWithoutControl: advance motion controller by the given frame without applying motion, return true when reached end */
+   bool advanceWithoutControl(double deltaFrame);
+
+   /* hasSameState: return true when this controller will give the same pose as the given controller at next advance() */
+   bool hasSameState(MotionController *mc);
+
    /* rewind: rewind motion controller to the given frame */
    void rewind(float targetFrame, float frame);
 
@@ -229,4 +251,7 @@ public:
 
    /* getBoneCtrlList: get list of bone controller */
    MotionControllerBoneElement *getBoneCtrlList();
+
+   /* isEvaluated: return true when any key frame was evaluated at the last call to advance() */
+   bool isEvaluated();
 };
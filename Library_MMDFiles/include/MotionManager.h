@@ -120,6 +120,10 @@ private:
    MotionPlayer *m_playerList;          /* list of motion players running */
    float m_beginningNonControlledBlend; /* at motion start, bones/faces not controlled in base motion will be reset within this frame */
 
+   unsigned int m_numEvaluated;  /* number of controller updates which evaluated key frames */
+   unsigned int m_numSkipped;    /* number of controller updates which reused cached results */
+   unsigned int m_numShared;     /* number of updates which took the pose of another model */
+
    /* terminateEndingMotion: terminate ending active motion */
    void terminateEndingMotion(const char *name);
 
@@ -132,6 +136,12 @@ private:
    /* startMotionSub: initialize a motion */
    void startMotionSub(VMD *vmd, MotionPlayer *m);
 
+   /* advancePlayer: advance a motion player, applying motion when apply is true */
+   bool advancePlayer(MotionPlayer *m, double frame, bool apply);
+
+   /* updateSub: update all motion players, applying motions when apply is true */
+   bool updateSub(double frame, bool apply);
+
    /* initialize: initialize motion manager */
    void initialize();
 
@@ -164,6 +174,12 @@ public:
    /* update: apply all motion players */
    bool update(double frame);
 
+   /* advance: proceed all motion players without applying them, for a model which takes the pose of another model */
+   bool advance(double frame);
+
+   /* hasSameState: return true when this manager will give the same pose as the given manager at next update */
+   bool hasSameState(MotionManager *mm);
+
    /* updateMotionSpeedRate: update motion speed rate */
    bool updateMotionSpeedRate(double frame);
 
@@ -175,4 +191,10 @@ public:
 
    /* updateModel: update model */
    void updateModel(PMDModel *pmd);
+
+   /* getStatistics: get number of controller updates which evaluated key frames and which reused cached results, and number of updates which took the pose of another model */
+   void getStatistics(unsigned int *numEvaluated, unsigned int *numSkipped, unsigned int *numShared);
+
+   /* resetStatistics: reset number of controller updates */
+   void resetStatistics();
 };
@@ -79,12 +79,91 @@
 #define PMDMODEL_VBO_BUFFERDATA     2
 #define PMDMODEL_VBO_AUTO           3
 
+#define PMDMODEL_GPUSKINNING_LIGHTING 0
+#define PMDMODEL_GPUSKINNING_EDGE     1
+#define PMDMODEL_GPUSKINNING_PLAIN    2
+
+#define PMDMODEL_PICKMARGIN    1.0f     /* margin of refitted boxes for picking to cover morphs and SDEF */
+#define PMDMODEL_PICKEPSILON   1.0e-8f
+#define PMDMODEL_PICKSTACKSIZE 64
+
+#define PMDMODEL_DETAIL_FULL   0 /* full mesh with edge and SDEF */
+#define PMDMODEL_DETAIL_NOEDGE 1 /* full mesh without edge, SDEF is approximated as BDEF2 */
+#define PMDMODEL_DETAIL_LOW    2 /* simplified mesh without edge, SDEF is approximated as BDEF2 */
+
+#define PMDMODEL_LODGRIDDIV  64.0f /* number of grid cells along the longest side of model for simplification */
+#define PMDMODEL_LODMAXRATE  0.7f  /* simplified mesh is discarded when it has more surfaces than this rate */
+
+#define PMDMODEL_BONEBLOCK_LEVEL      0 /* bones updated level by level of hierarchy */
+#define PMDMODEL_BONEBLOCK_SEQUENTIAL 1 /* bones updated one by one with their IK */
+#define PMDMODEL_BONEBLOCK_UPDATE     2 /* bones updated one by one without IK */
+
+#define PMDMODEL_BONEPARALLELMIN 64 /* bones are updated in parallel when a level has at least this number of bones */
+
+#define PMDMODEL_LODSURFACE_ALL       0
+#define PMDMODEL_LODSURFACE_EDGE      1
+#define PMDMODEL_LODSURFACE_SHADOW    2
+#define PMDMODEL_LODSURFACE_SHADOWMAP 3
+
 typedef struct {
    float dist;
    float alpha;
    unsigned int id;
 } MaterialDistanceData;
 
+/* static vertex attributes for skinning on GPU */
+typedef struct {
+   float normal[4];     /* normal, and deform type at 4th (0: BDEF2, 1: BDEF4, 2: SDEF) */
+   float boneIndex[4];  /* bone indices */
+   float boneWeight[4]; /* bone weights */
+   float sdefC[3];      /* SDEF center */
+   float sdefCR0[3];    /* SDEF R0 */
+   float sdefCR1[3];    /* SDEF R1 */
+} PMDModelSkinningVertex;
+
+/* draw command of materials sharing the same rendering state */
+typedef struct {
+   unsigned int material;     /* material whose state is used */
+   unsigned int surfaceIndex; /* head index in surface list */
+   unsigned int numSurface;   /* number of surface indices */
+   unsigned int orderIndex;   /* head index in m_materialRenderOrder */
+   unsigned int numMaterial;  /* number of merged materials */
+} PMDRenderCommand;
+
+/* triangle cluster for picking, grouped by dominant bone */
+typedef struct {
+   unsigned short bone;      /* dominant bone */
+   unsigned int surfaceHead; /* head index in triangle list for picking */
+   unsigned int numSurface;  /* number of triangles */
+   unsigned int boxHead;     /* head index in bone box list for picking */
+   unsigned int numBox;      /* number of bone boxes */
+} PMDPickCluster;
+
+/* bind-pose bounding box of cluster vertices influenced by a bone */
+typedef struct {
+   unsigned short bone; /* influencing bone */
+   float min[3];
+   float max[3];
+} PMDPickBoneBox;
+
+/* node of bounding volume hierarchy for picking */
+typedef struct {
+   float min[3];
+   float max[3];
+   int child;            /* index of the first child, the second child follows, or -1 for leaf */
+   unsigned int cluster; /* cluster index for leaf */
+} PMDPickNode;
+
+/* block of bones in update order, transforms of bones in a level block are computed by levels in hierarchy */
+typedef struct {
+   unsigned char kind;     /* PMDMODEL_BONEBLOCK_* */
+   bool afterPhysics;      /* true when updated after physics simulation */
+   unsigned int head;      /* head index in bone hierarchy arrays */
+   unsigned int num;       /* number of bones */
+   unsigned int levelHead; /* head index in level list for level block */
+   unsigned int numLevel;  /* number of levels for level block */
+} PMDBoneBlock;
+
 /* PMDModel: model of PMD */
 class PMDModel
 {
@@ -162,10 +241,15 @@ private:
 
    /* work area for OpenGL rendering */
    btTransform *m_boneSkinningTrans;           /* transform matrices of bones for skinning */
+   btTransform *m_lastBoneSkinningTrans;       /* transform matrices of bones at the last skin update */
+   float *m_lastMorphWeight;                   /* weights of faces, vertex morphs and group morphs at the last face update */
+   bool m_morphChanged;                        /* true when any morph weight has been changed since the last skin update */
+   unsigned int m_skinSerial;                  /* serial number, renewed when deformed shape has been changed */
    unsigned int m_numSurfaceForEdge;           /* number of edge-drawing surface list */
    unsigned short m_vboMethod;                 /* VBO method to be used for mapping */
-   char *m_vboBufData;                         /* VBO buffer for glBufferSubData, used when PMDMODEL_VBO_BUFFERDATA */
+   char *m_vboBufData;                         /* staging buffer of skinning result with the same layout as the dynamic VBO buffer */
    unsigned long m_vboBufDataLen;              /* length of m_vboBufData */
+   bool m_skinUpdated;                         /* true when m_vboBufData was updated and not uploaded yet */
    GLuint m_vboBufDynamic;                     /* VBO buffers for dynamic data */
    GLuint m_vboBufStatic;                      /* VBO buffers for static  data */
    GLuint m_vboBufElement;                     /* VBO buffers for element data */
@@ -181,6 +265,44 @@ private:
    unsigned long m_vboOffsetSurfaceForShadow;
    GLuint m_vboBufElementShadowMap;
 
+   /* work area for skinning on GPU */
+   bool m_gpuSkinning;                         /* true when skinning is performed on GPU */
+   GLuint m_vboBufSkinning;                    /* VBO buffer for static skinning attributes */
+   GLuint m_boneTextureID;                     /* texture holding bone matrices */
+   float *m_boneTextureData;                   /* bone matrices to be uploaded to m_boneTextureID */
+   bool m_boneTextureUpdated;                  /* true when m_boneTextureData was updated and not uploaded yet */
+
+   /* work area for picking */
+   unsigned int m_numPickCluster;              /* number of triangle clusters */
+   PMDPickCluster *m_pickCluster;              /* triangle clusters */
+   unsigned int *m_pickSurfaceList;            /* triangle indices sorted by cluster */
+   unsigned int m_numPickBoneBox;              /* number of bone boxes */
+   PMDPickBoneBox *m_pickBoneBox;              /* bind-pose boxes of clusters */
+   unsigned int m_numPickNode;                 /* number of hierarchy nodes */
+   PMDPickNode *m_pickNode;                    /* hierarchy nodes, root at 0 */
+   bool m_pickRefitRequired;                   /* true when bones have moved after the last refit */
+
+   /* work area for level of detail */
+   INDICES *m_lodSurfaceList;                  /* simplified surface list in material order */
+   unsigned int *m_lodSurfaceHead;             /* head index in m_lodSurfaceList per material, numMaterial + 1 entries */
+   unsigned int m_numLODSurface;               /* length of m_lodSurfaceList */
+   unsigned int *m_lodVertexList;              /* vertices referred from simplified surface list */
+   unsigned int m_numLODVertex;                /* number of vertices in m_lodVertexList */
+   GLuint m_vboBufElementLOD;                  /* VBO buffer for simplified surface list */
+   int m_detailLevel;                          /* detail level used at the last skin update */
+   int m_requestedDetailLevel;                 /* detail level to be applied at the next skin update */
+
+   /* work area for bone update, structure of arrays in update order */
+   unsigned int m_numBoneHierarchy;            /* number of entries in bone hierarchy arrays */
+   unsigned short *m_boneHierarchyID;          /* bone index */
+   int *m_boneHierarchyParent;                 /* index of parent bone in the same block, or -1 when parent transform is read from bone */
+   btTransform *m_boneLocalTrans;              /* transform from parent bone */
+   btTransform *m_boneGlobalTrans;             /* transform from model origin */
+   unsigned int m_numBoneBlock;                /* number of blocks */
+   PMDBoneBlock *m_boneBlock;                  /* blocks in update order */
+   unsigned int m_numBoneLevel;                /* length of m_boneLevelHead */
+   unsigned int *m_boneLevelHead;              /* head index of each level in bone hierarchy arrays, numLevel + 1 entries per block */
+
    /* flags and short lists extracted from the model data */
    PMDBone *m_centerBone;                      /* center bone */
    PMDFace *m_baseFace;                        /* base face definition */
@@ -218,7 +340,17 @@ private:
    PTree m_name2materialmorph;     /* name-to-materialmorph index */
    PTree m_name2groupmorph;        /* name-to-groupmorph index */
    unsigned int *m_materialRenderOrder;
-   MaterialDistanceData *m_materialDistance;
+   MaterialDistanceData *m_materialDistance;       /* alpha and view depth per material */
+   unsigned int m_numTransparentMaterial;          /* number of transparent materials at the end of m_materialRenderOrder */
+   btTransform m_materialOrderView;                /* view transform at the last material ordering */
+   bool m_materialOrderReady;                      /* true when m_materialRenderOrder has been classified */
+   bool m_materialCenterUpdated;                   /* true when skin has been updated after the last material ordering */
+   PMDRenderCommand *m_renderCommand;              /* draw commands in rendering order */
+   unsigned int m_numRenderCommand;                /* number of draw commands */
+   bool m_renderCommandRequired;                   /* true when draw commands should be rebuilt */
+   unsigned int *m_materialBoneHead;               /* head index in m_materialBoneList per material, numMaterial + 1 entries */
+   unsigned short *m_materialBoneList;             /* bones assigned to vertices of each material */
+   bool *m_materialCulled;                         /* true when material is outside of view frustum */
 #ifdef MY_RESETPHYSICS
    bool m_physicsRestore;          /* flag for restoring physics status */
 #endif
@@ -246,6 +378,72 @@ private:
    /* clear: free PMDModel */
    void clear();
 
+   /* buildRenderCommand: build render command list from material order, merging neighboring materials of the same state */
+   void buildRenderCommand();
+
+   /* setupGPUSkinning: set up buffers for skinning on GPU, return false if not available */
+   bool setupGPUSkinning();
+
+   /* clearGPUSkinning: free buffers for skinning on GPU */
+   void clearGPUSkinning();
+
+   /* updateSkinGPU: prepare bone matrices and morphed positions for skinning on GPU, no OpenGL call */
+   void updateSkinGPU();
+
+   /* uploadBoneTexture: upload bone matrices to texture if updated */
+   void uploadBoneTexture();
+
+   /* beginGPUSkinning: bind skinning shader and vertex attributes */
+   void beginGPUSkinning(int mode);
+
+   /* setGPUSkinningMode: change shader mode while skinning shader is bound */
+   void setGPUSkinningMode(int mode);
+
+   /* setGPUSkinningSphereMap: set sphere map coordinate generation for texture unit 0 and 2 */
+   void setGPUSkinningSphereMap(bool unit0, bool unit2);
+
+   /* endGPUSkinning: unbind skinning shader and vertex attributes */
+   void endGPUSkinning();
+
+   /* getPickBones: get bones which affect the vertex, return number of bones */
+   int getPickBones(unsigned int j, unsigned short *bones, float *weights);
+
+   /* getPickDominantBone: get the bone of the largest weight for the vertex, or -1 if none */
+   int getPickDominantBone(unsigned int j);
+
+   /* getPickVertex: get current skinned position of a vertex */
+   void getPickVertex(unsigned int j, btVector3 *v);
+
+   /* setupPick: build bounding volume hierarchy over bone clusters for picking */
+   void setupPick();
+
+   /* clearPick: free bounding volume hierarchy for picking */
+   void clearPick();
+
+   /* refitPick: refit bounding volume hierarchy for picking from current bone transforms */
+   void refitPick(bool useBoneTransform);
+
+   /* setupLevelOfDetail: make simplified surface list and list of vertices used by it */
+   void setupLevelOfDetail();
+
+   /* clearLevelOfDetail: free simplified surface list */
+   void clearLevelOfDetail();
+
+   /* renderLODSurface: draw simplified surfaces of materials for the type, element buffer should be bound */
+   void renderLODSurface(int type);
+
+   /* addBoneBlock: add block of bones in update order */
+   void addBoneBlock(unsigned char kind, bool afterPhysics, PMDBone **list, unsigned int num, int *work);
+
+   /* setupBoneHierarchy: make blocks and arrays for bone update */
+   void setupBoneHierarchy();
+
+   /* clearBoneHierarchy: free blocks and arrays for bone update */
+   void clearBoneHierarchy();
+
+   /* updateBoneBlock: update bones in block */
+   void updateBoneBlock(PMDBoneBlock *block);
+
 public:
 
    /* PMDModel: constructor */
@@ -348,6 +546,9 @@ public:
    /* getNumIK: get number of IK chains */
    unsigned short getNumIK();
 
+   /* setIKSolver: set solver of IK chain for the destination bone, or all chains when name is NULL */
+   bool setIKSolver(const char *destBoneName, unsigned char solver);
+
    /* getNumFace: get number of faces */
    unsigned short getNumFace();
 
@@ -393,12 +594,30 @@ public:
    /* updateBoneFromSimulation: update bone transform from rigid body */
    void updateBoneFromSimulation();
 
+   /* canCopyPose: return true when this model has the same bones and morphs with the same current values as the given model */
+   bool canCopyPose(PMDModel *pmd);
+
+   /* copyPose: copy bone transforms and morph weights from the given model, keeping the root bone of this model */
+   void copyPose(PMDModel *pmd);
+
    /* updateFace: update face morph from current face weights */
    void updateFace();
 
+   /* updateSkinCPU: compute skin data from bone orientation, toon and edges into the staging buffer, no OpenGL call */
+   void updateSkinCPU();
+
+   /* uploadSkin: upload the staging buffer to the dynamic VBO buffer if updated, must be called from the OpenGL thread */
+   void uploadSkin();
+
+   /* getSkinSerial: get serial number which is renewed when deformed shape has been changed */
+   unsigned int getSkinSerial();
+
    /* updateSkin: update skin data from bone orientation, toon and edges */
    void updateSkin();
 
+   /* isGPUSkinning: return true when skinning is performed on GPU */
+   bool isGPUSkinning();
+
    /* setToonLight: set light direction for toon coordinates */
    void setToonLight(btVector3 *light);
 
@@ -408,6 +627,9 @@ public:
    /* calculateBoundingSphereRange: calculate the bounding sphere for depth texture rendering on shadow mapping */
    float calculateBoundingSphereRange(btVector3 *cpos);
 
+   /* updateMaterialCulling: mark materials outside of frustum as culled, NULL frustum clears all, return number of culled materials */
+   unsigned int updateMaterialCulling(const MMDFilesFrustum *frustum);
+
    /* smearAllBonesToDefault: smear all bone pos/rot into default value (rate 1.0 = keep, rate 0.0 = reset) */
    void smearAllBonesToDefault(float rate);
 
@@ -426,9 +648,18 @@ public:
    /* renderForPick: render for pick */
    void renderForPick();
 
+   /* pickRay: cast a ray and get the nearest hit on this model, dist gives maximum distance and returns hit distance */
+   bool pickRay(const btVector3 *from, const btVector3 *dir, float *dist, int *materialIndex, int *boneIndex);
+
    /* renderDebug: render for debug view */
    void renderDebug();
 
+   /* setDetailLevel: set detail level, will be applied at next skin update */
+   void setDetailLevel(int level);
+
+   /* getDetailLevel: get detail level currently in use */
+   int getDetailLevel();
+
 #ifdef MY_LUMINOUS
    bool hasLuminousMaterial();
 
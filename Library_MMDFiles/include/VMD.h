@@ -41,6 +41,10 @@
 
 #define VMD_INTERPOLATIONTABLESIZE 256 /* motion interpolation table size */
 
+#define VMD_BAKEROTSCALE 32767.0f /* scale of quantized rotation */
+#define VMD_BAKEPOSSTEP  65535.0f /* number of steps of quantized position */
+#define VMD_BAKECHECKDIV 4        /* number of points checked in a sample interval at baking */
+
 /* BoneKeyFrame: bone key frame */
 typedef struct _BoneKeyFrame {
    float keyFrame;               /* key frame */
@@ -50,11 +54,22 @@ typedef struct _BoneKeyFrame {
    float *interpolationTable[4]; /* table for interpolation */
 } BoneKeyFrame;
 
+/* BoneBakedTrack: bone motion resampled at regular interval */
+typedef struct _BoneBakedTrack {
+   float step;             /* interval of samples in frame */
+   unsigned int numSample; /* number of samples */
+   short *rot;             /* quantized rotations, 4 values for each sample */
+   unsigned short *pos;    /* quantized positions, 3 values for each sample, NULL when position is constant */
+   float posMin[3];        /* position at quantized value 0 */
+   float posScale[3];      /* position per quantized step */
+} BoneBakedTrack;
+
 /* BoneMotion: bone motion unit (list of key frames for a bone defined in a VMD file) */
 typedef struct _BoneMotion {
    char *name;                 /* bone name */
    unsigned int numKeyFrame;   /* number of defined key frames */
    BoneKeyFrame *keyFrameList; /* list of key frame data */
+   BoneBakedTrack *baked;      /* resampled track, NULL when not baked */
 } BoneMotion;
 
 /* BoneMotionLink: linked list of defined bone motions in a VMD data */
@@ -143,6 +158,9 @@ private:
 
    float m_maxFrame; /* max frame */
 
+   unsigned int m_numBakedBone; /* number of bone motions having resampled track */
+   size_t m_bakedSize;          /* total bytes of resampled tracks */
+
    /* addBoneMotion: add new bone motion to list */
    void addBoneMotion(const char *name);
 
@@ -207,4 +225,19 @@ public:
 
    /* getMaxFrame: get max frame */
    float getMaxFrame();
+
+   /* bake: resample bone motions at the given rate per second, bone motions exceeding the tolerances of position or rotation (radian) are left as key frames */
+   void bake(float rate, float posTolerance, float rotTolerance);
+
+   /* clearBake: free resampled tracks */
+   void clearBake();
+
+   /* getNumBakedBone: get number of bone motions having resampled track */
+   unsigned int getNumBakedBone();
+
+   /* getBakedSize: get total bytes of resampled tracks */
+   size_t getBakedSize();
 };
+
+/* VMD_getBakedBoneAt: get bone pos/rot at the given frame from resampled track */
+void VMD_getBakedBoneAt(BoneBakedTrack *track, float frame, btVector3 *pos, btQuaternion *rot);
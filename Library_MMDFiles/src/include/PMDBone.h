@@ -142,6 +142,9 @@ public:
    /* update: update internal transform for current position/rotation */
    void update();
 
+   /* getLocalTransform: get transform from parent bone for current position/rotation */
+   void getLocalTransform(btTransform *tr);
+
    /* calcSkinningTrans: get internal transform for skinning */
    void calcSkinningTrans(btTransform *b);
 
@@ -253,6 +256,9 @@ public:
    /* clearTransBySimulationFlag: clear flag for transform by physics simulation */
    void clearTransBySimulationFlag();
 
+   /* getTransBySimulation: get transform by physics simulation, or NULL if not given */
+   btTransform *getTransBySimulation();
+
    /* setTransBySimulation: set transform by physics simulation */
    void setTransBySimulation(btTransform *tr);
 
@@ -267,4 +273,10 @@ public:
 
    /* saveAsBoneFrame: save as bone frame */
    int saveAsBoneFrame(unsigned char **data, unsigned int keyFrame);
+
+   /* hasSameState: return true when this bone has the same definition and current position, rotation and switch as the given bone */
+   bool hasSameState(PMDBone *b);
+
+   /* copyState: copy current position, rotation and switch from the given bone, and its transform moved by the given root difference */
+   void copyState(PMDBone *b, const btTransform *rootDiff);
 };
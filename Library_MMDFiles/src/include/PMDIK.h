@@ -61,6 +61,11 @@
 #define PMDIK_MINROTSUM   0.002f
 #define PMDIK_MINROTATION 0.00001f
 
+#define PMDIK_SOLVER_CCD      0 /* cyclic coordinate descent, same as MikuMikuDance */
+#define PMDIK_SOLVER_ANALYTIC 1 /* analytic solution for two-bone chains with knee, CCD with early stop for others */
+
+#define PMDIK_MINIMPROVEMENT 0.001f /* CCD stops when an iteration reduces the squared distance less than this rate */
+
 /* PMDIK: IK for PMD */
 class PMDIK
 {
@@ -74,12 +79,24 @@ private:
    unsigned short m_iteration; /* IK value 1: maximum iteration count */
    float m_angleConstraint;    /* IK value 2: maximum angle per one step in radian */
 
+   unsigned char m_solver; /* solver type, PMDIK_SOLVER_* */
+   bool m_twoBone;         /* true when the chain is root, knee and target in a row */
+
    /* initialize: initialize IK */
    void initialize();
 
    /* clear: free IK */
    void clear();
 
+   /* checkTwoBone: check if analytic two-bone solver can be applied to this chain */
+   bool checkTwoBone();
+
+   /* solveCCD: solve by cyclic coordinate descent */
+   void solveCCD(bool earlyStop);
+
+   /* solveTwoBone: solve two-bone chain analytically, return false when not solved */
+   bool solveTwoBone();
+
 public:
 
    /* PMDIK: constructor */
@@ -103,4 +120,10 @@ public:
    /* updateInfo: update information */
    void updateInfo();
 
+   /* setSolver: set solver type */
+   void setSolver(unsigned char solver);
+
+   /* getSolver: get solver type */
+   unsigned char getSolver();
+
 };
@@ -76,6 +76,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <atomic>
 
 #ifdef __ANDROID__
 #include <sys/sysconf.h>
@@ -108,6 +109,109 @@ short MMDFiles_getVBOMethodDefault()
    return g_VBOMethodDefault;
 }
 
+/* default flag of skinning on GPU */
+static bool g_GPUSkinningDefault = false;
+
+/* MMDFiles_setGPUSkinningDefault: set default flag of skinning on GPU */
+void MMDFiles_setGPUSkinningDefault(bool flag)
+{
+   g_GPUSkinningDefault = flag;
+}
+
+/* MMDFiles_getGPUSkinningDefault: get default flag of skinning on GPU */
+bool MMDFiles_getGPUSkinningDefault()
+{
+   return g_GPUSkinningDefault;
+}
+
+/* default IK solver */
+static unsigned char g_IKSolverDefault = PMDIK_SOLVER_CCD;
+
+/* MMDFiles_setIKSolverDefault: set default IK solver */
+void MMDFiles_setIKSolverDefault(unsigned char solver)
+{
+   g_IKSolverDefault = solver;
+}
+
+/* MMDFiles_getIKSolverDefault: get default IK solver */
+unsigned char MMDFiles_getIKSolverDefault()
+{
+   return g_IKSolverDefault;
+}
+
+/* number of draw calls and state changes for statistics */
+static unsigned int g_numDrawCall = 0;
+static unsigned int g_numStateChange = 0;
+
+/* MMDFiles_resetRenderStatistics: reset number of draw calls and state changes */
+void MMDFiles_resetRenderStatistics()
+{
+   g_numDrawCall = 0;
+   g_numStateChange = 0;
+}
+
+/* MMDFiles_addRenderStatistics: add number of draw calls and state changes */
+void MMDFiles_addRenderStatistics(unsigned int numDrawCall, unsigned int numStateChange)
+{
+   g_numDrawCall += numDrawCall;
+   g_numStateChange += numStateChange;
+}
+
+/* MMDFiles_getRenderStatistics: get number of draw calls and state changes since the last reset */
+void MMDFiles_getRenderStatistics(unsigned int *numDrawCall, unsigned int *numStateChange)
+{
+   *numDrawCall = g_numDrawCall;
+   *numStateChange = g_numStateChange;
+}
+
+/* MMDFiles_getNewSerial: get new serial number, unique in the process */
+unsigned int MMDFiles_getNewSerial()
+{
+   static std::atomic<unsigned int> serial(0);
+
+   return ++serial;
+}
+
+/* MMDFiles_setFrustum: set frustum planes from column-major projection * model view matrix */
+void MMDFiles_setFrustum(MMDFilesFrustum *frustum, const double *m)
+{
+   int i, j;
+   double p[4], len;
+
+   /* left, right, bottom, top, near, far: row 3 +/- row 0, 1, 2 */
+   for (i = 0; i < 6; i++) {
+      for (j = 0; j < 4; j++) {
+         if (i % 2 == 0)
+            p[j] = m[j * 4 + 3] + m[j * 4 + i / 2];
+         else
+            p[j] = m[j * 4 + 3] - m[j * 4 + i / 2];
+      }
+      len = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+      if (len == 0.0)
+         len = 1.0;
+      for (j = 0; j < 4; j++)
+         frustum->plane[i][j] = (float)(p[j] / len);
+   }
+}
+
+/* MMDFiles_testSphereInFrustum: test sphere against frustum, return MMDFILES_FRUSTUM_OUTSIDE, INTERSECT or INSIDE */
+int MMDFiles_testSphereInFrustum(const MMDFilesFrustum *frustum, const btVector3 *center, float radius)
+{
+   int i;
+   float d;
+   int ret = MMDFILES_FRUSTUM_INSIDE;
+
+   for (i = 0; i < 6; i++) {
+      d = frustum->plane[i][0] * center->x() + frustum->plane[i][1] * center->y() + frustum->plane[i][2] * center->z() + frustum->plane[i][3];
+      if (d < -radius)
+         return MMDFILES_FRUSTUM_OUTSIDE;
+      if (d < radius)
+         ret = MMDFILES_FRUSTUM_INTERSECT;
+   }
+
+   return ret;
+}
+
 #if defined(__ANDROID__) || TARGET_OS_IPHONE
 /* searchTable: search for character conversion table between utf8 and sjis */
 bool searchTable(const char *key, int len, const char **ptr, bool forward)
@@ -810,6 +914,37 @@ MMDFILES_STAT MMDFiles_stat(const char *file)
    return ret;
 }
 
+/* MMDFiles_getmtime: get last modification time of the file in sec, or -1 if not available */
+long long MMDFiles_getmtime(const char *file)
+{
+   if (file == NULL)
+      return -1;
+
+#if defined(_WIN32)
+   WCHAR *wpath = MMDFiles_pathdup_from_application_to_widechar(file);
+   struct _stat st;
+   if (wpath == NULL)
+      return -1;
+   if (_wstat(wpath, &st) != 0) {
+      free(wpath);
+      return -1;
+   }
+   free(wpath);
+#else
+   char *path = MMDFiles_pathdup_from_application_to_system_locale(file);
+   struct stat st;
+   if (path == NULL)
+      return -1;
+   if (stat(path, &st) == -1) {
+      free(path);
+      return -1;
+   }
+   free(path);
+#endif
+
+   return (long long)st.st_mtime;
+}
+
 /* MMDFiles_exist: check if the file exists */
 bool MMDFiles_exist(const char *file)
 {
@@ -78,6 +78,13 @@ void MotionController::calcBoneAt(MotionControllerBoneElement *mc, float frameNo
    if (frame > bm->keyFrameList[bm->numKeyFrame - 1].keyFrame)
       frame = bm->keyFrameList[bm->numKeyFrame - 1].keyFrame;
 
+   /* use resampled track if exist, except for the first interval replaced by end-of-motion pose */
+   if (bm->baked && (m_overrideFirst == false || mc->looped == false || frame > bm->keyFrameList[1].keyFrame)) {
+      VMD_getBakedBoneAt(bm->baked, frame, &mc->pos, &mc->rot);
+      smearBone(mc);
+      return;
+   }
+
    /* find key frames between which the given frame exists */
    if (frame >= bm->keyFrameList[mc->lastKey].keyFrame) {
       /* start searching from last used key frame */
@@ -172,6 +179,14 @@ void MotionController::calcBoneAt(MotionControllerBoneElement *mc, float frameNo
       mc->rot = rot1;
    }
 
+   smearBone(mc);
+}
+
+/* MotionController::smearBone: blend bone pos/rot with the snapshot at the beginning of motion */
+void MotionController::smearBone(MotionControllerBoneElement *mc)
+{
+   float w;
+
    if (m_overrideFirst && m_noBoneSmearFrame > 0.0f && mc->opFlag == MOTIONCONTROLLER_OPERATION_REPLACE) {
       /* lerp with the initial position/rotation at the time of starting motion */
       w = (float) (m_noBoneSmearFrame / MOTIONCONTROLLER_BONESTARTMARGINFRAME);
@@ -336,6 +351,10 @@ void MotionController::control(float frameNow)
    btVector3 tmpPos;
    btQuaternion tmpRot;
    PMDBone *bone;
+   float frame;
+   bool smear;
+
+   m_evaluated = false;
 
    /* update bone positions / rotations at current frame by the correponding motion data */
    /* if blend rate is 1.0, the values will override the current bone pos/rot */
@@ -358,12 +377,22 @@ void MotionController::control(float frameNow)
          continue;
       }
       /* calculate bone position / rotation */
-      calcBoneAt(mcb, frameNow);
-      if (mcb->opRate != 1.0f) {
-         /* apply operation rate */
-         mcb->pos *= mcb->opRate;
-         const btQuaternion norot(btScalar(0.0f), btScalar(0.0f), btScalar(0.0f), btScalar(1.0f));
-         mcb->rot = norot.slerp(mcb->rot, btScalar(mcb->opRate));
+      /* the result is kept while the frame stays at the same point of the key frames, as for ended or single key frame motion */
+      frame = frameNow;
+      if (frame > mcb->motion->keyFrameList[mcb->motion->numKeyFrame - 1].keyFrame)
+         frame = mcb->motion->keyFrameList[mcb->motion->numKeyFrame - 1].keyFrame;
+      smear = (m_overrideFirst && m_noBoneSmearFrame > 0.0f);
+      if (mcb->cached == false || mcb->cachedFrame != frame || smear) {
+         calcBoneAt(mcb, frameNow);
+         if (mcb->opRate != 1.0f) {
+            /* apply operation rate */
+            mcb->pos *= mcb->opRate;
+            const btQuaternion norot(btScalar(0.0f), btScalar(0.0f), btScalar(0.0f), btScalar(1.0f));
+            mcb->rot = norot.slerp(mcb->rot, btScalar(mcb->opRate));
+         }
+         mcb->cached = !smear;
+         mcb->cachedFrame = frame;
+         m_evaluated = true;
       }
       /* set the calculated position / rotation to the bone */
       switch (mcb->opFlag) {
@@ -431,11 +460,20 @@ void MotionController::control(float frameNow)
       /* if ignore static flag is set and this motion has only one frame (= first), skip it in this controller */
       if (m_ignoreSingleMotion && mcf->motion->numKeyFrame <= 1)
          continue;
-      /* calculate face weight */
-      calcFaceAt(mcf, frameNow);
-      if (mcf->opRate != 1.0f) {
-         /* apply operation rate */
-         mcf->weight *= mcf->opRate;
+      /* calculate face weight, reusing the last result as bones */
+      frame = frameNow;
+      if (frame > mcf->motion->keyFrameList[mcf->motion->numKeyFrame - 1].keyFrame)
+         frame = mcf->motion->keyFrameList[mcf->motion->numKeyFrame - 1].keyFrame;
+      smear = (m_overrideFirst && m_noFaceSmearFrame > 0.0f);
+      if (mcf->cached == false || mcf->cachedFrame != frame || smear) {
+         calcFaceAt(mcf, frameNow);
+         if (mcf->opRate != 1.0f) {
+            /* apply operation rate */
+            mcf->weight *= mcf->opRate;
+         }
+         mcf->cached = !smear;
+         mcf->cachedFrame = frame;
+         m_evaluated = true;
       }
       /* set the calculated weight to the face */
       if (mcf->face) {
@@ -666,6 +704,18 @@ void MotionController::setLoopedFlags(bool flag)
       m_boneCtrlList[i].looped = flag;
    for (i = 0; i < m_numFaceCtrl; i++)
       m_faceCtrlList[i].looped = flag;
+   clearCache();
+}
+
+/* MotionController::clearCache: discard cached results of all bones and faces */
+void MotionController::clearCache()
+{
+   unsigned long i;
+
+   for (i = 0; i < m_numBoneCtrl; i++)
+      m_boneCtrlList[i].cached = false;
+   for (i = 0; i < m_numFaceCtrl; i++)
+      m_faceCtrlList[i].cached = false;
 }
 
 /* MotionController::initialize: initialize controller */
@@ -686,6 +736,7 @@ void MotionController::initialize()
    m_noBoneSmearFrame = 0.0f;
    m_noFaceSmearFrame = 0.0f;
    m_overrideFirst = false;
+   m_evaluated = false;
 }
 
 /* MotionController::clear: free controller */
@@ -750,6 +801,8 @@ void MotionController::setup(PMDModel *pmd, VMD *vmd)
       m_boneCtrlList[i].looped = false;
       m_boneCtrlList[i].opFlag = MOTIONCONTROLLER_OPERATION_REPLACE;
       m_boneCtrlList[i].opRate = 1.0f;
+      m_boneCtrlList[i].cached = false;
+      m_boneCtrlList[i].cachedFrame = 0.0f;
    }
    /* check all bone definitions in vmd to match the pmd, and store if match */
    m_numBoneCtrl = 0;
@@ -786,6 +839,8 @@ void MotionController::setup(PMDModel *pmd, VMD *vmd)
       m_faceCtrlList[i].looped = false;
       m_faceCtrlList[i].opFlag = MOTIONCONTROLLER_OPERATION_REPLACE;
       m_faceCtrlList[i].opRate = 1.0f;
+      m_faceCtrlList[i].cached = false;
+      m_faceCtrlList[i].cachedFrame = 0.0f;
    }
    /* check all face definitions in vmd to match the pmd, and store if match */
    m_numFaceCtrl = 0;
@@ -869,6 +924,23 @@ bool MotionController::advance(double deltaFrame)
    /* apply motion at current frame to bones and faces */
    control((float) m_currentFrame);
 
+   return proceed(deltaFrame);
+}
+
+/* MotionController::advanceWithoutControl: advance motion controller by the given frame without applying motion, return true when reached end */
+bool MotionController::advanceWithoutControl(double deltaFrame)
+{
+   if (m_boneCtrlList == NULL && m_faceCtrlList == NULL)
+      return false;
+
+   m_evaluated = false;
+
+   return proceed(deltaFrame);
+}
+
+/* MotionController::proceed: proceed the current frame, return true when reached end */
+bool MotionController::proceed(double deltaFrame)
+{
    /* advance the current frame count */
    if (m_noBoneSmearFrame > 0.0f) {
       m_noBoneSmearFrame -= deltaFrame;
@@ -893,6 +965,41 @@ bool MotionController::advance(double deltaFrame)
    return false;
 }
 
+/* MotionController::hasSameState: return true when this controller will give the same pose as the given controller at next advance() */
+bool MotionController::hasSameState(MotionController *mc)
+{
+   unsigned long i;
+   MotionControllerBoneElement *b1, *b2;
+   MotionControllerFaceElement *f1, *f2;
+
+   if (m_currentFrame != mc->m_currentFrame)
+      return false;
+   if (m_numBoneCtrl != mc->m_numBoneCtrl || m_numFaceCtrl != mc->m_numFaceCtrl)
+      return false;
+   if (m_ignoreSingleMotion != mc->m_ignoreSingleMotion || m_overrideFirst != mc->m_overrideFirst)
+      return false;
+   /* snapshots for smoothing and switches are taken from and applied to each model */
+   if (m_overrideFirst && (m_noBoneSmearFrame > 0.0 || m_noFaceSmearFrame > 0.0 || mc->m_noBoneSmearFrame > 0.0 || mc->m_noFaceSmearFrame > 0.0))
+      return false;
+   if (m_switchCtrl || mc->m_switchCtrl)
+      return false;
+
+   for (i = 0; i < m_numBoneCtrl; i++) {
+      b1 = &(m_boneCtrlList[i]);
+      b2 = &(mc->m_boneCtrlList[i]);
+      if (b1->motion != b2->motion || b1->bone->getId() != b2->bone->getId() || b1->looped != b2->looped || b1->opFlag != b2->opFlag || b1->opRate != b2->opRate)
+         return false;
+   }
+   for (i = 0; i < m_numFaceCtrl; i++) {
+      f1 = &(m_faceCtrlList[i]);
+      f2 = &(mc->m_faceCtrlList[i]);
+      if (f1->motion != f2->motion || f1->looped != f2->looped || f1->opFlag != f2->opFlag || f1->opRate != f2->opRate)
+         return false;
+   }
+
+   return true;
+}
+
 /* MotionController::rewind: rewind motion controller to the given frame */
 void MotionController::rewind(float targetFrame, float frame)
 {
@@ -914,6 +1021,7 @@ void MotionController::setOpRate(float rate)
       m_boneCtrlList[i].opRate = rate;
    for (i = 0; i < m_numFaceCtrl; i++)
       m_faceCtrlList[i].opRate = rate;
+   clearCache();
 }
 
 /* MotionController::configure: configure motion applying method */
@@ -1096,3 +1204,9 @@ MotionControllerBoneElement *MotionController::getBoneCtrlList()
 {
    return m_boneCtrlList;
 }
+
+/* MotionController::isEvaluated: return true when any key frame was evaluated at the last call to advance() */
+bool MotionController::isEvaluated()
+{
+   return m_evaluated;
+}
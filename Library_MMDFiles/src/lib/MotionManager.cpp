@@ -198,6 +198,9 @@ void MotionManager::initialize()
    m_pmd = NULL;
    m_playerList = NULL;
    m_beginningNonControlledBlend = 0.0f;
+   m_numEvaluated = 0;
+   m_numSkipped = 0;
+   m_numShared = 0;
 }
 
 /* MotionManager::clear: free motion manager */
@@ -367,12 +370,29 @@ bool MotionManager::configureMotion(const char *name, const char *key, const cha
    return false;
 }
 
-/* MotionManager::update: apply all motion players */
-bool MotionManager::update(double frame)
+/* MotionManager::advancePlayer: advance a motion player, applying motion when apply is true */
+bool MotionManager::advancePlayer(MotionPlayer *m, double frame, bool apply)
+{
+   bool ended;
+
+   if (apply == false)
+      return m->mc.advanceWithoutControl(frame);
+
+   ended = m->mc.advance(frame);
+   if (m->mc.isEvaluated())
+      m_numEvaluated++;
+   else
+      m_numSkipped++;
+   return ended;
+}
+
+/* MotionManager::updateSub: update all motion players, applying motions when apply is true */
+bool MotionManager::updateSub(double frame, bool apply)
 {
    MotionPlayer *m;
+   bool ended;
 
-   if (m_beginningNonControlledBlend > 0.0f) {
+   if (apply && m_beginningNonControlledBlend > 0.0f) {
       /* if this is the beginning of a base motion, the uncontrolled bone/face will be reset */
       m_beginningNonControlledBlend -= (float) frame;
       if (m_beginningNonControlledBlend < 0.0f)
@@ -399,7 +419,7 @@ bool MotionManager::update(double frame)
          m->mc.setBoneBlendRate(m->motionBlendRate * m->endingBoneBlend / m->endingBoneBlendFrames);
          m->mc.setFaceBlendRate(m->endingFaceBlend / m->endingFaceBlendFrames);
          /* proceed the motion */
-         m->mc.advance(frame * m->currentSpeedRate);
+         advancePlayer(m, frame * m->currentSpeedRate, apply);
          /* decrement the rest frames */
          m->endingBoneBlend -= (float) frame;
          m->endingFaceBlend -= (float) frame;
@@ -415,7 +435,8 @@ bool MotionManager::update(double frame)
          m->mc.setBoneBlendRate(m->motionBlendRate);
          m->mc.setFaceBlendRate(1.0f); /* does not apply blend rate for face morphs */
          /* proceed the motion */
-         if (m->mc.advance(frame * m->currentSpeedRate)) {
+         ended = advancePlayer(m, frame * m->currentSpeedRate, apply);
+         if (ended) {
             /* this motion player has reached end */
             switch (m->onEnd) {
             case 0:
@@ -466,6 +487,48 @@ bool MotionManager::update(double frame)
    return false;
 }
 
+/* MotionManager::update: apply all motion players */
+bool MotionManager::update(double frame)
+{
+   return updateSub(frame, true);
+}
+
+/* MotionManager::advance: proceed all motion players without applying them, for a model which takes the pose of another model */
+bool MotionManager::advance(double frame)
+{
+   m_numShared++;
+   return updateSub(frame, false);
+}
+
+/* MotionManager::hasSameState: return true when this manager will give the same pose as the given manager at next update */
+bool MotionManager::hasSameState(MotionManager *mm)
+{
+   MotionPlayer *m1, *m2;
+
+   /* beginning blend uses the current pose of each model */
+   if (m_beginningNonControlledBlend > 0.0f || mm->m_beginningNonControlledBlend > 0.0f)
+      return false;
+
+   for (m1 = m_playerList, m2 = mm->m_playerList; m1 && m2; m1 = m1->next, m2 = m2->next) {
+      if (m1->vmd != m2->vmd || m1->active != m2->active)
+         return false;
+      if (m1->active == false)
+         continue;
+      if (m1->motionBlendRate != m2->motionBlendRate)
+         return false;
+      if (m1->accelerationStatusFlag != ACCELERATION_STATUS_CONSTANT || m2->accelerationStatusFlag != ACCELERATION_STATUS_CONSTANT || m1->currentSpeedRate != m2->currentSpeedRate)
+         return false;
+      if (m1->endingBoneBlend != m2->endingBoneBlend || m1->endingFaceBlend != m2->endingFaceBlend)
+         return false;
+      if (m1->endingBoneBlendFrames != m2->endingBoneBlendFrames || m1->endingFaceBlendFrames != m2->endingFaceBlendFrames)
+         return false;
+      if (m1->mc.hasSameState(&(m2->mc)) == false)
+         return false;
+   }
+
+   return m1 == NULL && m2 == NULL;
+}
+
 /* MotionManager::updateMotionSpeedRate: update motion speed rate */
 bool MotionManager::updateMotionSpeedRate(double frame)
 {
@@ -543,3 +606,19 @@ void MotionManager::updateModel(PMDModel *pmd)
    m_pmd = pmd;
 
 }
+
+/* MotionManager::getStatistics: get number of controller updates which evaluated key frames and which reused cached results, and number of updates which took the pose of another model */
+void MotionManager::getStatistics(unsigned int *numEvaluated, unsigned int *numSkipped, unsigned int *numShared)
+{
+   *numEvaluated = m_numEvaluated;
+   *numSkipped = m_numSkipped;
+   *numShared = m_numShared;
+}
+
+/* MotionManager::resetStatistics: reset number of controller updates */
+void MotionManager::resetStatistics()
+{
+   m_numEvaluated = 0;
+   m_numSkipped = 0;
+   m_numShared = 0;
+}
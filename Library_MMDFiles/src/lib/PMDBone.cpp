@@ -263,6 +263,14 @@ void PMDBone::setMotionIndependency()
 
 /* PMDBone::update: update internal transform for current position/rotation */
 void PMDBone::update()
+{
+   getLocalTransform(&m_trans);
+   if (m_parentBone)
+      m_trans = m_parentBone->m_trans * m_trans;
+}
+
+/* PMDBone::getLocalTransform: get transform from parent bone for current position/rotation */
+void PMDBone::getLocalTransform(btTransform *tr)
 {
    btVector3 p;
    btQuaternion r;
@@ -280,23 +288,21 @@ void PMDBone::update()
          p += (m_childBone->m_pos + m_childBone->m_morphPos) * m_followCoef;
    }
 
-   m_trans.setOrigin(p + m_offset);
+   tr->setOrigin(p + m_offset);
 
    if (m_type == UNDER_ROTATE) {
       /* for under-rotate bone, overwrite rotation by the target bone */
-      m_trans.setRotation(m_targetBone->m_rot);
+      tr->setRotation(m_targetBone->m_rot);
    } else if (m_type == FOLLOW_ROTATE) {
       /* for co-rotate bone, further apply the rotation of child bone scaled by the weight */
       if (m_followCoef >= 0.0f)
          r = r * norot.slerp(m_childBone->m_rot, btScalar(m_followCoef));
       else
          r = r * norot.slerp(m_childBone->m_rot.inverse(), btScalar(-m_followCoef));
-      m_trans.setRotation(r);
+      tr->setRotation(r);
    } else {
-      m_trans.setRotation(r);
+      tr->setRotation(r);
    }
-   if (m_parentBone)
-      m_trans = m_parentBone->m_trans * m_trans;
 }
 
 /* PMDBone::calcSkinningTrans: get internal transform for skinning */
@@ -617,6 +623,14 @@ void PMDBone::clearTransBySimulationFlag()
    m_hasTransBySimulation = false;
 }
 
+/* PMDBone::getTransBySimulation: get transform by physics simulation, or NULL if not given */
+btTransform *PMDBone::getTransBySimulation()
+{
+   if (m_hasTransBySimulation == false)
+      return NULL;
+   return &m_transBySimulation;
+}
+
 /* PMDBone::setTransBySimulation: set transform by physics simulation */
 void PMDBone::setTransBySimulation(btTransform *tr)
 {
@@ -628,36 +642,7 @@ void PMDBone::setTransBySimulation(btTransform *tr)
 /* PMDBone::updateAfterSimulation: update after simulation */
 void PMDBone::updateAfterSimulation()
 {
-   btVector3 p;
-   btQuaternion r;
-   const btQuaternion norot(btScalar(0.0f), btScalar(0.0f), btScalar(0.0f), btScalar(1.0f));
-
-   p = m_pos;
-   r = m_rot;
-
-   p += m_morphPos;
-   r = m_morphRot * r;
-
-   if (m_type == FOLLOW_MOVE) {
-      /* for co-move bone, further apply the movementn of child bone scaled by the weight */
-      if (m_followCoef != 0.0f)
-         p += (m_childBone->m_pos + m_childBone->m_morphPos) * m_followCoef;
-   }
-
-   m_trans.setOrigin(p + m_offset);
-   if (m_type == UNDER_ROTATE) {
-      /* for under-rotate bone, overwrite rotation by the target bone */
-      m_trans.setRotation(m_targetBone->m_rot);
-   } else if (m_type == FOLLOW_ROTATE) {
-      /* for co-rotate bone, further apply the rotation of child bone scaled by the rotation weight */
-      if (m_followCoef >= 0.0f)
-         r = r * norot.slerp(m_childBone->m_rot, btScalar(m_followCoef));
-      else
-         r = r * norot.slerp(m_childBone->m_rot.inverse(), btScalar(-m_followCoef));
-      m_trans.setRotation(r);
-   } else {
-      m_trans.setRotation(r);
-   }
+   getLocalTransform(&m_trans);
 
    if (m_hasTransBySimulation) {
       m_trans = m_transBySimulation * m_trans;
@@ -772,3 +757,28 @@ int PMDBone::saveAsBoneFrame(unsigned char **data, unsigned int keyFrame)
 
    return (saveLast && keyFrame > 0) ? 2 : 1;
 }
+
+/* PMDBone::hasSameState: return true when this bone has the same definition and current position, rotation and switch as the given bone */
+bool PMDBone::hasSameState(PMDBone *b)
+{
+   if (m_type != b->m_type || m_offset != b->m_offset || m_parentIsRoot != b->m_parentIsRoot)
+      return false;
+   if ((m_parentBone == NULL) != (b->m_parentBone == NULL))
+      return false;
+   if (m_parentBone && m_parentIsRoot == false && m_parentBone->m_id != b->m_parentBone->m_id)
+      return false;
+   if (m_pos != b->m_pos || m_rot != b->m_rot || m_morphPos != b->m_morphPos || m_morphRot != b->m_morphRot)
+      return false;
+   return m_IKSwitchFlag == b->m_IKSwitchFlag;
+}
+
+/* PMDBone::copyState: copy current position, rotation and switch from the given bone, and its transform moved by the given root difference */
+void PMDBone::copyState(PMDBone *b, const btTransform *rootDiff)
+{
+   m_pos = b->m_pos;
+   m_rot = b->m_rot;
+   m_morphPos = b->m_morphPos;
+   m_morphRot = b->m_morphRot;
+   m_IKSwitchFlag = b->m_IKSwitchFlag;
+   m_trans = (*rootDiff) * b->m_trans;
+}
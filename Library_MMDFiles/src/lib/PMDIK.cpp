@@ -67,6 +67,9 @@ void PMDIK::initialize()
    m_numBone = 0;
    m_iteration = 0;
    m_angleConstraint = 0.0f;
+
+   m_solver = PMDIK_SOLVER_CCD;
+   m_twoBone = false;
 }
 
 /* PMDIK::clear: free IK */
@@ -109,17 +112,66 @@ void PMDIK::setup(PMDFile_IK *ik, const unsigned char *data, PMDBone *boneList)
    }
    m_iteration = ik->numIteration;
    m_angleConstraint = ik->angleConstraint * 4.0f;
+
+   m_solver = MMDFiles_getIKSolverDefault();
+   m_twoBone = checkTwoBone();
+}
+
+/* PMDIK::checkTwoBone: check if analytic two-bone solver can be applied to this chain */
+bool PMDIK::checkTwoBone()
+{
+   if (m_numBone != 2 || m_boneList == NULL)
+      return false;
+   if (m_boneList[0]->isLimitAngleX() == false || m_boneList[1]->isLimitAngleX() == true)
+      return false;
+
+   /* root, knee and target should be a parent-child sequence */
+   if (m_boneList[0]->getParentBone() != m_boneList[1] || m_targetBone->getParentBone() != m_boneList[0])
+      return false;
+
+   return true;
 }
 
 /* PMDIK::solve: try to move targetBone toward destBone, solving constraint among bones in boneList[] and the targetBone */
 void PMDIK::solve()
+{
+   btQuaternion origTargetRot;
+
+   if (m_boneList == NULL)
+      return;
+
+   if (m_destBone->getIKSwitchFlag() == false)
+      return;
+
+   /* before begin IK iteration, make sure all the child bones and target bone are up to date update from root to child */
+#ifndef MMDFILES_DONTUPDATEMATRICESFORIK
+   /* this can be disabled for compatibility with MikuMikuDance */
+   updateLinkBones();
+#endif /* !MMDFILES_DONTUPDATEMATRICESFORIK */
+
+   /* save the current rotation of the target bone */
+   /* it will be restored at the end of this function */
+   m_targetBone->getCurrentRotation(&origTargetRot);
+
+   /* analytic solver falls back to CCD for other chains */
+   if (m_solver != PMDIK_SOLVER_ANALYTIC || m_twoBone == false || solveTwoBone() == false)
+      solveCCD(m_solver != PMDIK_SOLVER_CCD);
+
+   /* restore the original rotation of the target bone */
+   m_targetBone->setCurrentRotation(&origTargetRot);
+   m_targetBone->update();
+}
+
+/* PMDIK::solveCCD: solve by cyclic coordinate descent */
+void PMDIK::solveCCD(bool earlyStop)
 {
    short i;
    unsigned char j;
    unsigned short ite;
    btQuaternion tmpRot;
 
-   btQuaternion origTargetRot;
+   bool moved;
+   float dist, prevDist = 0.0f;
 
    btVector3 destPos; /* destination position */
    btVector3 targetPos;
@@ -138,27 +190,12 @@ void PMDIK::solve()
    btScalar cx, cy, cz;
    btMatrix3x3 mat;
 
-   if (m_boneList == NULL)
-      return;
-
-   if (m_destBone->getIKSwitchFlag() == false)
-      return;
-
    /* get the global destination point */
    destPos = m_destBone->getTransform()->getOrigin();
 
-   /* before begin IK iteration, make sure all the child bones and target bone are up to date update from root to child */
-#ifndef MMDFILES_DONTUPDATEMATRICESFORIK
-   /* this can be disabled for compatibility with MikuMikuDance */
-   updateLinkBones();
-#endif /* !MMDFILES_DONTUPDATEMATRICESFORIK */
-
-   /* save the current rotation of the target bone */
-   /* it will be restored at the end of this function */
-   m_targetBone->getCurrentRotation(&origTargetRot);
-
    /* begin IK iteration */
    for (ite = 0; ite < m_iteration; ite++) {
+      moved = false;
       /* solve each step from leaf bone to root bone */
       for (j = 0; j < m_numBone; j++) {
          /* get current global target bone location */
@@ -248,12 +285,133 @@ void PMDIK::solve()
          /* update transform matrices for relevant (child) bones */
          for (i = j; i >= 0; i--) m_boneList[i]->update();
          m_targetBone->update();
+         moved = true;
+      }
+      /* when no bone has been rotated in this iteration, the rest will do nothing either */
+      if (moved == false)
+         break;
+      /* stop when the last iteration made little progress */
+      if (earlyStop) {
+         dist = m_targetBone->getTransform()->getOrigin().distance2(destPos);
+         if (ite > 0 && dist > prevDist * (1.0f - PMDIK_MINIMPROVEMENT))
+            break;
+         prevDist = dist;
       }
    }
+}
 
-   /* restore the original rotation of the target bone */
-   m_targetBone->setCurrentRotation(&origTargetRot);
+/* PMDIK::solveTwoBone: solve two-bone chain analytically, return false when not solved */
+/* the knee angle is given by the distance between root and destination, then the root is turned to the destination */
+bool PMDIK::solveTwoBone()
+{
+   PMDBone *knee = m_boneList[0];
+   PMDBone *root = m_boneList[1];
+   btVector3 destPos, rootPos, targetPos;
+   btTransform frame;
+   btQuaternion kneeRot, rootRot, rot;
+   btVector3 u, h, axis;
+   btMatrix3x3 mat;
+   btScalar cx, cy, cz;
+   float d2, c, s, k, r, base, phi, t, e, best, bestPhi, dot, angle;
+   int n;
+
+   destPos = m_destBone->getTransform()->getOrigin();
+   rootPos = root->getTransform()->getOrigin();
+   targetPos = m_targetBone->getTransform()->getOrigin();
+   if (targetPos.distance2(destPos) < PMDIK_MINDISTANCE)
+      return true;
+
+   /* knee frame without the knee rotation, in which the knee turns around x axis */
+   knee->getCurrentRotation(&kneeRot);
+   frame.setIdentity();
+   frame.setRotation(kneeRot.inverse());
+   frame = *(knee->getTransform()) * frame;
+   /* target and root positions in the frame */
+   u = frame.inverse() * targetPos;
+   h = frame.inverse() * rootPos;
+   d2 = destPos.distance2(rootPos);
+
+   /* |Rx(phi) u - h|^2 = d2 is c cos(phi) + s sin(phi) = k */
+   c = u.y() * h.y() + u.z() * h.z();
+   s = u.y() * h.z() - u.z() * h.y();
+   k = (u.length2() + h.length2() - d2) * 0.5f - u.x() * h.x();
+   r = sqrtf(c * c + s * s);
+   if (r < PMDIK_MINAXIS)
+      return false;
+   base = atan2f(s, c);
+   t = k / r;
+   if (t > 1.0f)
+      t = 1.0f;
+   else if (t < -1.0f)
+      t = -1.0f;
+   angle = acosf(t);
+
+   /* current knee angle, same as CCD */
+   mat.setRotation(kneeRot);
+   mat.getEulerZYX(cz, cy, cx);
+   if (cx < -PMDIK_PI * 0.5f)
+      cx += PMDIK_PI * 2.0f;
+
+   /* choose the solution which bends the knee within the limit and is closest to the destination */
+   best = 0.0f;
+   bestPhi = 0.0f;
+   for (n = 0; n < 2; n++) {
+      phi = (n == 0) ? base + angle : base - angle;
+      t = cx + phi;
+      while (t > PMDIK_PI)
+         t -= PMDIK_PI * 2.0f;
+      while (t <= -PMDIK_PI)
+         t += PMDIK_PI * 2.0f;
+      if (t > PMDIK_PI)
+         t = PMDIK_PI;
+      if (t < PMDIK_MINROTSUM)
+         t = PMDIK_MINROTSUM;
+      phi = t - cx;
+      e = fabsf(c * cosf(phi) + s * sinf(phi) - k);
+      if (n == 0 || e < best - PMDIK_MINROTATION || (e < best + PMDIK_MINROTATION && fabsf(phi) < fabsf(bestPhi))) {
+         best = e;
+         bestPhi = phi;
+      }
+   }
+
+   /* apply the knee rotation */
+   if (fabsf(bestPhi) >= PMDIK_MINROTATION) {
+      rot.setEulerZYX(btScalar(0.0f), btScalar(0.0f), btScalar(bestPhi));
+      kneeRot = rot * kneeRot;
+      knee->setCurrentRotation(&kneeRot);
+      knee->update();
+      m_targetBone->update();
+      targetPos = m_targetBone->getTransform()->getOrigin();
+   }
+
+   /* turn the root so that the target comes to the destination */
+   frame = root->getTransform()->inverse();
+   u = frame * targetPos;
+   h = frame * destPos;
+   if (u.length2() < PMDIK_MINDISTANCE || h.length2() < PMDIK_MINDISTANCE)
+      return true;
+   u.normalize();
+   h.normalize();
+   axis = u.cross(h);
+   if (axis.length2() < SIMD_EPSILON * SIMD_EPSILON)
+      return true;
+   axis.normalize();
+   dot = u.dot(h);
+   if (dot > 1.0f)
+      dot = 1.0f;
+   else if (dot < -1.0f)
+      dot = -1.0f;
+   angle = acosf(dot);
+   if (fabsf(angle) < PMDIK_MINANGLE)
+      return true;
+   root->getCurrentRotation(&rootRot);
+   rootRot *= btQuaternion(axis, btScalar(angle));
+   root->setCurrentRotation(&rootRot);
+   root->update();
+   knee->update();
    m_targetBone->update();
+
+   return true;
 }
 
 /* PMDIK::updateLinkBones: update link bones */
@@ -280,3 +438,15 @@ void PMDIK::updateInfo()
       m_boneList[i]->setIKLink(this);
    }
 }
+
+/* PMDIK::setSolver: set solver type */
+void PMDIK::setSolver(unsigned char solver)
+{
+   m_solver = solver;
+}
+
+/* PMDIK::getSolver: get solver type */
+unsigned char PMDIK::getSolver()
+{
+   return m_solver;
+}
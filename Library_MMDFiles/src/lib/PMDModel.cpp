@@ -130,10 +130,15 @@ void PMDModel::initialize()
    }
 
    m_boneSkinningTrans = NULL;
+   m_lastBoneSkinningTrans = NULL;
+   m_lastMorphWeight = NULL;
+   m_morphChanged = true;
+   m_skinSerial = MMDFiles_getNewSerial();
    m_numSurfaceForEdge = 0;
    m_vboMethod = MMDFiles_getVBOMethodDefault();
    m_vboBufData = NULL;
    m_vboBufDataLen = 0;
+   m_skinUpdated = false;
    m_vboBufDynamic = 0;
    m_vboBufStatic = 0;
    m_vboBufElement = 0;
@@ -149,6 +154,40 @@ void PMDModel::initialize()
    m_vboOffsetSurfaceForShadow = 0;
    m_vboBufElementShadowMap = 0;
 
+   m_gpuSkinning = false;
+   m_vboBufSkinning = 0;
+   m_boneTextureID = 0;
+   m_boneTextureData = NULL;
+   m_boneTextureUpdated = false;
+
+   m_numPickCluster = 0;
+   m_pickCluster = NULL;
+   m_pickSurfaceList = NULL;
+   m_numPickBoneBox = 0;
+   m_pickBoneBox = NULL;
+   m_numPickNode = 0;
+   m_pickNode = NULL;
+   m_pickRefitRequired = false;
+
+   m_lodSurfaceList = NULL;
+   m_lodSurfaceHead = NULL;
+   m_numLODSurface = 0;
+   m_lodVertexList = NULL;
+   m_numLODVertex = 0;
+   m_vboBufElementLOD = 0;
+   m_detailLevel = PMDMODEL_DETAIL_FULL;
+   m_requestedDetailLevel = PMDMODEL_DETAIL_FULL;
+
+   m_numBoneHierarchy = 0;
+   m_boneHierarchyID = NULL;
+   m_boneHierarchyParent = NULL;
+   m_boneLocalTrans = NULL;
+   m_boneGlobalTrans = NULL;
+   m_numBoneBlock = 0;
+   m_boneBlock = NULL;
+   m_numBoneLevel = 0;
+   m_boneLevelHead = NULL;
+
    m_centerBone = NULL;
    m_baseFace = NULL;
    m_orderedBoneList = NULL;
@@ -164,6 +203,16 @@ void PMDModel::initialize()
    m_maxProcessLayer = 0;
    m_materialRenderOrder = NULL;
    m_materialDistance = NULL;
+   m_numTransparentMaterial = 0;
+   m_materialOrderView.setIdentity();
+   m_materialOrderReady = false;
+   m_materialCenterUpdated = false;
+   m_renderCommand = NULL;
+   m_numRenderCommand = 0;
+   m_renderCommandRequired = true;
+   m_materialBoneHead = NULL;
+   m_materialBoneList = NULL;
+   m_materialCulled = NULL;
 
    /* initial values for variables that should be kept at model change */
    m_toon = false;
@@ -278,6 +327,10 @@ void PMDModel::clear()
 
    if (m_boneSkinningTrans)
       MMDFiles_alignedfree(m_boneSkinningTrans);
+   if (m_lastBoneSkinningTrans)
+      MMDFiles_alignedfree(m_lastBoneSkinningTrans);
+   if (m_lastMorphWeight)
+      free(m_lastMorphWeight);
    if (m_vboBufData)
       MMDFiles_alignedfree(m_vboBufData);
    if (m_vboBufDynamic != 0)
@@ -288,6 +341,10 @@ void PMDModel::clear()
       glDeleteBuffers(1, &m_vboBufElement);
    if (m_vboBufElementShadowMap != 0)
       glDeleteBuffers(1, &m_vboBufElementShadowMap);
+   clearGPUSkinning();
+   clearPick();
+   clearLevelOfDetail();
+   clearBoneHierarchy();
    if (m_orderedBoneList)
       free(m_orderedBoneList);
    if (m_rotateBoneIDList)
@@ -305,6 +362,14 @@ void PMDModel::clear()
       free(m_materialRenderOrder);
    if (m_materialDistance)
       free(m_materialDistance);
+   if (m_renderCommand)
+      free(m_renderCommand);
+   if (m_materialBoneHead)
+      free(m_materialBoneHead);
+   if (m_materialBoneList)
+      free(m_materialBoneList);
+   if (m_materialCulled)
+      free(m_materialCulled);
 
    for (i = 0; i < SYSTEMTEXTURE_NUMFILES; i++)
       m_localToonTexture[i].release();
@@ -722,6 +787,25 @@ unsigned short PMDModel::getNumIK()
    return m_numIK;
 }
 
+/* PMDModel::setIKSolver: set solver of IK chain for the destination bone, or all chains when name is NULL */
+bool PMDModel::setIKSolver(const char *destBoneName, unsigned char solver)
+{
+   unsigned short i;
+   PMDBone *bone;
+
+   if (destBoneName == NULL) {
+      for (i = 0; i < m_numIK; i++)
+         m_IKList[i].setSolver(solver);
+      return true;
+   }
+
+   bone = getBone(destBoneName);
+   if (bone == NULL || bone->getIK() == NULL)
+      return false;
+   bone->getIK()->setSolver(solver);
+   return true;
+}
+
 /* PMDModel::getNumFace: get number of faces */
 unsigned short PMDModel::getNumFace()
 {
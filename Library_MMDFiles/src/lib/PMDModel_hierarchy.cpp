@@ -0,0 +1,269 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDFiles.h"
+
+
+/* bone hierarchy for update */
+/* bones are grouped into blocks in the update order.  In a level block, the transform of a bone depends only */
+/* on its own position / rotation and on the transform of its parent, so the local transforms of all bones in */
+/* the block are computed at once, and then the global transforms are composed level by level from the root */
+/* side.  Bones in a level are independent each other and computed in parallel when the level is large. */
+/* Results are written back to PMDBone, so other parts (IK, physics, skinning) are not affected. */
+
+/* PMDModel_getBlockPosition: get position of parent bone in block, or -1 when not in block */
+static int PMDModel_getBlockPosition(PMDBone *bone, PMDBone *boneList, unsigned short numBone, int *pos)
+{
+   PMDBone *parent = bone->getParentBone();
+
+   /* parent may be the model root bone which is not in the bone list */
+   if (parent == NULL || parent < boneList || parent >= boneList + numBone)
+      return -1;
+   return pos[parent - boneList];
+}
+
+/* PMDModel::addBoneBlock: add block of bones in update order */
+void PMDModel::addBoneBlock(unsigned char kind, bool afterPhysics, PMDBone **list, unsigned int num, int *work)
+{
+   PMDBoneBlock *block;
+   int *pos, *depth, p;
+   unsigned int i, k, l, numLevel;
+
+   if (num == 0)
+      return;
+
+   block = &(m_boneBlock[m_numBoneBlock]);
+   block->kind = kind;
+   block->afterPhysics = afterPhysics;
+   block->head = m_numBoneHierarchy;
+   block->num = num;
+   block->levelHead = 0;
+   block->numLevel = 0;
+
+   /* work area for position in list and depth in block */
+   pos = work;
+   depth = work + m_numBone;
+
+   if (kind == PMDMODEL_BONEBLOCK_LEVEL) {
+      for (i = 0; i < num; i++)
+         pos[list[i] - m_boneList] = (int)i;
+      /* depth is counted through parents earlier in this block, others are treated as given */
+      numLevel = 0;
+      for (i = 0; i < num; i++) {
+         depth[i] = 0;
+         p = PMDModel_getBlockPosition(list[i], m_boneList, m_numBone, pos);
+         if (p < 0)
+            continue;
+         if ((unsigned int)p > i) {
+            /* parent is updated later, bones should be updated one by one to keep the result */
+            kind = PMDMODEL_BONEBLOCK_UPDATE;
+            break;
+         }
+         depth[i] = depth[p] + 1;
+         if (numLevel < (unsigned int)depth[i])
+            numLevel = (unsigned int)depth[i];
+      }
+      numLevel++;
+      if (kind == PMDMODEL_BONEBLOCK_LEVEL) {
+         /* sort by depth keeping the order in each level */
+         block->levelHead = m_numBoneLevel;
+         block->numLevel = numLevel;
+         k = m_numBoneHierarchy;
+         for (l = 0; l < numLevel; l++) {
+            m_boneLevelHead[m_numBoneLevel++] = k;
+            for (i = 0; i < num; i++) {
+               if ((unsigned int)depth[i] != l)
+                  continue;
+               pos[list[i] - m_boneList] = (int)k;
+               m_boneHierarchyID[k++] = (unsigned short)(list[i] - m_boneList);
+            }
+         }
+         m_boneLevelHead[m_numBoneLevel++] = k;
+         for (k = block->head; k < block->head + num; k++)
+            m_boneHierarchyParent[k] = PMDModel_getBlockPosition(&(m_boneList[m_boneHierarchyID[k]]), m_boneList, m_numBone, pos);
+      }
+      for (i = 0; i < num; i++)
+         pos[list[i] - m_boneList] = -1;
+      block->kind = kind;
+   }
+
+   if (kind != PMDMODEL_BONEBLOCK_LEVEL) {
+      for (i = 0; i < num; i++) {
+         m_boneHierarchyID[m_numBoneHierarchy + i] = (unsigned short)(list[i] - m_boneList);
+         m_boneHierarchyParent[m_numBoneHierarchy + i] = -1;
+      }
+   }
+
+   m_numBoneHierarchy += num;
+   m_numBoneBlock++;
+}
+
+/* PMDModel::setupBoneHierarchy: make blocks and arrays for bone update */
+void PMDModel::setupBoneHierarchy()
+{
+   unsigned int i, n, num;
+   short layer;
+   int a;
+   bool afterPhysics;
+   PMDBone **list;
+   int *work;
+
+   clearBoneHierarchy();
+
+   if (m_numBone == 0)
+      return;
+
+   /* follow-rotate bones are updated twice in extended style */
+   num = m_numBone;
+   if (m_hasExtBoneParam)
+      for (i = 0; i < m_numBone; i++)
+         if (m_boneList[i].getType() == FOLLOW_ROTATE)
+            num++;
+
+   m_boneHierarchyID = (unsigned short *) malloc(sizeof(unsigned short) * num);
+   m_boneHierarchyParent = (int *) malloc(sizeof(int) * num);
+   m_boneLocalTrans = (btTransform *) MMDFiles_alignedmalloc(sizeof(btTransform) * num, 16);
+   m_boneGlobalTrans = (btTransform *) MMDFiles_alignedmalloc(sizeof(btTransform) * num, 16);
+   m_boneBlock = (PMDBoneBlock *) malloc(sizeof(PMDBoneBlock) * num);
+   m_boneLevelHead = (unsigned int *) malloc(sizeof(unsigned int) * num * 2);
+   list = (PMDBone **) malloc(sizeof(PMDBone *) * m_numBone);
+   work = (int *) malloc(sizeof(int) * m_numBone * 2);
+   for (i = 0; i < m_numBone; i++)
+      work[i] = -1;
+
+   if (m_hasExtBoneParam == false) {
+      /* PMD style: all bones in the order of parents first, IKs are solved after them */
+      addBoneBlock(PMDMODEL_BONEBLOCK_LEVEL, false, m_orderedBoneList, m_numBone, work);
+   } else {
+      /* extended style: per layer in the order of bone index, IK is solved just after its bone */
+      for (a = 0; a < 2; a++) {
+         afterPhysics = (a == 1);
+         for (layer = 0; layer <= m_maxProcessLayer; layer++) {
+            n = 0;
+            for (i = 0; i < m_numBone; i++) {
+               if (m_boneList[i].processAfterPhysics() != afterPhysics) continue;
+               if (m_boneList[i].getProcessLayer() != layer) continue;
+               if (m_boneList[i].getIK()) {
+                  addBoneBlock(PMDMODEL_BONEBLOCK_LEVEL, afterPhysics, list, n, work);
+                  n = 0;
+                  list[0] = &(m_boneList[i]);
+                  addBoneBlock(PMDMODEL_BONEBLOCK_SEQUENTIAL, afterPhysics, list, 1, work);
+               } else {
+                  list[n++] = &(m_boneList[i]);
+               }
+            }
+            addBoneBlock(PMDMODEL_BONEBLOCK_LEVEL, afterPhysics, list, n, work);
+            /* additionally apply follow-rotate bone with IK target finally */
+            n = 0;
+            for (i = 0; i < m_numBone; i++) {
+               if (m_boneList[i].processAfterPhysics() != afterPhysics) continue;
+               if (m_boneList[i].getProcessLayer() != layer) continue;
+               if (m_boneList[i].getType() == FOLLOW_ROTATE)
+                  list[n++] = &(m_boneList[i]);
+            }
+            addBoneBlock(PMDMODEL_BONEBLOCK_UPDATE, afterPhysics, list, n, work);
+         }
+      }
+   }
+
+   free(work);
+   free(list);
+}
+
+/* PMDModel::clearBoneHierarchy: free blocks and arrays for bone update */
+void PMDModel::clearBoneHierarchy()
+{
+   if (m_boneHierarchyID)
+      free(m_boneHierarchyID);
+   if (m_boneHierarchyParent)
+      free(m_boneHierarchyParent);
+   if (m_boneLocalTrans)
+      MMDFiles_alignedfree(m_boneLocalTrans);
+   if (m_boneGlobalTrans)
+      MMDFiles_alignedfree(m_boneGlobalTrans);
+   if (m_boneBlock)
+      free(m_boneBlock);
+   if (m_boneLevelHead)
+      free(m_boneLevelHead);
+   m_numBoneHierarchy = 0;
+   m_boneHierarchyID = NULL;
+   m_boneHierarchyParent = NULL;
+   m_boneLocalTrans = NULL;
+   m_boneGlobalTrans = NULL;
+   m_numBoneBlock = 0;
+   m_boneBlock = NULL;
+   m_numBoneLevel = 0;
+   m_boneLevelHead = NULL;
+}
+
+/* PMDModel::updateBoneBlock: update bones in block */
+void PMDModel::updateBoneBlock(PMDBoneBlock *block)
+{
+   int k, from, to;
+   unsigned int l;
+   PMDBone *b;
+   PMDIK *ik;
+
+   switch (block->kind) {
+   case PMDMODEL_BONEBLOCK_SEQUENTIAL:
+   case PMDMODEL_BONEBLOCK_UPDATE:
+      for (k = (int)block->head; k < (int)(block->head + block->num); k++) {
+         b = &(m_boneList[m_boneHierarchyID[k]]);
+         if (block->afterPhysics)
+            b->updateAfterSimulation();
+         else
+            b->update();
+         if (block->kind == PMDMODEL_BONEBLOCK_SEQUENTIAL) {
+            ik = b->getIK();
+            if (ik) {
+               /* extended style seems to require updates of link bones at each IK call */
+               ik->updateLinkBones();
+               ik->solve();
+            }
+         }
+      }
+      break;
+   case PMDMODEL_BONEBLOCK_LEVEL:
+      /* local transforms do not depend on other transforms */
+      from = (int)block->head;
+      to = (int)(block->head + block->num);
+#pragma omp parallel for if (to - from >= PMDMODEL_BONEPARALLELMIN)
+      for (k = from; k < to; k++)
+         m_boneList[m_boneHierarchyID[k]].getLocalTransform(&(m_boneLocalTrans[k]));
+      /* compose global transforms from root side */
+      for (l = 0; l < block->numLevel; l++) {
+         from = (int)m_boneLevelHead[block->levelHead + l];
+         to = (int)m_boneLevelHead[block->levelHead + l + 1];
+#pragma omp parallel for if (to - from >= PMDMODEL_BONEPARALLELMIN)
+         for (k = from; k < to; k++) {
+            PMDBone *bone = &(m_boneList[m_boneHierarchyID[k]]);
+            btTransform *simulated = block->afterPhysics ? bone->getTransBySimulation() : NULL;
+            if (simulated)
+               m_boneGlobalTrans[k] = (*simulated) * m_boneLocalTrans[k];
+            else if (m_boneHierarchyParent[k] >= 0)
+               m_boneGlobalTrans[k] = m_boneGlobalTrans[m_boneHierarchyParent[k]] * m_boneLocalTrans[k];
+            else if (bone->getParentBone())
+               m_boneGlobalTrans[k] = (*(bone->getParentBone()->getTransform())) * m_boneLocalTrans[k];
+            else
+               m_boneGlobalTrans[k] = m_boneLocalTrans[k];
+            bone->setTransform(&(m_boneGlobalTrans[k]));
+         }
+      }
+      break;
+   }
+}
@@ -0,0 +1,224 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDFiles.h"
+
+/* level of detail for small models on screen */
+/* the simplified mesh is made by clustering vertices of each material on a grid.  Vertices are clustered */
+/* only when they share the same dominant bone, and each cluster is represented by one of its own vertices, */
+/* so the simplified mesh uses the original vertex buffers with their bone weights and texture coordinates. */
+/* Only vertices referred from the simplified mesh are skinned while it is in use. */
+
+/* PMDModelLODKey: cluster key of a vertex */
+typedef struct {
+   unsigned long long key; /* grid cell and dominant bone */
+   unsigned int id;        /* vertex index */
+} PMDModelLODKey;
+
+/* PMDModel_compareLODKey: qsort function for clustering */
+static int PMDModel_compareLODKey(const void *a, const void *b)
+{
+   const PMDModelLODKey *x = (const PMDModelLODKey *) a;
+   const PMDModelLODKey *y = (const PMDModelLODKey *) b;
+
+   if (x->key != y->key)
+      return (x->key > y->key) ? 1 : -1;
+   if (x->id != y->id)
+      return (x->id > y->id) ? 1 : -1;
+   return 0;
+}
+
+/* PMDModel_isLODSurfaceTarget: return true if the material should be drawn for the type */
+static bool PMDModel_isLODSurfaceTarget(PMDMaterial *m, int type)
+{
+   switch (type) {
+   case PMDMODEL_LODSURFACE_EDGE:
+      return m->getEdgeFlag();
+   case PMDMODEL_LODSURFACE_SHADOW:
+      return m->getShadowFlag();
+   case PMDMODEL_LODSURFACE_SHADOWMAP:
+      return m->getShadowMapRenderFlag();
+   }
+   return true;
+}
+
+/* PMDModel::setupLevelOfDetail: make simplified surface list and list of vertices used by it */
+void PMDModel::setupLevelOfDetail()
+{
+   unsigned int i, j, k, m, n, numKey, numSurface;
+   unsigned int v0, v1, v2;
+   float bmin[3], bmax[3], size;
+   unsigned long long cell[3];
+   unsigned int *rep, *mark;
+   INDICES *surface;
+   PMDModelLODKey *key;
+
+   clearLevelOfDetail();
+
+   if (m_numVertex == 0 || m_numSurface == 0 || m_numMaterial == 0)
+      return;
+
+   /* grid size from the extent of model */
+   for (k = 0; k < 3; k++)
+      bmin[k] = bmax[k] = m_vertexList[0].m_floats[k];
+   for (j = 1; j < m_numVertex; j++) {
+      for (k = 0; k < 3; k++) {
+         if (bmin[k] > m_vertexList[j].m_floats[k]) bmin[k] = m_vertexList[j].m_floats[k];
+         if (bmax[k] < m_vertexList[j].m_floats[k]) bmax[k] = m_vertexList[j].m_floats[k];
+      }
+   }
+   size = 0.0f;
+   for (k = 0; k < 3; k++)
+      if (size < bmax[k] - bmin[k])
+         size = bmax[k] - bmin[k];
+   size /= PMDMODEL_LODGRIDDIV;
+   if (size <= 0.0f)
+      return;
+
+   rep = (unsigned int *) malloc(sizeof(unsigned int) * m_numVertex);
+   mark = (unsigned int *) malloc(sizeof(unsigned int) * m_numVertex);
+   key = (PMDModelLODKey *) malloc(sizeof(PMDModelLODKey) * m_numVertex);
+   m_lodSurfaceList = (INDICES *) malloc(sizeof(INDICES) * m_numSurface);
+   m_lodSurfaceHead = (unsigned int *) malloc(sizeof(unsigned int) * (m_numMaterial + 1));
+   for (j = 0; j < m_numVertex; j++)
+      mark[j] = m_numMaterial;
+
+   n = 0;
+   for (m = 0; m < m_numMaterial; m++) {
+      m_lodSurfaceHead[m] = n;
+      surface = &(m_surfaceList[m_material[m].getSurfaceListIndex()]);
+      numSurface = m_material[m].getNumSurface();
+      /* make cluster keys of vertices in this material */
+      numKey = 0;
+      for (i = 0; i < numSurface; i++) {
+         j = surface[i];
+         if (mark[j] == m)
+            continue;
+         mark[j] = m;
+         for (k = 0; k < 3; k++) {
+            cell[k] = (unsigned long long) ((m_vertexList[j].m_floats[k] - bmin[k]) / size);
+            if (cell[k] > 0xffff)
+               cell[k] = 0xffff;
+         }
+         key[numKey].key = (cell[0] << 48) | (cell[1] << 32) | (cell[2] << 16) | (unsigned long long) ((getPickDominantBone(j) + 1) & 0xffff);
+         key[numKey].id = j;
+         numKey++;
+      }
+      /* the first vertex in each cluster represents the cluster */
+      qsort(key, numKey, sizeof(PMDModelLODKey), PMDModel_compareLODKey);
+      for (i = 0; i < numKey; i = k)
+         for (k = i; k < numKey && key[k].key == key[i].key; k++)
+            rep[key[k].id] = key[i].id;
+      /* remap surfaces and drop collapsed ones */
+      for (i = 0; i + 2 < numSurface; i += 3) {
+         v0 = rep[surface[i]];
+         v1 = rep[surface[i + 1]];
+         v2 = rep[surface[i + 2]];
+         if (v0 == v1 || v1 == v2 || v2 == v0)
+            continue;
+         m_lodSurfaceList[n++] = (INDICES) v0;
+         m_lodSurfaceList[n++] = (INDICES) v1;
+         m_lodSurfaceList[n++] = (INDICES) v2;
+      }
+   }
+   m_lodSurfaceHead[m_numMaterial] = n;
+   m_numLODSurface = n;
+
+   free(key);
+   free(rep);
+
+   /* discard when not simplified enough */
+   if (n == 0 || n > m_numSurface * PMDMODEL_LODMAXRATE) {
+      free(mark);
+      clearLevelOfDetail();
+      return;
+   }
+
+   /* make list of vertices to be skinned, including material centers for ordering transparent materials */
+   for (j = 0; j < m_numVertex; j++)
+      mark[j] = 0;
+   for (i = 0; i < n; i++)
+      mark[m_lodSurfaceList[i]] = 1;
+   for (m = 0; m < m_numMaterial; m++)
+      mark[m_material[m].getCenterPositionIndex()] = 1;
+   m_numLODVertex = 0;
+   for (j = 0; j < m_numVertex; j++)
+      if (mark[j] == 1)
+         m_numLODVertex++;
+   m_lodVertexList = (unsigned int *) malloc(sizeof(unsigned int) * m_numLODVertex);
+   k = 0;
+   for (j = 0; j < m_numVertex; j++)
+      if (mark[j] == 1)
+         m_lodVertexList[k++] = j;
+
+   free(mark);
+}
+
+/* PMDModel::clearLevelOfDetail: free simplified surface list */
+void PMDModel::clearLevelOfDetail()
+{
+   if (m_lodSurfaceList)
+      free(m_lodSurfaceList);
+   if (m_lodSurfaceHead)
+      free(m_lodSurfaceHead);
+   if (m_lodVertexList)
+      free(m_lodVertexList);
+   if (m_vboBufElementLOD != 0)
+      glDeleteBuffers(1, &m_vboBufElementLOD);
+   m_lodSurfaceList = NULL;
+   m_lodSurfaceHead = NULL;
+   m_numLODSurface = 0;
+   m_lodVertexList = NULL;
+   m_numLODVertex = 0;
+   m_vboBufElementLOD = 0;
+}
+
+/* PMDModel::renderLODSurface: draw simplified surfaces of materials for the type, element buffer should be bound */
+void PMDModel::renderLODSurface(int type)
+{
+   unsigned int i, from = 0, num = 0;
+
+   for (i = 0; i <= m_numMaterial; i++) {
+      if (i < m_numMaterial && PMDModel_isLODSurfaceTarget(&(m_material[i]), type)) {
+         /* neighboring materials are drawn at once */
+         if (num == 0)
+            from = m_lodSurfaceHead[i];
+         num += m_lodSurfaceHead[i + 1] - m_lodSurfaceHead[i];
+         continue;
+      }
+      if (num > 0) {
+         glDrawElements(GL_TRIANGLES, num, GL_INDICES, (const GLvoid *)(sizeof(INDICES) * from));
+         MMDFiles_addRenderStatistics(1, 0);
+         num = 0;
+      }
+   }
+}
+
+/* PMDModel::setDetailLevel: set detail level, will be applied at next skin update */
+void PMDModel::setDetailLevel(int level)
+{
+   if (level == PMDMODEL_DETAIL_LOW && m_vboBufElementLOD == 0)
+      level = PMDMODEL_DETAIL_NOEDGE;
+   m_requestedDetailLevel = level;
+}
+
+/* PMDModel::getDetailLevel: get detail level currently in use */
+int PMDModel::getDetailLevel()
+{
+   return m_detailLevel;
+}
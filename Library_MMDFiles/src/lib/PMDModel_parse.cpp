@@ -419,7 +419,7 @@ bool PMDModel::setupModel()
    btVector3 modelOffset;
    btVector3 tmpVector;
 
-   unsigned short j, k;
+   unsigned short j, k, l;
    float f;
 
 #ifdef MMDFILES_CONVERTCOORDINATESYSTEM
@@ -458,6 +458,9 @@ bool PMDModel::setupModel()
    /* prepare work area */
    /* transforms for skinning */
    m_boneSkinningTrans = (btTransform *)MMDFiles_alignedmalloc(sizeof(btTransform) * m_numBone, 16);
+   m_lastBoneSkinningTrans = (btTransform *)MMDFiles_alignedmalloc(sizeof(btTransform) * m_numBone, 16);
+   for (i = 0; i < m_numBone; i++)
+      m_lastBoneSkinningTrans[i].setIdentity();
    /* surface list to be rendered at edge drawing (skip non-edge materials) */
    m_numSurfaceForEdge = 0;
    for (i = 0; i < m_numMaterial; i++)
@@ -537,8 +540,15 @@ bool PMDModel::setupModel()
    /* initialize material order */
    m_materialRenderOrder = (unsigned int *) malloc(sizeof(unsigned int) * m_numMaterial);
    m_materialDistance = (MaterialDistanceData *) malloc(sizeof(MaterialDistanceData) * m_numMaterial);
-   for (i = 0; i < m_numMaterial; i++)
+   m_renderCommand = (PMDRenderCommand *) malloc(sizeof(PMDRenderCommand) * m_numMaterial);
+   m_numRenderCommand = 0;
+   m_renderCommandRequired = true;
+   for (i = 0; i < m_numMaterial; i++) {
       m_materialRenderOrder[i] = i;
+      m_materialDistance[i].dist = 0.0f;
+      m_materialDistance[i].alpha = 1.0f;
+      m_materialDistance[i].id = i;
+   }
    /* check if spheremap is used (single or multiple) */
    for (i = 0; i < m_numMaterial; i++) {
       if (m_material[i].hasSingleSphereMap())
@@ -625,6 +635,45 @@ bool PMDModel::setupModel()
             m_maxDistanceFromVertexAssignedBone[j] = sqrtf(m_maxDistanceFromVertexAssignedBone[j]);
    }
 
+   /* make list of bones assigned to vertices of each material for frustum culling */
+   m_materialBoneHead = (unsigned int *) malloc(sizeof(unsigned int) * (m_numMaterial + 1));
+   m_materialCulled = (bool *) malloc(sizeof(bool) * m_numMaterial);
+   for (i = 0; i < m_numMaterial; i++)
+      m_materialCulled[i] = false;
+   m_materialBoneHead[0] = 0;
+   if (m_numBone > 0 && m_numMaterial > 0) {
+      unsigned int m, s, n, v;
+      unsigned int *mark = (unsigned int *) malloc(sizeof(unsigned int) * m_numBone);
+      /* first pass counts, second pass stores */
+      for (l = 0; l < 2; l++) {
+         for (j = 0; j < m_numBone; j++)
+            mark[j] = m_numMaterial;
+         n = 0;
+         for (m = 0; m < m_numMaterial; m++) {
+            for (s = 0; s < m_material[m].getNumSurface(); s++) {
+               v = m_surfaceList[m_material[m].getSurfaceListIndex() + s];
+               if (m_boneWeight1[v] >= PMDMODEL_MINBONEWEIGHT && mark[m_bone1List[v]] != m) {
+                  mark[m_bone1List[v]] = m;
+                  if (l == 1) m_materialBoneList[n] = m_bone1List[v];
+                  n++;
+               }
+               if (m_boneWeight1[v] <= 1.0f - PMDMODEL_MINBONEWEIGHT && mark[m_bone2List[v]] != m) {
+                  mark[m_bone2List[v]] = m;
+                  if (l == 1) m_materialBoneList[n] = m_bone2List[v];
+                  n++;
+               }
+            }
+            m_materialBoneHead[m + 1] = n;
+         }
+         if (l == 0)
+            m_materialBoneList = (unsigned short *) malloc(sizeof(unsigned short) * (n > 0 ? n : 1));
+      }
+      free(mark);
+   } else {
+      for (i = 0; i < m_numMaterial; i++)
+         m_materialBoneHead[i + 1] = 0;
+   }
+
    /* get maximum height */
    if (m_numVertex > 0) {
       m_maxHeight = m_vertexList[0].y();
@@ -638,6 +687,15 @@ bool PMDModel::setupModel()
    if (m_boundingSphereStep < PMDMODEL_BOUNDINGSPHEREPOINTSMIN) m_boundingSphereStep = PMDMODEL_BOUNDINGSPHEREPOINTSMIN;
    if (m_boundingSphereStep > PMDMODEL_BOUNDINGSPHEREPOINTSMAX) m_boundingSphereStep = PMDMODEL_BOUNDINGSPHEREPOINTSMAX;
 
+   /* make blocks of bones in update order */
+   setupBoneHierarchy();
+
+   /* build bounding volume hierarchy for picking */
+   setupPick();
+
+   /* make simplified mesh for level of detail */
+   setupLevelOfDetail();
+
    /* simulation is currently off, so change bone status */
    if (!m_enableSimulation)
 #ifdef MY_RESETPHYSICS
@@ -678,6 +736,14 @@ void PMDModel::setupObjects()
    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)m_vboOffsetNormal, sizeof(btVector3) * m_numVertex, m_normalList);
    m_vboOffsetEdge = m_vboOffsetNormal + sizeof(btVector3) * m_numVertex;
    m_vboOffsetToon = m_vboOffsetEdge + sizeof(btVector3) * m_numVertex;
+   /* staging buffer for skinning on CPU, uploaded to the dynamic buffer by uploadSkin() */
+   m_vboBufData = (char *)MMDFiles_alignedmalloc(m_vboBufDynamicLen, 16);
+   if (m_vboBufData) {
+      m_vboBufDataLen = m_vboBufDynamicLen;
+      memset(m_vboBufData, 0, m_vboBufDataLen);
+      memcpy(m_vboBufData + m_vboOffsetVertex, m_vertexList, sizeof(btVector3) * m_numVertex);
+      memcpy(m_vboBufData + m_vboOffsetNormal, m_normalList, sizeof(btVector3) * m_numVertex);
+   }
 
    /* the second buffer contains static data: texture coordinates */
    glGenBuffers(1, &m_vboBufStatic);
@@ -726,10 +792,22 @@ void PMDModel::setupObjects()
       }
    }
 
+   /* simplified surface list for level of detail */
+   if (m_numLODSurface > 0) {
+      glGenBuffers(1, &m_vboBufElementLOD);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElementLOD);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(INDICES) * m_numLODSurface, m_lodSurfaceList, GL_STATIC_DRAW);
+   }
+
    /* unbind buffer */
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
+   /* use skinning on GPU if enabled and available, else skinning on CPU */
+   if (MMDFiles_getGPUSkinningDefault())
+      if (setupGPUSkinning() == false)
+         clearGPUSkinning();
+
    m_loadingProgressRate = 1.0f;
 }
 
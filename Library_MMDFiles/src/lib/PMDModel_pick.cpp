@@ -0,0 +1,522 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include <float.h>
+#include <limits.h>
+#include "MMDFiles.h"
+
+/* picking by ray casting on CPU */
+/* triangles are grouped into clusters by the dominant bone of their first vertex, and for each cluster */
+/* the bind-pose bounding box of its vertices is kept per influencing bone.  Since a skinned vertex is */
+/* a weighted average of the vertex transformed by each of its bones, it stays within the union of */
+/* those boxes transformed by the current skinning matrices, so the hierarchy can be refitted from */
+/* bone transforms alone.  Morphs and SDEF are covered by PMDMODEL_PICKMARGIN. */
+
+/* PMDModel_pickClearBox: make bounding box empty */
+static void PMDModel_pickClearBox(float *bmin, float *bmax)
+{
+   int k;
+
+   for (k = 0; k < 3; k++) {
+      bmin[k] = FLT_MAX;
+      bmax[k] = -FLT_MAX;
+   }
+}
+
+/* PMDModel_pickAddBox: extend bounding box by another box */
+static void PMDModel_pickAddBox(float *bmin, float *bmax, const float *amin, const float *amax)
+{
+   int k;
+
+   for (k = 0; k < 3; k++) {
+      if (bmin[k] > amin[k]) bmin[k] = amin[k];
+      if (bmax[k] < amax[k]) bmax[k] = amax[k];
+   }
+}
+
+/* PMDModel_pickBuildNode: build node for a range of clusters by median split of their centers */
+static void PMDModel_pickBuildNode(PMDPickNode *node, unsigned int n, unsigned int *numNode, unsigned int *idx, const float *center, unsigned int from, unsigned int to)
+{
+   unsigned int i, j, mid, tmp;
+   int axis, k;
+   float cmin[3], cmax[3];
+   float pivot;
+
+   if (to - from == 1) {
+      node[n].child = -1;
+      node[n].cluster = idx[from];
+      return;
+   }
+
+   /* split along the longest axis of cluster centers */
+   PMDModel_pickClearBox(cmin, cmax);
+   for (i = from; i < to; i++)
+      PMDModel_pickAddBox(cmin, cmax, &(center[idx[i] * 3]), &(center[idx[i] * 3]));
+   axis = 0;
+   for (k = 1; k < 3; k++)
+      if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+         axis = k;
+
+   /* sort the range along the axis, number of clusters is at most number of bones */
+   for (i = from + 1; i < to; i++) {
+      tmp = idx[i];
+      pivot = center[tmp * 3 + axis];
+      for (j = i; j > from && center[idx[j - 1] * 3 + axis] > pivot; j--)
+         idx[j] = idx[j - 1];
+      idx[j] = tmp;
+   }
+   mid = (from + to) / 2;
+
+   /* children are always placed after their parent so that refit can go backward over the node list */
+   node[n].cluster = 0;
+   node[n].child = (int) *numNode;
+   *numNode += 2;
+   PMDModel_pickBuildNode(node, node[n].child, numNode, idx, center, from, mid);
+   PMDModel_pickBuildNode(node, node[n].child + 1, numNode, idx, center, mid, to);
+}
+
+/* PMDModel_pickHitBox: test ray against bounding box within the given distance */
+static bool PMDModel_pickHitBox(const PMDPickNode *node, const btVector3 *from, const float *invDir, float maxDist)
+{
+   int k;
+   float t1, t2, tmin, tmax;
+
+   tmin = 0.0f;
+   tmax = maxDist;
+   for (k = 0; k < 3; k++) {
+      t1 = (node->min[k] - (*from)[k]) * invDir[k];
+      t2 = (node->max[k] - (*from)[k]) * invDir[k];
+      if (t1 > t2) {
+         if (tmin < t2) tmin = t2;
+         if (tmax > t1) tmax = t1;
+      } else {
+         if (tmin < t1) tmin = t1;
+         if (tmax > t2) tmax = t2;
+      }
+      if (tmin > tmax)
+         return false;
+   }
+
+   return true;
+}
+
+/* PMDModel::getPickBones: get bones which affect the vertex, return number of bones */
+int PMDModel::getPickBones(unsigned int j, unsigned short *bones, float *weights)
+{
+   int n = 0;
+
+#ifdef MY_EXTRADEFORMATION
+   if (m_bone3List != NULL && m_bone3List[j] >= 0) {
+      /* BDEF4 */
+      if (m_boneWeight1[j] > PMDMODEL_MINBONEWEIGHT && m_bone1List[j] >= 0 && m_bone1List[j] < m_numBone) {
+         bones[n] = m_bone1List[j];
+         weights[n++] = m_boneWeight1[j];
+      }
+      if (m_boneWeight2[j] > PMDMODEL_MINBONEWEIGHT && m_bone2List[j] >= 0 && m_bone2List[j] < m_numBone) {
+         bones[n] = m_bone2List[j];
+         weights[n++] = m_boneWeight2[j];
+      }
+      if (m_boneWeight3[j] > PMDMODEL_MINBONEWEIGHT && m_bone3List[j] < m_numBone) {
+         bones[n] = m_bone3List[j];
+         weights[n++] = m_boneWeight3[j];
+      }
+      if (m_boneWeight4[j] > PMDMODEL_MINBONEWEIGHT && m_bone4List[j] >= 0 && m_bone4List[j] < m_numBone) {
+         bones[n] = m_bone4List[j];
+         weights[n++] = m_boneWeight4[j];
+      }
+      return n;
+   }
+#endif /* MY_EXTRADEFORMATION */
+
+   /* BDEF2 and SDEF */
+   if (m_boneWeight1[j] > PMDMODEL_MINBONEWEIGHT && m_bone1List[j] >= 0 && m_bone1List[j] < m_numBone) {
+      bones[n] = m_bone1List[j];
+      weights[n++] = m_boneWeight1[j];
+   }
+   if (m_boneWeight1[j] < 1.0f - PMDMODEL_MINBONEWEIGHT && m_bone2List[j] >= 0 && m_bone2List[j] < m_numBone) {
+      bones[n] = m_bone2List[j];
+      weights[n++] = 1.0f - m_boneWeight1[j];
+   }
+
+   return n;
+}
+
+/* PMDModel::getPickDominantBone: get the bone of the largest weight for the vertex, or -1 if none */
+int PMDModel::getPickDominantBone(unsigned int j)
+{
+   unsigned short bones[4];
+   float weights[4];
+   int i, n, best;
+
+   n = getPickBones(j, bones, weights);
+   if (n == 0)
+      return -1;
+   best = 0;
+   for (i = 1; i < n; i++)
+      if (weights[best] < weights[i])
+         best = i;
+
+   return bones[best];
+}
+
+/* PMDModel::getPickVertex: get current skinned position of a vertex */
+void PMDModel::getPickVertex(unsigned int j, btVector3 *v)
+{
+   unsigned short bones[4];
+   float weights[4];
+   int i, n;
+
+   if (m_gpuSkinning == false && m_detailLevel != PMDMODEL_DETAIL_LOW) {
+      /* skinned on CPU: take from the staging buffer */
+      *v = ((btVector3 *)(m_vboBufData + m_vboOffsetVertex))[j];
+      return;
+   }
+
+   /* skinned on GPU or partly skinned at low detail: blend linearly on CPU, SDEF is approximated as BDEF2 */
+   n = getPickBones(j, bones, weights);
+   if (n == 0) {
+      *v = m_vertexList[j];
+      return;
+   }
+   v->setZero();
+   for (i = 0; i < n; i++)
+      *v += (m_boneSkinningTrans[bones[i]] * m_vertexList[j]) * btScalar(weights[i]);
+}
+
+/* PMDModel::setupPick: build bounding volume hierarchy over bone clusters for picking */
+void PMDModel::setupPick()
+{
+   unsigned int i, j, t, c, k, numTriangle, v;
+   unsigned int *count = NULL, *stamp = NULL, *slot = NULL, *idx = NULL;
+   float *center = NULL;
+   unsigned short *triangleBone = NULL;
+   unsigned short bones[4];
+   float weights[4];
+   int b, n, l;
+   unsigned int numNode;
+
+   clearPick();
+
+   numTriangle = m_numSurface / 3;
+   if (numTriangle == 0 || m_numBone == 0 || m_vertexList == NULL)
+      return;
+
+   count = (unsigned int *) malloc(sizeof(unsigned int) * m_numBone);
+   stamp = (unsigned int *) malloc(sizeof(unsigned int) * m_numBone);
+   slot = (unsigned int *) malloc(sizeof(unsigned int) * m_numBone);
+   triangleBone = (unsigned short *) malloc(sizeof(unsigned short) * numTriangle);
+   if (count == NULL || stamp == NULL || slot == NULL || triangleBone == NULL)
+      goto error;
+
+   /* assign each triangle to the dominant bone of its first vertex */
+   memset(count, 0, sizeof(unsigned int) * m_numBone);
+   for (t = 0; t < numTriangle; t++) {
+      b = getPickDominantBone(m_surfaceList[t * 3]);
+      if (b < 0)
+         b = 0;
+      triangleBone[t] = (unsigned short) b;
+      count[b]++;
+   }
+
+   /* make clusters of triangles */
+   m_numPickCluster = 0;
+   for (i = 0; i < m_numBone; i++)
+      if (count[i] > 0)
+         m_numPickCluster++;
+   m_pickCluster = (PMDPickCluster *) malloc(sizeof(PMDPickCluster) * m_numPickCluster);
+   m_pickSurfaceList = (unsigned int *) malloc(sizeof(unsigned int) * numTriangle);
+   if (m_pickCluster == NULL || m_pickSurfaceList == NULL)
+      goto error;
+   k = 0;
+   c = 0;
+   for (i = 0; i < m_numBone; i++) {
+      if (count[i] == 0)
+         continue;
+      m_pickCluster[c].bone = (unsigned short) i;
+      m_pickCluster[c].surfaceHead = k;
+      m_pickCluster[c].numSurface = 0;
+      slot[i] = c;
+      k += count[i];
+      c++;
+   }
+   for (t = 0; t < numTriangle; t++) {
+      c = slot[triangleBone[t]];
+      m_pickSurfaceList[m_pickCluster[c].surfaceHead + m_pickCluster[c].numSurface] = t;
+      m_pickCluster[c].numSurface++;
+   }
+
+   /* count bind-pose boxes, one per bone influencing vertices of each cluster */
+   for (i = 0; i < m_numBone; i++)
+      stamp[i] = UINT_MAX;
+   m_numPickBoneBox = 0;
+   for (c = 0; c < m_numPickCluster; c++) {
+      for (j = 0; j < m_pickCluster[c].numSurface; j++) {
+         t = m_pickSurfaceList[m_pickCluster[c].surfaceHead + j];
+         for (k = 0; k < 3; k++) {
+            n = getPickBones(m_surfaceList[t * 3 + k], bones, weights);
+            for (l = 0; l < n; l++) {
+               if (stamp[bones[l]] != c) {
+                  stamp[bones[l]] = c;
+                  m_numPickBoneBox++;
+               }
+            }
+         }
+      }
+   }
+
+   /* compute bind-pose boxes */
+   m_pickBoneBox = (PMDPickBoneBox *) malloc(sizeof(PMDPickBoneBox) * m_numPickBoneBox);
+   if (m_pickBoneBox == NULL)
+      goto error;
+   for (i = 0; i < m_numBone; i++)
+      stamp[i] = UINT_MAX;
+   m_numPickBoneBox = 0;
+   for (c = 0; c < m_numPickCluster; c++) {
+      m_pickCluster[c].boxHead = m_numPickBoneBox;
+      for (j = 0; j < m_pickCluster[c].numSurface; j++) {
+         t = m_pickSurfaceList[m_pickCluster[c].surfaceHead + j];
+         for (k = 0; k < 3; k++) {
+            v = m_surfaceList[t * 3 + k];
+            n = getPickBones(v, bones, weights);
+            for (l = 0; l < n; l++) {
+               if (stamp[bones[l]] != c) {
+                  stamp[bones[l]] = c;
+                  slot[bones[l]] = m_numPickBoneBox;
+                  m_pickBoneBox[m_numPickBoneBox].bone = bones[l];
+                  PMDModel_pickClearBox(m_pickBoneBox[m_numPickBoneBox].min, m_pickBoneBox[m_numPickBoneBox].max);
+                  m_numPickBoneBox++;
+               }
+               PMDModel_pickAddBox(m_pickBoneBox[slot[bones[l]]].min, m_pickBoneBox[slot[bones[l]]].max, m_vertexList[v], m_vertexList[v]);
+            }
+         }
+      }
+      m_pickCluster[c].numBox = m_numPickBoneBox - m_pickCluster[c].boxHead;
+   }
+
+   /* build hierarchy from bind-pose cluster centers */
+   idx = (unsigned int *) malloc(sizeof(unsigned int) * m_numPickCluster);
+   center = (float *) malloc(sizeof(float) * 3 * m_numPickCluster);
+   m_pickNode = (PMDPickNode *) malloc(sizeof(PMDPickNode) * (m_numPickCluster * 2 - 1));
+   if (idx == NULL || center == NULL || m_pickNode == NULL)
+      goto error;
+   for (c = 0; c < m_numPickCluster; c++) {
+      float bmin[3], bmax[3];
+      PMDModel_pickClearBox(bmin, bmax);
+      for (j = 0; j < m_pickCluster[c].numBox; j++)
+         PMDModel_pickAddBox(bmin, bmax, m_pickBoneBox[m_pickCluster[c].boxHead + j].min, m_pickBoneBox[m_pickCluster[c].boxHead + j].max);
+      for (k = 0; k < 3; k++)
+         center[c * 3 + k] = (bmin[k] + bmax[k]) * 0.5f;
+      idx[c] = c;
+   }
+   numNode = 1;
+   PMDModel_pickBuildNode(m_pickNode, 0, &numNode, idx, center, 0, m_numPickCluster);
+   m_numPickNode = numNode;
+
+   /* set bind-pose boxes until bones are updated */
+   refitPick(false);
+
+   free(count);
+   free(stamp);
+   free(slot);
+   free(triangleBone);
+   free(idx);
+   free(center);
+   return;
+
+error:
+   if (count) free(count);
+   if (stamp) free(stamp);
+   if (slot) free(slot);
+   if (triangleBone) free(triangleBone);
+   if (idx) free(idx);
+   if (center) free(center);
+   clearPick();
+}
+
+/* PMDModel::clearPick: free bounding volume hierarchy for picking */
+void PMDModel::clearPick()
+{
+   if (m_pickCluster)
+      free(m_pickCluster);
+   if (m_pickSurfaceList)
+      free(m_pickSurfaceList);
+   if (m_pickBoneBox)
+      free(m_pickBoneBox);
+   if (m_pickNode)
+      free(m_pickNode);
+   m_numPickCluster = 0;
+   m_pickCluster = NULL;
+   m_pickSurfaceList = NULL;
+   m_numPickBoneBox = 0;
+   m_pickBoneBox = NULL;
+   m_numPickNode = 0;
+   m_pickNode = NULL;
+   m_pickRefitRequired = false;
+}
+
+/* PMDModel::refitPick: refit bounding volume hierarchy for picking from current bone transforms */
+void PMDModel::refitPick(bool useBoneTransform)
+{
+   unsigned int i, j;
+   int k;
+   PMDPickNode *node;
+   const PMDPickCluster *cluster;
+   const PMDPickBoneBox *box;
+   btVector3 c, e, ce, ee;
+   float bmin[3], bmax[3];
+
+   /* go backward so that children are updated before their parent */
+   for (i = m_numPickNode; i > 0; i--) {
+      node = &(m_pickNode[i - 1]);
+      if (node->child >= 0) {
+         memcpy(node->min, m_pickNode[node->child].min, sizeof(float) * 3);
+         memcpy(node->max, m_pickNode[node->child].max, sizeof(float) * 3);
+         PMDModel_pickAddBox(node->min, node->max, m_pickNode[node->child + 1].min, m_pickNode[node->child + 1].max);
+         continue;
+      }
+      cluster = &(m_pickCluster[node->cluster]);
+      PMDModel_pickClearBox(node->min, node->max);
+      for (j = 0; j < cluster->numBox; j++) {
+         box = &(m_pickBoneBox[cluster->boxHead + j]);
+         if (useBoneTransform) {
+            /* transform center and extent of the bind-pose box by the skinning matrix */
+            const btTransform &tr = m_boneSkinningTrans[box->bone];
+            const btMatrix3x3 &basis = tr.getBasis();
+            c = btVector3(btScalar((box->min[0] + box->max[0]) * 0.5f), btScalar((box->min[1] + box->max[1]) * 0.5f), btScalar((box->min[2] + box->max[2]) * 0.5f));
+            e = btVector3(btScalar((box->max[0] - box->min[0]) * 0.5f), btScalar((box->max[1] - box->min[1]) * 0.5f), btScalar((box->max[2] - box->min[2]) * 0.5f));
+            ce = tr * c;
+            ee = btVector3(basis[0].absolute().dot(e), basis[1].absolute().dot(e), basis[2].absolute().dot(e));
+            for (k = 0; k < 3; k++) {
+               bmin[k] = ce[k] - ee[k];
+               bmax[k] = ce[k] + ee[k];
+            }
+            PMDModel_pickAddBox(node->min, node->max, bmin, bmax);
+         } else {
+            PMDModel_pickAddBox(node->min, node->max, box->min, box->max);
+         }
+      }
+      for (k = 0; k < 3; k++) {
+         node->min[k] -= PMDMODEL_PICKMARGIN;
+         node->max[k] += PMDMODEL_PICKMARGIN;
+      }
+   }
+}
+
+/* PMDModel::pickRay: cast a ray and get the nearest hit on this model, dist gives maximum distance and returns hit distance */
+bool PMDModel::pickRay(const btVector3 *from, const btVector3 *dir, float *dist, int *materialIndex, int *boneIndex)
+{
+   int stack[PMDMODEL_PICKSTACKSIZE];
+   int sp;
+   unsigned int i, j, t, hitTriangle = 0;
+   int k;
+   float invDir[3];
+   float best, det, u, v, d, hitU = 0.0f, hitV = 0.0f;
+   bool hit = false;
+   const PMDPickNode *node;
+   const PMDPickCluster *cluster;
+   btVector3 v0, v1, v2, e1, e2, p, s, q;
+
+   if (m_pickNode == NULL || m_vboBufData == NULL || m_showFlag == false)
+      return false;
+
+   /* refit only when picked, bones may have moved many times since the last pick */
+   if (m_pickRefitRequired) {
+      refitPick(true);
+      m_pickRefitRequired = false;
+   }
+
+   for (k = 0; k < 3; k++) {
+      d = (*dir)[k];
+      if (fabsf(d) < PMDMODEL_PICKEPSILON)
+         d = (d < 0.0f) ? -PMDMODEL_PICKEPSILON : PMDMODEL_PICKEPSILON;
+      invDir[k] = 1.0f / d;
+   }
+   best = *dist;
+
+   /* traverse hierarchy */
+   sp = 0;
+   stack[sp++] = 0;
+   while (sp > 0) {
+      node = &(m_pickNode[stack[--sp]]);
+      if (PMDModel_pickHitBox(node, from, invDir, best) == false)
+         continue;
+      if (node->child >= 0) {
+         if (sp + 2 <= PMDMODEL_PICKSTACKSIZE) {
+            stack[sp++] = node->child + 1;
+            stack[sp++] = node->child;
+         }
+         continue;
+      }
+      /* test triangles in cluster */
+      cluster = &(m_pickCluster[node->cluster]);
+      for (j = 0; j < cluster->numSurface; j++) {
+         t = m_pickSurfaceList[cluster->surfaceHead + j];
+         getPickVertex(m_surfaceList[t * 3], &v0);
+         getPickVertex(m_surfaceList[t * 3 + 1], &v1);
+         getPickVertex(m_surfaceList[t * 3 + 2], &v2);
+         /* both faces are hit as in rendering for picking */
+         e1 = v1 - v0;
+         e2 = v2 - v0;
+         p = dir->cross(e2);
+         det = e1.dot(p);
+         if (fabsf(det) < PMDMODEL_PICKEPSILON)
+            continue;
+         s = *from - v0;
+         u = s.dot(p) / det;
+         if (u < 0.0f || u > 1.0f)
+            continue;
+         q = s.cross(e1);
+         v = dir->dot(q) / det;
+         if (v < 0.0f || u + v > 1.0f)
+            continue;
+         d = e2.dot(q) / det;
+         if (d <= 0.0f || d >= best)
+            continue;
+         best = d;
+         hitTriangle = t;
+         hitU = u;
+         hitV = v;
+         hit = true;
+      }
+   }
+
+   if (hit == false)
+      return false;
+
+   *dist = best;
+   if (materialIndex) {
+      *materialIndex = -1;
+      for (i = 0; i < m_numMaterial; i++) {
+         if (hitTriangle * 3 >= m_material[i].getSurfaceListIndex() && hitTriangle * 3 < m_material[i].getSurfaceListIndex() + m_material[i].getNumSurface()) {
+            *materialIndex = (int) i;
+            break;
+         }
+      }
+   }
+   if (boneIndex) {
+      /* take dominant bone of the vertex nearest to the hit point */
+      if (1.0f - hitU - hitV >= hitU && 1.0f - hitU - hitV >= hitV)
+         *boneIndex = getPickDominantBone(m_surfaceList[hitTriangle * 3]);
+      else if (hitU >= hitV)
+         *boneIndex = getPickDominantBone(m_surfaceList[hitTriangle * 3 + 1]);
+      else
+         *boneIndex = getPickDominantBone(m_surfaceList[hitTriangle * 3 + 2]);
+   }
+
+   return true;
+}
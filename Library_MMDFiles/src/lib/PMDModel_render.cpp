@@ -58,6 +58,203 @@
 
 #include "MMDFiles.h"
 
+/* PMDModelRenderState: OpenGL state set per material in renderModel, valid only within one call */
+typedef struct {
+   GLenum activeTexture;        /* active texture unit, 0 when unknown */
+   int cullFace;                /* -1: unknown, 0: disabled, 1: enabled */
+   int texture2D[3];            /* GL_TEXTURE_2D status per texture unit */
+   int texGen[3];               /* texture coordinate generation status per texture unit */
+   GLint texEnvMode[3];         /* texture environment mode per texture unit, 0 when unknown */
+   GLuint boundTexture[3];      /* bound texture per texture unit */
+   bool boundTextureValid[3];   /* true when boundTexture is known */
+   int sphereMap[2];            /* sphere map flags of skinning shader for unit 0 and 2 */
+   float color[3][4];           /* material colors */
+   bool colorValid[3];          /* true when color is known */
+   float shininess;             /* material shininess, negative when unknown */
+   unsigned int numDrawCall;    /* number of issued draw calls */
+   unsigned int numStateChange; /* number of issued state changes */
+} PMDModelRenderState;
+
+static PMDModelRenderState g_renderState;
+
+/* PMDModel_resetRenderState: forget cached state */
+static void PMDModel_resetRenderState()
+{
+   int i;
+
+   g_renderState.activeTexture = 0;
+   g_renderState.cullFace = -1;
+   for (i = 0; i < 3; i++) {
+      g_renderState.texture2D[i] = -1;
+      g_renderState.texGen[i] = -1;
+      g_renderState.texEnvMode[i] = 0;
+      g_renderState.boundTexture[i] = 0;
+      g_renderState.boundTextureValid[i] = false;
+      g_renderState.colorValid[i] = false;
+   }
+   g_renderState.sphereMap[0] = -1;
+   g_renderState.sphereMap[1] = -1;
+   g_renderState.shininess = -1.0f;
+   g_renderState.numDrawCall = 0;
+   g_renderState.numStateChange = 0;
+}
+
+/* PMDModel_setActiveTexture: set active texture unit if changed */
+static void PMDModel_setActiveTexture(GLenum unit)
+{
+   if (g_renderState.activeTexture == GL_TEXTURE0 + unit)
+      return;
+   glActiveTexture(GL_TEXTURE0 + unit);
+   g_renderState.activeTexture = GL_TEXTURE0 + unit;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setCullFace: enable or disable face culling if changed */
+static void PMDModel_setCullFace(bool flag)
+{
+   if (g_renderState.cullFace == (flag ? 1 : 0))
+      return;
+   if (flag)
+      glEnable(GL_CULL_FACE);
+   else
+      glDisable(GL_CULL_FACE);
+   g_renderState.cullFace = flag ? 1 : 0;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setTexture2D: enable or disable texture of the unit if changed */
+static void PMDModel_setTexture2D(int unit, bool flag)
+{
+   if (g_renderState.texture2D[unit] == (flag ? 1 : 0))
+      return;
+   PMDModel_setActiveTexture(unit);
+   if (flag)
+      glEnable(GL_TEXTURE_2D);
+   else
+      glDisable(GL_TEXTURE_2D);
+   g_renderState.texture2D[unit] = flag ? 1 : 0;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setTexGen: enable or disable texture coordinate generation of the unit if changed */
+static void PMDModel_setTexGen(int unit, bool flag)
+{
+   if (g_renderState.texGen[unit] == (flag ? 1 : 0))
+      return;
+   PMDModel_setActiveTexture(unit);
+   if (flag) {
+      glEnable(GL_TEXTURE_GEN_S);
+      glEnable(GL_TEXTURE_GEN_T);
+   } else {
+      glDisable(GL_TEXTURE_GEN_S);
+      glDisable(GL_TEXTURE_GEN_T);
+   }
+   g_renderState.texGen[unit] = flag ? 1 : 0;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setTexEnvMode: set texture environment mode of the unit if changed */
+static void PMDModel_setTexEnvMode(int unit, GLint mode)
+{
+   if (g_renderState.texEnvMode[unit] == mode)
+      return;
+   PMDModel_setActiveTexture(unit);
+   glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, mode);
+   g_renderState.texEnvMode[unit] = mode;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_bindTexture: bind texture to the unit if changed */
+static void PMDModel_bindTexture(int unit, GLuint id)
+{
+   if (g_renderState.boundTextureValid[unit] && g_renderState.boundTexture[unit] == id)
+      return;
+   PMDModel_setActiveTexture(unit);
+   glBindTexture(GL_TEXTURE_2D, id);
+   g_renderState.boundTexture[unit] = id;
+   g_renderState.boundTextureValid[unit] = true;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setMaterialColor: set material color if changed, slot identifies the cached color */
+static void PMDModel_setMaterialColor(int slot, GLenum pname, const float *c)
+{
+   if (g_renderState.colorValid[slot] && memcmp(g_renderState.color[slot], c, sizeof(float) * 4) == 0)
+      return;
+   glMaterialfv(GL_FRONT_AND_BACK, pname, c);
+   memcpy(g_renderState.color[slot], c, sizeof(float) * 4);
+   g_renderState.colorValid[slot] = true;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_setShininess: set material shininess if changed */
+static void PMDModel_setShininess(float f)
+{
+   if (g_renderState.shininess == f)
+      return;
+   glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, f);
+   g_renderState.shininess = f;
+   g_renderState.numStateChange++;
+}
+
+/* PMDModel_isSameMaterialState: return true when two materials need exactly the same rendering state */
+static bool PMDModel_isSameMaterialState(PMDMaterial *a, PMDMaterial *b)
+{
+   float ca[3], cb[3];
+
+   if (a->getAlpha() != b->getAlpha() || a->getShiness() != b->getShiness())
+      return false;
+   if (a->getFaceFlag() != b->getFaceFlag() || a->getToonID() != b->getToonID() || a->getShadowMapRenderFlag() != b->getShadowMapRenderFlag())
+      return false;
+   if (a->getTexture() != b->getTexture() || a->getAdditionalTexture() != b->getAdditionalTexture())
+      return false;
+#ifdef MY_LUMINOUS
+   if (a->getLimunousFlag() != b->getLimunousFlag())
+      return false;
+#endif
+   a->copyDiffuse(ca);
+   b->copyDiffuse(cb);
+   if (memcmp(ca, cb, sizeof(float) * 3) != 0)
+      return false;
+   a->copyAmbient(ca);
+   b->copyAmbient(cb);
+   if (memcmp(ca, cb, sizeof(float) * 3) != 0)
+      return false;
+   a->copySpecular(ca);
+   b->copySpecular(cb);
+   if (memcmp(ca, cb, sizeof(float) * 3) != 0)
+      return false;
+
+   return true;
+}
+
+/* PMDModel::buildRenderCommand: build render command list from material order, merging neighboring materials of the same state */
+void PMDModel::buildRenderCommand()
+{
+   unsigned int i;
+   PMDMaterial *m, *head = NULL;
+   PMDRenderCommand *cmd = NULL;
+
+   m_numRenderCommand = 0;
+   for (i = 0; i < m_numMaterial; i++) {
+      m = &(m_material[m_materialRenderOrder[i]]);
+      /* surfaces of a material following the previous one in the element buffer can be drawn together */
+      if (cmd != NULL && cmd->surfaceIndex + cmd->numSurface == m->getSurfaceListIndex() && PMDModel_isSameMaterialState(head, m)) {
+         cmd->numSurface += m->getNumSurface();
+         cmd->numMaterial++;
+         continue;
+      }
+      cmd = &(m_renderCommand[m_numRenderCommand++]);
+      cmd->material = m_materialRenderOrder[i];
+      cmd->surfaceIndex = m->getSurfaceListIndex();
+      cmd->numSurface = m->getNumSurface();
+      cmd->orderIndex = i;
+      cmd->numMaterial = 1;
+      head = m;
+   }
+   m_renderCommandRequired = false;
+}
+
 /* PMDModel::renderModel: render the model */
 /* needs multi-texture function on OpenGL: */
 /* texture unit 0: model texture */
@@ -65,18 +262,23 @@
 /* texture unit 2: additional sphere map texture, if exist */
 void PMDModel::renderModel(bool renderEdgeFlag)
 {
-   unsigned int i;
+   unsigned int i, j;
    float c[4];
    PMDMaterial *m;
    float modelAlpha;
    unsigned int numSurface;
    unsigned int surfaceOffset;
+   unsigned int drawIndex, drawNum;
    bool drawEdge;
+   bool lod;
    float *col;
+   float edgeColor[4];
 
    if (!m_vertexList) return;
    if (!m_showFlag) return;
 
+   lod = (m_detailLevel == PMDMODEL_DETAIL_LOW && m_vboBufElementLOD != 0);
+
 #ifndef MMDFILES_CONVERTCOORDINATESYSTEM
    glPushMatrix();
    glScalef(1.0f, 1.0f, -1.0f); /* from left-hand to right-hand */
@@ -103,24 +305,34 @@ void PMDModel::renderModel(bool renderEdgeFlag)
       glClientActiveTexture(GL_TEXTURE0);
    }
 
-   /* set main buffer */
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
-
-   /* set lists */
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glEnableClientState(GL_NORMAL_ARRAY);
-   glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
-   glNormalPointer(GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetNormal);
-   if (m_toon) {
-      /* set toon texture coordinates to texture unit 1 */
-      if (!m_selfShadowDrawing) {
+   if (m_gpuSkinning) {
+      /* skinning, lighting and toon coordinates are computed in vertex shader */
+      beginGPUSkinning(PMDMODEL_GPUSKINNING_LIGHTING);
+      if (m_toon && !m_selfShadowDrawing) {
          glActiveTexture(GL_TEXTURE1);
          glEnable(GL_TEXTURE_2D);
-         glClientActiveTexture(GL_TEXTURE1);
-         glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-         glTexCoordPointer(2, GL_FLOAT, 0, (const GLvoid *)(uintptr_t)m_vboOffsetToon);
          glActiveTexture(GL_TEXTURE0);
-         glClientActiveTexture(GL_TEXTURE0);
+      }
+   } else {
+      /* set main buffer */
+      glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+
+      /* set lists */
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glEnableClientState(GL_NORMAL_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
+      glNormalPointer(GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetNormal);
+      if (m_toon) {
+         /* set toon texture coordinates to texture unit 1 */
+         if (!m_selfShadowDrawing) {
+            glActiveTexture(GL_TEXTURE1);
+            glEnable(GL_TEXTURE_2D);
+            glClientActiveTexture(GL_TEXTURE1);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(2, GL_FLOAT, 0, (const GLvoid *)(uintptr_t)m_vboOffsetToon);
+            glActiveTexture(GL_TEXTURE0);
+            glClientActiveTexture(GL_TEXTURE0);
+         }
       }
    }
 #ifndef MMDFILES_DONTUSESPHEREMAP
@@ -147,12 +359,34 @@ void PMDModel::renderModel(bool renderEdgeFlag)
    /* calculate alpha value, applying model global alpha */
    modelAlpha = m_globalAlpha;
 
-   /* set element buffer */
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElement);
-
-   /* render per material */
-   for (i = 0; i < m_numMaterial; i++) {
-      m = &(m_material[m_materialRenderOrder[i]]);
+   /* set element buffer, simplified one at low detail */
+   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lod ? m_vboBufElementLOD : m_vboBufElement);
+
+   /* rebuild render commands when material order or material parameters have been changed */
+   if (m_renderCommandRequired)
+      buildRenderCommand();
+
+   /* render per command, skipping redundant state changes */
+   PMDModel_resetRenderState();
+   g_renderState.activeTexture = GL_TEXTURE0;
+   for (i = 0; i < m_numRenderCommand; i++) {
+      /* skip when all merged materials are outside of view frustum */
+      if (m_materialCulled) {
+         for (j = 0; j < m_renderCommand[i].numMaterial; j++)
+            if (m_materialCulled[m_materialRenderOrder[m_renderCommand[i].orderIndex + j]] == false)
+               break;
+         if (j == m_renderCommand[i].numMaterial)
+            continue;
+      }
+      m = &(m_material[m_renderCommand[i].material]);
+      /* surface range of this command, merged materials are also neighboring in the simplified list */
+      if (lod) {
+         drawIndex = m_lodSurfaceHead[m_renderCommand[i].material];
+         drawNum = m_lodSurfaceHead[m_renderCommand[i].material + m_renderCommand[i].numMaterial] - drawIndex;
+      } else {
+         drawIndex = m_renderCommand[i].surfaceIndex;
+         drawNum = m_renderCommand[i].numSurface;
+      }
       /* set colors */
       c[3] = m->getAlpha() * modelAlpha;
       if (c[3] >= 0.98f) c[3] = 1.0f; /* clamp to 1.0 */
@@ -169,89 +403,76 @@ void PMDModel::renderModel(bool renderEdgeFlag)
       if (m_toon) {
          /* use averaged color of diffuse and ambient for both */
          m->copyAvgcol(c);
-         glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE, &(c[0]));
+         PMDModel_setMaterialColor(0, GL_AMBIENT_AND_DIFFUSE, c);
          m->copySpecular(c);
-         glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, &(c[0]));
+         PMDModel_setMaterialColor(2, GL_SPECULAR, c);
       } else {
          /* use each color */
          m->copyDiffuse(c);
-         glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, &(c[0]));
+         PMDModel_setMaterialColor(0, GL_DIFFUSE, c);
          m->copyAmbient(c);
-         glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, &(c[0]));
+         PMDModel_setMaterialColor(1, GL_AMBIENT, c);
          m->copySpecular(c);
-         glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, &(c[0]));
+         PMDModel_setMaterialColor(2, GL_SPECULAR, c);
       }
-      glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, m->getShiness());
+      PMDModel_setShininess(m->getShiness());
 
       /* disable face culling for drawing both sides */
-      if (m->getFaceFlag())
-         glDisable(GL_CULL_FACE);
-      else
-         glEnable(GL_CULL_FACE);
-
-      /* if using multiple texture units, set current unit to 0 */
-      if (m_toon || m_hasMultipleSphereMap)
-         glActiveTexture(GL_TEXTURE0);
+      PMDModel_setCullFace(m->getFaceFlag() == false);
 
 #ifdef MY_LUMINOUS
       if (m_luminousMode == PMDMODEL_LUMINOUS_OFF) {
-         glDisable(GL_TEXTURE_2D);
-         glDrawElements(GL_TRIANGLES, m->getNumSurface(), GL_INDICES, (const GLvoid *)(sizeof(INDICES) * m->getSurfaceListIndex()));
+         PMDModel_setTexture2D(0, false);
+         if (drawNum > 0) {
+            glDrawElements(GL_TRIANGLES, drawNum, GL_INDICES, (const GLvoid *)(sizeof(INDICES) * drawIndex));
+            g_renderState.numDrawCall++;
+         }
          continue;
       }
 #endif
 
       if (m->getTexture()) {
          /* bind model texture */
-         glEnable(GL_TEXTURE_2D);
-         glBindTexture(GL_TEXTURE_2D, m->getTexture()->getID());
+         PMDModel_setTexture2D(0, true);
+         PMDModel_bindTexture(0, m->getTexture()->getID());
 #ifndef MMDFILES_DONTUSESPHEREMAP
          if (m_hasSingleSphereMap) {
             if (m->getTexture()->isSphereMap()) {
                /* this is sphere map */
                /* enable texture coordinate generation */
-               if (m->getTexture()->isSphereMapAdd())
-                  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD);
-               glEnable(GL_TEXTURE_GEN_S);
-               glEnable(GL_TEXTURE_GEN_T);
+               PMDModel_setTexEnvMode(0, m->getTexture()->isSphereMapAdd() ? GL_ADD : GL_MODULATE);
+               PMDModel_setTexGen(0, true);
             } else {
                /* disable generation */
-               glDisable(GL_TEXTURE_GEN_S);
-               glDisable(GL_TEXTURE_GEN_T);
+               PMDModel_setTexEnvMode(0, GL_MODULATE);
+               PMDModel_setTexGen(0, false);
             }
+         } else {
+            PMDModel_setTexEnvMode(0, GL_MODULATE);
          }
+#else
+         PMDModel_setTexEnvMode(0, GL_MODULATE);
 #endif /* !MMDFILES_DONTUSESPHEREMAP */
-#if 0
-         /* per-texture-unit blending */
-         GLfloat blend[4];
-         m->copyTextureBase(blend);
-         glTexEnvfv(GL_TEXTURE_ENV, GL_TEXTURE_ENV_COLOR, blend);
-         glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_CONSTANT);
-         glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE1_RGB, GL_TEXTURE);
-         glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
-         glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_MODULATE);
-#endif
       } else {
-         glDisable(GL_TEXTURE_2D);
+         PMDModel_setTexture2D(0, false);
       }
 
       if (m_toon) {
          /* set toon texture for texture unit 1 */
-         glActiveTexture(GL_TEXTURE1);
          if (m_selfShadowDrawing) {
             if (m->getShadowMapRenderFlag() == false) {
                /* this material disables shadow map rendering, no shadow rendering */
-               glBindTexture(GL_TEXTURE_2D, m_toonTextureID[0]);
+               PMDModel_bindTexture(1, m_toonTextureID[0]);
             } else {
                /* this material enables shadow map rendering */
                if (m->getToonID() == 0)
                   /* no toonmap, apply toon01.bmp to force shadow map rendering */
-                  glBindTexture(GL_TEXTURE_2D, m_toonTextureID[1]);
+                  PMDModel_bindTexture(1, m_toonTextureID[1]);
                else
-                  glBindTexture(GL_TEXTURE_2D, m_toonTextureID[m->getToonID()]);
+                  PMDModel_bindTexture(1, m_toonTextureID[m->getToonID()]);
             }
          } else {
-            glBindTexture(GL_TEXTURE_2D, m_toonTextureID[m->getToonID()]);
+            PMDModel_bindTexture(1, m_toonTextureID[m->getToonID()]);
          }
       }
 
@@ -259,34 +480,42 @@ void PMDModel::renderModel(bool renderEdgeFlag)
       if (m_hasMultipleSphereMap) {
          if (m->getAdditionalTexture()) {
             /* this material has additional sphere map texture, bind it at texture unit 2 */
-            glActiveTexture(GL_TEXTURE2);
-            glEnable(GL_TEXTURE_2D);
-            if (m->getAdditionalTexture()->isSphereMapAdd())
-               glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD);
-            else
-               glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-            glBindTexture(GL_TEXTURE_2D, m->getAdditionalTexture()->getID());
-            glEnable(GL_TEXTURE_GEN_S);
-            glEnable(GL_TEXTURE_GEN_T);
+            PMDModel_setTexture2D(2, true);
+            PMDModel_setTexEnvMode(2, m->getAdditionalTexture()->isSphereMapAdd() ? GL_ADD : GL_MODULATE);
+            PMDModel_bindTexture(2, m->getAdditionalTexture()->getID());
+            PMDModel_setTexGen(2, true);
          } else {
             /* disable generation */
-            glActiveTexture(GL_TEXTURE2);
-            glDisable(GL_TEXTURE_2D);
+            PMDModel_setTexture2D(2, false);
+         }
+      }
+
+      /* texture coordinate generation is not applied to vertex shader, let it compute sphere map coordinates */
+      if (m_gpuSkinning) {
+         int s0 = (m_hasSingleSphereMap && m->getTexture() && m->getTexture()->isSphereMap()) ? 1 : 0;
+         int s2 = (m_hasMultipleSphereMap && m->getAdditionalTexture()) ? 1 : 0;
+         if (g_renderState.sphereMap[0] != s0 || g_renderState.sphereMap[1] != s2) {
+            setGPUSkinningSphereMap(s0 == 1, s2 == 1);
+            g_renderState.sphereMap[0] = s0;
+            g_renderState.sphereMap[1] = s2;
+            g_renderState.numStateChange++;
          }
       }
 #endif /* !MMDFILES_DONTUSESPHEREMAP */
 
       /* draw elements */
-      glDrawElements(GL_TRIANGLES, m->getNumSurface(), GL_INDICES, (const GLvoid *) (sizeof(INDICES) * m->getSurfaceListIndex()));
-
-      /* reset some parameters */
-      if (m->getTexture() && m->getTexture()->isSphereMap() && m->getTexture()->isSphereMapAdd()) {
-         if (m_toon)
-            glActiveTexture(GL_TEXTURE0);
-         glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+      if (drawNum > 0) {
+         glDrawElements(GL_TRIANGLES, drawNum, GL_INDICES, (const GLvoid *) (sizeof(INDICES) * drawIndex));
+         g_renderState.numDrawCall++;
       }
    }
 
+   /* reset some parameters */
+   if (g_renderState.texEnvMode[0] == GL_ADD)
+      PMDModel_setTexEnvMode(0, GL_MODULATE);
+   PMDModel_setActiveTexture(0);
+   MMDFiles_addRenderStatistics(g_renderState.numDrawCall, g_renderState.numStateChange);
+
    glDisableClientState(GL_NORMAL_ARRAY);
    if (m_toon) {
       glClientActiveTexture(GL_TEXTURE0);
@@ -353,6 +582,8 @@ void PMDModel::renderModel(bool renderEdgeFlag)
    glDisableClientState(GL_VERTEX_ARRAY);
 #ifdef MY_LUMINOUS
    if (m_luminousMode == PMDMODEL_LUMINOUS_OFF) {
+      if (m_gpuSkinning)
+         endGPUSkinning();
       /* unbind buffer */
       glBindBuffer(GL_ARRAY_BUFFER, 0);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -361,6 +592,8 @@ void PMDModel::renderModel(bool renderEdgeFlag)
 #endif
 
    if (renderEdgeFlag == false) {
+      if (m_gpuSkinning)
+         endGPUSkinning();
       /* unbind buffer */
       glBindBuffer(GL_ARRAY_BUFFER, 0);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -387,6 +620,9 @@ void PMDModel::renderModel(bool renderEdgeFlag)
       numSurface = m_numSurfaceForEdge;
       surfaceOffset = m_vboOffsetSurfaceForEdge;
    }
+   /* edge is skipped below full detail, edge vertices are not updated */
+   if (m_detailLevel != PMDMODEL_DETAIL_FULL)
+      drawEdge = false;
 
    if (drawEdge) {
 
@@ -401,26 +637,52 @@ void PMDModel::renderModel(bool renderEdgeFlag)
 
       if (m_forceEdge || m_hasExtParam == false) {
          glDisable(GL_LIGHTING);
-         glEnableClientState(GL_VERTEX_ARRAY);
          glColor4f(m_edgeColor[0], m_edgeColor[1], m_edgeColor[2], m_edgeColor[3] * modelAlpha);
-         glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetEdge);
+         if (m_gpuSkinning) {
+            setGPUSkinningMode(PMDMODEL_GPUSKINNING_EDGE);
+         } else {
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetEdge);
+         }
          glDrawElements(GL_TRIANGLES, numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL + surfaceOffset));
+         MMDFiles_addRenderStatistics(1, 0);
          glEnable(GL_LIGHTING);
       } else {
          glDisable(GL_LIGHTING);
-         glEnableClientState(GL_VERTEX_ARRAY);
-         glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetEdge);
-         for (i = 0; i < m_numMaterial; i++) {
-            if (m_material[i].getEdgeFlag()) {
+         if (m_gpuSkinning) {
+            setGPUSkinningMode(PMDMODEL_GPUSKINNING_EDGE);
+         } else {
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetEdge);
+         }
+         /* edge surfaces are packed in material order, so neighboring materials of the same edge color are drawn at once */
+         numSurface = 0;
+         for (i = 0; i <= m_numMaterial; i++) {
+            if (i < m_numMaterial) {
+               if (m_material[i].getEdgeFlag() == false)
+                  continue;
                col = m_material[i].getExtEdgeColor();
-               if (col) {
-                  glColor4f(col[0], col[1], col[2], col[3] * modelAlpha);
+               if (col == NULL)
+                  col = m_edgeColor;
+               c[0] = col[0];
+               c[1] = col[1];
+               c[2] = col[2];
+               c[3] = col[3] * modelAlpha;
+               if (numSurface == 0 || memcmp(c, edgeColor, sizeof(float) * 4) == 0) {
+                  memcpy(edgeColor, c, sizeof(float) * 4);
+                  numSurface += m_material[i].getNumSurface();
+                  continue;
                }
-               else {
-                  glColor4f(m_edgeColor[0], m_edgeColor[1], m_edgeColor[2], m_edgeColor[3] * modelAlpha);
-               }
-               glDrawElements(GL_TRIANGLES, m_material[i].getNumSurface(), GL_INDICES, (const GLvoid *)((GLubyte *)NULL + surfaceOffset));
-               surfaceOffset += sizeof(INDICES) * m_material[i].getNumSurface();
+            }
+            if (numSurface > 0) {
+               glColor4fv(edgeColor);
+               glDrawElements(GL_TRIANGLES, numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL + surfaceOffset));
+               MMDFiles_addRenderStatistics(1, 1);
+               surfaceOffset += sizeof(INDICES) * numSurface;
+            }
+            if (i < m_numMaterial) {
+               memcpy(edgeColor, c, sizeof(float) * 4);
+               numSurface = m_material[i].getNumSurface();
             }
          }
          glEnable(GL_LIGHTING);
@@ -436,6 +698,8 @@ void PMDModel::renderModel(bool renderEdgeFlag)
    }
 
    glDisableClientState(GL_VERTEX_ARRAY);
+   if (m_gpuSkinning)
+      endGPUSkinning();
 
    /* unbind buffer */
    glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -450,12 +714,25 @@ void PMDModel::renderForPlain()
    if (!m_showFlag) return;
 
    glDisable(GL_CULL_FACE);
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElement);
-   glDrawElements(GL_TRIANGLES, m_numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL));
-   glDisableClientState(GL_VERTEX_ARRAY);
+   if (m_gpuSkinning) {
+      beginGPUSkinning(PMDMODEL_GPUSKINNING_PLAIN);
+   } else {
+      glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
+   }
+   if (m_detailLevel == PMDMODEL_DETAIL_LOW && m_vboBufElementLOD != 0) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElementLOD);
+      renderLODSurface(PMDMODEL_LODSURFACE_ALL);
+   } else {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElement);
+      glDrawElements(GL_TRIANGLES, m_numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL));
+      MMDFiles_addRenderStatistics(1, 0);
+   }
+   if (m_gpuSkinning)
+      endGPUSkinning();
+   else
+      glDisableClientState(GL_VERTEX_ARRAY);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
    glEnable(GL_CULL_FACE);
@@ -482,12 +759,25 @@ void PMDModel::renderForShadow()
    if (numSurface == 0) return;
 
    glDisable(GL_CULL_FACE);
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
-   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElement);
-   glDrawElements(GL_TRIANGLES, numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL + surfaceOffset));
-   glDisableClientState(GL_VERTEX_ARRAY);
+   if (m_gpuSkinning) {
+      beginGPUSkinning(PMDMODEL_GPUSKINNING_PLAIN);
+   } else {
+      glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
+   }
+   if (m_detailLevel == PMDMODEL_DETAIL_LOW && m_vboBufElementLOD != 0) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElementLOD);
+      renderLODSurface(m_hasExtParam ? PMDMODEL_LODSURFACE_SHADOW : PMDMODEL_LODSURFACE_EDGE);
+   } else {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElement);
+      glDrawElements(GL_TRIANGLES, numSurface, GL_INDICES, (const GLvoid *)((GLubyte *)NULL + surfaceOffset));
+      MMDFiles_addRenderStatistics(1, 0);
+   }
+   if (m_gpuSkinning)
+      endGPUSkinning();
+   else
+      glDisableClientState(GL_VERTEX_ARRAY);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
    glEnable(GL_CULL_FACE);
@@ -523,11 +813,24 @@ void PMDModel::renderForShadowMap()
    }
 
    glDisable(GL_CULL_FACE);
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
-   glEnableClientState(GL_VERTEX_ARRAY);
-   glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
-   glDrawElements(GL_TRIANGLES, m_numSurfaceForShadowMap, GL_INDICES, (const GLvoid *)0);
-   glDisableClientState(GL_VERTEX_ARRAY);
+   if (m_gpuSkinning) {
+      beginGPUSkinning(PMDMODEL_GPUSKINNING_PLAIN);
+   } else {
+      glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(btVector3), (const GLvoid *)(uintptr_t)m_vboOffsetVertex);
+   }
+   if (m_detailLevel == PMDMODEL_DETAIL_LOW && m_vboBufElementLOD != 0) {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_vboBufElementLOD);
+      renderLODSurface(PMDMODEL_LODSURFACE_SHADOWMAP);
+   } else {
+      glDrawElements(GL_TRIANGLES, m_numSurfaceForShadowMap, GL_INDICES, (const GLvoid *)0);
+      MMDFiles_addRenderStatistics(1, 0);
+   }
+   if (m_gpuSkinning)
+      endGPUSkinning();
+   else
+      glDisableClientState(GL_VERTEX_ARRAY);
    glBindBuffer(GL_ARRAY_BUFFER, 0);
    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
    glEnable(GL_CULL_FACE);
@@ -0,0 +1,505 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include <stddef.h>
+#include "MMDFiles.h"
+
+/* vertex shader for skinning on GPU */
+/* skinning, toon coordinates and edge extrusion are computed here, and the per-vertex lighting */
+/* and texture coordinate generation of the fixed-function pipeline are reproduced so that */
+/* the fixed-function fragment stage (glMaterial, glTexEnv, toon and shadow map textures) can be kept */
+static const char *skinningVertexShaderSource = R"glsl(
+#version 120
+
+uniform sampler2D boneTexture;  /* 4 texels per bone: 3 rows of skinning matrix and global rotation */
+uniform float numBone;
+uniform int mode;               /* 0: lighting, 1: edge, 2: plain */
+uniform vec3 toonLight;
+uniform bool lightEdge;
+uniform bool selfShadow;
+uniform bool sphereMap0;
+uniform bool sphereMap2;
+
+attribute vec4 skinPosition;    /* xyz: morphed position, w: edge width */
+attribute vec4 skinNormal;      /* xyz: normal, w: deform type (0: BDEF2, 1: BDEF4, 2: SDEF) */
+attribute vec4 skinBoneIndex;
+attribute vec4 skinBoneWeight;
+attribute vec3 skinSdefC;
+attribute vec3 skinSdefCR0;
+attribute vec3 skinSdefCR1;
+
+vec4 boneTexel(float bone, float col)
+{
+   return texture2DLod(boneTexture, vec2((col + 0.5) / 4.0, (bone + 0.5) / numBone), 0.0);
+}
+
+vec3 bonePosition(float bone, vec3 p)
+{
+   vec4 v = vec4(p, 1.0);
+   return vec3(dot(boneTexel(bone, 0.0), v), dot(boneTexel(bone, 1.0), v), dot(boneTexel(bone, 2.0), v));
+}
+
+vec3 boneNormal(float bone, vec3 n)
+{
+   return vec3(dot(boneTexel(bone, 0.0).xyz, n), dot(boneTexel(bone, 1.0).xyz, n), dot(boneTexel(bone, 2.0).xyz, n));
+}
+
+vec4 slerp(vec4 a, vec4 b, float t)
+{
+   float c = dot(a, b);
+   float s, th;
+   if (c > 0.9995)
+      return normalize(mix(a, b, t));
+   th = acos(c);
+   s = sin(th);
+   return (a * sin((1.0 - t) * th) + b * sin(t * th)) / s;
+}
+
+vec3 rotate(vec4 q, vec3 v)
+{
+   return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec2 sphereCoord(vec3 u, vec3 n)
+{
+   vec3 r = reflect(u, n);
+   float m = 2.0 * sqrt(r.x * r.x + r.y * r.y + (r.z + 1.0) * (r.z + 1.0));
+   return vec2(r.x / m + 0.5, r.y / m + 0.5);
+}
+
+void main()
+{
+   vec3 p = skinPosition.xyz;
+   vec3 v, n;
+   float w = skinBoneWeight.x;
+   float toon, r, ndotl;
+   vec4 ecPos, col, spec;
+   vec3 ecNormal, l;
+
+   /* skinning */
+   if (skinNormal.w > 1.5) {
+      /* SDEF */
+      vec4 r1 = boneTexel(skinBoneIndex.x, 3.0);
+      vec4 r2 = boneTexel(skinBoneIndex.y, 3.0);
+      if (dot(r2, r1) < 0.0)
+         r2 = -r2;
+      v = mix(bonePosition(skinBoneIndex.y, skinSdefCR1), bonePosition(skinBoneIndex.x, skinSdefCR0), w);
+      v += rotate(slerp(r2, r1, w), p - skinSdefC);
+      n = mix(boneNormal(skinBoneIndex.y, skinNormal.xyz), boneNormal(skinBoneIndex.x, skinNormal.xyz), w);
+   } else if (skinNormal.w > 0.5) {
+      /* BDEF4 */
+      v = bonePosition(skinBoneIndex.x, p) * skinBoneWeight.x + bonePosition(skinBoneIndex.y, p) * skinBoneWeight.y + bonePosition(skinBoneIndex.z, p) * skinBoneWeight.z + bonePosition(skinBoneIndex.w, p) * skinBoneWeight.w;
+      n = boneNormal(skinBoneIndex.x, skinNormal.xyz) * skinBoneWeight.x + boneNormal(skinBoneIndex.y, skinNormal.xyz) * skinBoneWeight.y + boneNormal(skinBoneIndex.z, skinNormal.xyz) * skinBoneWeight.z + boneNormal(skinBoneIndex.w, skinNormal.xyz) * skinBoneWeight.w;
+   } else {
+      /* BDEF2 */
+      v = mix(bonePosition(skinBoneIndex.y, p), bonePosition(skinBoneIndex.x, p), w);
+      n = mix(boneNormal(skinBoneIndex.y, skinNormal.xyz), boneNormal(skinBoneIndex.x, skinNormal.xyz), w);
+   }
+
+   /* toon coordinate */
+   toon = (1.0 - dot(toonLight, n)) * 0.5;
+
+   /* edge extrusion */
+   if (mode == 1) {
+      r = skinPosition.w;
+      if (lightEdge)
+         r *= toon * 1.5 + 0.2;
+      v += n * r;
+   }
+
+   ecPos = gl_ModelViewMatrix * vec4(v, 1.0);
+   gl_Position = gl_ModelViewProjectionMatrix * vec4(v, 1.0);
+   gl_ClipVertex = ecPos;
+
+   /* texture coordinates for shadow mapping on texture unit 3 */
+   gl_TexCoord[3] = gl_TextureMatrix[3] * vec4(dot(ecPos, gl_EyePlaneS[3]), dot(ecPos, gl_EyePlaneT[3]), dot(ecPos, gl_EyePlaneR[3]), dot(ecPos, gl_EyePlaneQ[3]));
+
+   if (mode != 0) {
+      gl_FrontColor = gl_Color;
+      gl_BackColor = gl_Color;
+      return;
+   }
+
+   /* lighting by light 0 */
+   ecNormal = normalize(gl_NormalMatrix * n);
+   if (gl_LightSource[0].position.w == 0.0)
+      l = normalize(gl_LightSource[0].position.xyz);
+   else
+      l = normalize(gl_LightSource[0].position.xyz - ecPos.xyz);
+   ndotl = max(dot(ecNormal, l), 0.0);
+   col = gl_FrontLightModelProduct.sceneColor + gl_FrontLightProduct[0].ambient + gl_FrontLightProduct[0].diffuse * ndotl;
+   if (ndotl > 0.0) {
+      spec = gl_FrontLightProduct[0].specular * pow(max(dot(ecNormal, normalize(l + vec3(0.0, 0.0, 1.0))), 0.0), gl_FrontMaterial.shininess);
+      col += spec;
+   }
+   col.a = gl_FrontMaterial.diffuse.a;
+   gl_FrontColor = col;
+   gl_BackColor = col;
+
+   /* model texture or sphere map on texture unit 0 */
+   if (sphereMap0)
+      gl_TexCoord[0] = vec4(sphereCoord(normalize(ecPos.xyz), ecNormal), 0.0, 1.0);
+   else
+      gl_TexCoord[0] = gl_MultiTexCoord0;
+
+   /* toon texture on texture unit 1 */
+   if (selfShadow)
+      gl_TexCoord[1] = gl_MultiTexCoord1;
+   else
+      gl_TexCoord[1] = vec4(0.0, toon, 0.0, 1.0);
+
+   /* additional sphere map on texture unit 2 */
+   if (sphereMap2)
+      gl_TexCoord[2] = vec4(sphereCoord(normalize(ecPos.xyz), ecNormal), 0.0, 1.0);
+   else
+      gl_TexCoord[2] = vec4(0.0, 0.0, 0.0, 1.0);
+}
+)glsl";
+
+/* skinning shader program and locations, shared by all models */
+typedef struct {
+   bool tried;
+   GLuint program;
+   GLint boneTexture;
+   GLint numBone;
+   GLint mode;
+   GLint toonLight;
+   GLint lightEdge;
+   GLint selfShadow;
+   GLint sphereMap0;
+   GLint sphereMap2;
+   GLint position;
+   GLint normal;
+   GLint boneIndex;
+   GLint boneWeight;
+   GLint sdefC;
+   GLint sdefCR0;
+   GLint sdefCR1;
+} PMDModelSkinningShader;
+
+static PMDModelSkinningShader g_skinningShader = { false, 0 };
+
+/* loadSkinningShader: compile and link skinning shader program at first call, return false if not available */
+static bool loadSkinningShader()
+{
+   PMDModelSkinningShader *s = &g_skinningShader;
+   GLuint vertexShader, program;
+   GLint result = GL_FALSE;
+
+   if (s->tried)
+      return s->program != 0;
+   s->tried = true;
+
+#if defined(__ANDROID__) || TARGET_OS_IPHONE
+   /* OpenGL ES has no fixed-function built-ins */
+   return false;
+#else
+   if (!GLEW_VERSION_2_0 || !(GLEW_VERSION_3_0 || GLEW_ARB_texture_float))
+      return false;
+
+   vertexShader = glCreateShader(GL_VERTEX_SHADER);
+   glShaderSource(vertexShader, 1, &skinningVertexShaderSource, NULL);
+   glCompileShader(vertexShader);
+   glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &result);
+   if (!result) {
+      glDeleteShader(vertexShader);
+      return false;
+   }
+
+   /* fragment stage is left to the fixed-function pipeline */
+   program = glCreateProgram();
+   glAttachShader(program, vertexShader);
+   /* position should be at attribute 0 which aliases gl_Vertex */
+   glBindAttribLocation(program, 0, "skinPosition");
+   glLinkProgram(program);
+   glDetachShader(program, vertexShader);
+   glDeleteShader(vertexShader);
+   glGetProgramiv(program, GL_LINK_STATUS, &result);
+   if (!result) {
+      glDeleteProgram(program);
+      return false;
+   }
+
+   s->boneTexture = glGetUniformLocation(program, "boneTexture");
+   s->numBone = glGetUniformLocation(program, "numBone");
+   s->mode = glGetUniformLocation(program, "mode");
+   s->toonLight = glGetUniformLocation(program, "toonLight");
+   s->lightEdge = glGetUniformLocation(program, "lightEdge");
+   s->selfShadow = glGetUniformLocation(program, "selfShadow");
+   s->sphereMap0 = glGetUniformLocation(program, "sphereMap0");
+   s->sphereMap2 = glGetUniformLocation(program, "sphereMap2");
+   s->position = glGetAttribLocation(program, "skinPosition");
+   s->normal = glGetAttribLocation(program, "skinNormal");
+   s->boneIndex = glGetAttribLocation(program, "skinBoneIndex");
+   s->boneWeight = glGetAttribLocation(program, "skinBoneWeight");
+   s->sdefC = glGetAttribLocation(program, "skinSdefC");
+   s->sdefCR0 = glGetAttribLocation(program, "skinSdefCR0");
+   s->sdefCR1 = glGetAttribLocation(program, "skinSdefCR1");
+   if (s->position < 0 || s->normal < 0 || s->boneIndex < 0 || s->boneWeight < 0) {
+      glDeleteProgram(program);
+      return false;
+   }
+
+   s->program = program;
+   return true;
+#endif /* __ANDROID__ || TARGET_OS_IPHONE */
+}
+
+/* PMDModel::setupGPUSkinning: set up buffers for skinning on GPU, return false if not available */
+bool PMDModel::setupGPUSkinning()
+{
+   unsigned int j;
+   GLint maxTextureSize = 0;
+   PMDModelSkinningVertex *data;
+   float *morph;
+
+   if (loadSkinningShader() == false)
+      return false;
+   if (m_numVertex == 0 || m_numBone == 0 || m_vboBufData == NULL)
+      return false;
+   glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+   if (m_numBone > maxTextureSize)
+      return false;
+
+   /* static per-vertex data: normal, deform type, bone indices, weights and SDEF parameters */
+   data = (PMDModelSkinningVertex *)malloc(sizeof(PMDModelSkinningVertex) * m_numVertex);
+   if (data == NULL)
+      return false;
+   memset(data, 0, sizeof(PMDModelSkinningVertex) * m_numVertex);
+   for (j = 0; j < m_numVertex; j++) {
+      data[j].normal[0] = m_normalList[j].x();
+      data[j].normal[1] = m_normalList[j].y();
+      data[j].normal[2] = m_normalList[j].z();
+      data[j].boneIndex[0] = m_bone1List[j];
+      data[j].boneIndex[1] = m_bone2List[j];
+      data[j].boneWeight[0] = m_boneWeight1[j];
+      data[j].boneWeight[1] = 1.0f - m_boneWeight1[j];
+#ifdef MY_EXTRADEFORMATION
+      if (m_bone3List != NULL) {
+         if (m_bone3List[j] >= 0) {
+            /* BDEF4 */
+            data[j].normal[3] = 1.0f;
+            data[j].boneIndex[2] = m_bone3List[j];
+            data[j].boneIndex[3] = m_bone4List[j];
+            data[j].boneWeight[1] = m_boneWeight2[j];
+            data[j].boneWeight[2] = m_boneWeight3[j];
+            data[j].boneWeight[3] = m_boneWeight4[j];
+         } else if (m_bone3List[j] == -2) {
+            /* SDEF */
+            data[j].normal[3] = 2.0f;
+            data[j].sdefC[0] = m_sdefC[j].x();
+            data[j].sdefC[1] = m_sdefC[j].y();
+            data[j].sdefC[2] = m_sdefC[j].z();
+            data[j].sdefCR0[0] = m_sdefCR0[j].x();
+            data[j].sdefCR0[1] = m_sdefCR0[j].y();
+            data[j].sdefCR0[2] = m_sdefCR0[j].z();
+            data[j].sdefCR1[0] = m_sdefCR1[j].x();
+            data[j].sdefCR1[1] = m_sdefCR1[j].y();
+            data[j].sdefCR1[2] = m_sdefCR1[j].z();
+         }
+      }
+#endif /* MY_EXTRADEFORMATION */
+   }
+   glGenBuffers(1, &m_vboBufSkinning);
+   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufSkinning);
+   glBufferData(GL_ARRAY_BUFFER, sizeof(PMDModelSkinningVertex) * m_numVertex, data, GL_STATIC_DRAW);
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   free(data);
+
+   /* bone matrices as float texture */
+   m_boneTextureData = (float *)malloc(sizeof(float) * 16 * m_numBone);
+   if (m_boneTextureData == NULL) {
+      clearGPUSkinning();
+      return false;
+   }
+   memset(m_boneTextureData, 0, sizeof(float) * 16 * m_numBone);
+   glGenTextures(1, &m_boneTextureID);
+   glBindTexture(GL_TEXTURE_2D, m_boneTextureID);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, 4, m_numBone, 0, GL_RGBA, GL_FLOAT, m_boneTextureData);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   /* the dynamic buffer now holds only morphed position and edge width per vertex */
+   morph = (float *)m_vboBufData;
+   for (j = 0; j < m_numVertex; j++) {
+      morph[j * 4] = m_vertexList[j].x();
+      morph[j * 4 + 1] = m_vertexList[j].y();
+      morph[j * 4 + 2] = m_vertexList[j].z();
+      morph[j * 4 + 3] = m_edgeWidth[j];
+   }
+
+   m_gpuSkinning = true;
+   m_skinUpdated = true;
+   m_boneTextureUpdated = true;
+
+   return true;
+}
+
+/* PMDModel::clearGPUSkinning: free buffers for skinning on GPU */
+void PMDModel::clearGPUSkinning()
+{
+   if (m_vboBufSkinning != 0)
+      glDeleteBuffers(1, &m_vboBufSkinning);
+   if (m_boneTextureID != 0)
+      glDeleteTextures(1, &m_boneTextureID);
+   if (m_boneTextureData)
+      free(m_boneTextureData);
+   m_gpuSkinning = false;
+   m_vboBufSkinning = 0;
+   m_boneTextureID = 0;
+   m_boneTextureData = NULL;
+   m_boneTextureUpdated = false;
+}
+
+/* PMDModel::updateSkinGPU: prepare bone matrices and morphed positions for skinning on GPU, no OpenGL call */
+void PMDModel::updateSkinGPU()
+{
+   unsigned short i;
+   int j, numVertex;
+   float *p, *morph;
+   float e;
+   bool updated;
+   btQuaternion q;
+
+   /* rows of skinning matrix and global rotation for SDEF */
+   for (i = 0; i < m_numBone; i++) {
+      const btMatrix3x3 &basis = m_boneSkinningTrans[i].getBasis();
+      const btVector3 &origin = m_boneSkinningTrans[i].getOrigin();
+      p = &(m_boneTextureData[i * 16]);
+      p[0] = basis[0].x(); p[1] = basis[0].y(); p[2] = basis[0].z(); p[3] = origin.x();
+      p[4] = basis[1].x(); p[5] = basis[1].y(); p[6] = basis[1].z(); p[7] = origin.y();
+      p[8] = basis[2].x(); p[9] = basis[2].y(); p[10] = basis[2].z(); p[11] = origin.z();
+      q = m_boneList[i].getTransform()->getRotation();
+      p[12] = q.x(); p[13] = q.y(); p[14] = q.z(); p[15] = q.w();
+   }
+   m_boneTextureUpdated = true;
+
+   /* morphed position and edge width, marked for upload only when changed */
+   morph = (float *)m_vboBufData;
+   numVertex = (int)m_numVertex;
+   updated = false;
+   for (j = 0; j < numVertex; j++) {
+      p = &(morph[j * 4]);
+      e = m_edgeWidthMorphed ? m_edgeWidthMorphed[j] : m_edgeWidth[j];
+      if (p[0] != m_vertexList[j].x() || p[1] != m_vertexList[j].y() || p[2] != m_vertexList[j].z() || p[3] != e) {
+         p[0] = m_vertexList[j].x();
+         p[1] = m_vertexList[j].y();
+         p[2] = m_vertexList[j].z();
+         p[3] = e;
+         updated = true;
+      }
+   }
+   if (updated)
+      m_skinUpdated = true;
+}
+
+/* PMDModel::uploadBoneTexture: upload bone matrices to texture if updated */
+void PMDModel::uploadBoneTexture()
+{
+   if (m_boneTextureUpdated == false)
+      return;
+   glBindTexture(GL_TEXTURE_2D, m_boneTextureID);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, m_numBone, GL_RGBA, GL_FLOAT, m_boneTextureData);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   m_boneTextureUpdated = false;
+}
+
+/* PMDModel::beginGPUSkinning: bind skinning shader and vertex attributes */
+void PMDModel::beginGPUSkinning(int mode)
+{
+   PMDModelSkinningShader *s = &g_skinningShader;
+
+   glUseProgram(s->program);
+
+   /* bone texture on texture unit 4, other units are used by fixed-function fragment stage */
+   glActiveTexture(GL_TEXTURE4);
+   glBindTexture(GL_TEXTURE_2D, m_boneTextureID);
+   glActiveTexture(GL_TEXTURE0);
+   glUniform1i(s->boneTexture, 4);
+   glUniform1f(s->numBone, (float)m_numBone);
+   glUniform1i(s->mode, mode);
+   glUniform3f(s->toonLight, m_light.x(), m_light.y(), m_light.z());
+   glUniform1i(s->lightEdge, m_lightEdge ? 1 : 0);
+   glUniform1i(s->selfShadow, (m_toon && m_selfShadowDrawing) ? 1 : 0);
+   glUniform1i(s->sphereMap0, 0);
+   glUniform1i(s->sphereMap2, 0);
+
+   /* morphed position from dynamic buffer */
+   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+   glEnableVertexAttribArray(s->position);
+   glVertexAttribPointer(s->position, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 4, (const GLvoid *)0);
+
+   /* skinning parameters from static buffer */
+   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufSkinning);
+   glEnableVertexAttribArray(s->normal);
+   glVertexAttribPointer(s->normal, 4, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, normal));
+   glEnableVertexAttribArray(s->boneIndex);
+   glVertexAttribPointer(s->boneIndex, 4, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, boneIndex));
+   glEnableVertexAttribArray(s->boneWeight);
+   glVertexAttribPointer(s->boneWeight, 4, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, boneWeight));
+   if (s->sdefC >= 0) {
+      glEnableVertexAttribArray(s->sdefC);
+      glVertexAttribPointer(s->sdefC, 3, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, sdefC));
+   }
+   if (s->sdefCR0 >= 0) {
+      glEnableVertexAttribArray(s->sdefCR0);
+      glVertexAttribPointer(s->sdefCR0, 3, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, sdefCR0));
+   }
+   if (s->sdefCR1 >= 0) {
+      glEnableVertexAttribArray(s->sdefCR1);
+      glVertexAttribPointer(s->sdefCR1, 3, GL_FLOAT, GL_FALSE, sizeof(PMDModelSkinningVertex), (const GLvoid *)offsetof(PMDModelSkinningVertex, sdefCR1));
+   }
+   glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* PMDModel::setGPUSkinningMode: change shader mode while skinning shader is bound */
+void PMDModel::setGPUSkinningMode(int mode)
+{
+   glUniform1i(g_skinningShader.mode, mode);
+}
+
+/* PMDModel::setGPUSkinningSphereMap: set sphere map coordinate generation for texture unit 0 and 2 */
+void PMDModel::setGPUSkinningSphereMap(bool unit0, bool unit2)
+{
+   glUniform1i(g_skinningShader.sphereMap0, unit0 ? 1 : 0);
+   glUniform1i(g_skinningShader.sphereMap2, unit2 ? 1 : 0);
+}
+
+/* PMDModel::endGPUSkinning: unbind skinning shader and vertex attributes */
+void PMDModel::endGPUSkinning()
+{
+   PMDModelSkinningShader *s = &g_skinningShader;
+
+   glDisableVertexAttribArray(s->position);
+   glDisableVertexAttribArray(s->normal);
+   glDisableVertexAttribArray(s->boneIndex);
+   glDisableVertexAttribArray(s->boneWeight);
+   if (s->sdefC >= 0)
+      glDisableVertexAttribArray(s->sdefC);
+   if (s->sdefCR0 >= 0)
+      glDisableVertexAttribArray(s->sdefCR0);
+   if (s->sdefCR1 >= 0)
+      glDisableVertexAttribArray(s->sdefCR1);
+   glActiveTexture(GL_TEXTURE4);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   glActiveTexture(GL_TEXTURE0);
+   glUseProgram(0);
+}
@@ -85,7 +85,7 @@ void PMDModel::resetBone()
 void PMDModel::updateBone(bool afterPhysics)
 {
    unsigned short i;
-   short layer;
+   unsigned int j;
 
    if (m_hasExtBoneParam == false) {
 
@@ -94,8 +94,8 @@ void PMDModel::updateBone(bool afterPhysics)
          return;
 
       /* 1. update bone matrix from current position and rotation */
-      for (i = 0; i < m_numBone; i++)
-         m_orderedBoneList[i]->update();
+      for (j = 0; j < m_numBoneBlock; j++)
+         updateBoneBlock(&(m_boneBlock[j]));
 
       /* 2. solve IK chains */
       if (m_enableSimulation) {
@@ -116,36 +116,10 @@ void PMDModel::updateBone(bool afterPhysics)
    } else {
 
       /* extended style processing: before/after-physics, layered, no special re-order, keep index, bone and IK mixed */
-
-      PMDIK *ik;
-
-      for (layer = 0; layer <= m_maxProcessLayer; layer++) {
-         for (i = 0; i < m_numBone; i++) {
-            if (m_boneList[i].processAfterPhysics() != afterPhysics) continue;
-            if (m_boneList[i].getProcessLayer() != layer) continue;
-            if (afterPhysics == true)
-               m_boneList[i].updateAfterSimulation();
-            else
-               m_boneList[i].update();
-            ik = m_boneList[i].getIK();
-            if (ik) {
-               /* extended style seems to require updates of link bones at each IK call */
-               ik->updateLinkBones();
-               ik->solve();
-            }
-         }
-         /* additionally apply follow-rotate bone with IK target finally */
-         for (i = 0; i < m_numBone; i++) {
-            if (m_boneList[i].processAfterPhysics() != afterPhysics) continue;
-            if (m_boneList[i].getProcessLayer() != layer) continue;
-            if (m_boneList[i].getType() == FOLLOW_ROTATE) {
-               if (afterPhysics == true)
-                  m_boneList[i].updateAfterSimulation();
-               else
-                  m_boneList[i].update();
-            }
-         }
-      }
+      /* blocks are made per layer in the order of bone index, split at IK bones, and followed by follow-rotate bones */
+      for (j = 0; j < m_numBoneBlock; j++)
+         if (m_boneBlock[j].afterPhysics == afterPhysics)
+            updateBoneBlock(&(m_boneBlock[j]));
    }
 }
 
@@ -162,12 +136,106 @@ void PMDModel::updateBoneFromSimulation()
       m_rigidBodyList[i].applyTransformToBone();
 }
 
+/* PMDModel::canCopyPose: return true when this model has the same bones and morphs with the same current values as the given model */
+bool PMDModel::canCopyPose(PMDModel *pmd)
+{
+   unsigned short i;
+
+   if (m_numBone != pmd->m_numBone || m_numIK != pmd->m_numIK || m_numFace != pmd->m_numFace)
+      return false;
+   if (m_numBoneMorph != pmd->m_numBoneMorph || m_numVertexMorph != pmd->m_numVertexMorph || m_numUVMorph != pmd->m_numUVMorph || m_numMaterialMorph != pmd->m_numMaterialMorph || m_numGroupMorph != pmd->m_numGroupMorph)
+      return false;
+   if (m_numBoneBlock != pmd->m_numBoneBlock || m_numRigidBody != pmd->m_numRigidBody)
+      return false;
+   if (m_hasExtBoneParam != pmd->m_hasExtBoneParam || m_enableSimulation != pmd->m_enableSimulation)
+      return false;
+
+   /* bones not controlled by motions and blended bones depend on the current values */
+   for (i = 0; i < m_numBone; i++)
+      if (m_boneList[i].hasSameState(&(pmd->m_boneList[i])) == false)
+         return false;
+   for (i = 0; i < m_numFace; i++)
+      if (m_faceList[i].getWeight() != pmd->m_faceList[i].getWeight())
+         return false;
+   for (i = 0; i < m_numBoneMorph; i++)
+      if (m_boneMorphList[i].getWeight() != pmd->m_boneMorphList[i].getWeight())
+         return false;
+   for (i = 0; i < m_numVertexMorph; i++)
+      if (m_vertexMorphList[i].getWeight() != pmd->m_vertexMorphList[i].getWeight())
+         return false;
+   for (i = 0; i < m_numUVMorph; i++)
+      if (m_uvMorphList[i].getWeight() != pmd->m_uvMorphList[i].getWeight())
+         return false;
+   for (i = 0; i < m_numMaterialMorph; i++)
+      if (m_materialMorphList[i].getWeight() != pmd->m_materialMorphList[i].getWeight())
+         return false;
+   for (i = 0; i < m_numGroupMorph; i++)
+      if (m_groupMorphList[i].getWeight() != pmd->m_groupMorphList[i].getWeight())
+         return false;
+
+   return true;
+}
+
+/* PMDModel::copyPose: copy bone transforms and morph weights from the given model, keeping the root bone of this model */
+void PMDModel::copyPose(PMDModel *pmd)
+{
+   unsigned short i;
+   btTransform rootDiff;
+
+   /* all bones are under the root bone, so transforms are moved by the difference of root bones */
+   rootDiff = (*(m_rootBone.getTransform())) * pmd->m_rootBone.getTransform()->inverse();
+   for (i = 0; i < m_numBone; i++)
+      m_boneList[i].copyState(&(pmd->m_boneList[i]), &rootDiff);
+
+   for (i = 0; i < m_numFace; i++)
+      m_faceList[i].setWeight(pmd->m_faceList[i].getWeight());
+   for (i = 0; i < m_numBoneMorph; i++)
+      m_boneMorphList[i].setWeight(pmd->m_boneMorphList[i].getWeight());
+   for (i = 0; i < m_numVertexMorph; i++)
+      m_vertexMorphList[i].setWeight(pmd->m_vertexMorphList[i].getWeight());
+   for (i = 0; i < m_numUVMorph; i++)
+      m_uvMorphList[i].setWeight(pmd->m_uvMorphList[i].getWeight());
+   for (i = 0; i < m_numMaterialMorph; i++)
+      m_materialMorphList[i].setWeight(pmd->m_materialMorphList[i].getWeight());
+   for (i = 0; i < m_numGroupMorph; i++)
+      m_groupMorphList[i].setWeight(pmd->m_groupMorphList[i].getWeight());
+}
+
 /* PMDModel::updateFace: update face morph from current face weights */
 void PMDModel::updateFace()
 {
    unsigned short i;
    unsigned int j;
    bool updated;
+   float w;
+
+   /* compare morph weights with the last ones to detect shape change at skin update */
+   if (m_lastMorphWeight == NULL && m_numFace + m_numVertexMorph + m_numGroupMorph > 0) {
+      m_lastMorphWeight = (float *) malloc(sizeof(float) * (m_numFace + m_numVertexMorph + m_numGroupMorph));
+      m_morphChanged = true;
+   }
+   j = 0;
+   for (i = 0; i < m_numFace; i++, j++) {
+      w = m_faceList[i].getWeight();
+      if (m_lastMorphWeight[j] != w || m_morphChanged) {
+         m_lastMorphWeight[j] = w;
+         m_morphChanged = true;
+      }
+   }
+   for (i = 0; i < m_numVertexMorph; i++, j++) {
+      w = m_vertexMorphList[i].getWeight();
+      if (m_lastMorphWeight[j] != w || m_morphChanged) {
+         m_lastMorphWeight[j] = w;
+         m_morphChanged = true;
+      }
+   }
+   for (i = 0; i < m_numGroupMorph; i++, j++) {
+      w = m_groupMorphList[i].getWeight();
+      if (m_lastMorphWeight[j] != w || m_morphChanged) {
+         m_lastMorphWeight[j] = w;
+         m_morphChanged = true;
+      }
+   }
 
    if (m_vertexMorphList)
       memcpy(m_vertexList, m_baseVertexList, sizeof(btVector3) * m_numVertex);
@@ -271,92 +339,57 @@ void PMDModel::updateFace()
       }
       for (j = 0; j < m_numMaterial; j++)
          m_material[j].updateMorphedEdge(m_surfaceList, m_edgeWidth, m_edgeWidthMorphed);
+      /* material parameters may differ from the last draw commands */
+      m_renderCommandRequired = true;
    }
 }
 
-/* PMDModel::updateSkin: update skin data from bone orientation, toon and edges */
-void PMDModel::updateSkin()
+/* PMDModel::updateSkinCPU: compute skin data from bone orientation, toon and edges into the staging buffer, no OpenGL call */
+void PMDModel::updateSkinCPU()
 {
    unsigned short i;
-   int j, numVertex;
+   int k, numVertex;
+   unsigned int *vertexIndex = NULL;
+   bool full;
    btVector3 *vertexList, *normalList, *edgeVertexList = NULL;
    TexCoord *texCoordList = NULL;
    char *ptr;
 
-   /* calculate transform matrix for skinning (global -> local) */
-   for (i = 0; i < m_numBone; i++)
-      m_boneList[i].calcSkinningTrans(&(m_boneSkinningTrans[i]));
-
-   /* prepare VBO buffer */
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+   if (m_vboBufData == NULL)
+      return;
 
-   if (m_vboMethod == PMDMODEL_VBO_AUTO) {
+   /* apply requested detail level so that skin data matches what will be drawn, geometry changes with it */
+   if (m_detailLevel != m_requestedDetailLevel) {
+      m_detailLevel = m_requestedDetailLevel;
+      m_skinSerial = MMDFiles_getNewSerial();
+   }
+   full = (m_detailLevel == PMDMODEL_DETAIL_FULL);
 
-      // auto-detect now
-      ptr = NULL;
-      if (ptr == NULL) {
-         /* test 1: glMapBufferRange with orphaning */
-         ptr = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_vboBufDynamicLen, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-         if (ptr) {
-#ifdef __ANDROID__
-            __android_log_print(ANDROID_LOG_WARN, "MMDAgent", "PMDModel_update: glMapBufferRange chosen");
-#endif
-            m_vboMethod = PMDMODEL_VBO_MAPBUFFERRANGE;
-         }
-      }
-      if (ptr == NULL) {
-         /* test 2: glMapBuffer with orphaning */
-         glBufferData(GL_ARRAY_BUFFER, m_vboBufDynamicLen, NULL, GL_DYNAMIC_DRAW);
-         ptr = (char *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-         if (ptr) {
-#ifdef __ANDROID__
-            __android_log_print(ANDROID_LOG_WARN, "MMDAgent", "PMDModel_update: glMapBuffer chosen");
-#endif
-            m_vboMethod = PMDMODEL_VBO_MAPBUFFER;
-         }
-      }
-      if (ptr == NULL) {
-         /* test 3: glBuffer*Data with orphaning */
-         glBufferData(GL_ARRAY_BUFFER, m_vboBufDynamicLen, NULL, GL_DYNAMIC_DRAW);
-         if (m_vboBufData != NULL && m_vboBufDataLen < m_vboBufDynamicLen) {
-            MMDFiles_alignedfree(m_vboBufData);
-            m_vboBufData = NULL;
-         }
-         if (m_vboBufData == NULL) {
-            m_vboBufData = (char *)MMDFiles_alignedmalloc(m_vboBufDynamicLen, 16);
-            m_vboBufDataLen = m_vboBufDynamicLen;
-         }
-         ptr = m_vboBufData;
-         m_vboMethod = PMDMODEL_VBO_BUFFERDATA;
-      }
+   /* material centers will move */
+   m_materialCenterUpdated = true;
+   m_pickRefitRequired = true;
 
-   } else {
+   /* calculate transform matrix for skinning (global -> local) */
+   for (i = 0; i < m_numBone; i++)
+      m_boneList[i].calcSkinningTrans(&(m_boneSkinningTrans[i]));
 
-      /* use specified VBO function */
+   /* renew serial when bones or morphs have been changed since the last update */
+   if (m_morphChanged || memcmp(m_boneSkinningTrans, m_lastBoneSkinningTrans, sizeof(btTransform) * m_numBone) != 0) {
+      m_skinSerial = MMDFiles_getNewSerial();
+      m_morphChanged = false;
+      for (i = 0; i < m_numBone; i++)
+         m_lastBoneSkinningTrans[i] = m_boneSkinningTrans[i];
+   }
 
-      switch (m_vboMethod) {
-      case PMDMODEL_VBO_MAPBUFFERRANGE:
-         ptr = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_vboBufDynamicLen, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
-         break;
-      case PMDMODEL_VBO_MAPBUFFER:
-         glBufferData(GL_ARRAY_BUFFER, m_vboBufDynamicLen, NULL, GL_DYNAMIC_DRAW);
-         ptr = (char *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-         break;
-      case PMDMODEL_VBO_BUFFERDATA:
-         glBufferData(GL_ARRAY_BUFFER, m_vboBufDynamicLen, NULL, GL_DYNAMIC_DRAW);
-         if (m_vboBufData != NULL && m_vboBufDataLen < m_vboBufDynamicLen) {
-            MMDFiles_alignedfree(m_vboBufData);
-            m_vboBufData = NULL;
-         }
-         if (m_vboBufData == NULL) {
-            m_vboBufData = (char *)MMDFiles_alignedmalloc(m_vboBufDynamicLen, 16);
-            m_vboBufDataLen = m_vboBufDynamicLen;
-         }
-         ptr = m_vboBufData;
-         break;
-      }
+   if (m_gpuSkinning) {
+      /* skinning will be done in vertex shader */
+      updateSkinGPU();
+      return;
    }
 
+   /* write to the staging buffer with the same layout as the dynamic VBO buffer */
+   ptr = m_vboBufData;
+
    vertexList = (btVector3 *)(ptr + m_vboOffsetVertex);
    normalList = (btVector3 *)(ptr + m_vboOffsetNormal);
    if (m_toon) {
@@ -364,13 +397,20 @@ void PMDModel::updateSkin()
       edgeVertexList = (btVector3 *)(ptr + m_vboOffsetEdge);
    }
 
-   numVertex = (int)m_numVertex;
+   /* skin only vertices used by simplified mesh at low detail */
+   if (m_detailLevel == PMDMODEL_DETAIL_LOW && m_lodVertexList) {
+      vertexIndex = m_lodVertexList;
+      numVertex = (int)m_numLODVertex;
+   } else {
+      numVertex = (int)m_numVertex;
+   }
 
    /* do skinning */
 #ifdef MY_EXTRADEFORMATION
    if (m_bone3List != NULL) {
 #pragma omp parallel for
-      for (j = 0; j < numVertex; j++) {
+      for (k = 0; k < numVertex; k++) {
+         int j = vertexIndex ? (int)vertexIndex[k] : k;
          btVector3 v, v2, n, n2, vv, nn;
          if (m_bone3List[j] >= 0) {
             /* BDEF4 */
@@ -386,8 +426,8 @@ void PMDModel::updateSkin()
             n2 = m_boneSkinningTrans[m_bone4List[j]].getBasis() * m_normalList[j];
             vv += v * m_boneWeight3[j] + v2 * m_boneWeight4[j];
             nn += n * m_boneWeight3[j] + n2 * m_boneWeight4[j];
-         } else if (m_bone3List[j] == -2) {
-            /* SDEF */
+         } else if (m_bone3List[j] == -2 && full) {
+            /* SDEF, approximated by BDEF2 below full detail */
             btTransform t;
             btQuaternion r1, r2;
             r1 = m_boneList[m_bone1List[j]].getTransform()->getRotation();
@@ -429,17 +469,20 @@ void PMDModel::updateSkin()
             float r;
             texCoordList[j].u = 0.0f;
             texCoordList[j].v = (1.0f - m_light.dot(nn)) * 0.5f;
-            r = m_edgeWidthMorphed ? m_edgeWidthMorphed[j] : m_edgeWidth[j];
-            if (m_lightEdge)
-               r *= texCoordList[j].v * 1.5f + 0.2f;
-            edgeVertexList[j] = vv + nn * r;
+            if (full) {
+               r = m_edgeWidthMorphed ? m_edgeWidthMorphed[j] : m_edgeWidth[j];
+               if (m_lightEdge)
+                  r *= texCoordList[j].v * 1.5f + 0.2f;
+               edgeVertexList[j] = vv + nn * r;
+            }
          }
       }
 
    } else {
 #endif /* MY_EXTRADEFORMATION */
 #pragma omp parallel for
-      for (j = 0; j < numVertex; j++) {
+      for (k = 0; k < numVertex; k++) {
+         int j = vertexIndex ? (int)vertexIndex[k] : k;
          btVector3 v, v2, n, n2, vv, nn;
          if (m_boneWeight1[j] >= 1.0f - PMDMODEL_MINBONEWEIGHT) {
             /* bone 1 */
@@ -464,21 +507,110 @@ void PMDModel::updateSkin()
             float r;
             texCoordList[j].u = 0.0f;
             texCoordList[j].v = (1.0f - m_light.dot(nn)) * 0.5f;
-            r = m_edgeWidthMorphed ? m_edgeWidthMorphed[j] : m_edgeWidth[j];
-            if (m_lightEdge)
-               r *= texCoordList[j].v * 1.5f + 0.2f;
-            edgeVertexList[j] = vv + nn * r;
+            if (full) {
+               r = m_edgeWidthMorphed ? m_edgeWidthMorphed[j] : m_edgeWidth[j];
+               if (m_lightEdge)
+                  r *= texCoordList[j].v * 1.5f + 0.2f;
+               edgeVertexList[j] = vv + nn * r;
+            }
          }
       }
 #ifdef MY_EXTRADEFORMATION
    }
 #endif /* MY_EXTRADEFORMATION */
 
-   if (m_vboMethod == PMDMODEL_VBO_MAPBUFFER || m_vboMethod == PMDMODEL_VBO_MAPBUFFERRANGE)
+   m_skinUpdated = true;
+}
+
+
+/* PMDModel::uploadSkin: upload the staging buffer to the dynamic VBO buffer if updated, must be called from the OpenGL thread */
+void PMDModel::uploadSkin()
+{
+   char *ptr;
+   unsigned long len;
+
+   if (m_gpuSkinning)
+      uploadBoneTexture();
+
+   if (m_skinUpdated == false || m_vboBufData == NULL)
+      return;
+
+   /* on GPU skinning, only morphed positions and edge widths are uploaded */
+   len = m_gpuSkinning ? sizeof(float) * 4 * m_numVertex : m_vboBufDynamicLen;
+
+   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
+
+   if (m_vboMethod == PMDMODEL_VBO_AUTO) {
+
+      // auto-detect now
+      ptr = NULL;
+      if (ptr == NULL) {
+         /* test 1: glMapBufferRange with orphaning */
+         ptr = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, len, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+         if (ptr) {
+#ifdef __ANDROID__
+            __android_log_print(ANDROID_LOG_WARN, "MMDAgent", "PMDModel_update: glMapBufferRange chosen");
+#endif
+            m_vboMethod = PMDMODEL_VBO_MAPBUFFERRANGE;
+         }
+      }
+      if (ptr == NULL) {
+         /* test 2: glMapBuffer with orphaning */
+         glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+         ptr = (char *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+         if (ptr) {
+#ifdef __ANDROID__
+            __android_log_print(ANDROID_LOG_WARN, "MMDAgent", "PMDModel_update: glMapBuffer chosen");
+#endif
+            m_vboMethod = PMDMODEL_VBO_MAPBUFFER;
+         }
+      }
+      if (ptr == NULL) {
+         /* test 3: glBuffer*Data with orphaning */
+         m_vboMethod = PMDMODEL_VBO_BUFFERDATA;
+      }
+
+   } else {
+
+      /* use specified VBO function */
+
+      ptr = NULL;
+      switch (m_vboMethod) {
+      case PMDMODEL_VBO_MAPBUFFERRANGE:
+         ptr = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0, len, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+         break;
+      case PMDMODEL_VBO_MAPBUFFER:
+         glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+         ptr = (char *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+         break;
+      }
+   }
+
+   if (ptr) {
+      /* copy the staging buffer to the mapped (orphaned) buffer */
+      memcpy(ptr, m_vboBufData, len);
       glUnmapBuffer(GL_ARRAY_BUFFER);
-   else
-      glBufferSubData(GL_ARRAY_BUFFER, 0, m_vboBufDynamicLen, ptr);
+   } else {
+      /* orphan the buffer and upload the staging buffer, also used as fallback when mapping failed */
+      glBufferData(GL_ARRAY_BUFFER, len, NULL, GL_DYNAMIC_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, len, m_vboBufData);
+   }
    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+   m_skinUpdated = false;
+}
+
+/* PMDModel::getSkinSerial: get serial number which is renewed when deformed shape has been changed */
+unsigned int PMDModel::getSkinSerial()
+{
+   return m_skinSerial;
+}
+
+/* PMDModel::updateSkin: update skin data from bone orientation, toon and edges */
+void PMDModel::updateSkin()
+{
+   updateSkinCPU();
+   uploadSkin();
 }
 
 /* PMDModel::setToonLight: set light direction for toon coordinates */
@@ -539,6 +671,37 @@ float PMDModel::calculateBoundingSphereRange(btVector3 *cpos)
    return maxRange;
 }
 
+/* PMDModel::updateMaterialCulling: mark materials outside of frustum as culled, NULL frustum clears all, return number of culled materials */
+unsigned int PMDModel::updateMaterialCulling(const MMDFilesFrustum *frustum)
+{
+   unsigned int i, j, num = 0;
+   unsigned short b;
+   btVector3 pos;
+
+   if (m_materialCulled == NULL)
+      return 0;
+
+   for (i = 0; i < m_numMaterial; i++) {
+      m_materialCulled[i] = false;
+      if (frustum == NULL || m_materialBoneHead[i] == m_materialBoneHead[i + 1])
+         continue;
+      /* material is culled when all spheres around its assigned bones are outside */
+      m_materialCulled[i] = true;
+      for (j = m_materialBoneHead[i]; j < m_materialBoneHead[i + 1]; j++) {
+         b = m_materialBoneList[j];
+         pos = m_boneList[b].getTransform()->getOrigin();
+         if (MMDFiles_testSphereInFrustum(frustum, &pos, m_maxDistanceFromVertexAssignedBone[b] * 1.2f) != MMDFILES_FRUSTUM_OUTSIDE) {
+            m_materialCulled[i] = false;
+            break;
+         }
+      }
+      if (m_materialCulled[i])
+         num++;
+   }
+
+   return num;
+}
+
 /* PMDModel::smearAllBonesToDefault: smear all bone pos/rot into default value (rate 1.0 = keep, rate 0.0 = reset) */
 void PMDModel::smearAllBonesToDefault(float rate)
 {
@@ -561,62 +724,85 @@ void PMDModel::smearAllBonesToDefault(float rate)
    }
 }
 
-#if !defined(MMDFILES_DONTSORTORDERFORALPHARENDERING) && !defined(MMDFILES_DONTUSEGLMAPBUFFER)
-/* compareAlphaDepth: qsort function for reordering material */
-static int compareAlphaDepth(const void *a, const void *b)
-{
-   MaterialDistanceData *x = (MaterialDistanceData *) a;
-   MaterialDistanceData *y = (MaterialDistanceData *) b;
-
-   if (x->alpha < 1.0f && y->alpha < 1.0f) {
-      if (x->dist == y->dist)
-         return 0;
-      return ( (x->dist > y->dist) ? 1 : -1 );
-   } else if (x->alpha == 1.0f && y->alpha < 1.0f) {
-      return -1;
-   } else if (x->alpha < 1.0f && y->alpha == 1.0f) {
-      return 1;
-   } else {
-      return 0;
-   }
-}
-#endif /* !MMDFILES_DONTSORTORDERFORALPHARENDERING && !MMDFILES_DONTUSEGLMAPBUFFER */
-
 /* PMDModel::updateMaterialOrder: update material order */
 void PMDModel::updateMaterialOrder(btTransform *trans)
 {
-#if !defined(MMDFILES_DONTSORTORDERFORALPHARENDERING) && !defined(MMDFILES_DONTUSEGLMAPBUFFER)
-   unsigned int i;
+#ifndef MMDFILES_DONTSORTORDERFORALPHARENDERING
+   unsigned int i, j, k, id, first;
+   float alpha;
+   bool classChanged;
    btVector3 pos;
    btVector3 *vertexList;
-   char *ptr;
 
-   glBindBuffer(GL_ARRAY_BUFFER, m_vboBufDynamic);
-   ptr = (char *) glMapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY);
-   if (!ptr) {
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
+   if (m_gpuSkinning == false && m_vboBufData == NULL)
       return;
-   }
-   vertexList = (btVector3 *)(ptr + m_vboOffsetVertex);
 
+   /* classify materials into opaque and transparent */
+   classChanged = !m_materialOrderReady;
    for (i = 0; i < m_numMaterial; i++) {
-      pos = vertexList[m_material[i].getCenterPositionIndex()];
-      pos = *trans * pos;
-      m_materialDistance[i].dist = pos.z() + m_material[i].getCenterVertexRadius();
       if (m_material[i].getAlpha() == 1.0f && m_material[i].getTexture() != NULL && m_material[i].getTexture()->isTransparent())
-         m_materialDistance[i].alpha = 0.99f;
+         alpha = 0.99f;
       else
-         m_materialDistance[i].alpha = m_material[i].getAlpha();
-      m_materialDistance[i].id = i;
+         alpha = m_material[i].getAlpha();
+      if ((alpha < 1.0f) != (m_materialDistance[i].alpha < 1.0f))
+         classChanged = true;
+      m_materialDistance[i].alpha = alpha;
    }
 
-   glUnmapBuffer(GL_ARRAY_BUFFER);
-   glBindBuffer(GL_ARRAY_BUFFER, 0);
+   if (classChanged) {
+      /* opaque materials first in original order, then transparent materials */
+      k = 0;
+      for (i = 0; i < m_numMaterial; i++)
+         if (m_materialDistance[i].alpha >= 1.0f)
+            m_materialRenderOrder[k++] = i;
+      m_numTransparentMaterial = m_numMaterial - k;
+      for (i = 0; i < m_numMaterial; i++)
+         if (m_materialDistance[i].alpha < 1.0f)
+            m_materialRenderOrder[k++] = i;
+   } else {
+      /* skip when no transparent material, or when neither view nor skin has been changed */
+      if (m_numTransparentMaterial == 0)
+         return;
+      if (m_materialCenterUpdated == false && m_materialOrderView == *trans)
+         return;
+   }
+   m_materialOrderReady = true;
+   m_materialOrderView = *trans;
+   m_renderCommandRequired = true;
+   m_materialCenterUpdated = false;
+   if (m_numTransparentMaterial == 0)
+      return;
+   first = m_numMaterial - m_numTransparentMaterial;
+
+   /* get depth of transparent material centers from skinned vertices on CPU, no read back from GPU */
+   vertexList = m_gpuSkinning ? NULL : (btVector3 *)(m_vboBufData + m_vboOffsetVertex);
+   for (k = first; k < m_numMaterial; k++) {
+      id = m_materialRenderOrder[k];
+      j = m_material[id].getCenterPositionIndex();
+      if (vertexList == NULL) {
+         /* skinned vertices are not on CPU when skinning on GPU, transform center by its first bone */
+         pos = m_boneSkinningTrans[m_bone1List[j]] * m_vertexList[j];
+      } else {
+         pos = vertexList[j];
+      }
+      pos = *trans * pos;
+      m_materialDistance[id].dist = pos.z() + m_material[id].getCenterVertexRadius();
+   }
+
+   /* sort transparent materials from far to near by insertion sort, since order of last call mostly holds */
+   for (k = first + 1; k < m_numMaterial; k++) {
+      id = m_materialRenderOrder[k];
+      for (j = k; j > first && m_materialDistance[m_materialRenderOrder[j - 1]].dist > m_materialDistance[id].dist; j--)
+         m_materialRenderOrder[j] = m_materialRenderOrder[j - 1];
+      m_materialRenderOrder[j] = id;
+   }
+#endif /* !MMDFILES_DONTSORTORDERFORALPHARENDERING */
+}
 
-   qsort(m_materialDistance, m_numMaterial, sizeof(MaterialDistanceData), compareAlphaDepth);
-   for (i = 0; i < m_numMaterial; i++)
-      m_materialRenderOrder[i] = m_materialDistance[i].id;
-#endif /* !MMDFILES_DONTSORTORDERFORALPHARENDERING && !MMDFILES_DONTUSEGLMAPBUFFER */
+/* PMDModel::isGPUSkinning: return true when skinning is performed on GPU */
+bool PMDModel::isGPUSkinning()
+{
+   return m_gpuSkinning;
 }
 
 /* PMDModel::getMaterialRenderOrder: get material rendering order */
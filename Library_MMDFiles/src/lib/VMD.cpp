@@ -119,6 +119,7 @@ void VMD::addBoneMotion(const char *name)
    bmNew->name = MMDFiles_strdup(name);
    bmNew->numKeyFrame = 1;
    bmNew->keyFrameList = NULL;
+   bmNew->baked = NULL;
 
    link->next = m_boneLink;
    m_boneLink = link;
@@ -300,6 +301,8 @@ void VMD::initialize()
    m_numBoneKind = 0;
    m_numBoneKind = 0;
    m_maxFrame = 0.0f;
+   m_numBakedBone = 0;
+   m_bakedSize = 0;
 }
 
 /* VMD::clear: free VMD */
@@ -313,6 +316,8 @@ void VMD::clear()
    m_name2bone.release();
    m_name2face.release();
 
+   clearBake();
+
    bl = m_boneLink;
    while (bl) {
       if (bl->boneMotion.keyFrameList) {
@@ -0,0 +1,298 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDFiles.h"
+
+
+/* resampling of bone motions into regular pose tracks */
+/* each bone motion is sampled at a fixed rate and stored as quantized rotations and positions, */
+/* so that the pose at a frame is given by interpolating two neighboring samples. */
+/* A bone motion is left as key frames when the resampled track differs from the key frame interpolation */
+/* more than the tolerances, checked at key frames and at points between samples. */
+/* Position error is the distance in model units, and rotation error is the angle in radians, each with its own tolerance. */
+
+/* VMD_getBoneAt: get bone pos/rot at the given frame by key frame interpolation */
+static void VMD_getBoneAt(BoneMotion *bm, float frame, btVector3 *pos, btQuaternion *rot)
+{
+   unsigned long k1, k2, l, h, m;
+   float time1, time2, w, ww, v[3];
+   short idx, i;
+   BoneKeyFrame *kf1, *kf2;
+
+   /* find the first key frame at or after the given frame */
+   l = 0;
+   h = bm->numKeyFrame;
+   while (l < h) {
+      m = (l + h) / 2;
+      if (bm->keyFrameList[m].keyFrame < frame)
+         l = m + 1;
+      else
+         h = m;
+   }
+   k2 = l;
+   if (k2 >= bm->numKeyFrame)
+      k2 = bm->numKeyFrame - 1;
+   k1 = (k2 <= 1) ? 0 : k2 - 1;
+
+   kf1 = &(bm->keyFrameList[k1]);
+   kf2 = &(bm->keyFrameList[k2]);
+   time1 = kf1->keyFrame;
+   time2 = kf2->keyFrame;
+
+   if (time1 == time2 || frame <= time1) {
+      *pos = kf1->pos;
+      *rot = kf1->rot;
+      return;
+   }
+   if (frame >= time2) {
+      *pos = kf2->pos;
+      *rot = kf2->rot;
+      return;
+   }
+
+   /* same as MotionController::calcBoneAt */
+   w = (frame - time1) / (time2 - time1);
+   idx = (short)(w * VMD_INTERPOLATIONTABLESIZE);
+   for (i = 0; i < 3; i++) {
+      if (kf2->linear[i]) {
+         v[i] = kf1->pos.m_floats[i] * (1.0f - w) + kf2->pos.m_floats[i] * w;
+      } else {
+         ww = kf2->interpolationTable[i][idx] + (kf2->interpolationTable[i][idx + 1] - kf2->interpolationTable[i][idx]) * (w * VMD_INTERPOLATIONTABLESIZE - idx);
+         v[i] = kf1->pos.m_floats[i] * (1.0f - ww) + kf2->pos.m_floats[i] * ww;
+      }
+   }
+   pos->setValue(btScalar(v[0]), btScalar(v[1]), btScalar(v[2]));
+   if (kf2->linear[3]) {
+      *rot = kf1->rot.slerp(kf2->rot, btScalar(w));
+   } else {
+      ww = kf2->interpolationTable[3][idx] + (kf2->interpolationTable[3][idx + 1] - kf2->interpolationTable[3][idx]) * (w * VMD_INTERPOLATIONTABLESIZE - idx);
+      *rot = kf1->rot.slerp(kf2->rot, btScalar(ww));
+   }
+}
+
+/* VMD_isBoneErrorOver: return true when position distance or rotation angle between resampled track and key frames exceeds its tolerance */
+static bool VMD_isBoneErrorOver(BoneMotion *bm, BoneBakedTrack *track, float frame, float posTolerance, float rotTolerance)
+{
+   btVector3 pos1, pos2;
+   btQuaternion rot1, rot2;
+   float d;
+
+   VMD_getBoneAt(bm, frame, &pos1, &rot1);
+   VMD_getBakedBoneAt(track, frame, &pos2, &rot2);
+
+   if (pos1.distance(pos2) > posTolerance)
+      return true;
+   d = fabsf(rot1.normalized().dot(rot2));
+   if (d > 1.0f)
+      d = 1.0f;
+   return 2.0f * acosf(d) > rotTolerance;
+}
+
+/* VMD_freeBakedTrack: free resampled track */
+static void VMD_freeBakedTrack(BoneBakedTrack *track)
+{
+   if (track->rot)
+      free(track->rot);
+   if (track->pos)
+      free(track->pos);
+   free(track);
+}
+
+/* VMD_bakeBone: make resampled track of a bone motion, or return NULL when exceeding the tolerances */
+static BoneBakedTrack *VMD_bakeBone(BoneMotion *bm, float step, float posTolerance, float rotTolerance)
+{
+   BoneBakedTrack *track;
+   float lastFrame, frame, *p, q[4], vmin[3], vmax[3];
+   unsigned int i, j, n;
+   btVector3 pos;
+   btQuaternion rot, prev;
+
+   if (bm->numKeyFrame <= 1)
+      return NULL;
+   lastFrame = bm->keyFrameList[bm->numKeyFrame - 1].keyFrame;
+   if (lastFrame <= 0.0f)
+      return NULL;
+
+   /* samples are placed at regular interval so that the last one comes at the last key frame */
+   n = (unsigned int) ceilf(lastFrame / step) + 1;
+   if (n < 2)
+      n = 2;
+
+   track = (BoneBakedTrack *) malloc(sizeof(BoneBakedTrack));
+   track->step = lastFrame / (float) (n - 1);
+   track->numSample = n;
+   track->rot = (short *) malloc(sizeof(short) * 4 * n);
+   track->pos = NULL;
+   p = (float *) malloc(sizeof(float) * 3 * n);
+
+   /* sample rotations on the same hemisphere as the previous one, and positions */
+   prev = btQuaternion(btScalar(0.0f), btScalar(0.0f), btScalar(0.0f), btScalar(1.0f));
+   for (i = 0; i < n; i++) {
+      frame = (i == n - 1) ? lastFrame : track->step * (float) i;
+      VMD_getBoneAt(bm, frame, &pos, &rot);
+      rot.normalize();
+      if (i > 0 && prev.dot(rot) < 0.0f)
+         rot = -rot;
+      prev = rot;
+      q[0] = rot.x();
+      q[1] = rot.y();
+      q[2] = rot.z();
+      q[3] = rot.w();
+      for (j = 0; j < 4; j++)
+         track->rot[i * 4 + j] = (short) lrintf(q[j] * VMD_BAKEROTSCALE);
+      for (j = 0; j < 3; j++) {
+         p[i * 3 + j] = pos.m_floats[j];
+         if (i == 0 || vmin[j] > pos.m_floats[j]) vmin[j] = pos.m_floats[j];
+         if (i == 0 || vmax[j] < pos.m_floats[j]) vmax[j] = pos.m_floats[j];
+      }
+   }
+
+   /* quantize positions within their range, constant position needs no samples */
+   for (j = 0; j < 3; j++) {
+      track->posMin[j] = vmin[j];
+      track->posScale[j] = (vmax[j] - vmin[j]) / VMD_BAKEPOSSTEP;
+      if (vmax[j] > vmin[j] && track->pos == NULL)
+         track->pos = (unsigned short *) malloc(sizeof(unsigned short) * 3 * n);
+   }
+   if (track->pos) {
+      for (i = 0; i < n; i++) {
+         for (j = 0; j < 3; j++) {
+            if (track->posScale[j] > 0.0f)
+               track->pos[i * 3 + j] = (unsigned short) lrintf((p[i * 3 + j] - vmin[j]) / track->posScale[j]);
+            else
+               track->pos[i * 3 + j] = 0;
+         }
+      }
+   }
+   free(p);
+
+   /* check error at key frames and between samples */
+   for (i = 0; i < bm->numKeyFrame; i++) {
+      if (VMD_isBoneErrorOver(bm, track, bm->keyFrameList[i].keyFrame, posTolerance, rotTolerance)) {
+         VMD_freeBakedTrack(track);
+         return NULL;
+      }
+   }
+   for (i = 0; i + 1 < n; i++) {
+      for (j = 1; j < VMD_BAKECHECKDIV; j++) {
+         if (VMD_isBoneErrorOver(bm, track, track->step * ((float) i + (float) j / VMD_BAKECHECKDIV), posTolerance, rotTolerance)) {
+            VMD_freeBakedTrack(track);
+            return NULL;
+         }
+      }
+   }
+
+   return track;
+}
+
+/* VMD_getBakedBoneAt: get bone pos/rot at the given frame from resampled track */
+void VMD_getBakedBoneAt(BoneBakedTrack *track, float frame, btVector3 *pos, btQuaternion *rot)
+{
+   unsigned int i, j;
+   float f, w, v[4];
+   const short *r1, *r2;
+   const unsigned short *p1, *p2;
+
+   /* find samples at both sides */
+   f = frame / track->step;
+   if (f <= 0.0f) {
+      i = 0;
+      w = 0.0f;
+   } else {
+      i = (unsigned int) f;
+      w = f - (float) i;
+      if (i >= track->numSample - 1) {
+         i = track->numSample - 1;
+         w = 0.0f;
+      }
+   }
+   j = (w > 0.0f) ? i + 1 : i;
+
+   /* normalized linear interpolation of rotation */
+   r1 = &(track->rot[i * 4]);
+   r2 = &(track->rot[j * 4]);
+   v[0] = r1[0] + (r2[0] - r1[0]) * w;
+   v[1] = r1[1] + (r2[1] - r1[1]) * w;
+   v[2] = r1[2] + (r2[2] - r1[2]) * w;
+   v[3] = r1[3] + (r2[3] - r1[3]) * w;
+   rot->setValue(btScalar(v[0]), btScalar(v[1]), btScalar(v[2]), btScalar(v[3]));
+   rot->normalize();
+
+   /* linear interpolation of position */
+   if (track->pos == NULL) {
+      pos->setValue(btScalar(track->posMin[0]), btScalar(track->posMin[1]), btScalar(track->posMin[2]));
+   } else {
+      p1 = &(track->pos[i * 3]);
+      p2 = &(track->pos[j * 3]);
+      v[0] = track->posMin[0] + (p1[0] + ((float) p2[0] - (float) p1[0]) * w) * track->posScale[0];
+      v[1] = track->posMin[1] + (p1[1] + ((float) p2[1] - (float) p1[1]) * w) * track->posScale[1];
+      v[2] = track->posMin[2] + (p1[2] + ((float) p2[2] - (float) p1[2]) * w) * track->posScale[2];
+      pos->setValue(btScalar(v[0]), btScalar(v[1]), btScalar(v[2]));
+   }
+}
+
+/* VMD::bake: resample bone motions at the given rate per second, bone motions exceeding the tolerances are left as key frames */
+void VMD::bake(float rate, float posTolerance, float rotTolerance)
+{
+   BoneMotionLink *bl;
+   BoneBakedTrack *track;
+
+   clearBake();
+
+   if (rate <= 0.0f)
+      return;
+
+   /* key frames are at 30 frames per second */
+   for (bl = m_boneLink; bl; bl = bl->next) {
+      track = VMD_bakeBone(&(bl->boneMotion), 30.0f / rate, posTolerance, rotTolerance);
+      if (track == NULL)
+         continue;
+      bl->boneMotion.baked = track;
+      m_numBakedBone++;
+      m_bakedSize += sizeof(BoneBakedTrack) + sizeof(short) * 4 * track->numSample;
+      if (track->pos)
+         m_bakedSize += sizeof(unsigned short) * 3 * track->numSample;
+   }
+}
+
+/* VMD::clearBake: free resampled tracks */
+void VMD::clearBake()
+{
+   BoneMotionLink *bl;
+
+   for (bl = m_boneLink; bl; bl = bl->next) {
+      if (bl->boneMotion.baked) {
+         VMD_freeBakedTrack(bl->boneMotion.baked);
+         bl->boneMotion.baked = NULL;
+      }
+   }
+   m_numBakedBone = 0;
+   m_bakedSize = 0;
+}
+
+/* VMD::getNumBakedBone: get number of bone motions having resampled track */
+unsigned int VMD::getNumBakedBone()
+{
+   return m_numBakedBone;
+}
+
+/* VMD::getBakedSize: get total bytes of resampled tracks */
+size_t VMD::getBakedSize()
+{
+   return m_bakedSize;
+}
@@ -0,0 +1,184 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include <chrono>
+#include "MMDFiles.h"
+
+/* definitions */
+
+#define PMDIK_BENCHMARK_DEFAULTCOUNT 100000
+#define PMDIK_BENCHMARK_MAXBONE      6
+#define PMDIK_BENCHMARK_CONVERGED    0.01 /* distance regarded as reached */
+
+/* PMDIK_Benchmark_Result: result of a run */
+typedef struct _PMDIK_Benchmark_Result {
+   int converged;   /* number of solves which reached within PMDIK_BENCHMARK_CONVERGED */
+   double avgError; /* average distance between target and destination after solve */
+   double maxError; /* maximum distance between target and destination after solve */
+   double usec;     /* average solving time in usec */
+} PMDIK_Benchmark_Result;
+
+/* PMDIK_Benchmark_usage: print usage */
+static void PMDIK_Benchmark_usage()
+{
+   fprintf(stderr, "PMDIK_benchmark: measure accuracy and solving time of IK solvers\n");
+   fprintf(stderr, "usage: PMDIK_benchmark [count]\n");
+   fprintf(stderr, "  a standard leg chain (leg, knee, ankle, 40 iterations) and a stretched 3-link chain are solved\n");
+   fprintf(stderr, "  for count random poses (default: %d) with CCD and analytic solvers.\n", PMDIK_BENCHMARK_DEFAULTCOUNT);
+}
+
+/* PMDIK_Benchmark_makeBone: make bone definition */
+static void PMDIK_Benchmark_makeBone(PMDFile_Bone *b, const char *name, short parent, float x, float y, float z)
+{
+   memset(b, 0, sizeof(PMDFile_Bone));
+   strncpy(b->name, name, 19);
+   b->parentBoneID = parent;
+   b->childBoneID = -1;
+   b->targetBoneID = -1;
+   b->type = ROTATE;
+   b->pos[0] = x;
+   b->pos[1] = y;
+   b->pos[2] = z;
+}
+
+/* PMDIK_Benchmark_run: solve the IK for random poses with the given solver, with the same poses for the same seed */
+static void PMDIK_Benchmark_run(PMDFile_Bone *fileBone, unsigned short numBone, PMDFile_IK *fileIK, const short *link, unsigned char solver, unsigned int seed, int count, PMDIK_Benchmark_Result *result)
+{
+   PMDBone boneList[PMDIK_BENCHMARK_MAXBONE];
+   PMDBone rootBone;
+   PMDIK ik;
+   btVector3 pos;
+   btQuaternion rot;
+   std::chrono::steady_clock::time_point start;
+   double total = 0.0;
+   double err;
+   unsigned short i;
+   int j, k;
+   int numLink = fileIK->numLink;
+
+   for (i = 0; i < numBone; i++)
+      boneList[i].setup(&(fileBone[i]), boneList, numBone, &rootBone);
+   for (i = 0; i < numBone; i++)
+      boneList[i].computeOffset();
+   ik.setup(fileIK, (const unsigned char *) link, boneList);
+   ik.setSolver(solver);
+
+   result->converged = 0;
+   result->avgError = 0.0;
+   result->maxError = 0.0;
+
+   srand(seed);
+   for (j = 0; j < count; j++) {
+      /* random destination, center height and link rotations */
+      pos.setValue((rand() % 200 - 100) * 0.01f, (rand() % 200) * 0.02f, (rand() % 200 - 100) * 0.02f);
+      boneList[fileIK->destBoneID].setCurrentPosition(&pos);
+      pos.setValue(0.0f, -(rand() % 100) * 0.01f, 0.0f);
+      boneList[0].setCurrentPosition(&pos);
+      for (k = 1; k <= numLink; k++) {
+         if (k == 2 && numLink == 2)
+            rot.setRotation(btVector3(1.0f, 0.0f, 0.0f), (rand() % 100) * 0.01f);
+         else
+            rot.setRotation(btVector3(1.0f, 0.0f, 0.0f), (rand() % 100 - 50) * 0.004f);
+         boneList[k].setCurrentRotation(&rot);
+      }
+      for (i = 0; i < numBone; i++)
+         boneList[i].update();
+
+      start = std::chrono::steady_clock::now();
+      ik.solve();
+      total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+      err = boneList[fileIK->targetBoneID].getTransform()->getOrigin().distance(boneList[fileIK->destBoneID].getTransform()->getOrigin());
+      result->avgError += err;
+      if (result->maxError < err)
+         result->maxError = err;
+      if (err < PMDIK_BENCHMARK_CONVERGED)
+         result->converged++;
+   }
+
+   result->avgError /= count;
+   result->usec = total / count;
+}
+
+/* PMDIK_Benchmark_print: print result */
+static void PMDIK_Benchmark_print(const char *label, int count, PMDIK_Benchmark_Result *result)
+{
+   printf("  %-20s %5.1f%% within %.2f, avg err %.6f, max err %.6f, %7.3f usec\n", label, result->converged * 100.0 / count, PMDIK_BENCHMARK_CONVERGED, result->avgError, result->maxError, result->usec);
+}
+
+/* main: compare IK solvers */
+int main(int argc, char **argv)
+{
+   PMDFile_Bone legBone[5];
+   PMDFile_Bone chainBone[6];
+   PMDFile_IK legIK, chainIK;
+   const short legLink[2] = { 2, 1 };
+   const short chainLink[3] = { 3, 2, 1 };
+   PMDIK_Benchmark_Result result;
+   int count = PMDIK_BENCHMARK_DEFAULTCOUNT;
+
+   if (argc >= 2) {
+      if (argv[1][0] == '-') {
+         PMDIK_Benchmark_usage();
+         return 1;
+      }
+      count = atoi(argv[1]);
+   }
+   if (count <= 0)
+      count = 1;
+
+   /* standard leg: center, leg, knee, ankle and leg IK */
+   PMDIK_Benchmark_makeBone(&(legBone[0]), "center", -1, 0.0f, 8.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(legBone[1]), "leg", 0, 1.0f, 10.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(legBone[2]), PMDBONE_KNEENAME, 1, 1.0f, 5.5f, -0.2f);
+   PMDIK_Benchmark_makeBone(&(legBone[3]), "ankle", 2, 1.0f, 1.0f, 0.3f);
+   PMDIK_Benchmark_makeBone(&(legBone[4]), "legIK", -1, 1.0f, 1.0f, 0.3f);
+   legBone[4].type = IK_DESTINATION;
+   legIK.destBoneID = 4;
+   legIK.targetBoneID = 3;
+   legIK.numLink = 2;
+   legIK.numIteration = 40;
+   legIK.angleConstraint = 0.5f;
+
+   /* stretched 3-link chain, often out of reach */
+   PMDIK_Benchmark_makeBone(&(chainBone[0]), "center", -1, 0.0f, 8.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(chainBone[1]), "a", 0, 0.0f, 10.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(chainBone[2]), "b", 1, 0.0f, 8.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(chainBone[3]), "c", 2, 0.0f, 6.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(chainBone[4]), "tip", 3, 0.0f, 4.0f, 0.0f);
+   PMDIK_Benchmark_makeBone(&(chainBone[5]), "ik", -1, 0.0f, 4.0f, 0.0f);
+   chainIK.destBoneID = 5;
+   chainIK.targetBoneID = 4;
+   chainIK.numLink = 3;
+   chainIK.numIteration = 40;
+   chainIK.angleConstraint = 0.5f;
+
+   printf("%d random poses\n", count);
+   printf("leg:\n");
+   PMDIK_Benchmark_run(legBone, 5, &legIK, legLink, PMDIK_SOLVER_CCD, 1, count, &result);
+   PMDIK_Benchmark_print("CCD", count, &result);
+   PMDIK_Benchmark_run(legBone, 5, &legIK, legLink, PMDIK_SOLVER_ANALYTIC, 1, count, &result);
+   PMDIK_Benchmark_print("analytic", count, &result);
+   printf("3 links, stretched:\n");
+   PMDIK_Benchmark_run(chainBone, 6, &chainIK, chainLink, PMDIK_SOLVER_CCD, 2, count, &result);
+   PMDIK_Benchmark_print("CCD", count, &result);
+   PMDIK_Benchmark_run(chainBone, 6, &chainIK, chainLink, PMDIK_SOLVER_ANALYTIC, 2, count, &result);
+   PMDIK_Benchmark_print("CCD with early stop", count, &result);
+
+   return 0;
+}
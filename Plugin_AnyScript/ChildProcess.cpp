@@ -25,7 +25,11 @@
 #include "ChildProcess.h"
 #ifdef CHILDPROCESS_UNIX
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -37,6 +41,7 @@
 #define PLUGINANYSCRIPT_PROCESSTERMINATEWAITMSEC 5000
 #define FILEDESCRIPTOR_UNDEFINED -1
 #define CREATEPIPE_BUFFER_SIZE 65535
+#define CHILDPROCESS_POLLTIMEOUTMSEC 100
 
 #ifdef CHILDPROCESS_UNIX
 #define CHILDPROCESS_ARG_MAX 100
@@ -104,6 +109,8 @@ void ChildProcess::initialize()
    m_fd_r = FILEDESCRIPTOR_UNDEFINED;
    m_fd_w = FILEDESCRIPTOR_UNDEFINED;
 #endif
+   m_readBufStart = 0;
+   m_readBufEnd = 0;
    m_threadId = GLFWTHREAD_UNDEF;
    m_kill = false;
 }
@@ -131,6 +138,18 @@ void ChildProcess::closeProcess()
    }
 #endif
 #ifdef CHILDPROCESS_UNIX
+   m_pid = 0;
+#endif
+
+   /* receiving thread polls with timeout, so it will exit shortly after kill flag is set */
+   if (m_threadId >= 0) {
+      glfwWaitThread(m_threadId, GLFW_WAIT);
+      glfwDestroyThread(m_threadId);
+      m_threadId = -1;
+   }
+
+#ifdef CHILDPROCESS_UNIX
+   /* close descriptors after receiving thread has finished using them */
    if (m_fd_r != FILEDESCRIPTOR_UNDEFINED) {
       close(m_fd_r);
       m_fd_r = FILEDESCRIPTOR_UNDEFINED;
@@ -139,14 +158,8 @@ void ChildProcess::closeProcess()
       close(m_fd_w);
       m_fd_w = FILEDESCRIPTOR_UNDEFINED;
    }
-   m_pid = 0;
 #endif
-
-   if (m_threadId >= 0) {
-      glfwWaitThread(m_threadId, GLFW_WAIT);
-      glfwDestroyThread(m_threadId);
-      m_threadId = -1;
-   }
+   m_readBufStart = m_readBufEnd = 0;
 
 #ifdef CHILDPROCESS_WIN32
    HANDLE h = m_process_info.hProcess;
@@ -345,8 +358,16 @@ bool ChildProcess::runProcess(const char *title, const char *execString)
    m_fd_r = pipe_child2parent[READ];
    m_fd_w = pipe_parent2child[WRITE];
    m_pid = pid;
+
+   /* make read descriptor non-blocking, receiving thread waits for data by poll() */
+   int fl = fcntl(m_fd_r, F_GETFL, 0);
+   if (fl != -1)
+      fcntl(m_fd_r, F_SETFL, fl | O_NONBLOCK);
 #endif /* CHILDPROCESS_UNIX */
 
+   m_readBufStart = m_readBufEnd = 0;
+   m_kill = false;
+
    /* start receiving thread */
    m_threadId = glfwCreateThread(receivingThreadMain, this);
    if (m_threadId == -1) {
@@ -411,64 +432,108 @@ void ChildProcess::update()
 #endif
 }
 
-/* ChildProcess::readFromProcess: read from process's stdout */
-int ChildProcess::readFromProcess(char *buf, int buflen)
+/* ChildProcess::fillReadBuffer: wait for and read available data from process's stdout into buffer */
+int ChildProcess::fillReadBuffer()
 {
-   if (isRunning() == false)
-      return -1;
-
 #ifdef CHILDPROCESS_WIN32
    DWORD nBytesRead;
-   BOOL b;
-   BYTE lpBuffer[1];
-   int numRead = 0;
 
-   while (1) {
-      b = ReadFile(m_hReadFromChild, lpBuffer, 1, &nBytesRead, NULL);
-      if (b == FALSE)
+   /* ReadFile on pipe returns as soon as some data is available */
+   if (ReadFile(m_hReadFromChild, m_readBuf, CHILDPROCESS_READBUFLEN, &nBytesRead, NULL) == FALSE)
+      return -1;
+   if (nBytesRead == 0)
+      return -1;
+   m_readBufStart = 0;
+   m_readBufEnd = (int)nBytesRead;
+   return m_readBufEnd;
+#endif /* CHILDPROCESS_WIN32 */
+
+#ifdef CHILDPROCESS_UNIX
+   struct pollfd pfd;
+   ssize_t nBytesRead;
+   int ret;
+
+   while (m_kill == false) {
+      pfd.fd = m_fd_r;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      ret = poll(&pfd, 1, CHILDPROCESS_POLLTIMEOUTMSEC);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return -1;
+      }
+      if (ret == 0)
+         continue;
+      /* read as much as available at once */
+      nBytesRead = read(m_fd_r, m_readBuf, CHILDPROCESS_READBUFLEN);
+      if (nBytesRead < 0) {
+         if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+            continue;
          return -1;
-      if (lpBuffer[0] == 0x0a) {
-         buf[numRead] = '\0';
-         if (numRead > 0 && buf[numRead - 1] == 0x0d) {
-            numRead--;
-            buf[numRead] = '\0';
-         }
-         return numRead;
       }
-      buf[numRead] = lpBuffer[0];
-      numRead++;
-      if (numRead >= buflen) break;
+      if (nBytesRead == 0) {
+         /* end of file: child closed its stdout */
+         return -1;
+      }
+      m_readBufStart = 0;
+      m_readBufEnd = (int)nBytesRead;
+      return m_readBufEnd;
    }
 
-   return numRead;
-#endif /* CHILDPROCESS_WIN32 */
+   return -1;
+#endif /* CHILDPROCESS_UNIX */
+}
 
-#ifdef CHILDPROCESS_UNIX
-   ssize_t nBytesRead;
-   char buffer[1];
+/* ChildProcess::readFromProcess: read a line from process's stdout */
+int ChildProcess::readFromProcess(char *buf, int buflen)
+{
    int numRead = 0;
+   char *p;
+   int len;
+   bool found;
+
+   if (isRunning() == false || buflen <= 0)
+      return -1;
 
    while (1) {
-      nBytesRead = read(m_fd_r, buffer, 1);
-      if (nBytesRead == -1)
-         return -1;
-      if (nBytesRead == 0)
-         continue;
-      if (buffer[0] == 0x0a) {
-         buf[numRead] = '\0';
-         if (numRead > 0 && buf[numRead - 1] == 0x0d) {
-            numRead--;
-            buf[numRead] = '\0';
+      /* consume buffered data first */
+      if (m_readBufStart < m_readBufEnd) {
+         p = (char *)memchr(m_readBuf + m_readBufStart, 0x0a, m_readBufEnd - m_readBufStart);
+         found = (p != NULL);
+         len = found ? (int)(p - (m_readBuf + m_readBufStart)) : m_readBufEnd - m_readBufStart;
+         if (len > buflen - 1 - numRead) {
+            /* line too long, return it in pieces */
+            len = buflen - 1 - numRead;
+            memcpy(buf + numRead, m_readBuf + m_readBufStart, len);
+            numRead += len;
+            m_readBufStart += len;
+            break;
+         }
+         memcpy(buf + numRead, m_readBuf + m_readBufStart, len);
+         numRead += len;
+         m_readBufStart += len;
+         if (found) {
+            /* skip newline */
+            m_readBufStart++;
+            break;
          }
-         return numRead;
       }
-      buf[numRead] = buffer[0];
-      numRead++;
-      if (numRead >= buflen) break;
+      /* buffer is empty, wait for next data */
+      if (fillReadBuffer() < 0) {
+         if (numRead > 0)
+            break;
+         return -1;
+      }
+   }
+
+   buf[numRead] = '\0';
+   if (numRead > 0 && buf[numRead - 1] == 0x0d) {
+      numRead--;
+      buf[numRead] = '\0';
    }
 
    return numRead;
-#endif /* CHILDPROCESS_UNIX */
 }
 
 /* ChildProcess::writeToProcess: write to process's stdin */
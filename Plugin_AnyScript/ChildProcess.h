@@ -18,6 +18,9 @@
 #define GLFWTHREAD_UNDEF -1
 #endif
 
+/* size of buffer to hold data read from child process */
+#define CHILDPROCESS_READBUFLEN 65536
+
 // child process handler
 class ChildProcess
 {
@@ -39,6 +42,10 @@ private:
    int m_fd_w;
 #endif
 
+   char m_readBuf[CHILDPROCESS_READBUFLEN]; /* buffer of data read from child process */
+   int m_readBufStart;                      /* start point of unprocessed data in m_readBuf */
+   int m_readBufEnd;                        /* end point of unprocessed data in m_readBuf */
+
    GLFWthread m_threadId;  /* thread id */
    bool m_kill;            /* thread kill flag */
 
@@ -51,6 +58,9 @@ private:
    /* closeProcess: close process handlers */
    void closeProcess();
 
+   /* fillReadBuffer: wait for and read available data from process's stdout into buffer */
+   int fillReadBuffer();
+
 public:
 
    /* constructor */
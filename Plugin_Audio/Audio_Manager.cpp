@@ -58,6 +58,7 @@
 
 #include "MMDAgent.h"
 #include "Audio_Thread.h"
+#include "Audio_Mixer.h"
 #include "Audio_Manager.h"
 
 /* Audio_Event_initialize: initialize input message buffer */
@@ -141,6 +142,13 @@ static void mainThread(void *param)
    audio_manager->run();
 }
 
+/* preloadThread: preload thread */
+static void preloadThread(void *param)
+{
+   Audio_Manager *audio_manager = (Audio_Manager *) param;
+   audio_manager->runPreload();
+}
+
 /* Audio_Manager::initialize: initialize */
 void Audio_Manager::initialize()
 {
@@ -157,6 +165,14 @@ void Audio_Manager::initialize()
 
    Audio_EventQueue_initialize(&m_bufferQueue);
    m_list = NULL;
+
+   m_mixer = NULL;
+
+   m_preloadMutex = NULL;
+   m_preloadCond = NULL;
+   m_preloadThread = -1;
+   m_preloadCount = 0;
+   Audio_EventQueue_initialize(&m_preloadQueue);
 }
 
 /* Audio_Manager::clear: clear */
@@ -190,6 +206,25 @@ void Audio_Manager::clear()
 
    Audio_EventQueue_clear(&m_bufferQueue);
 
+   /* stop preload thread before releasing mixer */
+   if(m_preloadCond != NULL)
+      glfwSignalCond(m_preloadCond);
+   if(m_preloadThread >= 0) {
+      glfwWaitThread(m_preloadThread, GLFW_WAIT);
+      glfwDestroyThread(m_preloadThread);
+   }
+   if(m_preloadCond != NULL)
+      glfwDestroyCond(m_preloadCond);
+   if(m_preloadMutex != NULL)
+      glfwDestroyMutex(m_preloadMutex);
+   Audio_EventQueue_clear(&m_preloadQueue);
+
+#ifdef AUDIOMIXER_ENABLE
+   /* threads have been stopped, so no voice is left on mixer */
+   if (m_mixer)
+      delete m_mixer;
+#endif /* AUDIOMIXER_ENABLE */
+
    initialize();
 }
 
@@ -217,6 +252,17 @@ void Audio_Manager::setupAndStart(MMDAgent *mmdagent, int id)
    m_id = id;
 
    glfwInit();
+
+#ifdef AUDIOMIXER_ENABLE
+   /* open output stream once, fall back to external player if it fails */
+   m_mixer = new Audio_Mixer();
+   if (m_mixer->setup(m_mmdagent, m_id) == false) {
+      m_mmdagent->sendLogString(m_id, MLOG_WARNING, "failed to open audio output for mixer, use external player instead");
+      delete m_mixer;
+      m_mixer = NULL;
+   }
+#endif /* AUDIOMIXER_ENABLE */
+
    m_mutex = glfwCreateMutex();
    m_cond = glfwCreateCond();
    m_thread = glfwCreateThread(mainThread, this);
@@ -224,6 +270,15 @@ void Audio_Manager::setupAndStart(MMDAgent *mmdagent, int id)
       clear();
       return;
    }
+
+   /* sounds are preloaded only into mixer cache */
+   if(m_mixer != NULL) {
+      m_preloadMutex = glfwCreateMutex();
+      m_preloadCond = glfwCreateCond();
+      m_preloadThread = glfwCreateThread(preloadThread, this);
+      if(m_preloadMutex == NULL || m_preloadCond == NULL || m_preloadThread < 0)
+         m_mmdagent->sendLogString(m_id, MLOG_WARNING, "failed to start preload thread, sounds will be decoded at first play");
+   }
 }
 
 /* Audio_Manager::stopAndRelease: stop and release thread */
@@ -243,7 +298,7 @@ void Audio_Manager::run()
    /* create initial threads */
    for(i = 0; i < AUDIOMANAGER_INITIALNTHREAD; i++) {
       link = new Audio_Link;
-      link->audio_thread.setupAndStart(m_mmdagent, m_id);
+      link->audio_thread.setupAndStart(m_mmdagent, m_id, m_mixer);
       link->next = m_list;
       m_list = link;
    }
@@ -277,7 +332,7 @@ void Audio_Manager::run()
                      break;
                if(link == NULL) {
                   link = new Audio_Link;
-                  link->audio_thread.setupAndStart(m_mmdagent, m_id);
+                  link->audio_thread.setupAndStart(m_mmdagent, m_id, m_mixer);
                   link->next = m_list;
                   m_list = link;
                }
@@ -290,6 +345,58 @@ void Audio_Manager::run()
    }
 }
 
+/* Audio_Manager::runPreload: loop to decode files into mixer cache */
+void Audio_Manager::runPreload()
+{
+   char *file, *path;
+   ZFileKey *key;
+   ZFile *zf;
+
+   while(m_kill == false) {
+      /* wait preload event */
+      glfwLockMutex(m_preloadMutex);
+      while(m_preloadCount <= 0) {
+         glfwWaitCond(m_preloadCond, m_preloadMutex, GLFW_INFINITY);
+         if(m_kill == true) {
+            glfwUnlockMutex(m_preloadMutex);
+            return;
+         }
+      }
+      Audio_EventQueue_dequeue(&m_preloadQueue, &file);
+      m_preloadCount--;
+      glfwUnlockMutex(m_preloadMutex);
+
+      if(file == NULL)
+         continue;
+
+      /* if encrypted, decrypt it, and cache it by the original name as in playing */
+      path = NULL;
+      zf = NULL;
+      key = new ZFileKey();
+      if (key->loadKeyDir(m_mmdagent->getConfigDirName()) == true) {
+         zf = new ZFile(key);
+         if (MMDAgent_strtailmatch(file, ".mp3") || MMDAgent_strtailmatch(file, ".MP3"))
+            path = MMDAgent_strdup(zf->decryptAndGetFilePath(file, "mp3"));
+         else if (MMDAgent_strtailmatch(file, ".wav") || MMDAgent_strtailmatch(file, ".WAV"))
+            path = MMDAgent_strdup(zf->decryptAndGetFilePath(file, "wav"));
+      } else {
+         path = MMDAgent_strdup(file);
+      }
+
+      if (path == NULL || MMDAgent_exist(path) == false)
+         m_mmdagent->sendLogString(m_id, MLOG_ERROR, "failed to preload %s, file missing", file);
+#ifdef AUDIOMIXER_ENABLE
+      else if (m_mixer->preload(path, file) == false)
+         m_mmdagent->sendLogString(m_id, MLOG_ERROR, "failed to preload %s", file);
+#endif /* AUDIOMIXER_ENABLE */
+
+      if (path) free(path);
+      if (zf) delete zf;
+      delete key;
+      free(file);
+   }
+}
+
 /* Audio_Manager::isRunning: check running */
 bool Audio_Manager::isRunning()
 {
@@ -335,3 +442,51 @@ void Audio_Manager::stop(const char *str)
       }
    }
 }
+
+/* Audio_Manager::preload: decode file into mixer cache in background so that its first play starts immediately */
+void Audio_Manager::preload(const char *str)
+{
+   /* check */
+   if(isRunning() == false || m_preloadThread < 0)
+      return;
+   if(MMDAgent_strlen(str) <= 0)
+      return;
+
+   glfwLockMutex(m_preloadMutex);
+   Audio_EventQueue_enqueue(&m_preloadQueue, str);
+   m_preloadCount++;
+   if(m_preloadCount <= 1)
+      glfwSignalCond(m_preloadCond);
+   glfwUnlockMutex(m_preloadMutex);
+}
+
+/* Audio_Manager::setVolume: set volume of alias */
+void Audio_Manager::setVolume(const char *str)
+{
+   char *buff, *save;
+   char *alias, *volume;
+
+   if(isRunning() == false || m_mixer == NULL)
+      return;
+
+   buff = MMDAgent_strdup(str);
+   alias = MMDAgent_strtok(buff, "|", &save);
+   volume = MMDAgent_strtok(NULL, "|", &save);
+#ifdef AUDIOMIXER_ENABLE
+   if(alias != NULL && volume != NULL)
+      m_mixer->setVolume(alias, MMDAgent_str2float(volume));
+#endif /* AUDIOMIXER_ENABLE */
+   if(buff)
+      free(buff);
+}
+
+/* Audio_Manager::getStartTime: get time in sec when the sound of alias reached output, 0.0 if unknown */
+double Audio_Manager::getStartTime(const char *alias)
+{
+   Audio_Link *link;
+
+   for(link = m_list; link; link = link->next)
+      if(link->audio_thread.checkAlias(alias))
+         return link->audio_thread.getStartTime();
+   return 0.0;
+}
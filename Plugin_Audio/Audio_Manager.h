@@ -95,6 +95,14 @@ private:
    Audio_EventQueue m_bufferQueue; /* buffer queue */
    Audio_Link *m_list;             /* list of threads */
 
+   Audio_Mixer *m_mixer;           /* mixer engine shared by threads */
+
+   GLFWmutex m_preloadMutex;        /* mutex for preload queue */
+   GLFWcond m_preloadCond;          /* condition variable for preload queue */
+   GLFWthread m_preloadThread;      /* thread to decode files into mixer cache */
+   int m_preloadCount;              /* number of elements in preload queue */
+   Audio_EventQueue m_preloadQueue; /* queue of files to be preloaded */
+
    /* initialize: initialize */
    void initialize();
 
@@ -118,6 +126,9 @@ public:
    /* run: main loop */
    void run();
 
+   /* runPreload: loop to decode files into mixer cache */
+   void runPreload();
+
    /* isRunning: check running */
    bool isRunning();
 
@@ -126,4 +137,13 @@ public:
 
    /* stop: stop playing */
    void stop(const char *str);
+
+   /* preload: decode file into mixer cache in background so that its first play starts immediately */
+   void preload(const char *str);
+
+   /* setVolume: set volume of alias */
+   void setVolume(const char *str);
+
+   /* getStartTime: get time in sec when the sound of alias reached output, 0.0 if unknown */
+   double getStartTime(const char *alias);
 };
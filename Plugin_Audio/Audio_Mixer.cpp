@@ -0,0 +1,618 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+/* ----------------------------------------------------------------- */
+/*           The Toolkit for Building Voice Interaction Systems      */
+/*           "MMDAgent" developed by MMDAgent Project Team           */
+/*           http://www.mmdagent.jp/                                 */
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2009-2016  Nagoya Institute of Technology          */
+/*                           Department of Computer Science          */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAgent project team nor the names of  */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+
+/* headers */
+
+#include <atomic>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sndfile.h>
+#include <samplerate.h>
+#include "portaudio.h"
+
+#include "MMDAgent.h"
+#include "Audio_Mixer.h"
+
+/* Audio_MixerSound_free: free decoded sound */
+static void Audio_MixerSound_free(Audio_MixerSound *s)
+{
+   if (s->file)
+      free(s->file);
+   if (s->data)
+      free(s->data);
+   free(s);
+}
+
+/* audioMixerCallback: PortAudio callback to mix voices */
+static int audioMixerCallback(const void *inputBuffer, void *outputBuffer, unsigned long framesPerBuffer, const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData)
+{
+   Audio_Mixer *mixer = (Audio_Mixer *) userData;
+   double dacDelay = -1.0;
+
+   (void) inputBuffer;
+   (void) statusFlags;
+
+   /* delay from now until this buffer reaches output, if host API gives it */
+   if (timeInfo != NULL && timeInfo->outputBufferDacTime > 0.0 && timeInfo->currentTime > 0.0)
+      dacDelay = timeInfo->outputBufferDacTime - timeInfo->currentTime;
+
+   mixer->render((float *) outputBuffer, framesPerBuffer, dacDelay);
+
+   return paContinue;
+}
+
+/* Audio_Mixer::initialize: initialize mixer */
+void Audio_Mixer::initialize()
+{
+   int i;
+
+   m_mmdagent = NULL;
+   m_id = 0;
+
+   m_mutex = NULL;
+
+   m_stream = NULL;
+   m_outputLatency = 0.0;
+
+   m_soundList = NULL;
+   m_cachedFrames = 0;
+
+   for (i = 0; i < AUDIOMIXER_MAXVOICE; i++) {
+      m_voice[i].state = AUDIOMIXER_VOICE_FREE;
+      m_voice[i].stopRequest = false;
+      m_voice[i].volume = 1.0f;
+      m_voice[i].startTime = 0.0;
+      m_voice[i].sound = NULL;
+      m_voice[i].position = 0;
+      m_voice[i].alias = NULL;
+   }
+
+   for (i = 0; i < AUDIOMIXER_MAXALIAS; i++) {
+      m_alias[i].alias = NULL;
+      m_alias[i].volume = 1.0f;
+   }
+   m_numAlias = 0;
+}
+
+/* Audio_Mixer::clear: free mixer */
+void Audio_Mixer::clear()
+{
+   int i;
+   Audio_MixerSound *s, *tmp;
+
+   /* callback will not be called after the stream is closed */
+   if (m_stream) {
+      Pa_StopStream((PaStream *) m_stream);
+      Pa_CloseStream((PaStream *) m_stream);
+      Pa_Terminate();
+   }
+
+   for (i = 0; i < AUDIOMIXER_MAXVOICE; i++)
+      if (m_voice[i].alias)
+         free(m_voice[i].alias);
+   for (i = 0; i < m_numAlias; i++)
+      if (m_alias[i].alias)
+         free(m_alias[i].alias);
+   for (s = m_soundList; s; s = tmp) {
+      tmp = s->next;
+      Audio_MixerSound_free(s);
+   }
+
+   if (m_mutex)
+      glfwDestroyMutex(m_mutex);
+
+   initialize();
+}
+
+/* Audio_Mixer::decode: decode audio file into interleaved samples at output rate */
+Audio_MixerSound *Audio_Mixer::decode(const char *file)
+{
+   char *path;
+   SNDFILE *sf;
+   SF_INFO info;
+   float *in, *rate, *out;
+   long frames, i;
+   int c;
+   SRC_DATA src;
+   Audio_MixerSound *s;
+
+   path = MMDFiles_pathdup_from_application_to_system_locale(file);
+   if (path == NULL)
+      return NULL;
+   memset(&info, 0, sizeof(SF_INFO));
+   sf = sf_open(path, SFM_READ, &info);
+   free(path);
+   if (sf == NULL)
+      return NULL;
+   if (info.frames <= 0 || info.channels <= 0 || info.samplerate <= 0) {
+      sf_close(sf);
+      return NULL;
+   }
+
+   /* read whole samples */
+   in = (float *) malloc(sizeof(float) * info.frames * info.channels);
+   if (in == NULL) {
+      sf_close(sf);
+      return NULL;
+   }
+   frames = (long) sf_readf_float(sf, in, info.frames);
+   sf_close(sf);
+   if (frames <= 0) {
+      free(in);
+      return NULL;
+   }
+
+   /* convert sampling rate */
+   if (info.samplerate != AUDIOMIXER_SAMPLERATE) {
+      src.src_ratio = (double) AUDIOMIXER_SAMPLERATE / (double) info.samplerate;
+      src.input_frames = frames;
+      src.output_frames = (long) (frames * src.src_ratio) + 1;
+      rate = (float *) malloc(sizeof(float) * src.output_frames * info.channels);
+      if (rate == NULL) {
+         free(in);
+         return NULL;
+      }
+      src.data_in = in;
+      src.data_out = rate;
+      src.end_of_input = 1;
+      if (src_simple(&src, SRC_SINC_FASTEST, info.channels) != 0 || src.output_frames_gen <= 0) {
+         free(in);
+         free(rate);
+         return NULL;
+      }
+      free(in);
+      in = rate;
+      frames = src.output_frames_gen;
+   }
+
+   /* convert channels */
+   if (info.channels == AUDIOMIXER_CHANNELS) {
+      out = in;
+   } else {
+      out = (float *) malloc(sizeof(float) * frames * AUDIOMIXER_CHANNELS);
+      if (out == NULL) {
+         free(in);
+         return NULL;
+      }
+      for (i = 0; i < frames; i++)
+         for (c = 0; c < AUDIOMIXER_CHANNELS; c++)
+            out[i * AUDIOMIXER_CHANNELS + c] = in[i * info.channels + (c < info.channels ? c : info.channels - 1)];
+      free(in);
+   }
+
+   s = (Audio_MixerSound *) malloc(sizeof(Audio_MixerSound));
+   if (s == NULL) {
+      free(out);
+      return NULL;
+   }
+   s->file = MMDAgent_strdup(file);
+   s->data = out;
+   s->frames = (unsigned long) frames;
+   s->refCount = 0;
+   s->lastUsedTime = 0.0;
+   s->modifiedTime = 0;
+   s->next = NULL;
+
+   return s;
+}
+
+/* Audio_Mixer::findSound: find decoded sound, or decode and cache it, and hold a reference to it */
+Audio_MixerSound *Audio_Mixer::findSound(const char *name, const char *file)
+{
+   Audio_MixerSound *s, *prev, *d;
+   struct stat st;
+   long mtime = 0;
+   char *path;
+
+   path = MMDFiles_pathdup_from_application_to_system_locale(file);
+   if (path) {
+      if (stat(path, &st) == 0)
+         mtime = (long) st.st_mtime;
+      free(path);
+   }
+
+   /* search cache, drop the entry if the file has been updated */
+   glfwLockMutex(m_mutex);
+   for (s = m_soundList, prev = NULL; s; prev = s, s = s->next) {
+      if (MMDAgent_strequal(s->file, name)) {
+         if (s->modifiedTime == mtime) {
+            s->refCount++;
+            glfwUnlockMutex(m_mutex);
+            return s;
+         }
+         if (s->refCount == 0) {
+            if (prev)
+               prev->next = s->next;
+            else
+               m_soundList = s->next;
+            m_cachedFrames -= s->frames;
+            Audio_MixerSound_free(s);
+         }
+         break;
+      }
+   }
+   glfwUnlockMutex(m_mutex);
+
+   /* decode out of lock so that other voices can start meanwhile */
+   d = decode(file);
+   if (d == NULL)
+      return NULL;
+   free(d->file);
+   d->file = MMDAgent_strdup(name);
+   d->modifiedTime = mtime;
+   d->refCount = 1;
+
+   glfwLockMutex(m_mutex);
+   d->next = m_soundList;
+   m_soundList = d;
+   m_cachedFrames += d->frames;
+   glfwUnlockMutex(m_mutex);
+
+   return d;
+}
+
+/* Audio_Mixer::shrinkCache: free unused sounds until cache fits the limit */
+void Audio_Mixer::shrinkCache()
+{
+   Audio_MixerSound *s, *prev, *oldest, *oldestPrev;
+
+   glfwLockMutex(m_mutex);
+   while (m_cachedFrames > AUDIOMIXER_CACHEMAXFRAMES) {
+      /* find least recently used sound */
+      oldest = NULL;
+      oldestPrev = NULL;
+      for (s = m_soundList, prev = NULL; s; prev = s, s = s->next) {
+         if (s->refCount > 0)
+            continue;
+         if (oldest == NULL || s->lastUsedTime < oldest->lastUsedTime) {
+            oldest = s;
+            oldestPrev = prev;
+         }
+      }
+      if (oldest == NULL)
+         break;
+      if (oldestPrev)
+         oldestPrev->next = oldest->next;
+      else
+         m_soundList = oldest->next;
+      m_cachedFrames -= oldest->frames;
+      Audio_MixerSound_free(oldest);
+   }
+   glfwUnlockMutex(m_mutex);
+}
+
+/* Audio_Mixer::getAliasVolume: get volume of alias */
+float Audio_Mixer::getAliasVolume(const char *alias)
+{
+   int i;
+
+   for (i = 0; i < m_numAlias; i++)
+      if (MMDAgent_strequal(m_alias[i].alias, alias))
+         return m_alias[i].volume;
+   return 1.0f;
+}
+
+/* Audio_Mixer::Audio_Mixer: constructor */
+Audio_Mixer::Audio_Mixer()
+{
+   initialize();
+}
+
+/* Audio_Mixer::~Audio_Mixer: destructor */
+Audio_Mixer::~Audio_Mixer()
+{
+   clear();
+}
+
+/* Audio_Mixer::setup: open and start output stream */
+bool Audio_Mixer::setup(MMDAgent *mmdagent, int id)
+{
+   PaError err;
+   PaStream *stream;
+   PaStreamParameters parameters;
+   const PaStreamInfo *info;
+
+   clear();
+
+   m_mmdagent = mmdagent;
+   m_id = id;
+
+   m_mutex = glfwCreateMutex();
+   if (m_mutex == NULL) {
+      clear();
+      return false;
+   }
+
+   err = Pa_Initialize();
+   if (err != paNoError) {
+      clear();
+      return false;
+   }
+   parameters.device = Pa_GetDefaultOutputDevice();
+   if (parameters.device == paNoDevice) {
+      Pa_Terminate();
+      clear();
+      return false;
+   }
+   parameters.channelCount = AUDIOMIXER_CHANNELS;
+   parameters.sampleFormat = paFloat32;
+   parameters.suggestedLatency = Pa_GetDeviceInfo(parameters.device)->defaultLowOutputLatency;
+   parameters.hostApiSpecificStreamInfo = NULL;
+
+   /* keep one stream open while the plugin is running */
+   err = Pa_OpenStream(&stream, NULL, &parameters, AUDIOMIXER_SAMPLERATE, AUDIOMIXER_FRAMESPERBUFFER, paClipOff, audioMixerCallback, this);
+   if (err != paNoError) {
+      Pa_Terminate();
+      clear();
+      return false;
+   }
+   m_stream = stream;
+   info = Pa_GetStreamInfo(stream);
+   if (info)
+      m_outputLatency = info->outputLatency;
+   err = Pa_StartStream(stream);
+   if (err != paNoError) {
+      clear();
+      return false;
+   }
+
+   m_mmdagent->sendLogString(m_id, MLOG_STATUS, "mixer started: %d Hz, %d ch, latency %.1f msec", AUDIOMIXER_SAMPLERATE, AUDIOMIXER_CHANNELS, m_outputLatency * 1000.0);
+
+   return true;
+}
+
+/* Audio_Mixer::release: stop output stream and free sounds */
+void Audio_Mixer::release()
+{
+   clear();
+}
+
+/* Audio_Mixer::isRunning: return true when output stream is running */
+bool Audio_Mixer::isRunning()
+{
+   return m_stream != NULL;
+}
+
+/* Audio_Mixer::start: start playing a file and return voice id, or -1 on failure */
+int Audio_Mixer::start(const char *alias, const char *file, const char *name)
+{
+   int i;
+   Audio_MixerSound *s;
+   Audio_MixerVoice *v;
+
+   if (isRunning() == false || file == NULL)
+      return -1;
+   if (name == NULL)
+      name = file;
+
+   s = findSound(name, file);
+   if (s == NULL)
+      return -1;
+
+   glfwLockMutex(m_mutex);
+   for (i = 0; i < AUDIOMIXER_MAXVOICE; i++)
+      if (m_voice[i].state.load(std::memory_order_acquire) == AUDIOMIXER_VOICE_FREE)
+         break;
+   if (i >= AUDIOMIXER_MAXVOICE) {
+      s->refCount--;
+      glfwUnlockMutex(m_mutex);
+      return -1;
+   }
+   v = &(m_voice[i]);
+   s->lastUsedTime = MMDAgent_getTime();
+   v->sound = s;
+   v->position = 0;
+   v->alias = MMDAgent_strdup(alias);
+   v->volume.store(getAliasVolume(alias), std::memory_order_relaxed);
+   v->startTime.store(0.0, std::memory_order_relaxed);
+   v->stopRequest.store(false, std::memory_order_relaxed);
+   /* publish to callback */
+   v->state.store(AUDIOMIXER_VOICE_PLAYING, std::memory_order_release);
+   glfwUnlockMutex(m_mutex);
+
+   shrinkCache();
+
+   return i;
+}
+
+/* Audio_Mixer::preload: decode a file into sound cache without playing it */
+bool Audio_Mixer::preload(const char *file, const char *name)
+{
+   Audio_MixerSound *s;
+
+   if (isRunning() == false || file == NULL)
+      return false;
+   if (name == NULL)
+      name = file;
+
+   s = findSound(name, file);
+   if (s == NULL)
+      return false;
+
+   /* release the reference at once, and mark it as recently used so that it is not dropped first */
+   glfwLockMutex(m_mutex);
+   s->refCount--;
+   s->lastUsedTime = MMDAgent_getTime();
+   glfwUnlockMutex(m_mutex);
+
+   shrinkCache();
+
+   return true;
+}
+
+/* Audio_Mixer::isPlaying: return true while voice is playing */
+bool Audio_Mixer::isPlaying(int voice)
+{
+   if (voice < 0 || voice >= AUDIOMIXER_MAXVOICE)
+      return false;
+   return m_voice[voice].state.load(std::memory_order_acquire) == AUDIOMIXER_VOICE_PLAYING;
+}
+
+/* Audio_Mixer::waitStart: wait until the first sample of voice is sent to output and return its time in sec */
+double Audio_Mixer::waitStart(int voice)
+{
+   double t;
+
+   if (voice < 0 || voice >= AUDIOMIXER_MAXVOICE)
+      return 0.0;
+   while ((t = m_voice[voice].startTime.load(std::memory_order_acquire)) == 0.0) {
+      if (isPlaying(voice) == false)
+         break;
+      MMDAgent_sleep(AUDIOMIXER_WAITSLEEPSEC);
+   }
+   return t;
+}
+
+/* Audio_Mixer::stop: stop voice and release it */
+void Audio_Mixer::stop(int voice)
+{
+   Audio_MixerVoice *v;
+
+   if (voice < 0 || voice >= AUDIOMIXER_MAXVOICE)
+      return;
+   v = &(m_voice[voice]);
+   if (v->state.load(std::memory_order_acquire) == AUDIOMIXER_VOICE_FREE)
+      return;
+
+   /* ask callback to drop the voice and wait for it */
+   v->stopRequest.store(true, std::memory_order_release);
+   while (v->state.load(std::memory_order_acquire) == AUDIOMIXER_VOICE_PLAYING)
+      MMDAgent_sleep(AUDIOMIXER_WAITSLEEPSEC);
+
+   glfwLockMutex(m_mutex);
+   if (v->sound)
+      v->sound->refCount--;
+   v->sound = NULL;
+   if (v->alias)
+      free(v->alias);
+   v->alias = NULL;
+   v->state.store(AUDIOMIXER_VOICE_FREE, std::memory_order_release);
+   glfwUnlockMutex(m_mutex);
+}
+
+/* Audio_Mixer::setVolume: set volume of alias, applied also to playing voices */
+void Audio_Mixer::setVolume(const char *alias, float volume)
+{
+   int i;
+
+   if (m_mutex == NULL || MMDAgent_strlen(alias) <= 0)
+      return;
+   if (volume < 0.0f)
+      volume = 0.0f;
+
+   glfwLockMutex(m_mutex);
+   for (i = 0; i < m_numAlias; i++)
+      if (MMDAgent_strequal(m_alias[i].alias, alias))
+         break;
+   if (i >= m_numAlias && m_numAlias < AUDIOMIXER_MAXALIAS) {
+      m_alias[i].alias = MMDAgent_strdup(alias);
+      m_numAlias++;
+   }
+   if (i < m_numAlias)
+      m_alias[i].volume = volume;
+   for (i = 0; i < AUDIOMIXER_MAXVOICE; i++)
+      if (m_voice[i].state.load(std::memory_order_acquire) != AUDIOMIXER_VOICE_FREE && MMDAgent_strequal(m_voice[i].alias, alias))
+         m_voice[i].volume.store(volume, std::memory_order_relaxed);
+   glfwUnlockMutex(m_mutex);
+}
+
+/* Audio_Mixer::render: mix voices into output buffer, called from PortAudio callback */
+void Audio_Mixer::render(float *out, unsigned long frames, double dacDelay)
+{
+   int i;
+   unsigned long j, n;
+   float vol, *src;
+   double now;
+   Audio_MixerVoice *v;
+
+   memset(out, 0, sizeof(float) * frames * AUDIOMIXER_CHANNELS);
+
+   if (dacDelay < 0.0)
+      dacDelay = m_outputLatency;
+   now = MMDAgent_getTime();
+
+   for (i = 0; i < AUDIOMIXER_MAXVOICE; i++) {
+      v = &(m_voice[i]);
+      if (v->state.load(std::memory_order_acquire) != AUDIOMIXER_VOICE_PLAYING)
+         continue;
+      if (v->stopRequest.load(std::memory_order_acquire)) {
+         v->state.store(AUDIOMIXER_VOICE_ENDED, std::memory_order_release);
+         continue;
+      }
+      /* the first frame of this buffer will be heard after dacDelay */
+      if (v->position == 0)
+         v->startTime.store(now + dacDelay, std::memory_order_release);
+      vol = v->volume.load(std::memory_order_relaxed);
+      n = v->sound->frames - v->position;
+      if (n > frames)
+         n = frames;
+      src = &(v->sound->data[v->position * AUDIOMIXER_CHANNELS]);
+      for (j = 0; j < n * AUDIOMIXER_CHANNELS; j++)
+         out[j] += src[j] * vol;
+      v->position += n;
+      if (v->position >= v->sound->frames)
+         v->state.store(AUDIOMIXER_VOICE_ENDED, std::memory_order_release);
+   }
+
+   /* clip */
+   for (j = 0; j < frames * AUDIOMIXER_CHANNELS; j++) {
+      if (out[j] > 1.0f)
+         out[j] = 1.0f;
+      else if (out[j] < -1.0f)
+         out[j] = -1.0f;
+   }
+}
@@ -0,0 +1,180 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+/* ----------------------------------------------------------------- */
+/*           The Toolkit for Building Voice Interaction Systems      */
+/*           "MMDAgent" developed by MMDAgent Project Team           */
+/*           http://www.mmdagent.jp/                                 */
+/* ----------------------------------------------------------------- */
+/*                                                                   */
+/*  Copyright (c) 2009-2016  Nagoya Institute of Technology          */
+/*                           Department of Computer Science          */
+/*                                                                   */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/* - Redistributions of source code must retain the above copyright  */
+/*   notice, this list of conditions and the following disclaimer.   */
+/* - Redistributions in binary form must reproduce the above         */
+/*   copyright notice, this list of conditions and the following     */
+/*   disclaimer in the documentation and/or other materials provided */
+/*   with the distribution.                                          */
+/* - Neither the name of the MMDAgent project team nor the names of  */
+/*   its contributors may be used to endorse or promote products     */
+/*   derived from this software without specific prior written       */
+/*   permission.                                                     */
+/*                                                                   */
+/* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND            */
+/* CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,       */
+/* INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF          */
+/* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE          */
+/* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS */
+/* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,          */
+/* EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED   */
+/* TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,     */
+/* DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON */
+/* ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,   */
+/* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY    */
+/* OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE           */
+/* POSSIBILITY OF SUCH DAMAGE.                                       */
+/* ----------------------------------------------------------------- */
+
+
+/* definitions */
+
+#if !defined(_WIN32) && !defined(__ANDROID__) && !(defined(__APPLE__) && TARGET_OS_IPHONE)
+#define AUDIOMIXER_ENABLE                    /* use mixer engine instead of external player */
+#endif
+
+#define AUDIOMIXER_SAMPLERATE       48000    /* output sampling rate */
+#define AUDIOMIXER_CHANNELS         2        /* number of output channels */
+#define AUDIOMIXER_FRAMESPERBUFFER  256      /* frames per buffer in PortAudio */
+#define AUDIOMIXER_MAXVOICE         16       /* maximum number of voices played at once */
+#define AUDIOMIXER_MAXALIAS         32       /* maximum number of aliases with volume */
+#define AUDIOMIXER_CACHEMAXFRAMES   (AUDIOMIXER_SAMPLERATE * 60 * 10) /* maximum total frames of cached sounds (10 min.) */
+#define AUDIOMIXER_WAITSLEEPSEC     0.002    /* polling interval to wait for the callback */
+
+#define AUDIOMIXER_VOICE_FREE       0        /* voice is not used */
+#define AUDIOMIXER_VOICE_PLAYING    1        /* voice is being mixed */
+#define AUDIOMIXER_VOICE_ENDED      2        /* voice reached end or stopped, waiting to be released */
+
+/* Audio_MixerSound: decoded sound cache */
+typedef struct _Audio_MixerSound {
+   char *file;                      /* file name */
+   float *data;                     /* interleaved samples at AUDIOMIXER_SAMPLERATE */
+   unsigned long frames;            /* number of frames */
+   long modifiedTime;               /* modification time of the file */
+   int refCount;                    /* number of voices using this sound */
+   double lastUsedTime;             /* last time when this sound started */
+   struct _Audio_MixerSound *next;
+} Audio_MixerSound;
+
+/* Audio_MixerVoice: voice being played */
+typedef struct _Audio_MixerVoice {
+   std::atomic<int> state;          /* AUDIOMIXER_VOICE_* */
+   std::atomic<bool> stopRequest;   /* true when voice should be stopped at next callback */
+   std::atomic<float> volume;       /* volume of this voice */
+   std::atomic<double> startTime;   /* time in sec when the first sample reached output, 0.0 before start */
+   Audio_MixerSound *sound;         /* sound to be played */
+   unsigned long position;          /* current frame position, modified only in callback */
+   char *alias;                     /* alias name */
+} Audio_MixerVoice;
+
+/* Audio_MixerAlias: volume per alias */
+typedef struct _Audio_MixerAlias {
+   char *alias;
+   float volume;
+} Audio_MixerAlias;
+
+/* Audio_Mixer: mixer engine which keeps one output stream and mixes voices in its callback */
+class Audio_Mixer
+{
+private:
+
+   MMDAgent *m_mmdagent;   /* mmdagent */
+   int m_id;
+
+   GLFWmutex m_mutex;      /* mutex for sound cache, aliases and voice allocation */
+
+   void *m_stream;         /* PortAudio output stream */
+   double m_outputLatency; /* output latency in sec given by PortAudio */
+
+   Audio_MixerSound *m_soundList;  /* list of decoded sounds */
+   unsigned long m_cachedFrames;   /* total frames in m_soundList */
+
+   Audio_MixerVoice m_voice[AUDIOMIXER_MAXVOICE]; /* voices */
+
+   Audio_MixerAlias m_alias[AUDIOMIXER_MAXALIAS]; /* volume per alias */
+   int m_numAlias;
+
+   /* initialize: initialize mixer */
+   void initialize();
+
+   /* clear: free mixer */
+   void clear();
+
+   /* decode: decode audio file into interleaved samples at output rate */
+   Audio_MixerSound *decode(const char *file);
+
+   /* findSound: find decoded sound, or decode and cache it, and hold a reference to it */
+   Audio_MixerSound *findSound(const char *name, const char *file);
+
+   /* shrinkCache: free unused sounds until cache fits the limit */
+   void shrinkCache();
+
+   /* getAliasVolume: get volume of alias */
+   float getAliasVolume(const char *alias);
+
+public:
+
+   /* Audio_Mixer: constructor */
+   Audio_Mixer();
+
+   /* ~Audio_Mixer: destructor */
+   ~Audio_Mixer();
+
+   /* setup: open and start output stream */
+   bool setup(MMDAgent *mmdagent, int id);
+
+   /* release: stop output stream and free sounds */
+   void release();
+
+   /* isRunning: return true when output stream is running */
+   bool isRunning();
+
+   /* start: start playing a file and return voice id, or -1 on failure, name is used as cache key if given */
+   int start(const char *alias, const char *file, const char *name);
+
+   /* preload: decode a file into sound cache without playing it */
+   bool preload(const char *file, const char *name);
+
+   /* isPlaying: return true while voice is playing */
+   bool isPlaying(int voice);
+
+   /* waitStart: wait until the first sample of voice is sent to output and return its time in sec */
+   double waitStart(int voice);
+
+   /* stop: stop voice and release it */
+   void stop(int voice);
+
+   /* setVolume: set volume of alias, applied also to playing voices */
+   void setVolume(const char *alias, float volume);
+
+   /* render: mix voices into output buffer, called from PortAudio callback */
+   void render(float *out, unsigned long frames, double dacDelay);
+};
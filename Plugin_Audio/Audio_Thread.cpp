@@ -115,6 +115,7 @@
 #endif
 
 #include "Audio_Thread.h"
+#include "Audio_Mixer.h"
 
 #ifdef AUDIO_INTERFACE_WIN32
 typedef struct _Audio {
@@ -791,6 +792,9 @@ void Audio_Thread::initialize()
 
    m_key = NULL;
    m_zf = NULL;
+
+   m_mixer = NULL;
+   m_startTime = 0.0;
 }
 
 /* Audio_Thread::clear: free thread */
@@ -899,6 +903,41 @@ void Audio_Thread::stopLipsync()
    }
 }
 
+/* Audio_Thread::playOnMixer: play file on mixer engine, return false if mixer can not play it */
+bool Audio_Thread::playOnMixer(const char *alias, const char *file, const char *name)
+{
+#ifdef AUDIOMIXER_ENABLE
+   int voice;
+   bool lipsync;
+
+   if (m_mixer == NULL || m_mixer->isRunning() == false)
+      return false;
+
+   /* decoded samples are cached, so replaying the same file starts immediately */
+   voice = m_mixer->start(alias, file, name);
+   if (voice < 0)
+      return false;
+
+   /* wait for the first mixing to know when it is heard */
+   m_startTime = m_mixer->waitStart(voice);
+   lipsync = startLipsync(file);
+   /* send SOUND_EVENT_START */
+   m_mmdagent->sendMessage(m_id, AUDIOTHREAD_EVENTSTART, "%s", alias);
+   /* wait to stop audio */
+   while (m_playing == true && m_mixer->isPlaying(voice))
+      MMDAgent_sleep(AUDIOTHREAD_MIXERSLEEPSEC);
+   m_mixer->stop(voice);
+   if(lipsync) stopLipsync();
+   /* send SOUND_EVENT_STOP */
+   m_mmdagent->sendMessage(m_id, AUDIOTHREAD_EVENTSTOP, "%s", alias);
+   m_startTime = 0.0;
+
+   return true;
+#else
+   return false;
+#endif /* AUDIOMIXER_ENABLE */
+}
+
 /* Audio_Thread::Audio_Thread: thread constructor */
 Audio_Thread::Audio_Thread()
 {
@@ -912,10 +951,11 @@ Audio_Thread::~Audio_Thread()
 }
 
 /* Audio_Thread::setupAndStart: setup audio and start thread */
-void Audio_Thread::setupAndStart(MMDAgent *mmdagent, int id)
+void Audio_Thread::setupAndStart(MMDAgent *mmdagent, int id, Audio_Mixer *mixer)
 {
    m_mmdagent = mmdagent;
    m_id = id;
+   m_mixer = mixer;
 
    glfwInit();
    m_mutex = glfwCreateMutex();
@@ -937,7 +977,7 @@ void Audio_Thread::stopAndRelease()
 void Audio_Thread::run()
 {
    Audio audio;
-   char *alias, *file;
+   char *alias, *file, *name;
    bool lipsync;
 
    while (m_kill == false) {
@@ -952,6 +992,7 @@ void Audio_Thread::run()
       file = MMDAgent_strdup(m_file);
       m_count--;
       glfwUnlockMutex(m_mutex);
+      name = MMDAgent_strdup(file);
 
       /* if encrypted, decrypt it */
       m_key = new ZFileKey();
@@ -973,6 +1014,7 @@ void Audio_Thread::run()
             m_zf = NULL;
             if (alias) free(alias);
             if (file) free(file);
+            if (name) free(name);
             continue;
          }
          free(file);
@@ -981,10 +1023,12 @@ void Audio_Thread::run()
 
       m_playing = true;
 
+      Audio_initialize(&audio);
       if (MMDAgent_exist(file)) {
-         /* open and start audio */
-         Audio_initialize(&audio);
-         if(Audio_openAndStart(&audio, alias, file) == true) {
+         if (playOnMixer(alias, file, name) == true) {
+            /* played on mixer engine */
+         } else if(Audio_openAndStart(&audio, alias, file) == true) {
+            /* open and start audio */
             lipsync = startLipsync(file);
             /* send SOUND_EVENT_START */
             m_mmdagent->sendMessage(m_id, AUDIOTHREAD_EVENTSTART, "%s", alias);
@@ -1009,6 +1053,7 @@ void Audio_Thread::run()
 
       if(alias) free(alias);
       if(file) free(file);
+      if(name) free(name);
       Audio_clear(&audio);
       if (m_zf) {
          delete m_zf;
@@ -1092,3 +1137,9 @@ void Audio_Thread::stop()
    if(isRunning() == true)
       m_playing = false;
 }
+
+/* Audio_Thread::getStartTime: get time in sec when the current sound reached output, 0.0 if unknown */
+double Audio_Thread::getStartTime()
+{
+   return m_startTime;
+}
@@ -58,6 +58,7 @@
 
 #define AUDIOTHREAD_ENDSLEEPSEC   0.2                 /* check per 0.2 sec at end */
 #define AUDIOTHREAD_STARTSLEEPSEC 0.02                /* check per 0.02 sec at start*/
+#define AUDIOTHREAD_MIXERSLEEPSEC 0.01                /* check per 0.01 sec while playing on mixer */
 #define AUDIOTHREAD_EVENTSTART    "SOUND_EVENT_START"
 #define AUDIOTHREAD_EVENTSTOP     "SOUND_EVENT_STOP"
 
@@ -67,6 +68,8 @@
 #define AUDIOTHREAD_OUTPUTFLUSHWAITSEC 0.005 /* output flush wait time in seconds */
 #endif /* __ANDROID__ */
 
+class Audio_Mixer;
+
 /* Audio_Thread: thread for audio */
 class Audio_Thread
 {
@@ -90,6 +93,9 @@ private:
    ZFileKey *m_key;      /* encryption key */
    ZFile *m_zf;          /* encrypted file loading class */
 
+   Audio_Mixer *m_mixer; /* mixer engine, NULL when external player is used */
+   double m_startTime;   /* time in sec when the current sound reached output, 0.0 if unknown */
+
    /* initialize: initialize thread */
    void initialize();
 
@@ -102,6 +108,9 @@ private:
    /* stopLipsync: stop lipsync */
    void stopLipsync();
 
+   /* playOnMixer: play file on mixer engine, return false if mixer can not play it */
+   bool playOnMixer(const char *alias, const char *file, const char *name);
+
 public:
 
    /* Audio_Thraed: thread constructor */
@@ -111,7 +120,7 @@ public:
    ~Audio_Thread();
 
    /* setupAndStart: setup audio and start thread */
-   void setupAndStart(MMDAgent *mmdagent, int id);
+   void setupAndStart(MMDAgent *mmdagent, int id, Audio_Mixer *mixer = NULL);
 
    /* stopAndRelease: stop thread and free audio */
    void stopAndRelease();
@@ -133,4 +142,7 @@ public:
 
    /* stop: stop playing */
    void stop();
+
+   /* getStartTime: get time in sec when the current sound reached output, 0.0 if unknown */
+   double getStartTime();
 };
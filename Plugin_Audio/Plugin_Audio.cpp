@@ -79,6 +79,8 @@
 #define PLUGINAUDIO_DEFAULTALIAS "audio"
 #define PLUGINAUDIO_STARTCOMMAND "SOUND_START"
 #define PLUGINAUDIO_STOPCOMMAND  "SOUND_STOP"
+#define PLUGINAUDIO_VOLUMECOMMAND "SOUND_VOLUME"
+#define PLUGINAUDIO_PRELOADCOMMAND "SOUND_PRELOAD"
 
 /* variables */
 
@@ -123,6 +125,16 @@ EXPORT void extProcMessage(MMDAgent *mmdagent, const char *type, const char *arg
             mmdagent->sendLogString(mid, MLOG_MESSAGE_CAPTURED, "%s|%s", type, args);
             audio_manager.stop(args);
          }
+      } else if (MMDAgent_strequal(type, PLUGINAUDIO_VOLUMECOMMAND)) {
+         if (audio_manager.isRunning()) {
+            mmdagent->sendLogString(mid, MLOG_MESSAGE_CAPTURED, "%s|%s", type, args);
+            audio_manager.setVolume(args);
+         }
+      } else if (MMDAgent_strequal(type, PLUGINAUDIO_PRELOADCOMMAND)) {
+         if (audio_manager.isRunning()) {
+            mmdagent->sendLogString(mid, MLOG_MESSAGE_CAPTURED, "%s|%s", type, args);
+            audio_manager.preload(args);
+         }
       } else if(MMDAgent_strequal(type, MMDAGENT_EVENT_DRAGANDDROP)) {
          buf = MMDAgent_strdup(args);
          p = MMDAgent_strtok(buf, "|", &q);
@@ -169,7 +181,12 @@ EXPORT void extProcMessage(MMDAgent *mmdagent, const char *type, const char *arg
                         mmdagent->sendMessage(mid, MMDAGENT_COMMAND_MOTIONADD, "%s|%s|%s|FULL|ONCE|ON|ON", objs[i].getAlias(), "base", drop_motion);
                   }
                }
-               mmdagent->resetAdjustmentTimer();
+               /* align motion to the time when the sound was actually heard, if known */
+               double startTime = audio_manager.getStartTime(args);
+               if (startTime > 0.0)
+                  mmdagent->resetAdjustmentTimer(startTime);
+               else
+                  mmdagent->resetAdjustmentTimer();
             }
             free(drop_motion);
             drop_motion = NULL;
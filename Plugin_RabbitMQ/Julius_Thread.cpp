@@ -73,46 +73,27 @@ static int audioPlayCallback(const void *inputBuffer, void *outputBuffer,
    (void)inputBuffer; /* Prevent unused variable warning. */
    AudioProcess *d = (AudioProcess *)userData;
 
-#if 1
-   if (d->m_play_buffer_current < framesPerBuffer) {
-      /* short of audio data */
-      if (d->m_requestSegmentAfterPlayed && d->m_play_buffer_current != 0) {
-         /* last trail should be played here */
-         glfwLockMutex(d->m_play_mutex);
-         memset(out, 0, framesPerBuffer * sizeof(SP16));
-         /* clear buffer */
-         d->m_play_buffer_current = 0;
+   unsigned long n;
+
+   /* take a full block from the ring, or the rest of it when the specified part should be played out */
+   n = (unsigned long)d->m_play_ring.read(out, framesPerBuffer, d->m_requestSegmentAfterPlayed);
+   if (n < framesPerBuffer) {
+      /* short of audio data, fill the rest with 0 */
+      memset(&(out[n]), 0, (framesPerBuffer - n) * sizeof(SP16));
+      if (d->m_requestSegmentAfterPlayed && n != 0) {
+         /* last trail has been played here */
          /* clear flag since the specified part has been played */
          d->m_requestSegmentAfterPlayed = false;
          /* set segment flag to tell main thread to stop processing */
          d->m_want_segment = true;
-         glfwUnlockMutex(d->m_play_mutex);
-      } else {
-         /* next audio will come later, just fill output with 0 */
-         memset(out, 0, framesPerBuffer * sizeof(SP16));
-         if (d->m_requestPlayFlush) {
-            /* this is the last trail, discard it */
-            glfwLockMutex(d->m_play_mutex);
-            d->m_play_buffer_current = 0;
-            glfwUnlockMutex(d->m_play_mutex);
-            d->m_requestPlayFlush = false;
-         }
+      } else if (d->m_requestPlayFlush) {
+         /* this is the last trail, discard it */
+         d->m_play_ring.discard();
+         d->m_requestPlayFlush = false;
       }
-
-      return 0;
    }
-#else
-   while (d->m_play_buffer_current < framesPerBuffer) {
-      Pa_Sleep(20);
-   }
-#endif
-   glfwLockMutex(d->m_play_mutex);
-   memcpy(out, d->m_play_buffer, framesPerBuffer * sizeof(SP16));
-   memmove(d->m_play_buffer, &(d->m_play_buffer[framesPerBuffer]), (d->m_play_buffer_current - framesPerBuffer) * sizeof(SP16));
-   d->m_play_buffer_current -= framesPerBuffer;
-   glfwUnlockMutex(d->m_play_mutex);
 
-   for (unsigned long i = 0; i < framesPerBuffer; i++) {
+   for (unsigned long i = 0; i < n; i++) {
       int v = out[i] > 0 ? out[i] : -out[i];
       if (d->m_maxvol < v) d->m_maxvol = v;
    }
@@ -125,10 +106,6 @@ AudioProcess::AudioProcess(bool local)
 {
    m_audio_open = false;
    m_play_stream = NULL;
-   m_play_buffer = NULL;
-   m_receive_buffer = NULL;
-   m_play_mutex = NULL;
-   m_receive_mutex = NULL;
    m_streaming = true;
    m_want_segment = false;
    m_maxvol = 0;
@@ -159,32 +136,11 @@ boolean AudioProcess::callback_begin(char *arg)
    PaError err;
 
    if (m_audio_open == false) {
-      if (m_disablePlay == false) {
-         if (m_play_buffer)
-            free(m_play_buffer);
-         m_play_buffer_current = 0;
-         m_play_buffer_len = m_frequency * AUDIO_PLAY_BUFFER_SIZE_IN_SEC;
-         m_play_buffer = (SP16 *)malloc(sizeof(SP16) * m_play_buffer_len);
-      }
-      if (m_receive_buffer)
-         free(m_receive_buffer);
-      m_receive_buffer_last_point = 0;
-      m_receive_buffer_store_point = 0;
-      m_receive_buffer_len = m_frequency * AUDIO_PLAY_BUFFER_SIZE_IN_SEC;
-      m_receive_buffer = (SP16 *)malloc(sizeof(SP16) * m_receive_buffer_len);
       if (m_disablePlay == false) {
          err = Pa_Initialize();
          if (err != paNoError) {
             return FALSE;
          }
-         if (m_play_mutex != NULL)
-            glfwDestroyMutex(m_play_mutex);
-         m_play_mutex = glfwCreateMutex();
-      }
-      if (m_receive_mutex != NULL)
-         glfwDestroyMutex(m_receive_mutex);
-      m_receive_mutex = glfwCreateMutex();
-      if (m_disablePlay == false) {
          err = Pa_OpenDefaultStream(&m_play_stream, 0, 1, paInt16, m_frequency, 256, audioPlayCallback, this);
          if (err != paNoError)
             return FALSE;
@@ -205,37 +161,18 @@ boolean AudioProcess::callback_end()
 {
    PaError err;
 
-   if (m_disablePlay == false) {
-      if (m_play_mutex != NULL)
-         glfwLockMutex(m_play_mutex);
-   }
    if (m_audio_open == true) {
       if (m_disablePlay == false) {
-         /* close audio device */
+         /* close audio device, PortAudio callback will not be called after this */
          err = Pa_StopStream(m_play_stream);
          if (err != paNoError) return FALSE;
          err = Pa_CloseStream(m_play_stream);
          if (err != paNoError) return FALSE;
-
-         if (m_play_buffer)
-            free(m_play_buffer);
-         m_play_buffer = NULL;
+         m_play_ring.requestFlush();
       }
-      if (m_receive_buffer)
-         free(m_receive_buffer);
-      m_receive_buffer = NULL;
+      m_receive_ring.requestFlush();
 
       m_audio_open = false;
-      if (m_disablePlay == false) {
-         if (m_play_mutex != NULL) {
-            glfwUnlockMutex(m_play_mutex);
-            glfwDestroyMutex(m_play_mutex);
-         }
-         m_play_mutex = NULL;
-      }
-      if (m_receive_mutex != NULL)
-         glfwDestroyMutex(m_receive_mutex);
-      m_receive_mutex = NULL;
 
       if (m_localAdin)
          adin_mic_end(NULL);
@@ -247,8 +184,7 @@ boolean AudioProcess::callback_end()
 /* AudioProcess::callback_read: Julius callback to return new audio data to be processed */
 int AudioProcess::callback_read(SP16 *buf, int sampnum)
 {
-   unsigned long buflen;
-   int num;
+   size_t buflen;
 
    if (m_audio_open == false) {
       m_requestPlayFlush = true;
@@ -268,7 +204,7 @@ int AudioProcess::callback_read(SP16 *buf, int sampnum)
    }
 
    /* return 0 if no data exist in the buffer to be processed */
-   if (m_receive_buffer_store_point == 0) {
+   if (m_receive_ring.getReadable() == 0) {
       /* if segmentation is required, trigger segmentation here */
       if (m_want_segment) {
          m_want_segment = false;
@@ -279,42 +215,18 @@ int AudioProcess::callback_read(SP16 *buf, int sampnum)
       return 0;
    }
 
-   glfwLockMutex(m_receive_mutex);
-
    /* write at most sampnum samples at head of the buffer to audio recognition buf */
-   buflen = m_receive_buffer_store_point;
-   if (buflen > (unsigned long)sampnum)
-      buflen = sampnum;
-   memcpy(buf, m_receive_buffer, buflen * sizeof(SP16));
-
-   if (m_disablePlay == false) {
-      /* also store the new part to audio playing buffer */
-      glfwLockMutex(m_play_mutex);
+   buflen = m_receive_ring.read(buf, sampnum, true);
+
+   if (m_disablePlay == false && buflen > 0) {
+      /* also store the same part to audio playing buffer, so that playback keeps in step with recognition */
       if (m_audio_open == false) {
          m_requestPlayFlush = true;
          return -2;
       }
-      num = m_receive_buffer_store_point - m_receive_buffer_last_point;
-      unsigned long len;
-      if (m_play_buffer_current + num >= m_play_buffer_len) {
-         len = m_play_buffer_len - m_play_buffer_current;
-      } else {
-         len = num;
-      }
-      if (len > 0) {
-         memcpy(&(m_play_buffer[m_play_buffer_current]), &(m_receive_buffer[m_receive_buffer_last_point]), len * sizeof(SP16));
-         m_play_buffer_current += len;
-      }
-      glfwUnlockMutex(m_play_mutex);
+      m_play_ring.write(buf, buflen);
    }
 
-   /* shrink the buffer for the written samples */
-   if (m_receive_buffer_store_point > buflen)
-      memmove(m_receive_buffer, &(m_receive_buffer[buflen]), (m_receive_buffer_store_point - buflen) * sizeof(SP16));
-   m_receive_buffer_store_point -= buflen;
-   m_receive_buffer_last_point = m_receive_buffer_store_point;
-   glfwUnlockMutex(m_receive_mutex);
-
    return (int)buflen;
 }
 
@@ -401,15 +313,10 @@ static char *local_input_name(void *user_data)
 void AudioProcess::appendAudioData(const char *data, int len)
 {
    /* append the given audio data into Julius ad-in thread buffer */
-   int samples = len / 2;
+   /* samples will be copied to audio playing buffer when they are read by Julius */
+   size_t samples = len / 2;
 
-   // store to receive buffer
-   if (m_receive_buffer_store_point + samples >= m_receive_buffer_len)
-      return;
-   glfwLockMutex(m_receive_mutex);
-   memcpy(&(m_receive_buffer[m_receive_buffer_store_point]), data, len);
-   m_receive_buffer_store_point += samples;
-   glfwUnlockMutex(m_receive_mutex);
+   m_receive_ring.write((const short *)data, samples);
 }
 
 /* AudioProcess::audioInitialize: initialize audio */
@@ -436,6 +343,17 @@ bool AudioProcess::audioInitialize(Recog *recog)
    adin->silence_cut_default = TRUE;
    adin->enable_thread = FALSE;
 
+   /* allocate rings before Julius and receiver start to use them, at the rate of received samples */
+   m_frequency = recog->jconf->input.use_ds48to16 ? 48000 : recog->jconf->input.sfreq;
+   if (m_receive_ring.setup(m_frequency * AUDIO_PLAY_BUFFER_SIZE_IN_SEC, m_frequency) == false) {
+      jlog("ERROR: m_adin: failed to allocate audio buffer\n");
+      return false;
+   }
+   if (m_disablePlay == false && m_play_ring.setup(m_frequency * AUDIO_PLAY_BUFFER_SIZE_IN_SEC, m_frequency) == false) {
+      jlog("ERROR: m_adin: failed to allocate audio buffer\n");
+      return false;
+   }
+
    /* stand-by A/D-in, dealing 48kHz-to-16kHz downsampling */
    if (recog->jconf->input.use_ds48to16) {
       if (recog->jconf->input.use_ds48to16 && recog->jconf->input.sfreq != 16000) {
@@ -829,6 +747,16 @@ void Julius_Thread::proc()
 void Julius_Thread::procEnd()
 {
    m_sync->storeMouthShape(NULL);
+
+   /* report audio buffer statistics of this segment when audio was lost or delayed */
+   if (m_audio) {
+      unsigned int underrun = m_audio->m_play_ring.getUnderrunCount();
+      size_t dropped = m_audio->m_receive_ring.getDroppedSamples() + m_audio->m_play_ring.getDroppedSamples();
+      if (underrun > 0 || dropped > 0)
+         m_mmdagent->sendLogString(m_id, MLOG_WARNING, "audio: %u underruns, %lu samples dropped, latency %.1f msec (max %.1f msec)", underrun, (unsigned long)dropped, m_audio->m_receive_ring.getLatencyMSec(), m_audio->m_receive_ring.getMaxLatencyMSec());
+      m_audio->m_receive_ring.resetStatistics();
+      m_audio->m_play_ring.resetStatistics();
+   }
 }
 
 /* Julius_Thread::sendMessage: send message to MMDAgent */
@@ -881,10 +809,10 @@ void Julius_Thread::segmentAudio()
 void Julius_Thread::clearAudio()
 {
    if (m_audio) {
-      m_audio->m_receive_buffer_last_point = 0;
-      m_audio->m_receive_buffer_store_point = 0;
+      /* buffers are flushed by their consumers at next read */
+      m_audio->m_receive_ring.requestFlush();
       if (m_audio->m_disablePlay == false) {
-         m_audio->m_play_buffer_current = 0;
+         m_audio->m_play_ring.requestFlush();
       }
    }
 }
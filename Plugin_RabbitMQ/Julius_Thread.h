@@ -73,15 +73,8 @@ public:
    int m_frequency;                            /* sampling frequency */
    bool m_audio_open;                          /* true when audio is opened */
    PaStream *m_play_stream;                    /* audio playing stream for PortAudio */
-   SP16 *m_play_buffer;                        /* audio playing buffer */
-   unsigned long m_play_buffer_len;            /* assigned length of audio playing buffer */
-   unsigned long m_play_buffer_current;        /* current position at audio playing buffer */
-   SP16 *m_receive_buffer;                     /* buffer to hold received audio samples */
-   unsigned long m_receive_buffer_len;         /* assigned length of receive buffer */
-   unsigned long m_receive_buffer_last_point;  /* last processed point at receive buffer */
-   unsigned long m_receive_buffer_store_point; /* last storing point at receive buffer */
-   GLFWmutex m_play_mutex;                     /* mutex for audio playing thread */
-   GLFWmutex m_receive_mutex;                  /* mutex for audio receiving thread */
+   AudioRingBuffer m_play_ring;                /* audio playing buffer, from Julius ad-in thread to PortAudio callback */
+   AudioRingBuffer m_receive_ring;             /* buffer to hold received audio samples, from receiver to Julius */
    bool m_streaming;                           /* true when processing audio is streaming and VAD is required */
    bool m_want_segment;                        /* flag to tell process end of segment */
    ADIn *m_adin;                               /* pointer to audio input structure in Julius */
@@ -457,16 +457,13 @@ void RabbitMQ::parse_received_data(char *buf, int len)
          Poco::Base64Decoder decoder(istr);
          std::vector<char> decodedData;
 
-         char ch;
-         while (decoder.get(ch)) {
-            decodedData.push_back(ch);
-         }
+         /* decode in blocks, decoded samples are handed to the audio rings directly from this buffer */
+         decodedData.resize(body.size() * 3 / 4 + 4);
+         decoder.read(decodedData.data(), decodedData.size());
+         int len = (int)decoder.gcount();
 
-         int len = (int)decodedData.size();
-         char *buf = (char *)malloc(len);
-         if (buf) {
-            for (int i = 0; i < len; i++)
-               buf[i] = decodedData[i];
+         if (len > 0) {
+            const char *buf = decodedData.data();
             // disable streaming mode (== silence cut off) 
             m_sync->setStreamingSoundDataFlag(false);
             const char *audioMode = m_motion_config->getParam("audio_mode");
@@ -480,7 +477,6 @@ void RabbitMQ::parse_received_data(char *buf, int len)
                m_sync->processSoundData(buf, len, false);
             }
             m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: audio len = %d", m_name, len);
-            free(buf);
          }
       }
    }
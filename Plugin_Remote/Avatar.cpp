@@ -103,6 +103,10 @@ void Avatar::initialize()
    m_arkit.setup();
    m_exMorph.setup();
 
+   m_morphTableName = NULL;
+   m_morphTable = NULL;
+   m_morphTableNum = 0;
+
    for (int i = 0; i < LIP_NUM; i++)
       m_lipControl[i].clear();
    for (int i = 0; i < NUMACTIONUNITS; i++)
@@ -131,6 +135,8 @@ void Avatar::clear()
    if (m_noLipControl)
       delete [] m_noLipControl;
 
+   clearMorphTable();
+
    initialize();
 }
 
@@ -255,9 +261,71 @@ bool Avatar::assignModel(const char *alias)
    m_obj = obj;
    m_pmd = pmd;
 
+   // morph controls were reset, re-resolve the negotiated morph table for the new model
+   resolveMorphTable();
+
    return true;
 }
 
+// Avatar::getExMorphControl: get cached morph control for the external morph name
+MorphControl *Avatar::getExMorphControl(const char *name)
+{
+   MorphControl *m;
+   char buf[MMDAGENT_MAXBUFLEN];
+
+   if (m_obj == NULL || m_shapemap == NULL || name == NULL)
+      return NULL;
+
+   // look up the shape map only once per name, names not found in the shape map are also cached
+   m = m_exMorph.find(name);
+   if (m)
+      return m;
+   MMDAgent_snprintf(buf, MMDAGENT_MAXBUFLEN, "EXMORPH_%s", name);
+   return m_exMorph.add(name, m_shapemap->getExMorph(buf));
+}
+
+// Avatar::setMorphTable: set morph table for binary frames
+void Avatar::setMorphTable(char **names, int num)
+{
+   clearMorphTable();
+
+   if (num <= 0)
+      return;
+
+   m_morphTableName = (char **)malloc(sizeof(char *) * num);
+   m_morphTable = (MorphControl **)malloc(sizeof(MorphControl *) * num);
+   for (int i = 0; i < num; i++) {
+      m_morphTableName[i] = MMDAgent_strdup(names[i]);
+      m_morphTable[i] = NULL;
+   }
+   m_morphTableNum = num;
+
+   resolveMorphTable();
+}
+
+// Avatar::resolveMorphTable: resolve morph table entries to morph controls of current model
+void Avatar::resolveMorphTable()
+{
+   for (int i = 0; i < m_morphTableNum; i++)
+      m_morphTable[i] = getExMorphControl(m_morphTableName[i]);
+}
+
+// Avatar::clearMorphTable: clear morph table
+void Avatar::clearMorphTable()
+{
+   if (m_morphTableName) {
+      for (int i = 0; i < m_morphTableNum; i++)
+         if (m_morphTableName[i])
+            free(m_morphTableName[i]);
+      free(m_morphTableName);
+   }
+   if (m_morphTable)
+      free(m_morphTable);
+   m_morphTableName = NULL;
+   m_morphTable = NULL;
+   m_morphTableNum = 0;
+}
+
 // Avatar::setup: setup avatar control for a model
 bool Avatar::setup(MMDAgent *mmdagent, int id, bool wantLocal, bool wantPassthrough)
 {
@@ -348,19 +416,20 @@ bool Avatar::processMessage(const char *AVString)
       bool ret = assignModel(m_messageBuf[1]);
       if (m_obj) m_obj->unlock();
       return ret;
+   } else if (MMDAgent_strequal(m_messageBuf[0], "__AV_MORPHTABLE")) {
+      // negotiate morph names for binary morph frames: "__AV_MORPHTABLE,name1,name2,..."
+      setMorphTable(&(m_messageBuf[1]), n - 1);
    } else if (MMDAgent_strequal(m_messageBuf[0], "__AV_EXMORPH") && m_enable == true) {
       char *p2, *p3, *save2;
+      MorphControl *m;
       for (int i = 1; i < n; i++) {
          strcpy(buff2, m_messageBuf[i]);
          p2 = MMDAgent_strtok(buff2, "=", &save2);
          p3 = MMDAgent_strtok(NULL, "=", &save2);
          if (p2 != NULL && p3 != NULL) {
-            if (m_obj && m_shapemap) {
-               strcpy(buff3, "EXMORPH_");
-               strcat(buff3, p2);
-               PMDFaceInterface *f = m_shapemap->getExMorph(buff3);
-               m_exMorph.set(p2, f, MMDAgent_str2float(p3));
-            }
+            m = getExMorphControl(p2);
+            if (m)
+               m->setTarget(MMDAgent_str2float(p3));
          }
       }
       // reset face tracking last frame count
@@ -418,6 +487,50 @@ bool Avatar::processMessage(const char *AVString)
    return true;
 }
 
+// Avatar::processBinaryMorph: process binary morph frame body
+// the body is a sequence of little-endian float32 weights in the order of the morph table given by __AV_MORPHTABLE
+bool Avatar::processBinaryMorph(const char *data, int len)
+{
+   int num;
+   float value;
+
+   if (data == NULL || len < 0)
+      return false;
+
+   if (m_obj) {
+      // detect model change and re-assign if model change has occured
+      m_obj->lock();
+      if (m_pmd != m_obj->getPMDModel())
+         assignModel(NULL);
+   } else {
+      // model was set but not loaded yet, try assigning
+      if (m_name)
+         assignModel(NULL);
+   }
+
+   if (m_enable == false || m_obj == NULL || m_morphTableNum == 0) {
+      if (m_obj) m_obj->unlock();
+      return false;
+   }
+
+   num = len / (int)sizeof(float);
+   if (num > m_morphTableNum)
+      num = m_morphTableNum;
+   for (int i = 0; i < num; i++) {
+      if (m_morphTable[i] == NULL)
+         continue;
+      memcpy(&value, &(data[i * sizeof(float)]), sizeof(float));
+      m_morphTable[i]->setTarget(value);
+   }
+
+   // reset face tracking last frame count
+   m_faceTrackingFrameLeft = FACETRACKINGLEAVINGFRAMES + LEAVINGFRAMES;
+
+   if (m_obj) m_obj->unlock();
+
+   return true;
+}
+
 // Avatar::update: apply controlled motions to bones and morphs
 void Avatar::update(float deltaFrame)
 {
@@ -70,6 +70,10 @@ enum BONELIST {
    TRACK_NUM
 };
 
+// binary morph frame header: "AVMxxxx" where xxxx is 4-digit body length, followed by packed float32 weights
+#define AVATAR_BINARY_MORPH_HEADER    "AVM"
+#define AVATAR_BINARY_MORPH_HEADERLEN 7
+
 // number of action units
 #define NUMACTIONUNITS 46
 
@@ -108,6 +112,10 @@ private:
    MorphControlSet m_arkit;
    MorphControlSet m_exMorph;
 
+   char **m_morphTableName;         // morph names negotiated by __AV_MORPHTABLE, indexed by binary frame
+   MorphControl **m_morphTable;     // resolved morph controls for m_morphTableName
+   int m_morphTableNum;             // number of entries in morph table
+
    float m_leavingFrameLeft;
    bool m_issueLeaveEvent;
 
@@ -142,6 +150,18 @@ private:
    // assignModel: assign model
    bool assignModel(const char *alias);
 
+   // getExMorphControl: get cached morph control for the external morph name
+   MorphControl *getExMorphControl(const char *name);
+
+   // setMorphTable: set morph table for binary frames
+   void setMorphTable(char **names, int num);
+
+   // resolveMorphTable: resolve morph table entries to morph controls of current model
+   void resolveMorphTable();
+
+   // clearMorphTable: clear morph table
+   void clearMorphTable();
+
 #ifdef LIPSYNC_JULIUS
    // startJulius: start Julius thread
    void startJulius(const char *conffile, bool wantLocal, bool wantPassthrough);
@@ -161,6 +181,9 @@ public:
    // processMessage: process message from openface
    bool processMessage(const char *AVString);
 
+   // processBinaryMorph: process binary morph frame body
+   bool processBinaryMorph(const char *data, int len);
+
    // update: apply controlled motions to bones and morphs
    void update(float deltaFrame);
 
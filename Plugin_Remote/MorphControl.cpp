@@ -154,6 +154,24 @@ bool MorphControlSet::set(const char *shapeName, PMDFaceInterface *interface, fl
    return true;
 }
 
+// MorphControlSet::add: get control for the shape name, register it if not yet (interface can be NULL to remember missing shape)
+MorphControl *MorphControlSet::add(const char *shapeName, PMDFaceInterface *interface)
+{
+   MorphControl *m;
+   int len;
+
+   if (m_index == NULL)
+      return NULL;
+
+   len = (int)MMDAgent_strlen(shapeName);
+   if (m_index->search(shapeName, len, (void **)&m) == true)
+      return m;
+
+   m = new MorphControl(interface, 0.0f);
+   m_index->add(shapeName, len, (void *)m);
+   return m;
+}
+
 /* MorphControlSet::find: find MorphControl in the index */
 MorphControl *MorphControlSet::find(const char *shapeName)
 {
@@ -82,6 +82,9 @@ public:
    // set: set control for the shape name on the model
    bool set(const char *shapeName, PMDFaceInterface *interface, float value);
 
+   // add: get control for the shape name, register it if not yet (interface can be NULL to remember missing shape)
+   MorphControl *add(const char *shapeName, PMDFaceInterface *interface);
+
    /* find: find morphinfo in the index */
    MorphControl *find(const char *shapeName);
 
@@ -29,9 +29,15 @@
 // host name to connect at client mode
 #define PLUGIN_REMOVE_CLIENT_CONNECT_DEFAULT_HOSTNAME "localhost"
 
-// maximum number of clients in server mode
+// default maximum number of clients in server mode
 #define PLUGIN_REMOTE_MAXCLIENT 20
 
+// maximum length of pending outbound data per client, messages are dropped for the client when exceeds
+#define PLUGIN_REMOTE_MAXSENDBUFLEN 1048576
+
+// timeout of waiting socket events in msec, outbound messages are flushed at least in this interval
+#define PLUGIN_REMOTE_EVENT_WAIT_MSEC 10
+
 // connection retry interval in sec.
 #define PLUGIN_REMOTE_CONNECTION_ERROR_RETRY_INTERVAL_SEC 0.5
 #define PLUGIN_REMOTE_CONNECTION_OTHER_RETRY_INTERVAL_SEC 0.2
@@ -63,6 +69,8 @@
 #define PLUGIN_REMOTE_CONFIG_MOVE_RATE_UPDOWN    "Plugin_Remote_MoveRateUpDown"
 // configuration key for left-right moving relative scale (default: CENTERBONE_ADDITIONALMOVECOEF_SCALE_RELATIVE_X)
 #define PLUGIN_REMOTE_CONFIG_MOVE_RATE_SLIDE     "Plugin_Remote_MoveRateSlide"
+// configuration key for maximum number of clients in server mode (default: PLUGIN_REMOTE_MAXCLIENT)
+#define PLUGIN_REMOTE_CONFIG_MAXCLIENT           "Plugin_Remote_MaxClient"
 
 
 // old bogus keys (still active)
@@ -157,6 +165,42 @@ static std::string makeRandomString(int length) {
    return random_string;
 }
 
+/* checkBinaryMorphHeader: check if data begins with binary morph frame header, return 1 if yes, 0 if no, -1 if need more data */
+static int checkBinaryMorphHeader(const char *buff, int len)
+{
+   int i;
+
+   for (i = 0; i < AVATAR_BINARY_MORPH_HEADERLEN; i++) {
+      if (i >= len)
+         return -1;
+      if (i < 3) {
+         if (buff[i] != AVATAR_BINARY_MORPH_HEADER[i])
+            return 0;
+      } else {
+         if (buff[i] < '0' || buff[i] > '9')
+            return 0;
+      }
+   }
+   return 1;
+}
+
+/* RemoteConnection: connection to a client */
+struct RemoteConnection {
+   socket_t sd;         // socket
+   bool processing;     // true when a client is connected and message transfer is undergo
+   bool isWebSocket;    // true when this is websocket connection handled by Poco
+   char *hostName;      // client host name
+   Avatar *avatar;      // avatar controlled by this client
+   char *rbuf;          // receive buffer to re-assemble messages, SOCKET_MAXBUFLEN bytes
+   int rlen;            // length of received data pending in rbuf
+   char *wbuf;          // send buffer holding outbound data not yet written
+   int wstart;          // start point of pending outbound data in wbuf
+   int wlen;            // length of pending outbound data in wbuf
+   int wsize;           // allocated length of wbuf
+   bool wdropped;       // true while outbound messages are dropped due to full send buffer
+   bool wwatch;         // true while write event is watched for this socket
+};
+
 /* RemotePlugin class */
 class RemotePlugin {
 
@@ -176,19 +220,15 @@ private:
    char *m_ws_dir;
    int m_clientNum;           // number of maximum connected clients
    int m_validClientNum;      // number of valid clients
-   char *m_clientHostName[PLUGIN_REMOTE_MAXCLIENT];    // client host names
-   bool m_processing[PLUGIN_REMOTE_MAXCLIENT];         // true when a client is connected and message transfer is undergo
-   socket_t m_sd[PLUGIN_REMOTE_MAXCLIENT];                  // socket to clients
+   int m_maxClient;           // allocated number of clients
+   RemoteConnection *m_conn;  // client connections
+   SocketEvent *m_events;     // socket event buffer
    int m_portNum;             // port number
    int m_portNumListen;
    char *m_serverHostName;    // server host name
-   Avatar *m_avatar[PLUGIN_REMOTE_MAXCLIENT];
    int m_retryCount;
    FILE *m_fpLog;
 
-   int m_len;
-   int m_bp;
-
    char m_statusString[MMDAGENT_MAXBUFLEN];
    bool m_statusStringUpdated;
    FTGLTextDrawElements m_elem;
@@ -202,8 +242,6 @@ private:
    // initialize
    void initialize()
    {
-      int i;
-
       m_mmdagent = NULL;
       m_id = 0;
       m_thread = NULL;
@@ -217,19 +255,14 @@ private:
       m_ws_dir = NULL;
       m_clientNum = 0;
       m_validClientNum = 0;
-      for (i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         m_clientHostName[i] = NULL;
-         m_processing[i] = false;
-         m_sd[i] = SOCKET_INVALID;
-         m_avatar[i] = NULL;
-      }
+      m_maxClient = 0;
+      m_conn = NULL;
+      m_events = NULL;
       m_portNum = PLUGIN_REMOTE_DEFAULT_PORT;
       m_portNumListen = PLUGIN_REMOTE_DEFAULT_PORT;
       m_serverHostName = NULL;
       m_retryCount = 0;
       m_fpLog = NULL;
-      m_len = 0;
-      m_bp = 0;
       m_statusStringUpdated = false;
       memset(&m_elem, 0, sizeof(FTGLTextDrawElements));
       memset(&m_elemOutline, 0, sizeof(FTGLTextDrawElements));
@@ -252,16 +285,25 @@ private:
       if (m_elemOutline.indices) free(m_elemOutline.indices);
       if (m_serverHostName)
          free(m_serverHostName);
-      for (i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         if (m_clientHostName[i] != NULL)
-            free(m_clientHostName[i]);
-         if (m_avatar[i])
-            delete m_avatar[i];
-      }
       if (m_thread != NULL)
          delete m_thread;
       if (m_net != NULL)
          delete m_net;
+      if (m_conn) {
+         for (i = 0; i < m_maxClient; i++) {
+            if (m_conn[i].hostName != NULL)
+               free(m_conn[i].hostName);
+            if (m_conn[i].avatar)
+               delete m_conn[i].avatar;
+            if (m_conn[i].rbuf)
+               free(m_conn[i].rbuf);
+            if (m_conn[i].wbuf)
+               free(m_conn[i].wbuf);
+         }
+         free(m_conn);
+      }
+      if (m_events)
+         free(m_events);
       if (m_ws_host)
          free(m_ws_host);
       if (m_ws_dir)
@@ -294,37 +336,57 @@ private:
          m_displayStatusDurationFrame = STATUS_STRING_DISPLAY_DURATION_FRAMES;
    }
 
+   // reset a connection slot
+   void resetConnection(RemoteConnection *rc)
+   {
+      rc->sd = SOCKET_INVALID;
+      rc->processing = false;
+      rc->isWebSocket = false;
+      rc->hostName = NULL;
+      rc->rlen = 0;
+      rc->wstart = 0;
+      rc->wlen = 0;
+      rc->wdropped = false;
+      rc->wwatch = false;
+   }
+
    // add client
-   int addClient(socket_t sd)
+   int addClient(socket_t sd, bool isWebSocket = false)
    {
       int i;
       int c;
+      RemoteConnection *rc;
 
       for (i = 0; i < m_clientNum; i++) {
-         if (m_processing[i] == false)
+         if (m_conn[i].processing == false)
             break;
       }
       if (i >= m_clientNum) {
-         c = m_clientNum;
-         m_clientNum++;
-         if (m_clientNum > PLUGIN_REMOTE_MAXCLIENT) {
-            sendLog(MLOG_ERROR, "number of client reaches limit (%d)", PLUGIN_REMOTE_MAXCLIENT);
+         if (m_clientNum >= m_maxClient) {
+            sendLog(MLOG_ERROR, "number of client reaches limit (%d)", m_maxClient);
             return -1;
          }
+         c = m_clientNum;
+         m_clientNum++;
       }
       else {
          c = i;
       }
-      m_sd[c] = sd;
-      m_processing[c] = true;
-      if (m_net) {
+      rc = &(m_conn[c]);
+      resetConnection(rc);
+      rc->sd = sd;
+      rc->processing = true;
+      rc->isWebSocket = isWebSocket;
+      if (rc->rbuf == NULL)
+         rc->rbuf = (char *)malloc(SOCKET_MAXBUFLEN);
+      if (m_net && isWebSocket == false) {
          if (m_net->getClientHostName() != NULL) {
-            m_clientHostName[c] = MMDAgent_strdup(m_net->getClientHostName());
-            m_mmdagent->sendMessage(m_id, PLUGIN_EVENT_CONNECTED, "%s", m_clientHostName[c]);
+            rc->hostName = MMDAgent_strdup(m_net->getClientHostName());
+            m_mmdagent->sendMessage(m_id, PLUGIN_EVENT_CONNECTED, "%s", rc->hostName);
          }
       }
-      if (m_avatar[c] == NULL)
-         m_avatar[c] = new Avatar();
+      if (rc->avatar == NULL)
+         rc->avatar = new Avatar();
 
       KeyValue* k = m_mmdagent->getKeyValue();
 
@@ -354,7 +416,7 @@ private:
             }
          }
       }
-      m_avatar[c]->setup(m_mmdagent, m_id, local_lipsync, local_lipsync ? local_passthrough : true);
+      rc->avatar->setup(m_mmdagent, m_id, local_lipsync, local_lipsync ? local_passthrough : true);
 
       if (local_lipsync == true) {
          if (m_mmdagent->findModelAlias("0") >= 0) {
@@ -383,28 +445,125 @@ private:
       if (c < 0 || c >= m_clientNum)
          return;
 
-      if (m_processing[c] == false)
+      if (m_conn[c].processing == false)
          return;
 
-      if (m_net) {
-         m_net->closeSocket(m_sd[c]);
-         m_net->shutdown(m_sd[c]);
-         if (m_clientHostName[c] != NULL) {
-            m_mmdagent->sendMessage(m_id, PLUGIN_EVENT_DISCONNECTED, "%s", m_clientHostName[c]);
-            free(m_clientHostName[c]);
-            m_clientHostName[c] = NULL;
-         }
+      if (m_net && m_conn[c].isWebSocket == false) {
+         m_net->shutdown(m_conn[c].sd);
+         m_net->closeSocket(m_conn[c].sd);
+      }
+      if (m_conn[c].hostName != NULL) {
+         m_mmdagent->sendMessage(m_id, PLUGIN_EVENT_DISCONNECTED, "%s", m_conn[c].hostName);
+         free(m_conn[c].hostName);
       }
-      m_sd[c] = SOCKET_INVALID;
-      m_processing[c] = false;
-      if (m_avatar[c]) {
-         delete m_avatar[c];
-         m_avatar[c] = NULL;
+      if (m_conn[c].avatar) {
+         delete m_conn[c].avatar;
+         m_conn[c].avatar = NULL;
       }
+      resetConnection(&(m_conn[c]));
 
       m_validClientNum--;
    }
 
+   // add client of a connected socket and start watching its events, the socket is closed on failure
+   int addSocketClient(socket_t sd)
+   {
+      int c;
+
+      c = addClient(sd);
+      if (c < 0) {
+         m_net->shutdown(sd);
+         m_net->closeSocket(sd);
+         return -1;
+      }
+      m_net->setNonBlocking(sd);
+      if (m_net->addEventSocket(sd) == false) {
+         removeClient(c);
+         return -1;
+      }
+      return c;
+   }
+
+   // receive data from a client and process it, return false when the client was closed
+   bool receiveData(int c)
+   {
+      RemoteConnection *rc = &(m_conn[c]);
+      int len;
+
+      len = m_net->recv(rc->sd, &(rc->rbuf[rc->rlen]), SOCKET_MAXBUFLEN - 1 - rc->rlen);
+      if (len == SOCKET_WOULDBLOCK)
+         return true;
+      if (len <= 0) {
+         // other end error (may be disconnected), close it
+         removeClient(c);
+         return false;
+      }
+      rc->rlen = processMessageData(c, rc->rbuf, rc->rlen + len);
+      return true;
+   }
+
+   // find client of the socket, return -1 if not found
+   int findClient(socket_t sd)
+   {
+      for (int i = 0; i < m_clientNum; i++) {
+         if (m_conn[i].processing == true && m_conn[i].isWebSocket == false && m_conn[i].sd == sd)
+            return i;
+      }
+      return -1;
+   }
+
+   // queue outbound data to a client, drop it when the client does not consume fast enough
+   void queueSendData(int c, const char *data, int len)
+   {
+      RemoteConnection *rc = &(m_conn[c]);
+
+      if (rc->wlen + len > PLUGIN_REMOTE_MAXSENDBUFLEN) {
+         if (rc->wdropped == false) {
+            m_mmdagent->sendLogString(m_id, MLOG_WARNING, "client %d is too slow, dropping outbound messages", c);
+            rc->wdropped = true;
+         }
+         return;
+      }
+      rc->wdropped = false;
+      if (rc->wstart + rc->wlen + len > rc->wsize) {
+         // compact pending data to the top, and expand buffer if still not enough
+         if (rc->wlen > 0 && rc->wstart > 0)
+            memmove(rc->wbuf, &(rc->wbuf[rc->wstart]), rc->wlen);
+         rc->wstart = 0;
+         if (rc->wlen + len > rc->wsize) {
+            rc->wsize = rc->wlen + len + SOCKET_MAXBUFLEN;
+            rc->wbuf = (char *)realloc(rc->wbuf, rc->wsize);
+         }
+      }
+      memcpy(&(rc->wbuf[rc->wstart + rc->wlen]), data, len);
+      rc->wlen += len;
+   }
+
+   // write pending outbound data of a client as much as possible, return false on error
+   bool flushSendData(int c)
+   {
+      RemoteConnection *rc = &(m_conn[c]);
+      int ret;
+
+      while (rc->wlen > 0) {
+         ret = m_net->send(rc->sd, &(rc->wbuf[rc->wstart]), rc->wlen);
+         if (ret == SOCKET_WOULDBLOCK)
+            break;
+         if (ret <= 0)
+            return false;
+         rc->wstart += ret;
+         rc->wlen -= ret;
+      }
+      if (rc->wlen == 0)
+         rc->wstart = 0;
+      // watch write event only while data is pending
+      if (rc->wwatch != (rc->wlen > 0)) {
+         rc->wwatch = (rc->wlen > 0);
+         m_net->setEventWritable(rc->sd, rc->wwatch);
+      }
+      return true;
+   }
+
 public:
 
    RemotePlugin()
@@ -461,6 +620,20 @@ public:
 
       m_retryCount = MMDAgent_str2int(mmdagent->getKeyValue()->getString(PLUGIN_REMOTE_CONFIG_RETRY_COUNT, "0"));
 
+      // allocate client connections
+      m_maxClient = MMDAgent_str2int(mmdagent->getKeyValue()->getString(PLUGIN_REMOTE_CONFIG_MAXCLIENT, "0"));
+      if (m_maxClient <= 0)
+         m_maxClient = PLUGIN_REMOTE_MAXCLIENT;
+      m_conn = (RemoteConnection *)malloc(sizeof(RemoteConnection) * m_maxClient);
+      for (int i = 0; i < m_maxClient; i++) {
+         m_conn[i].avatar = NULL;
+         m_conn[i].rbuf = NULL;
+         m_conn[i].wbuf = NULL;
+         m_conn[i].wsize = 0;
+         resetConnection(&(m_conn[i]));
+      }
+      m_events = (SocketEvent *)malloc(sizeof(SocketEvent) * (m_maxClient + 1));
+
       m_thread = new Thread;
       m_thread->setup();
    }
@@ -472,11 +645,8 @@ public:
 
       m_clientNum = 0;
       m_validClientNum = 0;
-      for (i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         m_clientHostName[i] = NULL;
-         m_processing[i] = false;
-         m_sd[i] = SOCKET_INVALID;
-      }
+      for (i = 0; i < m_maxClient; i++)
+         resetConnection(&(m_conn[i]));
       if (m_thread->isRunning() == false) {
          m_active = true;
          m_thread->addThread(glfwCreateThread(mainThread, this));
@@ -494,16 +664,12 @@ public:
       if (is_active() == false)
          return;
 
+      // thread waits socket events with timeout, so it will notice this and proceed to end
       m_active = false;
-      if (m_net) {
-         if (m_serverMode && m_net->isServerStarted())
-            // thread may be waiting socket at select(), so connect to the thread to let the thread proceed to end
-            m_net->makeConnection("localhost", m_portNumListen);
-      }
+      m_thread->stop();
       // shutdown clients
       for (i = 0; i < m_clientNum; i++)
          removeClient(i);
-      m_thread->stop();
    }
 
    // return true when main thread is active
@@ -531,131 +697,159 @@ public:
          m_thread->enqueueBuffer(1, str, NULL);
    }
 
-   void processMessageData(int avatarId, char buff[])
+   // process received data of a client, return length of incomplete data left at the top of buffer
+   int processMessageData(int c, char *buff, int len)
    {
       char buff2[SOCKET_MAXBUFLEN];
       char buff3[SOCKET_MAXBUFLEN];
       char buf_timestamp[MMDAGENT_MAXBUFLEN];
-      bool binary_mode;
+      Avatar *avatar = m_conn[c].avatar;
+      char *p = buff;
       int slen;
       int snd_header_len;
+      int tlen;
+      int ret;
 
-      if (m_avatar[avatarId])
-         m_avatar[avatarId]->resetIdleTime();
+      if (avatar)
+         avatar->resetIdleTime();
 
       // loop until the given data is fully processed or require next data chunk
-      while (m_len > 0) {
-         binary_mode = false;
-         // check if this chunk is binary chunk of audio data or text chunk
-         // audio data chunk should be "SNDxxxx" where xxxx is 4-digit data length + data body
-         // not that the length of an audio chunk should not exceed SOCKET_MAXBUFLEN-7
-         if (buff[0] == 'S') {
-            if (m_len < 7) {
+      // p points to the head of unprocessed data and len is its length
+      while (len > 0) {
+         // check if this chunk is binary morph frame: "AVMxxxx" where xxxx is 4-digit data length + packed float weights
+         if (p[0] == 'A') {
+            ret = checkBinaryMorphHeader(p, len);
+            if (ret < 0) {
                // short of data
-               m_bp = m_len;
                break;
             }
-            if (buff[1] == 'N' && buff[2] == 'D') {
-               buff2[0] = buff[3];
-               buff2[1] = buff[4];
-               buff2[2] = buff[5];
-               buff2[3] = buff[6];
+            if (ret > 0) {
+               memcpy(buff2, &(p[3]), 4);
                buff2[4] = '\0';
-               snd_header_len = 0;
-               if (MMDAgent_strequal(buff2, "STRM")) {
-                  // "SNDSTRM" -> cut silence (for live streaming, default)
-                  if (m_avatar[avatarId])
-                     m_avatar[avatarId]->setStreamingSoundDataFlag(true);
-                  snd_header_len = 7;
-                  m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDSTRM received, silence cut on");
-               } else if (MMDAgent_strequal(buff2, "FILE")) {
-                  // "SNDFILE" -> no silence cut (for audio file, needs explicit end-of-segment)
-                  if (m_avatar[avatarId])
-                     m_avatar[avatarId]->setStreamingSoundDataFlag(false);
-                  snd_header_len = 7;
-                  m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDFILE received, silence cut off");
-               } else if (MMDAgent_strequal(buff2, "BRKS")) {
-                  // "SNDBRKS" -> end-of-segment break code
-                  if (m_avatar[avatarId])
-                     m_avatar[avatarId]->segmentSoundData();
-                  snd_header_len = 7;
-                  m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDBRKS received");
-               }
-               if (snd_header_len != 0) {
-                  if (snd_header_len < m_len && buff[snd_header_len] == '\n') {
-                     snd_header_len += 1;
-                  } else if (snd_header_len + 1 < m_len && buff[snd_header_len] == '\r' && buff[snd_header_len + 1] == '\n') {
-                     snd_header_len += 2;
-                  }
-                  memmove(&(buff[0]), &(buff[snd_header_len]), SOCKET_MAXBUFLEN - snd_header_len);
-                  m_len -= snd_header_len;
-                  continue;
-               }
                slen = MMDAgent_str2int(buff2);
-               if (m_len < slen + 7) {
+               if (slen > SOCKET_MAXBUFLEN - 1 - AVATAR_BINARY_MORPH_HEADERLEN) {
+                  // will never fit in buffer, skip the header
+                  m_mmdagent->sendLogString(m_id, MLOG_ERROR, "binary morph frame too long: %d", slen);
+                  slen = 0;
+               } else if (len < slen + AVATAR_BINARY_MORPH_HEADERLEN) {
                   // short of data
-                  m_bp = m_len;
                   break;
+               } else if (avatar) {
+                  avatar->processBinaryMorph(&(p[AVATAR_BINARY_MORPH_HEADERLEN]), slen);
                }
-               binary_mode = true;
+               p += AVATAR_BINARY_MORPH_HEADERLEN + slen;
+               len -= AVATAR_BINARY_MORPH_HEADERLEN + slen;
+               continue;
             }
          }
-         if (binary_mode) {
-            // process the binary audio data chunk
-            if (m_avatar[avatarId])
-               m_avatar[avatarId]->processSoundData(&(buff[7]), slen);
-            // shrink buffer for next chunk and loop
-            memmove(&(buff[0]), &(buff[7 + slen]), SOCKET_MAXBUFLEN - (7 + slen));
-            m_len -= 7 + slen;
-         } else {
-            // process as text chunk
-            char *lp, *lpsave;
-            int tlen;
-            // make sure to terminate
-            memcpy(buff2, buff, SOCKET_MAXBUFLEN);
-            buff2[m_len] = '\0';
-            lp = MMDAgent_strtok(buff2, "\r\n", &lpsave);
-            /* check if this message ends in this buffer */
-            tlen = (int)MMDAgent_strlen(lp);
-            if (buff[tlen] != '\n' && buff[tlen] != '\r') {
-               // not terminated with "\r\n", means this token is not a full chunk
-               // wait for next data
-               m_bp = m_len;
+         // check if this chunk is binary chunk of audio data or text chunk
+         // audio data chunk should be "SNDxxxx" where xxxx is 4-digit data length + data body
+         // not that the length of an audio chunk should not exceed SOCKET_MAXBUFLEN-7
+         if (p[0] == 'S' && (len < 2 || p[1] == 'N') && (len < 3 || p[2] == 'D')) {
+            if (len < 7) {
+               // short of data
                break;
             }
-            // if avatar controll message, pass it to avatar module
-            if (MMDAgent_strheadmatch(lp, "__AV_MESSAGE,")) {
-               // pass raw message to message queue
-               char *p, *q, *psave;
-               strcpy(buff3, &lp[13]);
-               p = MMDAgent_strtok(buff3, "|", &psave);
-               q = MMDAgent_strtok(NULL, "\r\n", &psave);
-               // enqueue the received message to pass to MMDAgent
-               m_thread->enqueueBuffer(0, p, q);
-            } else if (MMDAgent_strheadmatch(lp, "__AV")) {
-               // protocol message other than SND, pass to Avatar class
-               if (m_avatar[avatarId])
-                  m_avatar[avatarId]->processMessage(lp);
-            } else {
-               // if does not have "__AV", just pass it to message queue as old Plugin_Remote
-               char *p, *q, *psave;
-               strcpy(buff3, lp);
-               p = MMDAgent_strtok(buff3, "|", &psave);
-               q = MMDAgent_strtok(NULL, "\r\n", &psave);
-               m_thread->enqueueBuffer(0, p, q);
+            buff2[0] = p[3];
+            buff2[1] = p[4];
+            buff2[2] = p[5];
+            buff2[3] = p[6];
+            buff2[4] = '\0';
+            snd_header_len = 0;
+            if (MMDAgent_strequal(buff2, "STRM")) {
+               // "SNDSTRM" -> cut silence (for live streaming, default)
+               if (avatar)
+                  avatar->setStreamingSoundDataFlag(true);
+               snd_header_len = 7;
+               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDSTRM received, silence cut on");
+            } else if (MMDAgent_strequal(buff2, "FILE")) {
+               // "SNDFILE" -> no silence cut (for audio file, needs explicit end-of-segment)
+               if (avatar)
+                  avatar->setStreamingSoundDataFlag(false);
+               snd_header_len = 7;
+               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDFILE received, silence cut off");
+            } else if (MMDAgent_strequal(buff2, "BRKS")) {
+               // "SNDBRKS" -> end-of-segment break code
+               if (avatar)
+                  avatar->segmentSoundData();
+               snd_header_len = 7;
+               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "SNDBRKS received");
+            }
+            if (snd_header_len != 0) {
+               // trailing newline after the header will be skipped as empty line
+               p += snd_header_len;
+               len -= snd_header_len;
+               continue;
             }
-            if (m_fpLog) {
-               // log to file
-               MMDAgent_gettimestampstr(buf_timestamp, MMDAGENT_MAXBUFLEN, "%4d/%02d/%02d %02d:%02d:%02d.%03d");
-               fprintf(m_fpLog, "%s %s\n", buf_timestamp, lp);
+            slen = MMDAgent_str2int(buff2);
+            if (len < slen + 7) {
+               // short of data
+               break;
             }
-            // shrink the buffer for one chunk and loop
-            slen = (int)MMDAgent_strlen(lp);
-            while (buff[slen] == '\r' || buff[slen] == '\n') slen++;
-            memmove(&(buff[0]), &(buff[slen]), SOCKET_MAXBUFLEN - (slen));
-            m_len -= slen;
+            // process the binary audio data chunk
+            if (avatar)
+               avatar->processSoundData(&(p[7]), slen);
+            p += 7 + slen;
+            len -= 7 + slen;
+            continue;
+         }
+         // skip newline codes left at the head
+         if (p[0] == '\r' || p[0] == '\n') {
+            p++;
+            len--;
+            continue;
          }
+         // process as text chunk, find end of line
+         for (tlen = 0; tlen < len; tlen++)
+            if (p[tlen] == '\r' || p[tlen] == '\n')
+               break;
+         if (tlen >= len) {
+            // not terminated with "\r\n", means this token is not a full chunk
+            // wait for next data
+            break;
+         }
+         memcpy(buff2, p, tlen);
+         buff2[tlen] = '\0';
+         // if avatar controll message, pass it to avatar module
+         if (MMDAgent_strheadmatch(buff2, "__AV_MESSAGE,")) {
+            // pass raw message to message queue
+            char *q1, *q2, *psave;
+            strcpy(buff3, &buff2[13]);
+            q1 = MMDAgent_strtok(buff3, "|", &psave);
+            q2 = MMDAgent_strtok(NULL, "\r\n", &psave);
+            // enqueue the received message to pass to MMDAgent
+            m_thread->enqueueBuffer(0, q1, q2);
+         } else if (MMDAgent_strheadmatch(buff2, "__AV")) {
+            // protocol message other than SND, pass to Avatar class
+            if (avatar)
+               avatar->processMessage(buff2);
+         } else {
+            // if does not have "__AV", just pass it to message queue as old Plugin_Remote
+            char *q1, *q2, *psave;
+            strcpy(buff3, buff2);
+            q1 = MMDAgent_strtok(buff3, "|", &psave);
+            q2 = MMDAgent_strtok(NULL, "\r\n", &psave);
+            m_thread->enqueueBuffer(0, q1, q2);
+         }
+         if (m_fpLog) {
+            // log to file
+            MMDAgent_gettimestampstr(buf_timestamp, MMDAGENT_MAXBUFLEN, "%4d/%02d/%02d %02d:%02d:%02d.%03d");
+            fprintf(m_fpLog, "%s %s\n", buf_timestamp, buff2);
+         }
+         p += tlen;
+         len -= tlen;
+      }
+
+      // move the incomplete chunk to the top of buffer to wait for the rest
+      if (len > 0 && p != buff)
+         memmove(buff, p, len);
+      if (len >= SOCKET_MAXBUFLEN - 1) {
+         // buffer is full but no chunk is complete, discard
+         m_mmdagent->sendLogString(m_id, MLOG_ERROR, "too long message from client %d, discarded", c);
+         len = 0;
       }
+
+      return len;
    }
 
    // make websocket connection
@@ -743,7 +937,7 @@ public:
       if (connected == false) {
          return -1;
       } else {
-         ws_c = addClient(0);
+         ws_c = addClient(0, true);
          if (ws_c < 0) {
             sendLog(MLOG_ERROR, "failed to assign control for websocket connection");
             return -1;
@@ -789,7 +983,7 @@ public:
             sendLog(MLOG_ERROR, "Error: failed to connect to %s:%d (tried for %d seconds)", m_serverHostName, m_portNum, triedSeconds);
          return false;
       } else {
-         if (addClient(sd) < 0) {
+         if (addSocketClient(sd) < 0) {
             sendLog(MLOG_ERROR, "failed to assign control");
             return false;
          } else {
@@ -802,13 +996,14 @@ public:
    // main processing loop
    bool process()
    {
-      int i;
-      socket_t sd, rsd;
+      int i, j;
+      socket_t sd;
       int c;
-      char buff[SOCKET_MAXBUFLEN];
+      int len;
+      int num;
       char buff2[SOCKET_MAXBUFLEN];
-      socket_t valid_sd[PLUGIN_REMOTE_MAXCLIENT];
       int valid_num;
+      int last_valid_num = -1;
       Poco::Net::Socket::SocketList readList;
       Poco::Net::Socket::SocketList writeList;
       Poco::Net::Socket::SocketList exceptList;
@@ -846,16 +1041,13 @@ public:
             return false;
       }
 
-      m_bp = 0;
       // socket processing loop
       while (is_active()) {
-         // make a list of valid sd
+         // count valid clients
          valid_num = 0;
          for (i = 0; i < m_clientNum; i++) {
-            if (m_processing[i] == true) {
-               valid_sd[valid_num] = m_sd[i];
+            if (m_conn[i].processing == true && m_conn[i].isWebSocket == false)
                valid_num++;
-            }
          }
 
          if (m_clientConnect == true) {
@@ -872,10 +1064,11 @@ public:
          }
 
          if (m_serverMode) {
-            if (valid_num == 0) {
+            if (valid_num == 0 && last_valid_num != 0) {
                sendLog(MLOG_STATUS, "closed all, listening port %d", m_portNumListen);
             }
          }
+         last_valid_num = valid_num;
 
          if (m_webSocketMode) {
 
@@ -889,19 +1082,20 @@ public:
                Poco::Timespan timeout(0, 10000);
                if (Poco::Net::Socket::select(readList, writeList, exceptList, timeout) > 0) {
                   if (std::find(readList.begin(), readList.end(), *ws) != readList.end()) {
+                     RemoteConnection *rc = &(m_conn[ws_c]);
                      int flags = 0;
                      {
                         std::lock_guard<std::mutex> lock(m_stdmutex);
-                        m_len = ws->receiveFrame(&(buff[m_bp]), SOCKET_MAXBUFLEN - 1 - m_bp, flags);
+                        len = ws->receiveFrame(&(rc->rbuf[rc->rlen]), SOCKET_MAXBUFLEN - 1 - rc->rlen, flags);
                      }
                      if ((flags & Poco::Net::WebSocket::FRAME_OP_BITMASK) == Poco::Net::WebSocket::FRAME_OP_PING) {
-                        ws->sendFrame(&(buff[m_bp]), m_len == 0 ? 1 : m_len, Poco::Net::WebSocket::FRAME_OP_PONG | Poco::Net::WebSocket::FRAME_FLAG_FIN);
+                        ws->sendFrame(&(rc->rbuf[rc->rlen]), len == 0 ? 1 : len, Poco::Net::WebSocket::FRAME_OP_PONG | Poco::Net::WebSocket::FRAME_FLAG_FIN);
                         continue;
                      }
                      if ((flags & Poco::Net::WebSocket::FRAME_OP_BITMASK) == Poco::Net::WebSocket::FRAME_OP_PONG) {
                         continue;
                      }
-                     if (m_len <= 0) {
+                     if (len <= 0) {
                         // other end error (may be disconnected)
                         removeClient(ws_c);
                         ws->close();
@@ -912,15 +1106,15 @@ public:
                            return false;
                         continue;
                      } else {
-                        m_len += m_bp;
-                        m_bp = 0;
-                        if (MMDAgent_strheadmatch(buff, "__peer_disconnected__")) {
+                        len += rc->rlen;
+                        rc->rlen = 0;
+                        if (MMDAgent_strheadmatch(rc->rbuf, "__peer_disconnected__")) {
                            // peer disconnection notification
-                           if (m_avatar[ws_c])
-                              m_avatar[ws_c]->setEnableFlag(false);
+                           if (rc->avatar)
+                              rc->avatar->setEnableFlag(false);
                         }
                         // process the received message
-                        processMessageData(ws_c, buff);
+                        rc->rlen = processMessageData(ws_c, rc->rbuf, len);
                      }
                   }
                } else {
@@ -944,59 +1138,60 @@ public:
             }
          }
          if (m_serverMode || m_clientConnect) {
-            // wait for socket to ready
-            ServerClient::kStatus status;
-            status = m_net->waitData(valid_sd, valid_num, &rsd);
+            // wait for socket events, with timeout to flush outbound messages
+            num = m_net->waitEvents(m_events, m_maxClient + 1, PLUGIN_REMOTE_EVENT_WAIT_MSEC);
 
             // when deactivated by another thread, exit immediately
             if (!is_active())
                break;
 
-            // check socket status
-            if (status == ServerClient::SOCKET_HASERROR) {
+            if (num < 0) {
                // an error occur
-               sendLog(MLOG_ERROR, "error in selecting socket");
+               sendLog(MLOG_ERROR, "error in waiting socket events");
                break;
-            } else if (status == ServerClient::SOCKET_CONNECT) {
-               // new connection arrives
-               sd = m_net->acceptFrom();
-               if (sd == SOCKET_INVALID) {
-                  sendLog(MLOG_ERROR, "error in accepting connection");
-                  break;
-               }
-               addClient(sd);
-               sendLog(MLOG_STATUS, "new connection established, total %d peers", m_validClientNum);
-               continue;
-            } else if (status == ServerClient::SOCKET_READABLE) {
-               // received message from the other end, then enqueue it
-               c = -1;
-               for (i = 0; i < m_clientNum; i++) {
-                  if (m_processing[i] == false) continue;
-                  if (m_sd[i] == rsd) {
-                     c = i;
-                     break;
+            }
+
+            for (j = 0; j < num; j++) {
+               if (m_net->isServerSocket(m_events[j].sd)) {
+                  // new connection arrives
+                  sd = m_net->acceptFrom();
+                  if (sd == SOCKET_INVALID) {
+                     sendLog(MLOG_ERROR, "error in accepting connection");
+                     continue;
                   }
+                  if (addSocketClient(sd) >= 0)
+                     sendLog(MLOG_STATUS, "new connection established, total %d peers", m_validClientNum);
+                  continue;
                }
+               c = findClient(m_events[j].sd);
                if (c == -1)
                   continue;
-               if ((m_len = m_net->recv(m_sd[c], &(buff[m_bp]), SOCKET_MAXBUFLEN - 1 - m_bp)) <= 0) {
-                  // other end error (may be disconnected), close it
-                  removeClient(c);
-               } else {
-                  m_len += m_bp;
-                  m_bp = 0;
-                  // process the received message
-                  processMessageData(c, buff);
+               if (m_events[j].readable || m_events[j].hasError) {
+                  // received message from the other end, then process it
+                  if (receiveData(c) == false)
+                     continue;
                }
-            } else {
-               // dequeue the log strings to pass to the other end
-               while (m_thread->dequeueBuffer(1, buff2, NULL) > 0) {
-                  for (i = 0; i < m_clientNum; i++) {
-                     if (m_processing[i] == false) continue;
-                     if (m_net->send(m_sd[i], buff2, MMDAgent_strlen(buff2)) < 0) {
-                        // client error, close it
-                        removeClient(i);
-                     }
+               if (m_events[j].writable) {
+                  // socket became writable, send pending outbound data
+                  if (flushSendData(c) == false)
+                     removeClient(c);
+               }
+            }
+
+            // dequeue the log strings to pass to the other end
+            while (m_thread->dequeueBuffer(1, buff2, NULL) > 0) {
+               len = (int)MMDAgent_strlen(buff2);
+               for (i = 0; i < m_clientNum; i++) {
+                  if (m_conn[i].processing == false || m_conn[i].isWebSocket == true) continue;
+                  queueSendData(i, buff2, len);
+               }
+            }
+            for (i = 0; i < m_clientNum; i++) {
+               if (m_conn[i].processing == false || m_conn[i].isWebSocket == true) continue;
+               if (m_conn[i].wlen > 0 && m_conn[i].wwatch == false) {
+                  if (flushSendData(i) == false) {
+                     // client error, close it
+                     removeClient(i);
                   }
                }
             }
@@ -1017,6 +1212,9 @@ public:
          m_net = new ServerClient;
       }
       process();
+      // close all connections before releasing sockets
+      for (int i = 0; i < m_clientNum; i++)
+         removeClient(i);
       if (m_serverMode || m_clientConnect) {
          delete m_net;
          m_net = NULL;
@@ -1033,9 +1231,9 @@ public:
          return;
 
       vmax = 0;
-      for (int i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         if (m_avatar[i]) {
-            v = m_avatar[i]->getMaxVol();
+      for (int i = 0; i < m_maxClient; i++) {
+         if (m_conn[i].avatar) {
+            v = m_conn[i].avatar->getMaxVol();
             if (vmax < v)
                vmax = v;
          }
@@ -1060,9 +1258,9 @@ public:
 
    void avatarUpdate(float frames, int speak_max_vol)
    {
-      for (int i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         if (m_avatar[i])
-            m_avatar[i]->update(frames);
+      for (int i = 0; i < m_maxClient; i++) {
+         if (m_conn[i].avatar)
+            m_conn[i].avatar->update(frames);
       }
       avatarUpdateMaxVol(frames, speak_max_vol);
       updateDisplayStatus();
@@ -1075,9 +1273,9 @@ public:
 
    void avatarSetEnableFlag(bool flag)
    {
-      for (int i = 0; i < PLUGIN_REMOTE_MAXCLIENT; i++) {
-         if (m_avatar[i])
-            m_avatar[i]->setEnableFlag(flag);
+      for (int i = 0; i < m_maxClient; i++) {
+         if (m_conn[i].avatar)
+            m_conn[i].avatar->setEnableFlag(flag);
       }
    }
 
@@ -1202,9 +1400,9 @@ public:
    void setupModelForLocalLipSync(int id)
    {
       char buff[MMDAGENT_MAXBUFLEN];
-      m_avatar[id]->processMessage("__AV_START\n");
+      m_conn[id].avatar->processMessage("__AV_START\n");
       MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "__AV_SETMODEL,0\n");
-      m_avatar[id]->processMessage(buff);
+      m_conn[id].avatar->processMessage(buff);
    }
 };
 
@@ -147,11 +147,30 @@ static void my_freehostent(struct hostent *h)
    free(box);
 }
 
+/* socketWouldBlock: return true when the last socket operation failed since non-blocking socket is not ready */
+static bool socketWouldBlock()
+{
+#ifdef WINSOCK
+   return (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+   return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+#endif
+}
+
 void ServerClient::initialize()
 {
    m_socket_initialized = false;
    m_server_sd = SOCKET_INVALID;
    m_hostname = NULL;
+#ifdef SERVERCLIENT_USE_EPOLL
+   m_epfd = -1;
+   m_epollEvents = NULL;
+   m_epollEventsNum = 0;
+#else
+   m_pollfds = NULL;
+   m_pollfdsNum = 0;
+   m_pollfdsMax = 0;
+#endif
 }
 
 void ServerClient::reset()
@@ -167,11 +186,20 @@ void ServerClient::reset()
 
 void ServerClient::clear()
 {
+   reset();
 #ifdef WINSOCK
    if (m_socket_initialized == true)
       WSACleanup();
 #endif
-   reset();
+#ifdef SERVERCLIENT_USE_EPOLL
+   if (m_epfd >= 0)
+      close(m_epfd);
+   if (m_epollEvents)
+      free(m_epollEvents);
+#else
+   if (m_pollfds)
+      free(m_pollfds);
+#endif
    initialize();
 }
 
@@ -237,7 +265,13 @@ bool ServerClient::readyAsServer(int portnum)
       return false;
    }
    /* begin to listen */
-   if (listen(m_server_sd, 5) < 0) {
+   if (listen(m_server_sd, SOMAXCONN) < 0) {
+      reset();
+      return false;
+   }
+
+   /* watch incoming connection */
+   if (addEventSocket(m_server_sd) == false) {
       reset();
       return false;
    }
@@ -346,6 +380,8 @@ socket_t ServerClient::makeConnection(const char *hostname, int port_num)
 int ServerClient::closeSocket(socket_t sd)
 {
   int ret;
+
+  removeEventSocket(sd);
 #ifdef WINSOCK
   ret = closesocket(sd);
   if (ret != 0)
@@ -361,41 +397,171 @@ char *ServerClient::getClientHostName()
    return m_hostname;
 }
 
-ServerClient::kStatus ServerClient::waitData(socket_t *sd, int num, socket_t *sd_ret)
+// return true when the socket is the listening server socket
+bool ServerClient::isServerSocket(socket_t sd)
+{
+   return (m_server_sd != SOCKET_INVALID && sd == m_server_sd);
+}
+
+// set socket to non-blocking mode
+bool ServerClient::setNonBlocking(socket_t sd)
+{
+#ifdef WINSOCK
+   u_long mode = 1;
+   if (ioctlsocket(sd, FIONBIO, &mode) != 0)
+      return false;
+#else
+   int flags = fcntl(sd, F_GETFL, 0);
+   if (flags == -1)
+      return false;
+   if (fcntl(sd, F_SETFL, flags | O_NONBLOCK) == -1)
+      return false;
+#endif
+   return true;
+}
+
+// add socket to event watch list, read events are always watched
+bool ServerClient::addEventSocket(socket_t sd)
+{
+   if (sd == SOCKET_INVALID)
+      return false;
+
+#ifdef SERVERCLIENT_USE_EPOLL
+   struct epoll_event ev;
+
+   if (m_epfd < 0) {
+      m_epfd = epoll_create1(EPOLL_CLOEXEC);
+      if (m_epfd < 0)
+         return false;
+   }
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.fd = sd;
+   if (epoll_ctl(m_epfd, EPOLL_CTL_ADD, sd, &ev) != 0)
+      return false;
+#else
+   for (int i = 0; i < m_pollfdsNum; i++)
+      if (m_pollfds[i].fd == sd)
+         return true;
+   if (m_pollfdsNum >= m_pollfdsMax) {
+      m_pollfdsMax = (m_pollfdsMax == 0) ? 8 : m_pollfdsMax * 2;
+#ifdef WINSOCK
+      m_pollfds = (WSAPOLLFD *)realloc(m_pollfds, sizeof(WSAPOLLFD) * m_pollfdsMax);
+#else
+      m_pollfds = (struct pollfd *)realloc(m_pollfds, sizeof(struct pollfd) * m_pollfdsMax);
+#endif
+   }
+   m_pollfds[m_pollfdsNum].fd = sd;
+   m_pollfds[m_pollfdsNum].events = POLLIN;
+   m_pollfds[m_pollfdsNum].revents = 0;
+   m_pollfdsNum++;
+#endif
+
+   return true;
+}
+
+// remove socket from event watch list
+void ServerClient::removeEventSocket(socket_t sd)
+{
+   if (sd == SOCKET_INVALID)
+      return;
+
+#ifdef SERVERCLIENT_USE_EPOLL
+   struct epoll_event ev;
+
+   if (m_epfd < 0)
+      return;
+   memset(&ev, 0, sizeof(ev));
+   epoll_ctl(m_epfd, EPOLL_CTL_DEL, sd, &ev);
+#else
+   for (int i = 0; i < m_pollfdsNum; i++) {
+      if (m_pollfds[i].fd == sd) {
+         m_pollfds[i] = m_pollfds[m_pollfdsNum - 1];
+         m_pollfdsNum--;
+         break;
+      }
+   }
+#endif
+}
+
+// enable or disable watching write events of the socket
+void ServerClient::setEventWritable(socket_t sd, bool flag)
+{
+#ifdef SERVERCLIENT_USE_EPOLL
+   struct epoll_event ev;
+
+   if (m_epfd < 0)
+      return;
+   memset(&ev, 0, sizeof(ev));
+   ev.events = flag ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+   ev.data.fd = sd;
+   epoll_ctl(m_epfd, EPOLL_CTL_MOD, sd, &ev);
+#else
+   for (int i = 0; i < m_pollfdsNum; i++) {
+      if (m_pollfds[i].fd == sd) {
+         m_pollfds[i].events = flag ? (POLLIN | POLLOUT) : POLLIN;
+         break;
+      }
+   }
+#endif
+}
+
+// wait events on watched sockets up to timeout, return number of events, 0 on timeout, -1 on error
+int ServerClient::waitEvents(SocketEvent *events, int maxnum, int timeoutMSec)
 {
-   fd_set rfds, wfds;
    int ret;
-   int i;
-   socket_t sdmax;
-
-   FD_ZERO(&rfds);
-   FD_ZERO(&wfds);
-   if (m_server_sd != SOCKET_INVALID)
-      FD_SET(m_server_sd, &rfds);
-   sdmax = m_server_sd;
-   for (i = 0; i < num; i++) {
-      FD_SET(sd[i], &rfds);
-      FD_SET(sd[i], &wfds);
-      if (sdmax < sd[i])
-         sdmax = sd[i];
+   int n = 0;
+
+   if (maxnum <= 0)
+      return 0;
+
+#ifdef SERVERCLIENT_USE_EPOLL
+   if (m_epfd < 0) {
+      /* nothing to watch */
+      MMDAgent_sleep(timeoutMSec / 1000.0);
+      return 0;
+   }
+   if (m_epollEventsNum < maxnum) {
+      m_epollEvents = (struct epoll_event *)realloc(m_epollEvents, sizeof(struct epoll_event) * maxnum);
+      m_epollEventsNum = maxnum;
+   }
+   ret = epoll_wait(m_epfd, m_epollEvents, maxnum, timeoutMSec);
+   if (ret < 0)
+      return (errno == EINTR) ? 0 : -1;
+   for (int i = 0; i < ret; i++) {
+      events[n].sd = m_epollEvents[i].data.fd;
+      events[n].readable = (m_epollEvents[i].events & EPOLLIN) ? true : false;
+      events[n].writable = (m_epollEvents[i].events & EPOLLOUT) ? true : false;
+      events[n].hasError = (m_epollEvents[i].events & (EPOLLERR | EPOLLHUP)) ? true : false;
+      n++;
+   }
+#else
+   if (m_pollfdsNum == 0) {
+      /* nothing to watch */
+      MMDAgent_sleep(timeoutMSec / 1000.0);
+      return 0;
    }
-   ret = select(sdmax + 1, &rfds, &wfds, NULL, NULL);
 #ifdef WINSOCK
+   ret = WSAPoll(m_pollfds, m_pollfdsNum, timeoutMSec);
    if (ret == SOCKET_ERROR)
-      return ServerClient::SOCKET_HASERROR;
+      return -1;
 #else
-   if (ret <= 0)
-      return ServerClient::SOCKET_HASERROR;
+   ret = poll(m_pollfds, m_pollfdsNum, timeoutMSec);
+   if (ret < 0)
+      return (errno == EINTR) ? 0 : -1;
 #endif
-   if (m_server_sd >= 0 && FD_ISSET(m_server_sd, &rfds))
-      return ServerClient::SOCKET_CONNECT;
-   for (i = 0; i < num; i++) {
-      if (FD_ISSET(sd[i], &rfds)) {
-         *sd_ret = sd[i];
-         return ServerClient::SOCKET_READABLE;
-      }
+   for (int i = 0; i < m_pollfdsNum && n < maxnum; i++) {
+      if (m_pollfds[i].revents == 0)
+         continue;
+      events[n].sd = m_pollfds[i].fd;
+      events[n].readable = (m_pollfds[i].revents & POLLIN) ? true : false;
+      events[n].writable = (m_pollfds[i].revents & POLLOUT) ? true : false;
+      events[n].hasError = (m_pollfds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) ? true : false;
+      n++;
    }
-   return ServerClient::SOCKET_WRITABLE;
+#endif
+
+   return n;
 }
 
 int ServerClient::send(socket_t sd, const void *buf, size_t len)
@@ -404,9 +570,15 @@ int ServerClient::send(socket_t sd, const void *buf, size_t len)
 #ifdef WINSOCK
    ret = ::send(sd, (const char *)buf, (int)len, 0);
    if (ret == SOCKET_ERROR)
-      ret = -1;
+      ret = socketWouldBlock() ? SOCKET_WOULDBLOCK : -1;
+#else
+#ifdef MSG_NOSIGNAL
+   ret = (int)::send(sd, buf, len, MSG_NOSIGNAL);
 #else
    ret = (int)::send(sd, buf, len, 0);
+#endif
+   if (ret < 0)
+      ret = socketWouldBlock() ? SOCKET_WOULDBLOCK : -1;
 #endif
    return ret;
 }
@@ -417,9 +589,11 @@ int ServerClient::recv(socket_t sd, void *buf, size_t maxlen)
 #ifdef WINSOCK
    ret = ::recv(sd, (char *)buf, (int)maxlen, 0);
    if (ret == SOCKET_ERROR)
-      ret = -1;
+      ret = socketWouldBlock() ? SOCKET_WOULDBLOCK : -1;
 #else
    ret = (int)::recv(sd, buf, maxlen, 0);
+   if (ret < 0)
+      ret = socketWouldBlock() ? SOCKET_WOULDBLOCK : -1;
 #endif
    return ret;
 }
@@ -67,6 +67,15 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define SERVERCLIENT_USE_EPOLL
+#elif !defined(WINSOCK)
+#include <poll.h>
 #endif
 
 #ifdef WINSOCK
@@ -77,12 +86,36 @@ typedef int socket_t;
 #define SOCKET_INVALID -1
 #endif
 
+// return value of send() and recv() when non-blocking socket is not ready
+#define SOCKET_WOULDBLOCK -2
+
+// socket event returned by waitEvents()
+struct SocketEvent {
+   socket_t sd;      // socket
+   bool readable;    // true when data (or connection on server socket) is arriving
+   bool writable;    // true when socket can be written without blocking
+   bool hasError;    // true when error or hang-up occured
+};
+
 class ServerClient
 {
 private:
    bool m_socket_initialized;   // flag for socket initialization
    socket_t m_server_sd;              // server socket
    char *m_hostname;             // client hostname
+#ifdef SERVERCLIENT_USE_EPOLL
+   int m_epfd;                         // epoll descriptor
+   struct epoll_event *m_epollEvents;  // event buffer for epoll_wait()
+   int m_epollEventsNum;               // allocated length of m_epollEvents
+#else
+#ifdef WINSOCK
+   WSAPOLLFD *m_pollfds;               // watched sockets
+#else
+   struct pollfd *m_pollfds;           // watched sockets
+#endif
+   int m_pollfdsNum;                   // number of watched sockets
+   int m_pollfdsMax;                   // allocated length of m_pollfds
+#endif
 
    // initialize
    void initialize();
@@ -91,7 +124,6 @@ private:
    void clear();
 
 public:
-   enum kStatus { SOCKET_CONNECT, SOCKET_READABLE, SOCKET_WRITABLE, SOCKET_HASERROR };
 
    // constructor
    ServerClient();
@@ -123,13 +155,28 @@ public:
    // get client host name
    char *getClientHostName();
 
-   // wait data
-   kStatus waitData(socket_t *sd, int num, socket_t *sd_ret);
+   // return true when the socket is the listening server socket
+   bool isServerSocket(socket_t sd);
+
+   // set socket to non-blocking mode
+   bool setNonBlocking(socket_t sd);
+
+   // add socket to event watch list, read events are always watched
+   bool addEventSocket(socket_t sd);
+
+   // remove socket from event watch list
+   void removeEventSocket(socket_t sd);
+
+   // enable or disable watching write events of the socket
+   void setEventWritable(socket_t sd, bool flag);
+
+   // wait events on watched sockets up to timeout, return number of events, 0 on timeout, -1 on error
+   int waitEvents(SocketEvent *events, int maxnum, int timeoutMSec);
 
-   // send data, -1 on error
+   // send data, -1 on error, SOCKET_WOULDBLOCK when non-blocking socket is not ready
    int send(socket_t sd, const void *buf, size_t len);
 
-   // receive data, -1 on error
+   // receive data, -1 on error, SOCKET_WOULDBLOCK when non-blocking socket is not ready
    int recv(socket_t sd, void *buf, size_t maxlen);
 
 };
@@ -61,6 +61,10 @@
 #include "MMDAgent.h"
 #include "VIManager.h"
 
+/* variables */
+
+static std::mutex VIManager_keyValueMutex; /* KeyValue is shared by FSTs which may be evaluated in parallel */
+
 /* findAsciiString: find ascii string */
 static const char* findAsciiString(const char *str, const char *c)
 {
@@ -233,6 +237,33 @@ static int countArgs(const char *str, char separator)
    return num;
 }
 
+/* splitEquation: split equation "$name=value" to variable name and value, return the name in buffn or NULL when invalid */
+static const char *splitEquation(const char *equation, char *buffn, char *buffv)
+{
+   int idx, len;
+   const char *name;
+
+   if (countArgs(equation, '=') != 2)
+      return NULL;
+   idx = 0;
+   getArgFromString(equation, &idx, buffn, '=');
+   if (buffn[0] != '$')
+      return NULL;
+   name = &(buffn[1]);
+   if (buffn[1] == '{') {
+      len = (int)MMDAgent_strlen(buffn);
+      if (buffn[len - 1] != '}')
+         return NULL;
+      buffn[len - 1] = '\0';
+      /* check if variable name is valid */
+      if (checkVariableName(&(buffn[2])) == false)
+         return NULL;
+      name = &(buffn[2]);
+   }
+   getArgFromString(equation, &idx, buffv, '=');
+   return name;
+}
+
 /* InputArguments_initialize: initialize input arguments */
 void InputArguments_initialize(InputArguments *ia, const char *str)
 {
@@ -296,9 +327,230 @@ void InputArguments_clear(InputArguments *ia)
    }
 }
 
+/* VIManager_Segment_classify: classify variable name of segment, the name should be writable */
+static void VIManager_Segment_classify(VIManager_Segment *seg)
+{
+   seg->hash = 0;
+   if (MMDAgent_strstr(seg->str, "%ENV")) {
+      seg->kind = VIMANAGER_SEGMENT_ENV;
+   } else if (seg->str[0] == '%') {
+      seg->kind = VIMANAGER_SEGMENT_KEYVALUE;
+      memmove(seg->str, &(seg->str[1]), seg->len);
+      seg->len--;
+   } else {
+      seg->kind = VIMANAGER_SEGMENT_VARIABLE;
+      seg->hash = VariableStore::getHash(seg->str, seg->len);
+   }
+}
+
+/* VIManager_Template_addSegment: add segment to template */
+static void VIManager_Template_addSegment(VIManager_Template *t, int kind, const char *str, size_t len)
+{
+   VIManager_Segment *seg;
+
+   if (kind == VIMANAGER_SEGMENT_TEXT && len == 0)
+      return;
+
+   t->segments = (VIManager_Segment *)realloc(t->segments, sizeof(VIManager_Segment) * (t->num + 1));
+   seg = &(t->segments[t->num]);
+   seg->str = (char *)malloc(len + 1);
+   memcpy(seg->str, str, len);
+   seg->str[len] = '\0';
+   seg->len = len;
+   seg->kind = kind;
+   seg->hash = 0;
+   if (kind != VIMANAGER_SEGMENT_TEXT)
+      VIManager_Segment_classify(seg);
+   t->num++;
+}
+
+/* VIManager_Template_scan: get next text or variable name in string and advance, return false at the end */
+static bool VIManager_Template_scan(const char **input, const char *end, int *kind, const char **str, size_t *len)
+{
+   const char *c, *head;
+   unsigned char size;
+   int braced_counter;
+
+   c = *input;
+   if (c >= end)
+      return false;
+
+   head = c;
+   if (MMDAgent_getcharsize(c) == 1 && *c == '$') {
+      c++;
+      if (c < end && MMDAgent_getcharsize(c) == 1 && *c == '$') {
+         /* "$$" -> "$", followed by text */
+         head = c;
+         c++;
+      } else {
+         braced_counter = 0;
+         if (c < end && MMDAgent_getcharsize(c) == 1 && *c == '{') {
+            braced_counter++;
+            c++;
+         }
+         /* read variable name */
+         *kind = VIMANAGER_SEGMENT_VARIABLE;
+         *str = c;
+         while (c < end) {
+            size = MMDAgent_getcharsize(c);
+            if (size == 0) { /* fail safe, take the rest as text */
+               *kind = VIMANAGER_SEGMENT_TEXT;
+               *str = head;
+               *len = c - head;
+               *input = end;
+               return true;
+            }
+            if (size == 1 && *c == '{') {
+               braced_counter++;
+            } else if (size == 1 && *c == '}') {
+               braced_counter--;
+               if (braced_counter == 0) {
+                  *len = c - *str;
+                  *input = c + 1;
+                  return true;
+               }
+            } else {
+               if (size != 1 || ! (isalnum(*c) || *c == '_' || *c == '%')) break;
+            }
+            c += size;
+         }
+         *len = c - *str;
+         *input = c;
+         return true;
+      }
+   }
+
+   /* text till the next variable */
+   *kind = VIMANAGER_SEGMENT_TEXT;
+   *str = head;
+   while (c < end) {
+      size = MMDAgent_getcharsize(c);
+      if (size == 0) { /* fail safe */
+         *len = c - head;
+         *input = end;
+         return true;
+      }
+      if (size == 1 && *c == '$')
+         break;
+      c += size;
+   }
+   *len = c - head;
+   *input = c;
+   return true;
+}
+
+/* VIManager_Template_initialize: initialize template by splitting string to text and variables */
+static void VIManager_Template_initialize(VIManager_Template *t, const char *input)
+{
+   const char *p, *end, *str;
+   int kind;
+   size_t len;
+
+   t->segments = NULL;
+   t->num = 0;
+
+   len = MMDAgent_strlen(input);
+   if (len <= 0)
+      return;
+
+   p = input;
+   end = input + len;
+   while (VIManager_Template_scan(&p, end, &kind, &str, &len))
+      VIManager_Template_addSegment(t, kind, str, len);
+}
+
+/* VIManager_Template_clear: free template */
+static void VIManager_Template_clear(VIManager_Template *t)
+{
+   int i;
+
+   if (t->segments != NULL) {
+      for (i = 0; i < t->num; i++)
+         free(t->segments[i].str);
+      free(t->segments);
+   }
+   t->segments = NULL;
+   t->num = 0;
+}
+
+/* VIManager_Arc_initializeInput: split input event type or variable test and input arguments at variables */
+static void VIManager_Arc_initializeInput(VIManager_Arc *a)
+{
+   int i, j, k;
+   const InputArguments *ia = &(a->input_event_args);
+
+   VIManager_Template_initialize(&a->input_type_template, NULL);
+   a->input_args_template = NULL;
+   a->num_input_args_template = 0;
+
+   if (a->input_kind == VIMANAGER_ARCINPUT_REGEXP)
+      return;
+
+   if (a->input_event_type != NULL && strchr(a->input_event_type, '$') != NULL)
+      VIManager_Template_initialize(&a->input_type_template, a->input_event_type);
+
+   if (a->input_kind != VIMANAGER_ARCINPUT_STRING || ia->str == NULL || strchr(ia->str, '$') == NULL)
+      return;
+   for (i = 0; i < ia->size; i++)
+      a->num_input_args_template += ia->argc[i];
+   if (a->num_input_args_template == 0)
+      return;
+   a->input_args_template = (VIManager_Template *)malloc(sizeof(VIManager_Template) * a->num_input_args_template);
+   k = 0;
+   for (i = 0; i < ia->size; i++) {
+      for (j = 0; j < ia->argc[i]; j++) {
+         if (strchr(ia->args[i][j], '$') != NULL)
+            VIManager_Template_initialize(&(a->input_args_template[k]), ia->args[i][j]);
+         else
+            VIManager_Template_initialize(&(a->input_args_template[k]), NULL);
+         k++;
+      }
+   }
+}
+
+/* VIManager_Arc_initializeAssignments: split variable action to assignments */
+static void VIManager_Arc_initializeAssignments(VIManager_Arc *a)
+{
+   int idx;
+   char tok[2];
+   const char *name;
+   VIManager_Assignment *as;
+   char buff[MMDAGENT_MAXBUFLEN];
+   char buffn[MMDAGENT_MAXBUFLEN];
+   char buffv[MMDAGENT_MAXBUFLEN];
+
+   a->assignments = NULL;
+   a->num_assignments = 0;
+   a->assignments_valid = true;
+
+   if (MMDAgent_strlen(a->variable_action) == 0)
+      return;
+
+   tok[0] = VIMANAGER_SEPARATOR2;
+   tok[1] = '\0';
+
+   idx = 0;
+   while (getTokenFromStringWithQuoters(a->variable_action, &idx, buff, tok, "\"'", true) > 0) {
+      name = splitEquation(buff, buffn, buffv);
+      if (name == NULL) {
+         /* assignments till here are executed as before */
+         a->assignments_valid = false;
+         return;
+      }
+      a->assignments = (VIManager_Assignment *)realloc(a->assignments, sizeof(VIManager_Assignment) * (a->num_assignments + 1));
+      as = &(a->assignments[a->num_assignments]);
+      as->name = MMDAgent_strdup(name);
+      VIManager_Template_initialize(&as->value, buffv);
+      a->num_assignments++;
+   }
+}
+
 /* VIManager_Arc_initialize: initialize arc */
 static void VIManager_Arc_initialize(VIManager_Arc *a, char *input_event_type, char *input_event_args, char *output_command_type, char *output_command_args, char *variable_action, VIManager_State *next_state)
 {
+   size_t len;
+   char *pattern;
+
    a->input_event_type = MMDAgent_strdup(input_event_type);
    InputArguments_initialize(&a->input_event_args, input_event_args);
    a->output_command_type = MMDAgent_strdup(output_command_type);
@@ -308,11 +560,48 @@ static void VIManager_Arc_initialize(VIManager_Arc *a, char *input_event_type, c
    a->block_id = 0;
    a->label = NULL;
    a->next = NULL;
+
+   /* kind of input matching */
+   a->input_kind = VIMANAGER_ARCINPUT_STRING;
+   a->regexp = NULL;
+   a->regexp_pattern = NULL;
+   a->regexp_static = false;
+   a->order = 0;
+   a->next_candidate = NULL;
+   VIManager_Template_initialize(&a->output_type_template, output_command_type);
+   VIManager_Template_initialize(&a->output_args_template, output_command_args);
+   VIManager_Template_initialize(&a->regexp_template, NULL);
+   len = MMDAgent_strlen(input_event_type);
+   if (len > 1 && input_event_type[0] == VIMANAGER_REGEXP_BRACE && input_event_type[len - 1] == VIMANAGER_REGEXP_BRACE) {
+      a->input_kind = VIMANAGER_ARCINPUT_REGEXP;
+      /* pattern without variables is compiled only once here */
+      if (strchr(input_event_type, '$') == NULL) {
+         a->regexp_pattern = MMDAgent_strdup(&(input_event_type[1]));
+         a->regexp_pattern[len - 2] = '\0';
+         a->regexp = new RE2(a->regexp_pattern);
+         a->regexp_static = true;
+      } else {
+         /* pattern with variables is split at variables here, and made at each test */
+         pattern = MMDAgent_strdup(&(input_event_type[1]));
+         pattern[len - 2] = '\0';
+         VIManager_Template_clear(&a->regexp_template);
+         VIManager_Template_initialize(&a->regexp_template, pattern);
+         free(pattern);
+      }
+   } else if (len > 1 && input_event_type[0] == '$') {
+      a->input_kind = VIMANAGER_ARCINPUT_VARIABLE;
+   }
+
+   /* strings with variables to be evaluated at each test and transition are split here */
+   VIManager_Arc_initializeInput(a);
+   VIManager_Arc_initializeAssignments(a);
 }
 
 /* VIManager_Arc_clear: free arc */
 static void VIManager_Arc_clear(VIManager_Arc * a)
 {
+   int i;
+
    if (a->input_event_type != NULL)
       free(a->input_event_type);
    InputArguments_clear(&a->input_event_args);
@@ -324,6 +613,26 @@ static void VIManager_Arc_clear(VIManager_Arc * a)
       free(a->variable_action);
    if (a->label != NULL)
       free(a->label);
+   if (a->regexp != NULL)
+      delete (RE2 *)a->regexp;
+   if (a->regexp_pattern != NULL)
+      free(a->regexp_pattern);
+   VIManager_Template_clear(&a->output_type_template);
+   VIManager_Template_clear(&a->output_args_template);
+   VIManager_Template_clear(&a->regexp_template);
+   VIManager_Template_clear(&a->input_type_template);
+   if (a->input_args_template != NULL) {
+      for (i = 0; i < a->num_input_args_template; i++)
+         VIManager_Template_clear(&(a->input_args_template[i]));
+      free(a->input_args_template);
+   }
+   if (a->assignments != NULL) {
+      for (i = 0; i < a->num_assignments; i++) {
+         free(a->assignments[i].name);
+         VIManager_Template_clear(&(a->assignments[i].value));
+      }
+      free(a->assignments);
+   }
    VIManager_Arc_initialize(a, NULL, NULL, NULL, NULL, NULL, NULL);
 }
 
@@ -331,6 +640,7 @@ static void VIManager_Arc_clear(VIManager_Arc * a)
 static void VIManager_AList_initialize(VIManager_AList *l)
 {
    l->head = NULL;
+   l->tail = NULL;
 }
 
 /* VIManager_AList_clear: free arc list */
@@ -344,6 +654,17 @@ static void VIManager_AList_clear(VIManager_AList *l)
       free(tmp1);
    }
    l->head = NULL;
+   l->tail = NULL;
+}
+
+/* VIManager_AList_append: append arc to the end of arc list */
+static void VIManager_AList_append(VIManager_AList *l, VIManager_Arc *a)
+{
+   if (l->head == NULL)
+      l->head = a;
+   else
+      l->tail->next = a;
+   l->tail = a;
 }
 
 /* VIManager_State_initialize: initialize state */
@@ -354,15 +675,108 @@ static void VIManager_State_initialize(VIManager_State *s, const char *label)
    VIManager_AList_initialize(&s->arc_list);
    s->virtual_fromState = NULL;
    s->virtual_toState = NULL;
+   s->arc_index = NULL;
+   s->num_arc_index = 0;
+   s->arc_dynamic = NULL;
 }
 
 /* VIManager_State_clear: free state */
 static void VIManager_State_clear(VIManager_State *s)
 {
    VIManager_AList_clear(&s->arc_list);
+   if (s->arc_index != NULL)
+      free(s->arc_index);
    VIManager_State_initialize(s, NULL);
 }
 
+/* VIManager_compareArcIndex: qsort function for arc index, by input event type and then by order */
+static int VIManager_compareArcIndex(const void *a, const void *b)
+{
+   const VIManager_Arc *x = *((const VIManager_Arc **)a);
+   const VIManager_Arc *y = *((const VIManager_Arc **)b);
+   int ret;
+
+   ret = strcmp(x->input_event_type, y->input_event_type);
+   if (ret != 0)
+      return ret;
+   if (x->order != y->order)
+      return (x->order > y->order) ? 1 : -1;
+   return 0;
+}
+
+/* VIManager_State_buildIndex: index arcs of a state by fixed input event type */
+static void VIManager_State_buildIndex(VIManager_State *s)
+{
+   VIManager_Arc *arc, *last = NULL;
+   VIManager_Arc **list;
+   unsigned int num = 0, n = 0, i;
+
+   if (s->arc_index != NULL)
+      free(s->arc_index);
+   s->arc_index = NULL;
+   s->num_arc_index = 0;
+   s->arc_dynamic = NULL;
+
+   /* arcs with regular expression, variable test or variables in type are tested for any input */
+   for (arc = s->arc_list.head; arc != NULL; arc = arc->next) {
+      arc->order = num++;
+      arc->next_candidate = NULL;
+      if (arc->input_kind == VIMANAGER_ARCINPUT_STRING && arc->input_event_type != NULL && strchr(arc->input_event_type, '$') == NULL) {
+         n++;
+      } else {
+         if (last == NULL)
+            s->arc_dynamic = arc;
+         else
+            last->next_candidate = arc;
+         last = arc;
+      }
+   }
+   if (n == 0)
+      return;
+
+   /* group the other arcs by type, keeping their order */
+   list = (VIManager_Arc **)malloc(sizeof(VIManager_Arc *) * n);
+   n = 0;
+   for (arc = s->arc_list.head; arc != NULL; arc = arc->next)
+      if (arc->input_kind == VIMANAGER_ARCINPUT_STRING && arc->input_event_type != NULL && strchr(arc->input_event_type, '$') == NULL)
+         list[n++] = arc;
+   qsort(list, n, sizeof(VIManager_Arc *), VIManager_compareArcIndex);
+   s->arc_index = (VIManager_ArcIndex *)malloc(sizeof(VIManager_ArcIndex) * n);
+   for (i = 0; i < n; i++) {
+      if (i > 0 && MMDAgent_strequal(list[i]->input_event_type, list[i - 1]->input_event_type)) {
+         list[i - 1]->next_candidate = list[i];
+         continue;
+      }
+      s->arc_index[s->num_arc_index].type = list[i]->input_event_type;
+      s->arc_index[s->num_arc_index].head = list[i];
+      s->num_arc_index++;
+   }
+   free(list);
+}
+
+/* VIManager_State_findArcs: get arcs of a state with the fixed input event type */
+static VIManager_Arc *VIManager_State_findArcs(VIManager_State *s, const char *type)
+{
+   int low, high, mid, ret;
+
+   if (type == NULL)
+      return NULL;
+
+   low = 0;
+   high = s->num_arc_index - 1;
+   while (low <= high) {
+      mid = (low + high) / 2;
+      ret = strcmp(s->arc_index[mid].type, type);
+      if (ret == 0)
+         return s->arc_index[mid].head;
+      if (ret < 0)
+         low = mid + 1;
+      else
+         high = mid - 1;
+   }
+   return NULL;
+}
+
 /* VIManager_SList_initialize: initialize state list */
 static void VIManager_SList_initialize(VIManager_SList *l)
 {
@@ -382,6 +796,16 @@ static void VIManager_SList_clear(VIManager_SList *l)
    l->index.release();
 }
 
+/* VIManager_SList_buildIndex: index arcs of all states in state list */
+static void VIManager_SList_buildIndex(VIManager_SList *l)
+{
+   VIManager_State *tmp;
+   void *save;
+
+   for (tmp = (VIManager_State *)l->index.firstData(&save); tmp; tmp = (VIManager_State *)l->index.nextData(&save))
+      VIManager_State_buildIndex(tmp);
+}
+
 /* VIManager_SList_count: count state list */
 static unsigned int VIManager_SList_count(VIManager_SList *l)
 {
@@ -442,8 +866,7 @@ static VIManager_Arc *VIManager_SList_addArc(VIManager_SList *l1, const char *la
 {
    int i, idx;
    VIManager_State *s1, *s2;
-   VIManager_Arc *a1, *a2;
-   VIManager_AList *arc_list;
+   VIManager_Arc *a1;
 
    char itype[MMDAGENT_MAXBUFLEN];
    char iargs[MMDAGENT_MAXBUFLEN];
@@ -452,7 +875,6 @@ static VIManager_Arc *VIManager_SList_addArc(VIManager_SList *l1, const char *la
 
    s1 = VIManager_SList_searchStateAndCreate(l1, label1);
    s2 = VIManager_SList_searchStateAndCreate(l2, label2);
-   arc_list = &s1->arc_list;
 
    /* analyze input symbol */
    if (MMDAgent_strlen(isymbol) > 1 && isymbol[0] == VIMANAGER_REGEXP_BRACE && isymbol[MMDAgent_strlen(isymbol) - 1] == VIMANAGER_REGEXP_BRACE) {
@@ -487,87 +909,205 @@ static VIManager_Arc *VIManager_SList_addArc(VIManager_SList *l1, const char *la
       a1->label = MMDAgent_strdup(label);
 
    /* set */
-   if (arc_list->head == NULL) {
-      arc_list->head = a1;
-   } else {
-      for (a2 = arc_list->head; a2->next != NULL; a2 = a2->next);
-      a2->next = a1;
-   }
+   VIManager_AList_append(&s1->arc_list, a1);
 
    return a1;
 }
 
-/* VIManager_Variable_initialize: initialize variable */
-static void VIManager_Variable_initialize(VIManager_Variable *v, const char *name, const char *value)
+/* VIManager_addStringList: add copy of string to string list */
+static void VIManager_addStringList(char ***list, int *num, const char *str)
 {
-   v->name = MMDAgent_strdup(name);
-   v->value = MMDAgent_strdup(value);
-   v->next = NULL;
+   *list = (char **)realloc(*list, sizeof(char *) * (*num + 1));
+   (*list)[*num] = MMDAgent_strdup(str);
+   (*num)++;
 }
 
-/* VIManager_Variable_clear: free variable */
-static void VIManager_Variable_clear(VIManager_Variable * v)
+/* VIManager_clearStringList: free string list */
+static void VIManager_clearStringList(char ***list, int *num)
 {
-   if (v->name != NULL)
-      free(v->name);
-   if (v->value != NULL)
-      free(v->value);
+   int i;
+
+   if (*list != NULL) {
+      for (i = 0; i < *num; i++)
+         if ((*list)[i] != NULL)
+            free((*list)[i]);
+      free(*list);
+   }
+   *list = NULL;
+   *num = 0;
 }
 
-/* VIManager_VList_initialize: initialize variable list */
-static void VIManager_VList_initialize(VIManager_VList *l)
+/* VIManager_StringTable: string table for compiled FST */
+typedef struct _VIManager_StringTable {
+   char *buf;         /* strings, each terminated by null */
+   unsigned int size; /* used byte size */
+   unsigned int max;  /* allocated byte size */
+   PTree index;       /* index from string to offset */
+} VIManager_StringTable;
+
+/* VIManager_StringTable_initialize: initialize string table, empty string is placed at the top */
+static void VIManager_StringTable_initialize(VIManager_StringTable *t)
 {
-   l->index.release();
+   t->max = 4096;
+   t->buf = (char *)malloc(t->max);
+   t->buf[0] = '\0';
+   t->size = 1;
+   t->index.release();
 }
 
-/* VIManager_VList_clear: free variable list */
-static void VIManager_VList_clear(VIManager_VList *l)
+/* VIManager_StringTable_clear: free string table */
+static void VIManager_StringTable_clear(VIManager_StringTable *t)
 {
-   VIManager_Variable *tmp;
-   void *save;
+   if (t->buf != NULL)
+      free(t->buf);
+   t->buf = NULL;
+   t->size = 0;
+   t->max = 0;
+   t->index.release();
+}
 
-   for (tmp = (VIManager_Variable *)l->index.firstData(&save); tmp; tmp = (VIManager_Variable *)l->index.nextData(&save)) {
-      VIManager_Variable_clear(tmp);
-      free(tmp);
+/* VIManager_StringTable_add: add string to string table if not yet and return its offset */
+static unsigned int VIManager_StringTable_add(VIManager_StringTable *t, const char *str)
+{
+   int len;
+   void *data;
+   unsigned int offset;
+
+   if (str == NULL)
+      return VIMANAGER_COMPILED_NONE;
+   len = (int)MMDAgent_strlen(str);
+   if (len == 0)
+      return 0;
+   if (t->index.search(str, len, &data) == true)
+      return (unsigned int)(size_t)data;
+
+   while (t->size + len + 1 > t->max) {
+      t->max *= 2;
+      t->buf = (char *)realloc(t->buf, t->max);
    }
-   l->index.release();
+   offset = t->size;
+   memcpy(&(t->buf[offset]), str, len + 1);
+   t->size += len + 1;
+   t->index.add(str, len, (void *)(size_t)offset);
+
+   return offset;
 }
 
-/* VIManager_VList_search: search for a variable */
-static VIManager_Variable *VIManager_VList_search(VIManager_VList *vlist, const char *name)
+/* VIManager_StateID: state and its index in compiled FST */
+typedef struct _VIManager_StateID {
+   VIManager_State *state;
+   unsigned int id;
+} VIManager_StateID;
+
+/* VIManager_compareStateID: qsort function for state index */
+static int VIManager_compareStateID(const void *a, const void *b)
 {
-   VIManager_Variable *v;
-   int len;
+   size_t x = (size_t)((const VIManager_StateID *)a)->state;
+   size_t y = (size_t)((const VIManager_StateID *)b)->state;
 
-   len = (int)MMDAgent_strlen(name);
+   if (x != y)
+      return (x > y) ? 1 : -1;
+   return 0;
+}
 
-   if (len <= 0)
-      return NULL;
+/* VIManager_findStateID: find index of state in compiled FST */
+static unsigned int VIManager_findStateID(VIManager_StateID *list, unsigned int num, VIManager_State *s)
+{
+   VIManager_StateID key;
+   VIManager_StateID *found;
+
+   if (s == NULL || num == 0)
+      return VIMANAGER_COMPILED_NONE;
+   key.state = s;
+   found = (VIManager_StateID *)bsearch(&key, list, num, sizeof(VIManager_StateID), VIManager_compareStateID);
+   if (found == NULL)
+      return VIMANAGER_COMPILED_NONE;
+   return found->id;
+}
 
-   if (vlist->index.search(name, len, (void **)&v) == false)
+/* VIManager_getCompiledString: get string in string table of compiled FST */
+static char *VIManager_getCompiledString(const char *strings, unsigned int offset)
+{
+   if (offset == VIMANAGER_COMPILED_NONE)
       return NULL;
-   return v;
+   return (char *)&(strings[offset]);
 }
 
-/* VIManager_VList_set: set variable to list */
-static void VIManager_VList_set(VIManager_VList *vlist, const char *name, const char *value)
+/* VIManager_checkCompiledString: check string offset in compiled FST */
+static bool VIManager_checkCompiledString(unsigned int offset, unsigned int size, bool allowNone)
 {
-   VIManager_Variable *v;
+   if (offset == VIMANAGER_COMPILED_NONE)
+      return allowNone;
+   return offset < size;
+}
 
-   /* search */
-   v = VIManager_VList_search(vlist, name);
-   if (v != NULL) {
-      /* replace */
-      if (v->value != NULL)
-         free(v->value);
-      v->value = MMDAgent_strdup(value);
-   } else {
-      /* create */
-      v = (VIManager_Variable *)malloc(sizeof(VIManager_Variable));
-      VIManager_Variable_initialize(v, name, value);
-      /* set */
-      vlist->index.add(name, (int)MMDAgent_strlen(name), v);
+/* VIManager_checkCompiledData: check if data is valid compiled FST */
+static bool VIManager_checkCompiledData(const unsigned char *data, size_t size)
+{
+   const VIManager_CompiledHeader *header;
+   const unsigned int *sources;
+   const unsigned int *definitions;
+   const VIManager_CompiledState *states;
+   const VIManager_CompiledArc *arcs;
+   const char *strings;
+   size_t expected;
+   unsigned int i;
+
+   if (data == NULL || size < sizeof(VIManager_CompiledHeader))
+      return false;
+   header = (const VIManager_CompiledHeader *)data;
+   if (memcmp(header->magic, VIMANAGER_COMPILED_MAGIC, sizeof(header->magic)) != 0 || header->version != VIMANAGER_COMPILED_VERSION)
+      return false;
+   if (header->numSource > size || header->numDefinition > size || header->numState > size || header->numArc > size || header->stringSize > size)
+      return false;
+   expected = sizeof(VIManager_CompiledHeader)
+              + sizeof(unsigned int) * ((size_t)header->numSource + header->numDefinition)
+              + sizeof(VIManager_CompiledState) * (size_t)header->numState
+              + sizeof(VIManager_CompiledArc) * (size_t)header->numArc
+              + header->stringSize;
+   if (expected != size || header->numSource == 0 || header->numStateMain > header->numState || header->stringSize == 0)
+      return false;
+
+   sources = (const unsigned int *)(data + sizeof(VIManager_CompiledHeader));
+   definitions = sources + header->numSource;
+   states = (const VIManager_CompiledState *)(definitions + header->numDefinition);
+   arcs = (const VIManager_CompiledArc *)(states + header->numState);
+   strings = (const char *)(arcs + header->numArc);
+
+   /* string table should be terminated */
+   if (strings[header->stringSize - 1] != '\0')
+      return false;
+
+   /* every reference should be in range */
+   for (i = 0; i < header->numSource; i++)
+      if (VIManager_checkCompiledString(sources[i], header->stringSize, false) == false)
+         return false;
+   for (i = 0; i < header->numDefinition; i++)
+      if (VIManager_checkCompiledString(definitions[i], header->stringSize, false) == false)
+         return false;
+   for (i = 0; i < header->numState; i++) {
+      if (VIManager_checkCompiledString(states[i].label, header->stringSize, false) == false)
+         return false;
+      if (states[i].virtualFromState != VIMANAGER_COMPILED_NONE && states[i].virtualFromState >= header->numState)
+         return false;
+      if (states[i].virtualToState != VIMANAGER_COMPILED_NONE && states[i].virtualToState >= header->numState)
+         return false;
+      if (states[i].arcHead > header->numArc || states[i].numArc > header->numArc - states[i].arcHead)
+         return false;
+   }
+   for (i = 0; i < header->numArc; i++) {
+      if (VIManager_checkCompiledString(arcs[i].inputEventType, header->stringSize, true) == false
+            || VIManager_checkCompiledString(arcs[i].inputEventArgs, header->stringSize, true) == false
+            || VIManager_checkCompiledString(arcs[i].outputCommandType, header->stringSize, true) == false
+            || VIManager_checkCompiledString(arcs[i].outputCommandArgs, header->stringSize, true) == false
+            || VIManager_checkCompiledString(arcs[i].variableAction, header->stringSize, true) == false
+            || VIManager_checkCompiledString(arcs[i].label, header->stringSize, true) == false)
+         return false;
+      if (arcs[i].nextState >= header->numState)
+         return false;
    }
+
+   return true;
 }
 
 /* VIManager::initialize: initialize VIManager */
@@ -579,14 +1119,22 @@ void VIManager::initialize()
    m_name = NULL;
    VIManager_SList_initialize(&m_stateList);
    VIManager_SList_initialize(&m_stateListAppend);
-   VIManager_VList_initialize(&m_variableList);
+   m_variableList.release();
    m_currentState = NULL;
    m_append_num = 0;
    m_block_id = 0;
    for (int i = 0; i < VIMANAGER_HISTORY_LEN; i++)
       m_history[i] = NULL;
    m_historyPoint = 0;
+   m_latencyCount = 0;
+   m_latencyTotal = 0.0;
+   m_latencyMax = 0.0;
    m_end = false;
+   m_useCompiled = true;
+   m_sourceList = NULL;
+   m_numSource = 0;
+   m_definitionList = NULL;
+   m_numDefinition = 0;
 }
 
 /* VIManager:clear: free VIManager */
@@ -598,152 +1146,177 @@ void VIManager::clear()
       free(m_fileName);
    VIManager_SList_clear(&m_stateList);
    VIManager_SList_clear(&m_stateListAppend);
-   VIManager_VList_clear(&m_variableList);
+   m_variableList.release();
+   VIManager_clearStringList(&m_sourceList, &m_numSource);
+   VIManager_clearStringList(&m_definitionList, &m_numDefinition);
    initialize();
 }
 
-/* VIManager::substituteVariableAndCopy: substitute variables with their values in a string */
-void VIManager::substituteVariableAndCopy(const char *input, char *output)
+/* VIManager::expandSegment: append segment to output, substituting variable with its value */
+void VIManager::expandSegment(const VIManager_Segment *seg, char **out, size_t *rest)
 {
-   int i, len, vlen;
-   const char *c;
-   char *out, *cv;
-   unsigned char size;
-   int braced_counter;
-   VIManager_Variable *v;
-
-   len = (int)MMDAgent_strlen(input);
-   if (len <= 0) {
-      *output = '\0';
+   int n;
+   const char *p;
+   char replaced_str[MMDAGENT_MAXBUFLEN];
+
+   p = NULL;
+   n = 0;
+   switch (seg->kind) {
+   case VIMANAGER_SEGMENT_TEXT:
+      p = seg->str;
+      n = (int)seg->len;
+      break;
+   case VIMANAGER_SEGMENT_ENV:
+      /* consult environmental variables */
+      m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s", seg->str);
+      if (MMDAgent_replaceEnvDup(seg->str, replaced_str) >= 0) {
+         m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: get \"%s\": \"%s\"", m_name, seg->str, replaced_str);
+         p = replaced_str;
+         n = (int)MMDAgent_strlen(replaced_str);
+      } else {
+         m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: \"%s\": not found", m_name, seg->str);
+      }
+      break;
+   case VIMANAGER_SEGMENT_KEYVALUE:
+      /* consult global variable in KeyValue, copy it while other FSTs can not modify it */
+      {
+         std::lock_guard<std::mutex> lock(VIManager_keyValueMutex);
+         p = m_mmdagent->getKeyValue()->getString(seg->str, NULL);
+         if (p) {
+            m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: get KeyValue of \"%s\": \"%s\"", m_name, seg->str, p);
+            n = (int)MMDAgent_strlen(p);
+            if ((size_t)n > *rest)
+               n = (int)*rest;
+            if (n > 0) {
+               memcpy(*out, p, n);
+               *out += n;
+               *rest -= n;
+            }
+         } else {
+            m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: KeyValue \"%s\": not found", m_name, seg->str);
+         }
+      }
+      return;
+   case VIMANAGER_SEGMENT_VARIABLE:
+      /* copy value directly, using the hash computed at parsing */
+      n = m_variableList.copyValueWithHash(seg->str, seg->len, seg->hash, *out, *rest + 1);
+      if (n > 0) {
+         *out += n;
+         *rest -= n;
+      }
       return;
    }
+   if (p == NULL || n <= 0)
+      return;
+   if ((size_t)n > *rest)
+      n = (int)*rest;
+   memcpy(*out, p, n);
+   *out += n;
+   *rest -= n;
+}
+
+/* VIManager::expandTemplate: make string from template, substituting variables with their values */
+void VIManager::expandTemplate(const VIManager_Template *t, char *output)
+{
+   int i;
+   size_t rest;
+   char *out;
 
-   c = input;
    out = output;
-   for (i = 0; i < len; i += size) {
-      size = MMDAgent_getcharsize(c);
-      if(size == 0) { /* fail safe */
-         *out = '\0';
-         return;
-      }
-      memcpy(out, c, size);
-      if (size == 1 && *c == '$') {
-         /* variable start, hold this place to cv and read variable name */
-         cv = out;
-         c += size;
-         out += size;
-         i += size;
-         if (MMDAgent_getcharsize(c) == 1 && *c == '$') {
-            /* "$$" -> "$" */
-            c += 1;
-            size = 1;
+   rest = MMDAGENT_MAXBUFLEN - 1;
+   for (i = 0; i < t->num; i++)
+      expandSegment(&(t->segments[i]), &out, &rest);
+   *out = '\0';
+}
+
+/* VIManager::substituteVariableAndCopy: substitute variables with their values in a string, scanning it in place */
+void VIManager::substituteVariableAndCopy(const char *input, char *output)
+{
+   const char *p, *end, *str;
+   size_t len, rest;
+   char *out;
+   VIManager_Segment seg;
+   char name[MMDAGENT_MAXBUFLEN];
+
+   out = output;
+   rest = MMDAGENT_MAXBUFLEN - 1;
+   len = MMDAgent_strlen(input);
+   if (len > 0) {
+      p = input;
+      end = input + len;
+      while (VIManager_Template_scan(&p, end, &seg.kind, &str, &len)) {
+         if (seg.kind == VIMANAGER_SEGMENT_TEXT) {
+            if (len > rest)
+               len = rest;
+            memcpy(out, str, len);
+            out += len;
+            rest -= len;
             continue;
          }
-         braced_counter = 0;
-         if (MMDAgent_getcharsize(c) == 1 && *c == '{') {
-            braced_counter++;
-            c += 1;
-            i += 1;
-         }
-         for (; i < len; i += size) {
-            size = MMDAgent_getcharsize(c);
-            if(size == 0) { /* fail safe */
-               *out = '\0';
-               return;
-            }
-            if (MMDAgent_getcharsize(c) == 1 && *c == '{') {
-               braced_counter++;
-            } else if (MMDAgent_getcharsize(c) == 1 && *c == '}') {
-               braced_counter--;
-               if (braced_counter == 0) {
-                  c += 1;
-                  i += 1;
-                  break;
-               }
-            } else {
-               if (size != 1 || ! (isalnum(*c) || *c == '_' || *c == '%')) break;
-            }
-            memcpy(out, c, size);
-            c += size;
-            out += size;
-         }
-         *out = '\0';
-         /* search for variable */
-         if (MMDAgent_strstr(cv + 1, "%ENV")) {
-            /* consult environmental variables */
-            v = NULL;
-            out = cv;
-            char replaced_str[MMDAGENT_MAXBUFLEN];
-            m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s", cv + 1);
-            if (MMDAgent_replaceEnvDup(cv + 1, replaced_str) >= 0) {
-               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: get \"%s\": \"%s\"", m_name, cv + 1, replaced_str);
-               vlen = (int)MMDAgent_strlen(replaced_str);
-               memcpy(out, replaced_str, vlen);
-               out += vlen;
-            } else {
-               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: \"%s\": not found", m_name, cv + 1);
-            }
-         } else if (*(cv + 1) == '%') {
-            /* consult global variable in KeyValue */
-            v = NULL;
-            /* rewind out buf to the start of variable name */
-            out = cv;
-            const char *p = m_mmdagent->getKeyValue()->getString(cv + 2, NULL);
-            if (p) {
-               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: get KeyValue of \"%s\": \"%s\"", m_name, cv + 2, p);
-               vlen = (int)MMDAgent_strlen(p);
-               memcpy(out, p, vlen);
-               out += vlen;
-            } else {
-               m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: KeyValue \"%s\": not found", m_name, cv + 2);
-            }
-         } else {
-            v = VIManager_VList_search(&m_variableList, cv + 1);
-            /* rewind out buf to the start of variable name */
-            out = cv;
-            /* overwrite with its value */
-            if (v != NULL) {
-               vlen = (int)MMDAgent_strlen(v->value);
-               memcpy(out, v->value, vlen);
-               out += vlen;
-            }
-         }
-         size = 0;
-      } else {
-         c += size;
-         out += size;
+         /* variable name is copied to stack to be classified */
+         if (len >= MMDAGENT_MAXBUFLEN)
+            len = MMDAGENT_MAXBUFLEN - 1;
+         memcpy(name, str, len);
+         name[len] = '\0';
+         seg.str = name;
+         seg.len = len;
+         VIManager_Segment_classify(&seg);
+         expandSegment(&seg, &out, &rest);
       }
    }
    *out = '\0';
 }
 
-/* VIManager::checkStringMatch: check if vstr with variables matches the string */
-bool VIManager::checkStringMatch(const char *vstr, const char *str)
+/* VIManager::checkStringMatch: check if vstr with variables, split in template if any, matches the string */
+bool VIManager::checkStringMatch(const char *vstr, const VIManager_Template *t, const char *str)
 {
    char buf1[MMDAGENT_MAXBUFLEN];
 
    if (vstr == NULL || str == NULL)
       return false;
 
+   /* pattern without variables */
+   if (t == NULL || t->num == 0)
+      return MMDAgent_strequal(str, vstr);
+
    /* substitute variables in pattern */
-   substituteVariableAndCopy(vstr, buf1);
+   expandTemplate(t, buf1);
 
    return MMDAgent_strequal(str, buf1);
 }
 
-/* VIManager::checkStringMatchRegExp: check if vstr with variables matches the string as regular expression */
-bool VIManager::checkStringMatchRegExp(const char *vstr, const char *str1, const char *str2)
+/* VIManager::checkStringMatchRegExp: check if regular expression of the arc with variables matches the string */
+bool VIManager::checkStringMatchRegExp(VIManager_Arc *arc, const char *str1, const char *str2)
 {
    char buf1[MMDAGENT_MAXBUFLEN];
    char buf2[MMDAGENT_MAXBUFLEN];
    int i, n;
    bool match;
-
-   if (vstr == NULL || str1 == NULL)
+   RE2 *re;
+   std::string resultBuf[VIMANAGER_REGEXP_MAXCAPTURE];
+   RE2::Arg argBuf[VIMANAGER_REGEXP_MAXCAPTURE];
+   RE2::Arg *argpBuf[VIMANAGER_REGEXP_MAXCAPTURE];
+   std::string *result;
+   RE2::Arg *arg;
+   RE2::Arg **argp;
+
+   if (arc == NULL || arc->input_kind != VIMANAGER_ARCINPUT_REGEXP || str1 == NULL)
       return false;
 
-   /* substitute variables in pattern */
-   substituteVariableAndCopy(vstr, buf1);
+   if (arc->regexp_static == false) {
+      /* substitute variables in pattern */
+      expandTemplate(&arc->regexp_template, buf1);
+      /* compile again only when the substituted pattern differs from the last one */
+      if (arc->regexp == NULL || MMDAgent_strequal(arc->regexp_pattern, buf1) == false) {
+         if (arc->regexp != NULL)
+            delete (RE2 *)arc->regexp;
+         if (arc->regexp_pattern != NULL)
+            free(arc->regexp_pattern);
+         arc->regexp_pattern = MMDAgent_strdup(buf1);
+         arc->regexp = new RE2(arc->regexp_pattern);
+      }
+   }
+   re = (RE2 *)arc->regexp;
 
    /* set target pattern */
    if (str2 != NULL)
@@ -751,42 +1324,47 @@ bool VIManager::checkStringMatchRegExp(const char *vstr, const char *str1, const
    else
       strcpy(buf2, str1);
 
-   /* create re2 instance with given pattern */
-   RE2 re(buf1);
-
-   if (re.ok() == false)
-      return MMDAgent_strequal(buf2, buf1);
+   if (re->ok() == false)
+      return MMDAgent_strequal(buf2, arc->regexp_pattern);
 
    /* get number of match argument to be taken */
-   n = re.NumberOfCapturingGroups();
+   n = re->NumberOfCapturingGroups();
    if (n == 0)
-      return RE2::FullMatch(buf2, re);
+      return RE2::FullMatch(buf2, *re);
 
-   std::string *result = new std::string[n];
-   RE2::Arg *arg = new RE2::Arg[n];
-   RE2::Arg **argp = new RE2::Arg*[n];
+   if (n <= VIMANAGER_REGEXP_MAXCAPTURE) {
+      result = resultBuf;
+      arg = argBuf;
+      argp = argpBuf;
+   } else {
+      result = new std::string[n];
+      arg = new RE2::Arg[n];
+      argp = new RE2::Arg*[n];
+   }
    for (i = 0; i < n; i++) {
       arg[i] = &result[i];
       argp[i] = &arg[i];
    }
-   match = RE2::FullMatchN(buf2, re, &(argp[0]), n);
+   match = RE2::FullMatchN(buf2, *re, &(argp[0]), n);
    if (match == true) {
       /* set numeric variables */
       for (i = 0; i < n; i++) {
          MMDAgent_snprintf(buf2, MMDAGENT_MAXBUFLEN, "%d", i + 1);
-         VIManager_VList_set(&m_variableList, buf2, result[i].c_str());
+         m_variableList.set(buf2, result[i].c_str());
          m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: $%s=%s", m_name, buf2, result[i].c_str());
       }
    }
-   delete[] result;
-   delete[] arg;
-   delete[] argp;
+   if (n > VIMANAGER_REGEXP_MAXCAPTURE) {
+      delete[] result;
+      delete[] arg;
+      delete[] argp;
+   }
 
    return match;
 }
 
-/* VIManager::checkVariableTest: check if variable expression is true */
-bool VIManager::checkVariableTest(const char *vstr, bool *result)
+/* VIManager::checkVariableTest: check if variable expression, split in template if any, is true */
+bool VIManager::checkVariableTest(const char *vstr, const VIManager_Template *t, bool *result)
 {
    char buff[MMDAGENT_MAXBUFLEN];
    int len;
@@ -795,7 +1373,10 @@ bool VIManager::checkVariableTest(const char *vstr, bool *result)
       return false;
 
    /* substitute variables in pattern */
-   substituteVariableAndCopy(vstr, buff);
+   if (t != NULL && t->num > 0)
+      expandTemplate(t, buff);
+   else
+      substituteVariableAndCopy(vstr, buff);
 
    len = (int)MMDAgent_strlen(buff);
    for (int i = 0; i < len - 1; i++) {
@@ -818,30 +1399,30 @@ bool VIManager::checkVariableTest(const char *vstr, bool *result)
 }
 
 /* VIManager::checkArcMatch: check if an arc matches an input */
-bool VIManager::checkArcMatch(const char *arc_type, const char *input_type, const InputArguments *arc_arg, const InputArguments *input_arg)
+bool VIManager::checkArcMatch(VIManager_Arc *arc, const char *input_type, const InputArguments *input_arg)
 {
-   char buf[MMDAGENT_MAXBUFLEN];
-   int i, j, k;
+   const char *arc_type = arc->input_event_type;
+   const InputArguments *arc_arg = &(arc->input_event_args);
+   const VIManager_Template *arc_arg_template;
+   int i, j, k, n;
    bool match;
 
-   if (MMDAgent_strlen(arc_type) > 1 && arc_type[0] == VIMANAGER_REGEXP_BRACE && arc_type[MMDAgent_strlen(arc_type) - 1] == VIMANAGER_REGEXP_BRACE) {
+   if (arc->input_kind == VIMANAGER_ARCINPUT_REGEXP) {
       /* regular expression match */
-      strcpy(buf, &(arc_type[1]));
-      buf[MMDAgent_strlen(buf) - 1] = '\0';
       if (input_arg != NULL)
-         return checkStringMatchRegExp(buf, input_type, input_arg->str);
+         return checkStringMatchRegExp(arc, input_type, input_arg->str);
       else
-         return checkStringMatchRegExp(buf, input_type, NULL);
+         return checkStringMatchRegExp(arc, input_type, NULL);
    }
 
-   if (MMDAgent_strlen(arc_type) > 1 && arc_type[0] == '$') {
+   if (arc->input_kind == VIMANAGER_ARCINPUT_VARIABLE) {
       /* variable test */
-      checkVariableTest(arc_type, &match);
+      checkVariableTest(arc_type, &arc->input_type_template, &match);
       m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: test: %s: result = %s", m_name, arc_type, match ? "true" : "false");
       return match;
    }
 
-   if (checkStringMatch(arc_type, input_type) == false)
+   if (checkStringMatch(arc_type, &arc->input_type_template, input_type) == false)
       return false;
 
    if (arc_arg == NULL)
@@ -855,11 +1436,13 @@ bool VIManager::checkArcMatch(const char *arc_type, const char *input_type, cons
    if (arc_arg->size != input_arg->size)
       return false;
 
+   n = 0;
    for (i = 0; i < arc_arg->size; i++) {
-      for (j = 0; j < arc_arg->argc[i]; j++) {
+      for (j = 0; j < arc_arg->argc[i]; j++, n++) {
+         arc_arg_template = arc->input_args_template != NULL ? &(arc->input_args_template[n]) : NULL;
          match = false;
          for (k = 0; k < input_arg->argc[i]; k++) {
-            if (checkStringMatch(arc_arg->args[i][j], input_arg->args[i][k]) == true) {
+            if (checkStringMatch(arc_arg->args[i][j], arc_arg_template, input_arg->args[i][k]) == true) {
                match = true;
                break;
             }
@@ -871,12 +1454,27 @@ bool VIManager::checkArcMatch(const char *arc_type, const char *input_type, cons
    return true;
 }
 
+/* VIManager::assignVariable: assign value to variable, or to KeyValue when name starts with '%' */
+void VIManager::assignVariable(const char *name, const char *value)
+{
+   if (name[0] == '%') {
+      {
+         std::lock_guard<std::mutex> lock(VIManager_keyValueMutex);
+         m_mmdagent->getKeyValue()->setString(&(name[1]), "%s", value);
+      }
+      m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: set KeyValue \"%s\" to \"%s\"", m_name, &(name[1]), value);
+   } else {
+      m_variableList.set(name, value);
+   }
+   m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: $%s=%s", m_name, name, value);
+}
+
 /* VIManager::assignVariableByEquation: assign variable by equation */
 bool VIManager::assignVariableByEquation(const char *va)
 {
-   int idx1, idx2;
-   int s, len;
+   int idx;
    char tok[2];
+   const char *name;
    char buff[MMDAGENT_MAXBUFLEN];
    char buffn[MMDAGENT_MAXBUFLEN];
    char buffv[MMDAGENT_MAXBUFLEN];
@@ -888,39 +1486,31 @@ bool VIManager::assignVariableByEquation(const char *va)
    tok[0] = VIMANAGER_SEPARATOR2;
    tok[1] = '\0';
 
-   idx1 = 0;
-   while (getTokenFromStringWithQuoters(va, &idx1, buff, tok, "\"'", true) > 0) {
+   idx = 0;
+   while (getTokenFromStringWithQuoters(va, &idx, buff, tok, "\"'", true) > 0) {
       /* separate by equal */
-      if (countArgs(buff, '=') != 2)
-         return false;
-      idx2 = 0;
-      getArgFromString(buff, &idx2, buffn, '=');
-      if (buffn[0] != '$')
+      name = splitEquation(buff, buffn, buffv);
+      if (name == NULL)
          return false;
-      s = 1;
-      if (buffn[1] == '{') {
-         len = (int)MMDAgent_strlen(buffn);
-         if (buffn[len - 1] != '}')
-            return false;
-         buffn[len - 1] = '\0';
-         /* check if variable name is valid */
-         if (checkVariableName(&(buffn[2])) == false)
-            return false;
-         s = 2;
-      }
-      getArgFromString(buff, &idx2, buffv, '=');
       substituteVariableAndCopy(buffv, buffvr);
-      if (buffn[s] == '%') {
-         m_mmdagent->getKeyValue()->setString(&(buffn[s + 1]), "%s", buffvr);
-         m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: set KeyValue \"%s\" to \"%s\"", m_name, &(buffn[s + 1]), buffvr);
-      } else {
-         VIManager_VList_set(&m_variableList, &(buffn[s]), buffvr);
-      }
-      m_mmdagent->sendLogString(m_id, MLOG_STATUS, "%s: $%s=%s", m_name, &(buffn[s]), buffvr);
+      assignVariable(name, buffvr);
    }
    return true;
 }
 
+/* VIManager::assignVariableByArc: assign variables by the assignments of the arc */
+bool VIManager::assignVariableByArc(const VIManager_Arc *arc)
+{
+   int i;
+   char buff[MMDAGENT_MAXBUFLEN];
+
+   for (i = 0; i < arc->num_assignments; i++) {
+      expandTemplate(&(arc->assignments[i].value), buff);
+      assignVariable(arc->assignments[i].name, buff);
+   }
+   return arc->assignments_valid;
+}
+
 /* VIManager::loadFSTFile: load fst file */
 bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_count_ret, int depth, const char *label)
 {
@@ -970,6 +1560,7 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
       *arc_count_ret = 0;
       return false;
    }
+   VIManager_addStringList(&m_sourceList, &m_numSource, file);
 
    /* prepare */
    line = 1;
@@ -998,6 +1589,8 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
             /* variable definitions at the top */
             if (assignVariableByEquation(&(buff[idx])) == false)
                m_mmdagent->sendLogString(m_id, MLOG_ERROR, "%s: line %d: failed to set variable: \"%s\"", file, line, buff_s1);
+            else
+               VIManager_addStringList(&m_definitionList, &m_numDefinition, &(buff[idx]));
             arc = NULL;
             within_block = false;
          } else if (buff[idx] == '%') {
@@ -1048,7 +1641,7 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
                   MMDAgent_snprintf(label1, VIMANAGER_STATE_LABEL_MAXLEN, "%s", buff_s1);
                   MMDAgent_snprintf(label2, VIMANAGER_STATE_LABEL_MAXLEN, "%s", buff_s2);
                   if (buff_is[0] == '$') {
-                     if (checkVariableTest(buff_is, NULL) == false) {
+                     if (checkVariableTest(buff_is, NULL, NULL) == false) {
                         m_mmdagent->sendLogString(m_id, MLOG_ERROR, "%s: line %d: format error in variable test: %s", file, line, buff_is);
                         err = true;
                      }
@@ -1081,7 +1674,7 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
                   if (buff_is[0] == '+') {
                      /* append line in block */
                      if (buff_is[1] == '$') {
-                        if (checkVariableTest(&(buff_is[1]), NULL) == false) {
+                        if (checkVariableTest(&(buff_is[1]), NULL, NULL) == false) {
                            m_mmdagent->sendLogString(m_id, MLOG_ERROR, "%s: line %d: format error in variable test: %s", file, line, buff_is);
                            err = true;
                         }
@@ -1109,7 +1702,7 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
                      /* definition line in block */
                      if (size_is > 0 && size_os > 0 && size_er == 0) {
                         if (buff_is[0] == '$') {
-                           if (checkVariableTest(buff_is, NULL) == false) {
+                           if (checkVariableTest(buff_is, NULL, NULL) == false) {
                               m_mmdagent->sendLogString(m_id, MLOG_ERROR, "%s: line %d: format error in variable test: %s", file, line, buff_is);
                               err = true;
                            }
@@ -1162,6 +1755,110 @@ bool VIManager::loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_c
    return ret;
 }
 
+/* VIManager::loadCompiledFSTFile: load compiled fst file if it is newer than all of its sources */
+bool VIManager::loadCompiledFSTFile(ZFileKey *key, const char *file, const char *source, unsigned int *arc_count_ret)
+{
+   ZFile *zf;
+   const unsigned char *data;
+   const VIManager_CompiledHeader *header;
+   const unsigned int *sources;
+   const unsigned int *definitions;
+   const VIManager_CompiledState *states;
+   const VIManager_CompiledArc *arcs;
+   const VIManager_CompiledArc *ca;
+   const char *strings;
+   VIManager_State **stateList;
+   VIManager_State *s;
+   VIManager_Arc *a;
+   long long mtime, t;
+   unsigned int i, j;
+
+   *arc_count_ret = 0;
+
+   /* compiled file should not be older than the source */
+   mtime = MMDAgent_getmtime(file);
+   if (mtime < 0)
+      return false;
+   t = MMDAgent_getmtime(source);
+   if (t < 0 || t > mtime)
+      return false;
+
+   /* open */
+   zf = new ZFile(key);
+   if (zf->openAndLoad(file) == false) {
+      delete zf;
+      return false;
+   }
+   data = zf->getData();
+   if (VIManager_checkCompiledData(data, zf->getSize()) == false) {
+      m_mmdagent->sendLogString(m_id, MLOG_WARNING, "%s: not a valid compiled FST, ignored", file);
+      zf->close();
+      delete zf;
+      return false;
+   }
+   header = (const VIManager_CompiledHeader *)data;
+   sources = (const unsigned int *)(data + sizeof(VIManager_CompiledHeader));
+   definitions = sources + header->numSource;
+   states = (const VIManager_CompiledState *)(definitions + header->numDefinition);
+   arcs = (const VIManager_CompiledArc *)(states + header->numState);
+   strings = (const char *)(arcs + header->numArc);
+
+   /* included files should also be older than the compiled file */
+   for (i = 0; i < header->numSource; i++) {
+      t = MMDAgent_getmtime(&(strings[sources[i]]));
+      if (t < 0 || t > mtime) {
+         zf->close();
+         delete zf;
+         return false;
+      }
+   }
+
+   /* create states */
+   stateList = (VIManager_State **)malloc(sizeof(VIManager_State *) * (header->numState + 1));
+   for (i = 0; i < header->numState; i++)
+      stateList[i] = VIManager_SList_searchStateAndCreate(i < header->numStateMain ? &m_stateList : &m_stateListAppend, &(strings[states[i].label]));
+
+   /* create arcs */
+   for (i = 0; i < header->numState; i++) {
+      s = stateList[i];
+      if (states[i].virtualFromState != VIMANAGER_COMPILED_NONE)
+         s->virtual_fromState = stateList[states[i].virtualFromState];
+      if (states[i].virtualToState != VIMANAGER_COMPILED_NONE)
+         s->virtual_toState = stateList[states[i].virtualToState];
+      for (j = 0; j < states[i].numArc; j++) {
+         ca = &(arcs[states[i].arcHead + j]);
+         a = (VIManager_Arc *)malloc(sizeof(VIManager_Arc));
+         VIManager_Arc_initialize(a, VIManager_getCompiledString(strings, ca->inputEventType), VIManager_getCompiledString(strings, ca->inputEventArgs), VIManager_getCompiledString(strings, ca->outputCommandType), VIManager_getCompiledString(strings, ca->outputCommandArgs), VIManager_getCompiledString(strings, ca->variableAction), stateList[ca->nextState]);
+         a->line_number = ca->lineNumber;
+         a->block_id = ca->blockId;
+         if (ca->label != VIMANAGER_COMPILED_NONE)
+            a->label = MMDAgent_strdup(&(strings[ca->label]));
+         VIManager_AList_append(&s->arc_list, a);
+      }
+   }
+   free(stateList);
+
+   /* execute variable definitions in the order they were read */
+   for (i = 0; i < header->numDefinition; i++) {
+      assignVariableByEquation(&(strings[definitions[i]]));
+      VIManager_addStringList(&m_definitionList, &m_numDefinition, &(strings[definitions[i]]));
+   }
+   for (i = 0; i < header->numSource; i++)
+      VIManager_addStringList(&m_sourceList, &m_numSource, &(strings[sources[i]]));
+
+   m_block_id = header->blockId;
+   m_append_num = header->appendNum;
+   *arc_count_ret = header->numArc;
+
+   zf->close();
+   delete zf;
+
+   if (m_fileName)
+      free(m_fileName);
+   m_fileName = MMDAgent_strdup(source);
+
+   return true;
+}
 
 /* VIManager::VIManager: constructor */
 VIManager::VIManager()
@@ -1180,6 +1877,7 @@ bool VIManager::load(MMDAgent *mmdagent, int id, ZFileKey *key, const char *file
 {
    unsigned int arc_count;
    unsigned int arc_count_total;
+   char buff[MMDAGENT_MAXBUFLEN];
    bool ret = true;
 
    m_mmdagent = mmdagent;
@@ -1193,18 +1891,28 @@ bool VIManager::load(MMDAgent *mmdagent, int id, ZFileKey *key, const char *file
    VIManager_SList_initialize(&m_stateList);
    VIManager_SList_clear(&m_stateListAppend);
    VIManager_SList_initialize(&m_stateListAppend);
+   VIManager_clearStringList(&m_sourceList, &m_numSource);
+   VIManager_clearStringList(&m_definitionList, &m_numDefinition);
    m_append_num = 0;
 
-   /* load FST */
+   /* load FST, using compiled one if up to date */
    arc_count_total = 0;
    m_block_id = 0;
-   if (loadFSTFile(key, file, &arc_count, 0, NULL) == true) {
+   MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "%s%s", file, VIMANAGER_COMPILED_SUFFIX);
+   if (m_useCompiled == true && loadCompiledFSTFile(key, buff, file, &arc_count) == true) {
+      m_mmdagent->sendLogString(m_id, MLOG_STATUS, "FST %s \"%s\"", name, buff);
+      arc_count_total += arc_count;
+   } else if (loadFSTFile(key, file, &arc_count, 0, NULL) == true) {
       m_mmdagent->sendLogString(m_id, MLOG_STATUS, "FST %s \"%s\"", name, file);
       arc_count_total += arc_count;
    } else {
       ret = false;
    }
 
+   /* index arcs of each state by input event type */
+   VIManager_SList_buildIndex(&m_stateList);
+   VIManager_SList_buildIndex(&m_stateListAppend);
+
    if (ret == true) {
       unsigned int c1, c2;
       c1 = VIManager_SList_count(&m_stateList);
@@ -1232,7 +1940,7 @@ static void dispNum(char *buff, int bufflen, VIManager_State *s1, VIManager_Stat
 /* VIManager::transition: state transition (if jumped, return arc) */
 bool VIManager::transition(const char *itype, const InputArguments *iargs, char *otype, char *oargs)
 {
-   VIManager_Arc *arc;
+   VIManager_Arc *arc, *candidate1, *candidate2;
    VIManager_AList *arc_list;
    char buff[128];
 
@@ -1250,10 +1958,19 @@ bool VIManager::transition(const char *itype, const InputArguments *iargs, char
       return false;
    }
 
-   /* match */
-   for (arc = arc_list->head; arc != NULL; arc = arc->next) {
+   /* match, testing only arcs of this input type and arcs which may match any input, in order of definition */
+   candidate1 = VIManager_State_findArcs(m_currentState, itype);
+   candidate2 = m_currentState->arc_dynamic;
+   while (candidate1 != NULL || candidate2 != NULL) {
+      if (candidate2 == NULL || (candidate1 != NULL && candidate1->order < candidate2->order)) {
+         arc = candidate1;
+         candidate1 = candidate1->next_candidate;
+      } else {
+         arc = candidate2;
+         candidate2 = candidate2->next_candidate;
+      }
       /* check if input matches this arc, consulting variables and wildcards */
-      if (checkArcMatch(arc->input_event_type, itype, &arc->input_event_args, iargs)) {
+      if (checkArcMatch(arc, itype, iargs)) {
          dispNum(buff, 128, m_currentState, arc->next_state);
          if (MMDAgent_strequal(itype, VIMANAGER_EPSILON) == false) {
             if (iargs == NULL || iargs->str == NULL)
@@ -1275,10 +1992,10 @@ bool VIManager::transition(const char *itype, const InputArguments *iargs, char
             }
          }
          /* set output string, consulting variables if any */
-         substituteVariableAndCopy(arc->output_command_type, otype);
-         substituteVariableAndCopy(arc->output_command_args, oargs);
+         expandTemplate(&arc->output_type_template, otype);
+         expandTemplate(&arc->output_args_template, oargs);
          /* if this arc has variable action, execute it */
-         assignVariableByEquation(arc->variable_action);
+         assignVariableByArc(arc);
          /* move to next state */
          m_currentState = arc->next_state;
          /* check if the next state has arc */
@@ -1325,7 +2042,7 @@ VIManager_State *VIManager::getCurrentState()
 }
 
 /* VIManager::getCurrentVariableList: get current variable list */
-VIManager_VList *VIManager::getCurrentVariableList()
+VariableStore *VIManager::getCurrentVariableList()
 {
    return &m_variableList;
 }
@@ -1392,3 +2109,142 @@ bool VIManager::jumpToState(const char *state_label)
    m_currentState = state;
    return true;
 }
+
+/* VIManager::addLatency: add time spent for evaluating an input event to statistics */
+void VIManager::addLatency(double msec)
+{
+   std::lock_guard<std::mutex> lock(m_mutexLatency);
+   m_latencyCount++;
+   m_latencyTotal += msec;
+   if (m_latencyMax < msec)
+      m_latencyMax = msec;
+}
+
+/* VIManager::getLatency: get number of evaluations and average / maximum time spent for an evaluation in msec */
+unsigned int VIManager::getLatency(double *average, double *max)
+{
+   std::lock_guard<std::mutex> lock(m_mutexLatency);
+   if (average)
+      *average = (m_latencyCount > 0) ? m_latencyTotal / m_latencyCount : 0.0;
+   if (max)
+      *max = m_latencyMax;
+   return m_latencyCount;
+}
+
+/* VIManager::setUseCompiled: set whether to use compiled FST file at loading */
+void VIManager::setUseCompiled(bool flag)
+{
+   m_useCompiled = flag;
+}
+
+/* VIManager::saveCompiled: save loaded FST to compiled FST file */
+bool VIManager::saveCompiled(const char *file)
+{
+   VIManager_CompiledHeader header;
+   VIManager_CompiledState *states;
+   VIManager_CompiledArc *arcs;
+   VIManager_StateID *ids;
+   VIManager_State **stateList;
+   VIManager_StringTable table;
+   VIManager_State *s;
+   VIManager_Arc *a;
+   VIManager_SList *l;
+   unsigned int *sources;
+   unsigned int *definitions;
+   unsigned int i, n;
+   void *save;
+   FILE *fp;
+   bool ret = true;
+
+   if (m_numSource <= 0)
+      return false;
+
+   /* number states, states in state list first */
+   memset(&header, 0, sizeof(VIManager_CompiledHeader));
+   header.numStateMain = VIManager_SList_count(&m_stateList);
+   header.numState = header.numStateMain + VIManager_SList_count(&m_stateListAppend);
+   stateList = (VIManager_State **)malloc(sizeof(VIManager_State *) * (header.numState + 1));
+   ids = (VIManager_StateID *)malloc(sizeof(VIManager_StateID) * (header.numState + 1));
+   n = 0;
+   for (l = &m_stateList; l != NULL; l = (l == &m_stateList) ? &m_stateListAppend : NULL) {
+      for (s = (VIManager_State *)l->index.firstData(&save); s; s = (VIManager_State *)l->index.nextData(&save)) {
+         stateList[n] = s;
+         ids[n].state = s;
+         ids[n].id = n;
+         n++;
+         for (a = s->arc_list.head; a != NULL; a = a->next)
+            header.numArc++;
+      }
+   }
+   qsort(ids, header.numState, sizeof(VIManager_StateID), VIManager_compareStateID);
+
+   /* make state list, arc list and string table */
+   VIManager_StringTable_initialize(&table);
+   states = (VIManager_CompiledState *)malloc(sizeof(VIManager_CompiledState) * (header.numState + 1));
+   arcs = (VIManager_CompiledArc *)malloc(sizeof(VIManager_CompiledArc) * (header.numArc + 1));
+   n = 0;
+   for (i = 0; i < header.numState; i++) {
+      s = stateList[i];
+      states[i].label = VIManager_StringTable_add(&table, s->label);
+      states[i].virtualFromState = VIManager_findStateID(ids, header.numState, s->virtual_fromState);
+      states[i].virtualToState = VIManager_findStateID(ids, header.numState, s->virtual_toState);
+      states[i].arcHead = n;
+      for (a = s->arc_list.head; a != NULL; a = a->next) {
+         arcs[n].inputEventType = VIManager_StringTable_add(&table, a->input_event_type);
+         arcs[n].inputEventArgs = VIManager_StringTable_add(&table, a->input_event_args.str);
+         arcs[n].outputCommandType = VIManager_StringTable_add(&table, a->output_command_type);
+         arcs[n].outputCommandArgs = VIManager_StringTable_add(&table, a->output_command_args);
+         arcs[n].variableAction = VIManager_StringTable_add(&table, a->variable_action);
+         arcs[n].label = VIManager_StringTable_add(&table, a->label);
+         arcs[n].nextState = VIManager_findStateID(ids, header.numState, a->next_state);
+         arcs[n].lineNumber = a->line_number;
+         arcs[n].blockId = a->block_id;
+         n++;
+      }
+      states[i].numArc = n - states[i].arcHead;
+   }
+   sources = (unsigned int *)malloc(sizeof(unsigned int) * (m_numSource + 1));
+   for (i = 0; i < (unsigned int)m_numSource; i++)
+      sources[i] = VIManager_StringTable_add(&table, m_sourceList[i]);
+   definitions = (unsigned int *)malloc(sizeof(unsigned int) * (m_numDefinition + 1));
+   for (i = 0; i < (unsigned int)m_numDefinition; i++)
+      definitions[i] = VIManager_StringTable_add(&table, m_definitionList[i]);
+
+   /* set header */
+   memcpy(header.magic, VIMANAGER_COMPILED_MAGIC, sizeof(header.magic));
+   header.version = VIMANAGER_COMPILED_VERSION;
+   header.numSource = m_numSource;
+   header.numDefinition = m_numDefinition;
+   header.stringSize = table.size;
+   header.blockId = m_block_id;
+   header.appendNum = m_append_num;
+
+   /* write */
+   fp = MMDAgent_fopen(file, "wb");
+   if (fp == NULL) {
+      ret = false;
+   } else {
+      if (fwrite(&header, sizeof(VIManager_CompiledHeader), 1, fp) != 1
+            || fwrite(sources, sizeof(unsigned int), header.numSource, fp) != header.numSource
+            || fwrite(definitions, sizeof(unsigned int), header.numDefinition, fp) != header.numDefinition
+            || fwrite(states, sizeof(VIManager_CompiledState), header.numState, fp) != header.numState
+            || fwrite(arcs, sizeof(VIManager_CompiledArc), header.numArc, fp) != header.numArc
+            || fwrite(table.buf, 1, table.size, fp) != table.size)
+         ret = false;
+      if (fclose(fp) != 0)
+         ret = false;
+   }
+
+   free(definitions);
+   free(sources);
+   free(arcs);
+   free(states);
+   free(ids);
+   free(stateList);
+   VIManager_StringTable_clear(&table);
+
+   if (ret == false)
+      m_mmdagent->sendLogString(m_id, MLOG_ERROR, "failed to write compiled FST \"%s\"", file);
+
+   return ret;
+}
@@ -69,6 +69,21 @@
 #define VIMANAGER_STATE_LABEL_MAXLEN 128
 #define VIMANAGER_HISTORY_LEN 128
 #define VIMANAGER_ATEXIST_STATE_LABEL "AT_EXIT"
+#define VIMANAGER_REGEXP_MAXCAPTURE 16 /* number of captures taken without heap allocation */
+
+#define VIMANAGER_ARCINPUT_STRING   0 /* arc matches event type and arguments */
+#define VIMANAGER_ARCINPUT_REGEXP   1 /* arc matches regular expression */
+#define VIMANAGER_ARCINPUT_VARIABLE 2 /* arc tests variables */
+
+#define VIMANAGER_SEGMENT_TEXT     0 /* plain text */
+#define VIMANAGER_SEGMENT_VARIABLE 1 /* FST variable */
+#define VIMANAGER_SEGMENT_KEYVALUE 2 /* global variable in KeyValue */
+#define VIMANAGER_SEGMENT_ENV      3 /* environmental variable */
+
+#define VIMANAGER_COMPILED_SUFFIX  "b"        /* compiled FST file name is FST file name followed by this */
+#define VIMANAGER_COMPILED_MAGIC   "VIMFSTB"  /* identifier at the head of compiled FST file */
+#define VIMANAGER_COMPILED_VERSION 1
+#define VIMANAGER_COMPILED_NONE    0xffffffff /* no string or no state */
 
 /* InputArguments: input for state transition */
 typedef struct _InputArguments {
@@ -84,6 +99,26 @@ void InputArguments_initialize(InputArguments *ia, const char *str);
 /* InputArguments_clear: free input */
 void InputArguments_clear(InputArguments *ia);
 
+/* VIManager_Segment: text or variable reference in string */
+typedef struct _VIManager_Segment {
+   int kind;          /* kind of segment */
+   char *str;         /* text, or name of variable */
+   size_t len;        /* length of str */
+   unsigned int hash; /* hash value of variable name */
+} VIManager_Segment;
+
+/* VIManager_Template: string split into text and variable references */
+typedef struct _VIManager_Template {
+   VIManager_Segment *segments;
+   int num;
+} VIManager_Template;
+
+/* VIManager_Assignment: assignment in variable action */
+typedef struct _VIManager_Assignment {
+   char *name;               /* variable name, KeyValue name when starting with '%' */
+   VIManager_Template value; /* value split at variables */
+} VIManager_Assignment;
+
 /* VIManager_Arc: arc */
 typedef struct _VIManager_Arc {
    char *input_event_type;
@@ -96,19 +131,44 @@ typedef struct _VIManager_Arc {
    unsigned int line_number;
    unsigned int block_id;
    char *label;
+   int input_kind;                          /* kind of input matching */
+   void *regexp;                            /* compiled regular expression, RE2 */
+   char *regexp_pattern;                    /* pattern of the compiled regular expression */
+   bool regexp_static;                      /* true when the pattern has no variable and was compiled at loading */
+   unsigned int order;                      /* order in the arc list of the state */
+   struct _VIManager_Arc *next_candidate;   /* next arc in the same candidate list of the state */
+   VIManager_Template output_type_template; /* output command type split at variables */
+   VIManager_Template output_args_template; /* output command args split at variables */
+   VIManager_Template regexp_template;      /* regular expression pattern with variables split at variables */
+   VIManager_Template input_type_template;  /* input event type or variable test split at variables, empty when it has no variable */
+   VIManager_Template *input_args_template; /* input arguments split at variables in order of args, NULL when no argument has variable */
+   int num_input_args_template;             /* number of templates in input_args_template */
+   VIManager_Assignment *assignments;       /* assignments of variable action split at loading */
+   int num_assignments;                     /* number of assignments */
+   bool assignments_valid;                  /* false when variable action has an invalid equation after the assignments */
 } VIManager_Arc;
 
 /* VIManager_ALis: arc list */
 typedef struct _VIManager_AList {
    VIManager_Arc *head;
+   VIManager_Arc *tail;
 } VIManager_AList;
 
+/* VIManager_ArcIndex: arcs of a state with the same fixed input event type */
+typedef struct _VIManager_ArcIndex {
+   const char *type;    /* input event type */
+   VIManager_Arc *head; /* arcs in order, linked by next_candidate */
+} VIManager_ArcIndex;
+
 /* VIManager_State: state */
 typedef struct _VIManager_State {
    char label[VIMANAGER_STATE_LABEL_MAXLEN];
    struct _VIManager_AList arc_list;
    struct _VIManager_State *virtual_fromState;
    struct _VIManager_State *virtual_toState;
+   VIManager_ArcIndex *arc_index; /* arcs with fixed input event type, sorted by type */
+   int num_arc_index;             /* number of entries in arc_index */
+   VIManager_Arc *arc_dynamic;    /* arcs to be tested for any input, linked by next_candidate */
 } VIManager_State;
 
 /* VIManager_SList: state list */
@@ -116,17 +176,43 @@ typedef struct _VIManager_SList {
    PTree index;
 } VIManager_SList;
 
-/* VIManager_Variable: variable */
-typedef struct _VIManager_Variable {
-   char *name;
-   char *value;
-   struct _VIManager_Variable *next;
-} VIManager_Variable;
-
-/* VIManager_VList: variable list */
-typedef struct _VIManager_VList {
-   PTree index;
-} VIManager_VList;
+/* VIManager_CompiledHeader: header of compiled FST file */
+/* the header is followed by source file list, variable definition list, state list, arc list and string table. */
+/* strings are referred by byte offset in the string table, and states by index in the state list */
+typedef struct _VIManager_CompiledHeader {
+   char magic[8];
+   unsigned int version;
+   unsigned int numSource;     /* number of FST files read for this data */
+   unsigned int numDefinition; /* number of variable definitions at the top of FST files */
+   unsigned int numState;      /* number of states */
+   unsigned int numStateMain;  /* number of states in state list, the rest are appended states */
+   unsigned int numArc;        /* number of arcs */
+   unsigned int stringSize;    /* byte size of string table */
+   unsigned int blockId;       /* last block id */
+   unsigned int appendNum;     /* number of appended states */
+} VIManager_CompiledHeader;
+
+/* VIManager_CompiledState: state in compiled FST file */
+typedef struct _VIManager_CompiledState {
+   unsigned int label;
+   unsigned int virtualFromState;
+   unsigned int virtualToState;
+   unsigned int arcHead;  /* index of the first arc of this state */
+   unsigned int numArc;
+} VIManager_CompiledState;
+
+/* VIManager_CompiledArc: arc in compiled FST file */
+typedef struct _VIManager_CompiledArc {
+   unsigned int inputEventType;
+   unsigned int inputEventArgs;
+   unsigned int outputCommandType;
+   unsigned int outputCommandArgs;
+   unsigned int variableAction;
+   unsigned int label;
+   unsigned int nextState;
+   unsigned int lineNumber;
+   unsigned int blockId;
+} VIManager_CompiledArc;
 
 /* VIManager: Voice Interaction Manager */
 class VIManager
@@ -142,11 +228,20 @@ private:
    unsigned int m_append_num; /* current number of appended status */
    unsigned int m_block_id;   /* current block id */
    VIManager_State *m_currentState; /* pointer to current state */
-   VIManager_VList m_variableList;  /* variable list */
+   VariableStore m_variableList;    /* variable list */
    VIManager_Arc *m_history[VIMANAGER_HISTORY_LEN]; /* transition history */
    int m_historyPoint; /* transition history entry point */
    std::mutex m_mutexHistory; /* mutex for history handling */
+   unsigned int m_latencyCount; /* number of measured evaluations of input events */
+   double m_latencyTotal;       /* total time spent for the evaluations in msec */
+   double m_latencyMax;         /* maximum time spent for an evaluation in msec */
+   std::mutex m_mutexLatency;   /* mutex for latency statistics */
    bool m_end;             /* true when reached a state with no arc */
+   bool m_useCompiled;     /* true when compiled FST file is used if it is up to date */
+   char **m_sourceList;    /* FST files read at the last loading */
+   int m_numSource;        /* number of FST files read at the last loading */
+   char **m_definitionList;   /* variable definitions executed at the last loading */
+   int m_numDefinition;       /* number of variable definitions executed at the last loading */
 
    /* initialize: initialize VIManager */
    void initialize();
@@ -154,27 +249,42 @@ private:
    /* clear: free VIManager */
    void clear();
 
-   /* substituteVariableAndCopy: substitute variables with their values in a string */
+   /* expandSegment: append segment to output, substituting variable with its value */
+   void expandSegment(const VIManager_Segment *seg, char **out, size_t *rest);
+
+   /* expandTemplate: make string from template, substituting variables with their values */
+   void expandTemplate(const VIManager_Template *t, char *output);
+
+   /* substituteVariableAndCopy: substitute variables with their values in a string, scanning it in place */
    void substituteVariableAndCopy(const char *input, char *output);
 
-   /* checkStringMatch: check if vstr with variables matches the string */
-   bool checkStringMatch(const char *vstr, const char *str);
+   /* checkStringMatch: check if vstr with variables, split in template if any, matches the string */
+   bool checkStringMatch(const char *vstr, const VIManager_Template *t, const char *str);
 
-   /* checkStringMatchRegExp: check if vstr with variables matches the string as regular expression */
-   bool checkStringMatchRegExp(const char *vstr, const char *str1, const char *str2);
+   /* checkStringMatchRegExp: check if regular expression of the arc matches the string */
+   bool checkStringMatchRegExp(VIManager_Arc *arc, const char *str1, const char *str2);
 
-   /* checkVariableTest: check if variable expression is true */
-   bool checkVariableTest(const char *vstr, bool *result);
+   /* checkVariableTest: check if variable expression, split in template if any, is true */
+   bool checkVariableTest(const char *vstr, const VIManager_Template *t, bool *result);
 
    /* checkArcMatch: check if an arc matches an input */
-   bool checkArcMatch(const char *arc_type, const char *input_type, const InputArguments *arc_arg, const InputArguments *input_arg);
+   bool checkArcMatch(VIManager_Arc *arc, const char *input_type, const InputArguments *input_arg);
+
+   /* assignVariable: assign value to variable, or to KeyValue when name starts with '%' */
+   void assignVariable(const char *name, const char *value);
 
    /* assignVariableByEquation: assign variable by equation */
    bool assignVariableByEquation(const char *va);
 
+   /* assignVariableByArc: assign variables by the assignments of the arc */
+   bool assignVariableByArc(const VIManager_Arc *arc);
+
    /* loadFSTFile: load fst file */
    bool loadFSTFile(ZFileKey *key, const char *file, unsigned int *arc_count_ret, int depth, const char *label);
 
+   /* loadCompiledFSTFile: load compiled fst file if it is newer than all of its sources */
+   bool loadCompiledFSTFile(ZFileKey *key, const char *file, const char *source, unsigned int *arc_count_ret);
+
 public:
 
    /* VIManager: constructor */
@@ -196,7 +306,7 @@ public:
    VIManager_State *getCurrentState();
 
    /* getCurrentVariableList: get current variable list */
-   VIManager_VList *getCurrentVariableList();
+   VariableStore *getCurrentVariableList();
 
    /* getName: get name */
    const char *getName();
@@ -212,4 +322,16 @@ public:
 
    /* jumpToState: jump to the state if exist */
    bool jumpToState(const char *state_label);
+
+   /* addLatency: add time spent for evaluating an input event to statistics */
+   void addLatency(double msec);
+
+   /* getLatency: get number of evaluations and average / maximum time spent for an evaluation in msec */
+   unsigned int getLatency(double *average, double *max);
+
+   /* setUseCompiled: set whether to use compiled FST file at loading */
+   void setUseCompiled(bool flag);
+
+   /* saveCompiled: save loaded FST to compiled FST file */
+   bool saveCompiled(const char *file);
 };
@@ -0,0 +1,109 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include <chrono>
+#include "MMDAgent.h"
+#include "VIManager.h"
+
+/* definitions */
+
+#define VIMANAGER_BENCHMARK_DEFAULTCOUNT 10
+
+/* VIManager_Benchmark_usage: print usage */
+static void VIManager_Benchmark_usage()
+{
+   fprintf(stderr, "VIManager_benchmark: measure loading time of FST and compiled FST\n");
+   fprintf(stderr, "usage: VIManager_benchmark file.fst [count]\n");
+   fprintf(stderr, "  the FST is compiled to \"file.fst%s\" first, then both are loaded count times (default: %d).\n", VIMANAGER_COMPILED_SUFFIX, VIMANAGER_BENCHMARK_DEFAULTCOUNT);
+   fprintf(stderr, "  run in the directory where the FST is loaded, since included files are relative to it.\n");
+}
+
+/* VIManager_Benchmark_measure: load FST count times and return average loading time in msec, or negative value on error */
+static double VIManager_Benchmark_measure(MMDAgent *mmdagent, const char *file, bool useCompiled, int count)
+{
+   VIManager *vimanager;
+   std::chrono::steady_clock::time_point start;
+   double total = 0.0;
+   int i;
+
+   for (i = 0; i < count; i++) {
+      vimanager = new VIManager();
+      vimanager->setUseCompiled(useCompiled);
+      start = std::chrono::steady_clock::now();
+      if (vimanager->load(mmdagent, 0, NULL, file, file) == false) {
+         delete vimanager;
+         return -1.0;
+      }
+      total += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      delete vimanager;
+   }
+
+   return total / count;
+}
+
+/* main: compile FST and compare loading time */
+int main(int argc, char **argv)
+{
+   MMDAgent *mmdagent;
+   VIManager *vimanager;
+   char buff[MMDAGENT_MAXBUFLEN];
+   int count = VIMANAGER_BENCHMARK_DEFAULTCOUNT;
+   double textTime, compiledTime;
+   bool ret;
+
+   if (argc < 2) {
+      VIManager_Benchmark_usage();
+      return 1;
+   }
+   if (argc >= 3)
+      count = MMDAgent_str2int(argv[2]);
+   if (count <= 0)
+      count = 1;
+
+   /* log messages are not output without running MMDAgent */
+   mmdagent = new MMDAgent();
+
+   /* compile */
+   MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "%s%s", argv[1], VIMANAGER_COMPILED_SUFFIX);
+   vimanager = new VIManager();
+   vimanager->setUseCompiled(false);
+   ret = vimanager->load(mmdagent, 0, NULL, argv[1], argv[1]) && vimanager->saveCompiled(buff);
+   delete vimanager;
+   if (ret == false) {
+      fprintf(stderr, "%s: failed to compile\n", argv[1]);
+      delete mmdagent;
+      return 1;
+   }
+
+   /* measure */
+   textTime = VIManager_Benchmark_measure(mmdagent, argv[1], false, count);
+   compiledTime = VIManager_Benchmark_measure(mmdagent, argv[1], true, count);
+   delete mmdagent;
+   if (textTime < 0.0 || compiledTime < 0.0) {
+      fprintf(stderr, "%s: failed to load\n", argv[1]);
+      return 1;
+   }
+
+   printf("%s: %d times\n", argv[1], count);
+   printf("  FST:          %10.3f msec\n", textTime);
+   printf("  compiled FST: %10.3f msec\n", compiledTime);
+   if (compiledTime > 0.0)
+      printf("  speedup:      %10.2f\n", textTime / compiledTime);
+
+   return 0;
+}
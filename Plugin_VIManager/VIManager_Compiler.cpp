@@ -0,0 +1,68 @@
+/*
+  Copyright 2022-2023  Nagoya Institute of Technology
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+/* headers */
+
+#include "MMDAgent.h"
+#include "VIManager.h"
+
+/* VIManager_Compiler_usage: print usage */
+static void VIManager_Compiler_usage()
+{
+   fprintf(stderr, "VIManager_compile: compile FST files for fast loading\n");
+   fprintf(stderr, "usage: VIManager_compile file.fst [file.fst ...]\n");
+   fprintf(stderr, "  each FST is saved as \"file.fst%s\", which will be used instead of the FST\n", VIMANAGER_COMPILED_SUFFIX);
+   fprintf(stderr, "  while it is not older than the FST and its included files.\n");
+   fprintf(stderr, "  run in the directory where the FST is loaded, since included files are relative to it.\n");
+}
+
+/* main: compile FST files given in command line */
+int main(int argc, char **argv)
+{
+   MMDAgent *mmdagent;
+   VIManager *vimanager;
+   char buff[MMDAGENT_MAXBUFLEN];
+   int i;
+   int ret = 0;
+
+   if (argc < 2) {
+      VIManager_Compiler_usage();
+      return 1;
+   }
+
+   /* log messages are not output without running MMDAgent */
+   mmdagent = new MMDAgent();
+
+   for (i = 1; i < argc; i++) {
+      vimanager = new VIManager();
+      vimanager->setUseCompiled(false);
+      MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "%s%s", argv[i], VIMANAGER_COMPILED_SUFFIX);
+      if (vimanager->load(mmdagent, 0, NULL, argv[i], argv[i]) == false) {
+         fprintf(stderr, "%s: failed to load, not compiled\n", argv[i]);
+         ret = 1;
+      } else if (vimanager->saveCompiled(buff) == false) {
+         fprintf(stderr, "%s: failed to write\n", buff);
+         ret = 1;
+      } else {
+         printf("%s -> %s\n", argv[i], buff);
+      }
+      delete vimanager;
+   }
+
+   delete mmdagent;
+
+   return ret;
+}
@@ -152,11 +152,11 @@ void VIManager_Logger::addArcToElement(VIManager_Arc *arc, float x, float y)
 }
 
 /* VIManager_Logger::addVariableToElement: draw variable string */
-void VIManager_Logger::addVariableToElement(VIManager_Variable *v, float x, float y)
+void VIManager_Logger::addVariableToElement(const char *name, const char *value, float x, float y)
 {
    char buf[MMDAGENT_MAXBUFLEN];
 
-   MMDAgent_snprintf(buf, MMDAGENT_MAXBUFLEN, "$%s=%s", v->name, v->value);
+   MMDAgent_snprintf(buf, MMDAGENT_MAXBUFLEN, "$%s=%s", name, value);
    if (m_mmdagent->getTextureFont())
       m_mmdagent->getTextureFont()->getTextDrawElements(buf, &m_elem, m_elem.textLen, x, y, 0.0f);
 }
@@ -183,7 +183,11 @@ void VIManager_Logger::addRenderElement(VIManager *vim, float base, float lineHe
    }
 
    if (vim->getFileName()) {
-      MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "---- %s: %s ----", vim->getName(), vim->getFileName());
+      double average, max;
+      if (vim->getLatency(&average, &max) > 0)
+         MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "---- %s: %s (%.2f ms avg, %.2f ms max) ----", vim->getName(), vim->getFileName(), average, max);
+      else
+         MMDAgent_snprintf(buff, MMDAGENT_MAXBUFLEN, "---- %s: %s ----", vim->getName(), vim->getFileName());
       if (m_mmdagent->getTextureFont())
          m_mmdagent->getTextureFont()->getTextDrawElements(buff, &m_elem, m_elem.textLen, 0.0f, base + lineHeight * (numItems - 1), 0.0f);
    }
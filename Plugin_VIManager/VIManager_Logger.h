@@ -92,7 +92,7 @@ private:
    void addArcToElement(VIManager_Arc *arc, float x, float y);
 
    /* drawVariable: draw variable string */
-   void addVariableToElement(VIManager_Variable *v, float x, float y);
+   void addVariableToElement(const char *name, const char *value, float x, float y);
 
    /* initialize: initialize logger */
    void initialize();
@@ -149,6 +149,44 @@ static int VIManager_EventQueue_dequeue(VIManager_EventQueue *q, char *type, cha
    return 1;
 }
 
+/* VIManager_EventQueue_send: send all output commands in queue and empty it */
+static void VIManager_EventQueue_send(MMDAgent *mmdagent, int id, VIManager_EventQueue *q)
+{
+   VIManager_Event *e;
+
+   for (e = q->head; e != NULL; e = e->next)
+      mmdagent->sendMessage(id, e->type, "%s", e->args ? e->args : "");
+   VIManager_EventQueue_clear(q);
+}
+
+/* VIManager_evaluate: evaluate input event and following epsilon transitions, keep output commands in queue */
+static bool VIManager_evaluate(VIManager *vim, const char *itype, const InputArguments *iargs, VIManager_EventQueue *output)
+{
+   char otype[MMDAGENT_MAXBUFLEN];
+   char oargs[MMDAGENT_MAXBUFLEN];
+   double start;
+   bool trans = false;
+
+   start = MMDAgent_getTime();
+
+   /* state transition with input symbol */
+   if (vim->transition(itype, iargs, otype, oargs))
+      trans = true;
+   if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
+      VIManager_EventQueue_enqueue(output, otype, oargs);
+
+   /* state transition with epsilon */
+   while (vim->transition(VIMANAGER_EPSILON, NULL, otype, oargs)) {
+      trans = true;
+      if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
+         VIManager_EventQueue_enqueue(output, otype, oargs);
+   }
+
+   vim->addLatency(MMDAgent_diffTime(MMDAgent_getTime(), start) * 1000.0);
+
+   return trans;
+}
+
 /* mainThread: main thread */
 static void mainThread(void *param)
 {
@@ -156,6 +194,13 @@ static void mainThread(void *param)
    vimanager_thread->run();
 }
 
+/* workerThread: worker thread */
+static void workerThread(void *param)
+{
+   VIManager_Thread *vimanager_thread = (VIManager_Thread *) param;
+   vimanager_thread->runWorker();
+}
+
 /* VIManager_Thread::initialize: initialize thread */
 void VIManager_Thread::initialize()
 {
@@ -173,8 +218,22 @@ void VIManager_Thread::initialize()
    m_thread = -1;
    m_vimList = NULL;
    m_vimNum = 0;
+   m_subList = NULL;
+   m_subNum = 0;
    m_key = NULL;
 
+   m_mutex_worker = NULL;
+   m_cond_worker = NULL;
+   m_cond_done = NULL;
+   m_worker = NULL;
+   m_workerNum = 0;
+   m_jobId = 0;
+   m_jobNext = 0;
+   m_jobDone = 0;
+   m_jobNum = 0;
+   m_jobType = NULL;
+   m_jobArgs = NULL;
+
    m_count = 0;
 
    m_predictword[0] = '\0';
@@ -186,6 +245,7 @@ void VIManager_Thread::initialize()
 void VIManager_Thread::clear()
 {
    VIManager_Link *tmp1, *tmp2;
+   int i;
 
    m_kill = true;
 
@@ -206,6 +266,24 @@ void VIManager_Thread::clear()
          glfwDestroyMutex(m_mutex_sub);
    }
 
+   /* stop workers */
+   if (m_worker != NULL) {
+      glfwLockMutex(m_mutex_worker);
+      glfwBroadcastCond(m_cond_worker);
+      glfwUnlockMutex(m_mutex_worker);
+      for (i = 0; i < m_workerNum; i++) {
+         glfwWaitThread(m_worker[i], GLFW_WAIT);
+         glfwDestroyThread(m_worker[i]);
+      }
+      free(m_worker);
+   }
+   if (m_cond_worker != NULL)
+      glfwDestroyCond(m_cond_worker);
+   if (m_cond_done != NULL)
+      glfwDestroyCond(m_cond_done);
+   if (m_mutex_worker != NULL)
+      glfwDestroyMutex(m_mutex_worker);
+
    /* free */
    VIManager_EventQueue_clear(&eventQueue);
 
@@ -221,6 +299,8 @@ void VIManager_Thread::clear()
 
    if (m_vimList)
       free(m_vimList);
+   if (m_subList)
+      free(m_subList);
 
    initialize();
 }
@@ -244,6 +324,8 @@ bool VIManager_Thread::addSub(const char *label, const char *filename)
 
    /* load file */
    l = new VIManager_Link;
+   VIManager_EventQueue_initialize(&(l->output));
+   l->trans = false;
    if (l->vim.load(m_mmdagent, m_id, m_key, filename, label) == false) {
       delete l;
       return false;
@@ -343,6 +425,15 @@ void VIManager_Thread::updateSubList()
    n = 1;
    for (l = m_sub; l != NULL; l = l->next)
       m_vimList[n++] = &(l->vim);
+
+   /* update sub list for workers */
+   if (m_subList)
+      free(m_subList);
+   m_subNum = m_vimNum - 1;
+   m_subList = (VIManager_Link **)malloc(sizeof(VIManager_Link *) * m_vimNum);
+   n = 0;
+   for (l = m_sub; l != NULL; l = l->next)
+      m_subList[n++] = l;
 }
 
 
@@ -353,6 +444,7 @@ void VIManager_Thread::loadAndStart(MMDAgent *mmdagent, int id, const char *file
    char buf[MMDAGENT_MAXBUFLEN];
    char buf2[MMDAGENT_MAXBUFLEN];
    char *dir, *fst;
+   const char *p;
    int i;
 
    if(mmdagent == NULL)
@@ -409,6 +501,29 @@ void VIManager_Thread::loadAndStart(MMDAgent *mmdagent, int id, const char *file
    m_mutex = glfwCreateMutex();
    m_mutex_sub = glfwCreateMutex();
    m_cond = glfwCreateCond();
+
+   /* start workers to evaluate sub FSTs in parallel, the thread itself also evaluates them */
+   m_mutex_worker = glfwCreateMutex();
+   m_cond_worker = glfwCreateCond();
+   m_cond_done = glfwCreateCond();
+   m_workerNum = glfwGetNumberOfProcessors() - 1;
+   p = m_mmdagent->getKeyValue()->getString(PLUGINVIMANAGER_CONFIG_WORKERS, NULL);
+   if (p != NULL)
+      m_workerNum = MMDAgent_str2int(p);
+   if (m_workerNum > PLUGINVIMANAGER_MAXWORKERS)
+      m_workerNum = PLUGINVIMANAGER_MAXWORKERS;
+   if (m_mutex_worker == NULL || m_cond_worker == NULL || m_cond_done == NULL || m_workerNum < 0)
+      m_workerNum = 0;
+   if (m_workerNum > 0) {
+      m_worker = (GLFWthread *) malloc(sizeof(GLFWthread) * m_workerNum);
+      for (i = 0; i < m_workerNum; i++) {
+         m_worker[i] = glfwCreateThread(workerThread, this);
+         if (m_worker[i] < 0)
+            break;
+      }
+      m_workerNum = i;
+   }
+
    m_thread = glfwCreateThread(mainThread, this);
    if(m_mutex == NULL || m_cond == NULL || m_thread < 0) {
       clear();
@@ -427,27 +542,21 @@ void VIManager_Thread::run()
 {
    char itype[MMDAGENT_MAXBUFLEN];
    char iargs[MMDAGENT_MAXBUFLEN];
-   char otype[MMDAGENT_MAXBUFLEN];
-   char oargs[MMDAGENT_MAXBUFLEN];
    InputArguments ia;
+   VIManager_EventQueue output;
    VIManager_Link *l, *ltmp;
    bool trans;
    bool sub_deleted;
 
+   VIManager_EventQueue_initialize(&output);
+
    /* first epsilon step */
-   while (m_vim->transition(VIMANAGER_EPSILON, NULL, otype, oargs)) {
-      if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-         m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-   }
+   VIManager_evaluate(m_vim, VIMANAGER_EPSILON, NULL, &output);
+   VIManager_EventQueue_send(m_mmdagent, m_id, &output);
 
    glfwLockMutex(m_mutex_sub);
 
-   for(l = m_sub; l != NULL; l = l->next) {
-      while (l->vim.transition(VIMANAGER_EPSILON, NULL, otype, oargs)) {
-         if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-            m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-      }
-   }
+   evaluateSub(VIMANAGER_EPSILON, NULL);
 
    updatePredictWords();
 
@@ -470,36 +579,15 @@ void VIManager_Thread::run()
 
       InputArguments_initialize(&ia, iargs);
 
-      trans = false;
-
-      /* state transition with input symbol */
-      if (m_vim->transition(itype, &ia, otype, oargs))
-         trans = true;
-      if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-         m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-
-      /* state transition with epsilon */
-      while (m_vim->transition(VIMANAGER_EPSILON, NULL, otype, oargs)) {
-         trans = true;
-         if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-            m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-      }
+      /* state transition of main FST, before sub FSTs */
+      trans = VIManager_evaluate(m_vim, itype, &ia, &output);
+      VIManager_EventQueue_send(m_mmdagent, m_id, &output);
 
       glfwLockMutex(m_mutex_sub);
 
-      for(l = m_sub; l != NULL; l = l->next) {
-         if (l->vim.transition(itype, &ia, otype, oargs))
-            trans = true;
-         if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-            m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-
-         /* state transition with epsilon */
-         while (l->vim.transition(VIMANAGER_EPSILON, NULL, otype, oargs)) {
-            trans = true;
-            if (MMDAgent_strequal(otype, VIMANAGER_EPSILON) == false)
-               m_mmdagent->sendMessage(m_id, otype, "%s", oargs);
-         }
-      }
+      /* state transition of sub FSTs */
+      if (evaluateSub(itype, &ia))
+         trans = true;
 
       /* check if a sub fst has reached no arc state and delete it */
       sub_deleted = false;
@@ -534,6 +622,80 @@ void VIManager_Thread::run()
    }
 }
 
+/* VIManager_Thread::runWorker: main loop of worker */
+void VIManager_Thread::runWorker()
+{
+   unsigned int id = 0;
+
+   glfwLockMutex(m_mutex_worker);
+   while (m_kill == false) {
+      if (m_jobId == id) {
+         /* wait for next evaluation */
+         glfwWaitCond(m_cond_worker, m_mutex_worker, GLFW_INFINITY);
+         continue;
+      }
+      id = m_jobId;
+      evaluateJob();
+   }
+   glfwUnlockMutex(m_mutex_worker);
+}
+
+/* VIManager_Thread::evaluateJob: evaluate sub FSTs until no sub FST is left, m_mutex_worker should be locked */
+void VIManager_Thread::evaluateJob()
+{
+   VIManager_Link *l;
+   const char *itype;
+   const InputArguments *iargs;
+
+   while (m_jobNext < m_jobNum) {
+      l = m_subList[m_jobNext++];
+      itype = m_jobType;
+      iargs = m_jobArgs;
+      glfwUnlockMutex(m_mutex_worker);
+      l->trans = VIManager_evaluate(&(l->vim), itype, iargs, &(l->output));
+      glfwLockMutex(m_mutex_worker);
+      m_jobDone++;
+      if (m_jobDone >= m_jobNum)
+         glfwSignalCond(m_cond_done);
+   }
+}
+
+/* VIManager_Thread::evaluateSub: evaluate input event by all sub FSTs and send their output commands in list order */
+bool VIManager_Thread::evaluateSub(const char *itype, const InputArguments *iargs)
+{
+   int i;
+   bool trans = false;
+
+   if (m_workerNum > 0 && m_subNum > 1) {
+      /* sub FSTs are independent each other, evaluate them in parallel with workers */
+      glfwLockMutex(m_mutex_worker);
+      m_jobType = itype;
+      m_jobArgs = iargs;
+      m_jobNext = 0;
+      m_jobDone = 0;
+      m_jobNum = m_subNum;
+      m_jobId++;
+      glfwBroadcastCond(m_cond_worker);
+      evaluateJob();
+      while (m_jobDone < m_jobNum)
+         glfwWaitCond(m_cond_done, m_mutex_worker, GLFW_INFINITY);
+      m_jobNum = 0;
+      glfwUnlockMutex(m_mutex_worker);
+   } else {
+      for (i = 0; i < m_subNum; i++)
+         m_subList[i]->trans = VIManager_evaluate(&(m_subList[i]->vim), itype, iargs, &(m_subList[i]->output));
+   }
+
+   /* send output commands in list order, as the same as sequential evaluation */
+   for (i = 0; i < m_subNum; i++) {
+      if (m_subList[i]->trans == true)
+         trans = true;
+      VIManager_EventQueue_send(m_mmdagent, m_id, &(m_subList[i]->output));
+   }
+
+   return trans;
+}
+
 /* VIManager_Thread::isRunning: check running */
 bool VIManager_Thread::isRunning()
 {
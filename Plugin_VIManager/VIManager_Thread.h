@@ -60,6 +60,9 @@
 #define PLUGINVIMANAGER_SUB_COMMAND_STOP "SUBFST_STOP"
 #define PLUGINVIMANAGER_SUB_EVENT_STOP "SUBFST_EVENT_STOP"
 
+#define PLUGINVIMANAGER_CONFIG_WORKERS "Plugin_VIManager_SubFSTThreads" /* number of threads to evaluate sub FSTs in parallel */
+#define PLUGINVIMANAGER_MAXWORKERS     8                                /* upper limit of the number of threads */
+
 /* VIManager_Event: input message buffer */
 typedef struct _VIManager_Event {
    char *type;
@@ -73,8 +76,11 @@ typedef struct _VIManager_EventQueue {
    VIManager_Event *tail;
 } VIManager_EventQueue;
 
+/* VIManager_Link: list of sub FST */
 typedef struct _VIManager_Link {
    VIManager vim;
+   VIManager_EventQueue output; /* output commands of the last evaluation, sent after all sub FSTs are evaluated */
+   bool trans;                  /* true when transition occurred at the last evaluation */
    struct _VIManager_Link *next;
 } VIManager_Link;
 
@@ -104,6 +110,21 @@ private:
    VIManager **m_vimList; /* all vim list */
    int m_vimNum;
 
+   VIManager_Link **m_subList; /* sub FST list for workers */
+   int m_subNum;
+
+   GLFWmutex m_mutex_worker;  /* mutex for workers */
+   GLFWcond m_cond_worker;    /* condition variable to start workers */
+   GLFWcond m_cond_done;      /* condition variable to notify end of evaluation */
+   GLFWthread *m_worker;      /* worker threads to evaluate sub FSTs */
+   int m_workerNum;
+   unsigned int m_jobId;      /* serial number of evaluation */
+   int m_jobNext;             /* index of sub FST to be evaluated next */
+   int m_jobDone;             /* number of evaluated sub FSTs */
+   int m_jobNum;              /* number of sub FSTs to be evaluated */
+   const char *m_jobType;     /* input event type to be evaluated */
+   const InputArguments *m_jobArgs; /* input event arguments to be evaluated */
+
    ZFileKey *m_key;           /* encryption key */
 
    char m_predictword[MMDAGENT_MAXBUFLEN]; /* comma-separated list of words predicted at current dialogue status */
@@ -114,6 +135,12 @@ private:
    /* clear: free thread */
    void clear();
 
+   /* evaluateJob: evaluate sub FSTs until no sub FST is left, m_mutex_worker should be locked */
+   void evaluateJob();
+
+   /* evaluateSub: evaluate input event by all sub FSTs and send their output commands in list order */
+   bool evaluateSub(const char *itype, const InputArguments *iargs);
+
 public:
 
    /* VIManager_Thraed: thread constructor */
@@ -140,6 +167,9 @@ public:
    /* run: main loop */
    void run();
 
+   /* runWorker: main loop of worker */
+   void runWorker();
+
    /* isRunning: check running */
    bool isRunning();
 
@@ -67,16 +67,55 @@ static void mainThread(void *param)
    cdt->run();
 }
 
+/* CountDown_siftUp: move timer toward root of heap while its goal is earlier than parent */
+static void CountDown_siftUp(CountDown **heap, int i)
+{
+   CountDown *c = heap[i];
+   int parent;
+
+   while (i > 0) {
+      parent = (i - 1) / 2;
+      if (heap[parent]->goal <= c->goal)
+         break;
+      heap[i] = heap[parent];
+      heap[i]->index = i;
+      i = parent;
+   }
+   heap[i] = c;
+   c->index = i;
+}
+
+/* CountDown_siftDown: move timer toward leaves of heap while its goal is later than children */
+static void CountDown_siftDown(CountDown **heap, int num, int i)
+{
+   CountDown *c = heap[i];
+   int child;
+
+   while ((child = i * 2 + 1) < num) {
+      if (child + 1 < num && heap[child + 1]->goal < heap[child]->goal)
+         child++;
+      if (c->goal <= heap[child]->goal)
+         break;
+      heap[i] = heap[child];
+      heap[i]->index = i;
+      i = child;
+   }
+   heap[i] = c;
+   c->index = i;
+}
+
 /* CountDown_Thread::initialize: initialize thread */
 void CountDown_Thread::initialize()
 {
-   m_head = NULL;
-   m_tail = NULL;
+   m_heap = NULL;
+   m_heapNum = 0;
+   m_heapMax = 0;
 
    m_mmdagent = NULL;
    m_id = 0;
 
    m_mutex = NULL;
+   m_cond = NULL;
    m_thread = -1;
 
    m_kill = false;
@@ -85,29 +124,81 @@ void CountDown_Thread::initialize()
 /* CountDown_Thread::clear: free thread */
 void CountDown_Thread::clear()
 {
-   CountDown *tmp1, *tmp2;
+   CountDown *countDown;
+   void *save;
 
    m_kill = true;
 
+   /* wake up thread */
+   if(m_mutex != NULL && m_cond != NULL) {
+      glfwLockMutex(m_mutex);
+      glfwSignalCond(m_cond);
+      glfwUnlockMutex(m_mutex);
+   }
+
    /* wait end of thread */
-   if(m_mutex != NULL || m_thread >= 0) {
+   if(m_mutex != NULL || m_cond != NULL || m_thread >= 0) {
       if(m_thread >= 0) {
          glfwWaitThread(m_thread, GLFW_WAIT);
          glfwDestroyThread(m_thread);
       }
+      if(m_cond != NULL)
+         glfwDestroyCond(m_cond);
       if(m_mutex != NULL)
          glfwDestroyMutex(m_mutex);
    }
 
-   for(tmp1 = m_head; tmp1 ; tmp1 = tmp2) {
-      tmp2 = tmp1->next;
-      free(tmp1->name);
-      free(tmp1);
+   for(countDown = (CountDown *) m_index.firstData(&save); countDown; countDown = (CountDown *) m_index.nextData(&save)) {
+      free(countDown->name);
+      free(countDown);
    }
+   m_index.release();
+   if(m_heap != NULL)
+      free(m_heap);
 
    initialize();
 }
 
+/* CountDown_Thread::push: add timer to heap */
+void CountDown_Thread::push(CountDown *countDown)
+{
+   if(m_heapNum >= m_heapMax) {
+      m_heapMax = (m_heapMax == 0) ? COUNTDOWNTHREAD_HEAPSIZE : m_heapMax * 2;
+      m_heap = (CountDown **) realloc(m_heap, sizeof(CountDown *) * m_heapMax);
+   }
+   m_heap[m_heapNum] = countDown;
+   CountDown_siftUp(m_heap, m_heapNum);
+   m_heapNum++;
+}
+
+/* CountDown_Thread::remove: remove timer from heap */
+void CountDown_Thread::remove(CountDown *countDown)
+{
+   int i = countDown->index;
+
+   if(i < 0)
+      return;
+   countDown->index = -1;
+   m_heapNum--;
+   if(i == m_heapNum)
+      return;
+   /* fill the hole by the last timer */
+   m_heap[i] = m_heap[m_heapNum];
+   m_heap[i]->index = i;
+   update(m_heap[i]);
+}
+
+/* CountDown_Thread::update: move timer in heap after its goal was changed */
+void CountDown_Thread::update(CountDown *countDown)
+{
+   int i = countDown->index;
+
+   if(i > 0 && m_heap[(i - 1) / 2]->goal > countDown->goal)
+      CountDown_siftUp(m_heap, i);
+   else
+      CountDown_siftDown(m_heap, m_heapNum, i);
+}
+
 /* CountDown_Thread::CountDown_Thread: thread constructor */
 CountDown_Thread::CountDown_Thread()
 {
@@ -128,8 +219,9 @@ void CountDown_Thread::setupAndStart(MMDAgent *mmdagent, int id)
 
    glfwInit();
    m_mutex = glfwCreateMutex();
+   m_cond = glfwCreateCond();
    m_thread = glfwCreateThread(mainThread, this);
-   if(m_mutex == NULL || m_thread < 0) {
+   if(m_mutex == NULL || m_cond == NULL || m_thread < 0) {
       clear();
       return;
    }
@@ -138,52 +230,35 @@ void CountDown_Thread::setupAndStart(MMDAgent *mmdagent, int id)
 /* CountDown_Thread::run: check timers */
 void CountDown_Thread::run()
 {
-   CountDown *tmp1, *tmp2;
+   CountDown *countDown;
    double now;
 
-   while(m_kill == false) {
-      /* wait */
-      glfwLockMutex(m_mutex);
+   glfwLockMutex(m_mutex);
 
+   while(m_kill == false) {
       now = MMDAgent_getTime();
 
-      for(tmp1 = m_head; tmp1; tmp1 = tmp2) {
-         tmp2 = tmp1->next;
-         if(tmp1->goal <= now) {
-            if(tmp1 == m_head) {
-               if(tmp1 == m_tail) {
-                  m_head = NULL;
-                  m_tail = NULL;
-               } else {
-                  m_head = tmp1->next;
-                  tmp1->next->prev = NULL;
-               }
-            } else {
-               if(tmp1 == m_tail) {
-                  tmp1->prev->next = NULL;
-                  m_tail = tmp1->prev;
-               } else {
-                  tmp1->prev->next = tmp1->next;
-                  tmp1->next->prev = tmp1->prev;
-               }
-            }
-            m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERSTOPEVENT, "%s", tmp1->name);
-            free(tmp1->name);
-            free(tmp1);
-         }
+      /* issue events of expired timers in order of goal */
+      while(m_heapNum > 0 && m_heap[0]->goal <= now) {
+         countDown = m_heap[0];
+         remove(countDown);
+         m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERSTOPEVENT, "%s", countDown->name);
       }
 
-      /* release */
-      glfwUnlockMutex(m_mutex);
-
-      MMDAgent_sleep(COUNTDOWNTHREAD_SLEEPSEC);
+      /* sleep until the earliest goal, or until a timer with earlier goal is set */
+      if(m_heapNum > 0)
+         glfwWaitCond(m_cond, m_mutex, m_heap[0]->goal - now);
+      else
+         glfwWaitCond(m_cond, m_mutex, GLFW_INFINITY);
    }
+
+   glfwUnlockMutex(m_mutex);
 }
 
 /* CountDown_Thread::isRunning: check running */
 bool CountDown_Thread::isRunning()
 {
-   if (m_kill == true || m_mutex == NULL || m_thread < 0)
+   if (m_kill == true || m_mutex == NULL || m_cond == NULL || m_thread < 0)
       return false;
    else
       return true;
@@ -199,9 +274,12 @@ void CountDown_Thread::stopAndRelease()
 void CountDown_Thread::set(const char *alias, const char *str)
 {
    CountDown *countDown;
+   void *data;
+   int len;
    double sec, now;
 
-   if(MMDAgent_strlen(alias) <= 0) {
+   len = MMDAgent_strlen(alias);
+   if(len <= 0) {
       m_mmdagent->sendLogString(m_id, MLOG_ERROR, "set: null alias string?");
       return;
    }
@@ -215,31 +293,30 @@ void CountDown_Thread::set(const char *alias, const char *str)
    now = MMDAgent_getTime();
 
    /* check the same alias */
-   for(countDown = m_head; countDown; countDown = countDown->next) {
-      if(MMDAgent_strequal(countDown->name, alias))
-         break;
+   if(m_index.search(alias, len, &data) == true) {
+      countDown = (CountDown *) data;
+   } else {
+      countDown = (CountDown *) malloc(sizeof(CountDown));
+      countDown->name = MMDAgent_strdup(alias);
+      countDown->index = -1;
+      m_index.add(alias, len, countDown);
    }
 
    /* push timer */
-   if(countDown == NULL) {
-      countDown = (CountDown *) malloc(sizeof(CountDown));
-      countDown->name = MMDAgent_strdup(alias);
-      countDown->next = NULL;
-      if(m_tail == NULL) {
-         m_head = countDown;
-         countDown->prev = NULL;
-      } else {
-         m_tail->next = countDown;
-         countDown->prev = m_tail;
-      }
-      m_tail = countDown;
+   countDown->goal = now + sec;
+   if(countDown->index < 0) {
+      push(countDown);
    } else {
       m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERCANCELLEDEVENT, "%s", countDown->name);
+      update(countDown);
    }
-   countDown->goal = now + sec;
 
    m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERSTARTEVENT, "%s",  countDown->name);
 
+   /* wake up thread when the earliest goal is changed */
+   if(countDown->index == 0)
+      glfwSignalCond(m_cond);
+
    /* release */
    glfwUnlockMutex(m_mutex);
 }
@@ -247,42 +324,22 @@ void CountDown_Thread::set(const char *alias, const char *str)
 /* CountDown_Thread::unset: unset timer */
 void CountDown_Thread::unset(const char *alias, bool issue_stop)
 {
-   CountDown *tmp1, *tmp2;
+   CountDown *countDown = NULL;
+   void *data;
 
    /* wait */
    glfwLockMutex(m_mutex);
 
-   for(tmp1 = m_head; tmp1; tmp1 = tmp2) {
-      tmp2 = tmp1->next;
-      if(MMDAgent_strequal(tmp1->name, alias)) {
-         if(tmp1 == m_head) {
-            if(tmp1 == m_tail) {
-               m_head = NULL;
-               m_tail = NULL;
-            } else {
-               m_head = tmp1->next;
-               tmp1->next->prev = NULL;
-            }
-         } else {
-            if(tmp1 == m_tail) {
-               m_tail = tmp1->prev;
-               tmp1->prev->next = NULL;
-            } else {
-               tmp1->next->prev = tmp1->prev;
-               tmp1->prev->next = tmp1->next;
-            }
-         }
-         if (issue_stop)
-            m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERSTOPEVENT, "%s", tmp1->name);
-         else
-            m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERCANCELLEDEVENT, "%s", tmp1->name);
-         free(tmp1->name);
-         free(tmp1);
-         break;
-      }
+   if(MMDAgent_strlen(alias) > 0 && m_index.search(alias, MMDAgent_strlen(alias), &data) == true && ((CountDown *) data)->index >= 0) {
+      countDown = (CountDown *) data;
+      remove(countDown);
+      if (issue_stop)
+         m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERSTOPEVENT, "%s", countDown->name);
+      else
+         m_mmdagent->sendMessage(m_id, COUNTDOWNTHREAD_TIMERCANCELLEDEVENT, "%s", countDown->name);
    }
 
-   if (tmp1 == NULL) {
+   if (countDown == NULL) {
       if (issue_stop)
          m_mmdagent->sendLogString(m_id, MLOG_WARNING, "unset: alias \"%s\" not exist", alias);
       else
@@ -56,7 +56,7 @@
 
 /* definitions */
 
-#define COUNTDOWNTHREAD_SLEEPSEC        0.1                 /* check per 0.1 sec */
+#define COUNTDOWNTHREAD_HEAPSIZE        64                  /* initial number of running timers to be allocated */
 #define COUNTDOWNTHREAD_TIMERSTARTEVENT "TIMER_EVENT_START"
 #define COUNTDOWNTHREAD_TIMERSTOPEVENT  "TIMER_EVENT_STOP"
 #define COUNTDOWNTHREAD_TIMERCANCELLEDEVENT  "TIMER_EVENT_CANCELLED"
@@ -65,8 +65,7 @@
 typedef struct _CountDown {
    char *name;
    double goal;
-   struct _CountDown *prev;
-   struct _CountDown *next;
+   int index;   /* position in heap, -1 when not running */
 } CountDown;
 
 /* CountDown_Thread: thread for CountDown */
@@ -74,13 +73,16 @@ class CountDown_Thread
 {
 private:
 
-   CountDown *m_head;    /* head of thread */
-   CountDown *m_tail;    /* tail of thread */
+   PTree m_index;        /* index from alias to timer, timers are kept for reuse */
+   CountDown **m_heap;   /* binary min-heap of running timers ordered by goal */
+   int m_heapNum;        /* number of running timers */
+   int m_heapMax;        /* allocated length of heap */
 
    MMDAgent *m_mmdagent; /* mmdagent */
    int m_id;
 
    GLFWmutex m_mutex;    /* mutex */
+   GLFWcond m_cond;      /* condition variable to wake up when the earliest goal is changed */
    GLFWthread m_thread;  /* thread */
 
    bool m_kill;          /* kill flag */
@@ -91,6 +93,15 @@ private:
    /* clear: free thread */
    void clear();
 
+   /* push: add timer to heap */
+   void push(CountDown *countDown);
+
+   /* remove: remove timer from heap */
+   void remove(CountDown *countDown);
+
+   /* update: move timer in heap after its goal was changed */
+   void update(CountDown *countDown);
+
 public:
 
    /* CountDown_Thraed: thread constructor */
@@ -83,6 +83,7 @@
 #define PLUGINVARIABLES_VALUEUNSETCOMMAND "VALUE_UNSET"
 #define PLUGINVARIABLES_VALUEEVALCOMMAND  "VALUE_EVAL"
 #define PLUGINVARIABLES_VALUEGETCOMMAND   "VALUE_GET"
+#define PLUGINVARIABLES_VALUEADDCOMMAND   "VALUE_ADD"
 
 /* variables */
 
@@ -138,6 +139,15 @@ EXPORT void extProcMessage(MMDAgent *mmdagent, const char *type, const char *arg
          variables.evaluate(p1, p2, p3);
          if(buff)
             free(buff);
+      } else if (MMDAgent_strequal(type, PLUGINVARIABLES_VALUEADDCOMMAND)) {
+         /* VALUE_ADD command */
+         mmdagent->sendLogString(mid, MLOG_MESSAGE_CAPTURED, "%s|%s", type, args);
+         buff = MMDAgent_strdup(args);
+         p1 = MMDAgent_strtok(buff, "|", &save);
+         p2 = MMDAgent_strtok(NULL, "|", &save);
+         variables.add(p1, p2);
+         if(buff)
+            free(buff);
       } else if (MMDAgent_strequal(type, PLUGINVARIABLES_VALUEGETCOMMAND)) {
          /* VALUE_GET command */
          mmdagent->sendLogString(mid, MLOG_MESSAGE_CAPTURED, "%s|%s", type, args);
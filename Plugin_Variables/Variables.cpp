@@ -63,9 +63,6 @@
 /* Variables::initialize: initialize */
 void Variables::initialize()
 {
-   m_head = NULL;
-   m_tail = NULL;
-
    m_mmdagent = NULL;
 
    srand((unsigned) time(NULL));
@@ -74,14 +71,7 @@ void Variables::initialize()
 /* Variables::clear: free */
 void Variables::clear()
 {
-   Value *tmp1, *tmp2;
-
-   for(tmp1 = m_head; tmp1 ; tmp1 = tmp2) {
-      tmp2 = tmp1->next;
-      free(tmp1->name);
-      free(tmp1->sval);
-      free(tmp1);
-   }
+   m_store.release();
 
    initialize();
 }
@@ -111,7 +101,8 @@ void Variables::setup(MMDAgent *mmdagent, int id)
 /* Variables::set: set value */
 void Variables::set(const char *alias, const char *str1, const char *str2)
 {
-   Value *val;
+   char *sval;
+   float fval;
 
    float max, min, tmp;
 
@@ -119,41 +110,19 @@ void Variables::set(const char *alias, const char *str1, const char *str2)
       m_mmdagent->sendLogString(m_id, MLOG_ERROR, "set: null alias string?");
       return;
    }
-   /* check the same alias */
-   for(val = m_head; val; val = val->next) {
-      if(MMDAgent_strequal(val->name, alias))
-         break;
-   }
-
-   /* push */
-   if(val == NULL) {
-      val = (Value *) malloc(sizeof(Value));
-      val->name = MMDAgent_strdup(alias);
-      val->next = NULL;
-      if(m_tail == NULL) {
-         m_head = val;
-         val->prev = NULL;
-      } else {
-         m_tail->next = val;
-         val->prev = m_tail;
-      }
-      m_tail = val;
-   } else {
-      free(val->sval);
-   }
 
    /* set string */
    if(str2 == NULL) {
-      val->sval = MMDAgent_strdup(str1);
+      sval = MMDAgent_strdup(str1);
    } else {
       size_t plen = sizeof(char) * (MMDAgent_strlen(str1) + 1 + MMDAgent_strlen(str2) + 1);
-      val->sval = (char *) malloc(plen);
-      MMDAgent_snprintf(val->sval, plen, "%s|%s", str1, str2);
+      sval = (char *) malloc(plen);
+      MMDAgent_snprintf(sval, plen, "%s|%s", str1, str2);
    }
 
    /* set float */
    if(str2 == NULL) {
-      val->fval = MMDAgent_str2float(str1);
+      fval = MMDAgent_str2float(str1);
    } else {
       min = MMDAgent_str2float(str1);
       max = MMDAgent_str2float(str2);
@@ -162,63 +131,47 @@ void Variables::set(const char *alias, const char *str1, const char *str2)
          max = min;
          min = tmp;
       }
-      val->fval = min + (max - min) * (rand() - 0.0f) * (1.0f / (RAND_MAX - 0.0f)); /* 0.0f is RAND_MIN */
+      fval = min + (max - min) * (rand() - 0.0f) * (1.0f / (RAND_MAX - 0.0f)); /* 0.0f is RAND_MIN */
    }
 
+   m_store.setWithNumber(alias, sval, fval);
+   if(sval)
+      free(sval);
+
    m_mmdagent->sendMessage(m_id, VARIABLES_VALUESETEVENT, "%s", alias); /* send message */
 }
 
 /* Variables::unset: unset value */
 void Variables::unset(const char *alias)
 {
-   Value *tmp1, *tmp2;
+   if(m_store.remove(alias) == true)
+      m_mmdagent->sendMessage(m_id, VARIABLES_VALUEUNSETEVENT, "%s", alias); /* send message */
+   else
+      m_mmdagent->sendLogString(m_id, MLOG_WARNING, "unset: alias \"%s\" not exist", alias);
+}
 
-   for(tmp1 = m_head; tmp1; tmp1 = tmp2) {
-      tmp2 = tmp1->next;
-      if(MMDAgent_strequal(tmp1->name, alias)) {
-         if(tmp1 == m_head) {
-            if(tmp1 == m_tail) {
-               m_head = NULL;
-               m_tail = NULL;
-            } else {
-               m_head = tmp1->next;
-               tmp1->next->prev = NULL;
-            }
-         } else {
-            if(tmp1 == m_tail) {
-               m_tail = tmp1->prev;
-               tmp1->prev->next = NULL;
-            } else {
-               tmp1->next->prev = tmp1->prev;
-               tmp1->prev->next = tmp1->prev;
-            }
-         }
-         m_mmdagent->sendMessage(m_id, VARIABLES_VALUEUNSETEVENT, "%s", tmp1->name); /* send message */
-         free(tmp1->name);
-         free(tmp1->sval);
-         free(tmp1);
-         break;
-      }
+/* Variables::add: add to numeric value */
+void Variables::add(const char *alias, const char *str)
+{
+   if(MMDAgent_strlen(alias) <= 0) {
+      m_mmdagent->sendLogString(m_id, MLOG_ERROR, "add: null alias string?");
+      return;
    }
-   if (tmp1 == NULL)
-      m_mmdagent->sendLogString(m_id, MLOG_WARNING, "unset: alias \"%s\" not exist", alias);
+
+   /* read, add and write are done at once */
+   m_store.addNumber(alias, MMDAgent_str2float(str));
+
+   m_mmdagent->sendMessage(m_id, VARIABLES_VALUESETEVENT, "%s", alias); /* send message */
 }
 
 /* Variables::evaluate: evaluate value */
 void Variables::evaluate(const char *alias, const char *mode, const char *str)
 {
-   Value *val;
    float f1, f2;
    bool ret;
 
    /* get value 1 */
-   for(val = m_head; val; val = val->next) {
-      if(MMDAgent_strequal(val->name, alias) == true) {
-         f1 = val->fval;
-         break;
-      }
-   }
-   if(val == NULL) {
+   if(m_store.getNumber(alias, &f1) == false) {
       m_mmdagent->sendLogString(m_id, MLOG_ERROR, "evaluate: alias \"%s\" not exist", alias);
       return;
    }
@@ -272,13 +225,11 @@ void Variables::evaluate(const char *alias, const char *mode, const char *str)
 /* Variables::get: get value */
 void Variables::get(const char *alias)
 {
-   Value *val;
+   char buf[MMDAGENT_MAXBUFLEN];
 
-   for(val = m_head; val; val = val->next) {
-      if(MMDAgent_strequal(val->name, alias) == true) {
-         m_mmdagent->sendMessage(m_id, VARIABLES_VALUEGETEVENT, "%s|%s", alias, val->sval);
-         return;
-      }
+   if(m_store.copyValue(alias, buf, MMDAGENT_MAXBUFLEN) >= 0) {
+      m_mmdagent->sendMessage(m_id, VARIABLES_VALUEGETEVENT, "%s|%s", alias, buf);
+      return;
    }
    m_mmdagent->sendLogString(m_id, MLOG_WARNING, "get: alias \"%s\" not exist", alias);
 }
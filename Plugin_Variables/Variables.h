@@ -70,22 +70,12 @@
 #define VARIABLES_TRUE  "TRUE"
 #define VARIABLES_FALSE "FALSE"
 
-/* Value: value */
-typedef struct _Value {
-   char *name;
-   char *sval;
-   float fval;
-   struct _Value *prev;
-   struct _Value *next;
-} Value;
-
 /* Variables: variables manager */
 class Variables
 {
 private:
 
-   Value *m_head;        /* head of variables manager */
-   Value *m_tail;        /* tail of variables manager */
+   VariableStore m_store; /* variables */
 
    MMDAgent *m_mmdagent; /* mmdagent */
    int m_id;
@@ -113,6 +103,9 @@ public:
    /* unset: unset value */
    void unset(const char *alias);
 
+   /* add: add to numeric value */
+   void add(const char *alias, const char *str);
+
    /* evaluate: evaluate value */
    void evaluate(const char *alias, const char *mode, const char *str);
 